@@ -84,6 +84,20 @@ AddArchiveMailDialog::AddArchiveMailDialog(ArchiveMailInfo *info, QWidget *paren
     mRecursiveCheckBox->setChecked(true);
     ++row;
 
+    mIncrementalCheckBox = new QCheckBox(i18n("Only archive new and modified messages"), this);
+    mIncrementalCheckBox->setObjectName(QStringLiteral("incremental_checkbox"));
+    mIncrementalCheckBox->setWhatsThis(i18n("Each archive only contains the messages added or modified since the previous one. "
+                                            "All archives are kept, and an interrupted archive resumes where it stopped."));
+    mainLayout->addWidget(mIncrementalCheckBox, row, 0, 1, 2, Qt::AlignLeft);
+    ++row;
+
+    mDeduplicatedCheckBox = new QCheckBox(i18n("Store each message only once across archives"), this);
+    mDeduplicatedCheckBox->setObjectName(QStringLiteral("deduplicated_checkbox"));
+    mDeduplicatedCheckBox->setWhatsThis(i18n("Each archive describes the complete folder, but messages already stored by a previous archive "
+                                             "are not stored again. Removing old archives only frees the messages no other archive contains."));
+    mainLayout->addWidget(mDeduplicatedCheckBox, row, 0, 1, 2, Qt::AlignLeft);
+    ++row;
+
     QLabel *pathLabel = new QLabel(i18n("Path:"), this);
     mainLayout->addWidget(pathLabel, row, 0);
     pathLabel->setObjectName(QStringLiteral("path_label"));
@@ -118,6 +132,9 @@ AddArchiveMailDialog::AddArchiveMailDialog(ArchiveMailInfo *info, QWidget *paren
     mMaximumArchive->setSpecialValueText(i18n("unlimited"));
     maxCountlabel->setBuddy(mMaximumArchive);
     mainLayout->addWidget(mMaximumArchive, row, 1);
+    mMaximumArchiveLabel = maxCountlabel;
+    connect(mIncrementalCheckBox, &QCheckBox::toggled, this, &AddArchiveMailDialog::slotUpdateArchiveMode);
+    connect(mDeduplicatedCheckBox, &QCheckBox::toggled, this, &AddArchiveMailDialog::slotUpdateArchiveMode);
     ++row;
 
     mainLayout->addWidget(new KSeparator, row, 0, row, 2);
@@ -151,6 +168,8 @@ void AddArchiveMailDialog::load(ArchiveMailInfo *info)
 {
     mPath->setUrl(info->url());
     mRecursiveCheckBox->setChecked(info->saveSubCollection());
+    mIncrementalCheckBox->setChecked(info->isIncremental());
+    mDeduplicatedCheckBox->setChecked(info->isDeduplicated());
     mFolderRequester->setCollection(Akonadi::Collection(info->saveCollectionId()));
     mFormatComboBox->setFormat(info->archiveType());
     mDays->setValue(info->archiveAge());
@@ -165,6 +184,8 @@ ArchiveMailInfo *AddArchiveMailDialog::info()
         mInfo = new ArchiveMailInfo();
     }
     mInfo->setSaveSubCollection(mRecursiveCheckBox->isChecked());
+    mInfo->setIncremental(mIncrementalCheckBox->isChecked() && !mDeduplicatedCheckBox->isChecked());
+    mInfo->setDeduplicated(mDeduplicatedCheckBox->isChecked());
     mInfo->setArchiveType(mFormatComboBox->format());
     mInfo->setSaveCollectionId(mFolderRequester->collection().id());
     mInfo->setUrl(mPath->url());
@@ -180,6 +201,18 @@ void AddArchiveMailDialog::slotUpdateOkButton()
     mOkButton->setEnabled(valid);
 }
 
+void AddArchiveMailDialog::slotUpdateArchiveMode()
+{
+    // A deduplicated store has its own format and is always incremental
+    const bool deduplicated = mDeduplicatedCheckBox->isChecked();
+    mFormatComboBox->setDisabled(deduplicated);
+    mIncrementalCheckBox->setDisabled(deduplicated);
+    // Incremental archives depend on each other, they can't be expired
+    const bool canExpire = deduplicated || !mIncrementalCheckBox->isChecked();
+    mMaximumArchive->setEnabled(canExpire);
+    mMaximumArchiveLabel->setEnabled(canExpire);
+}
+
 void AddArchiveMailDialog::slotFolderChanged(const Akonadi::Collection &collection)
 {
     Q_UNUSED(collection);
@@ -206,6 +239,26 @@ bool AddArchiveMailDialog::recursive() const
     return mRecursiveCheckBox->isChecked();
 }
 
+void AddArchiveMailDialog::setIncremental(bool b)
+{
+    mIncrementalCheckBox->setChecked(b);
+}
+
+bool AddArchiveMailDialog::incremental() const
+{
+    return mIncrementalCheckBox->isChecked();
+}
+
+void AddArchiveMailDialog::setDeduplicated(bool b)
+{
+    mDeduplicatedCheckBox->setChecked(b);
+}
+
+bool AddArchiveMailDialog::deduplicated() const
+{
+    return mDeduplicatedCheckBox->isChecked();
+}
+
 void AddArchiveMailDialog::setSelectedFolder(const Akonadi::Collection &collection)
 {
     mFolderRequester->setCollection(collection);
@@ -26,6 +26,7 @@
 #include <Collection>
 class QUrl;
 class QCheckBox;
+class QLabel;
 class KUrlRequester;
 class QSpinBox;
 class QPushButton;
@@ -49,6 +50,12 @@ public:
     void setRecursive(bool b);
     bool recursive() const;
 
+    void setIncremental(bool b);
+    bool incremental() const;
+
+    void setDeduplicated(bool b);
+    bool deduplicated() const;
+
     void setSelectedFolder(const Akonadi::Collection &collection);
     Akonadi::Collection selectedFolder() const;
 
@@ -64,14 +71,18 @@ public:
 private:
     void slotFolderChanged(const Akonadi::Collection &);
     void slotUpdateOkButton();
+    void slotUpdateArchiveMode();
     void load(ArchiveMailInfo *info);
     MailCommon::FolderRequester *mFolderRequester = nullptr;
     FormatComboBox *mFormatComboBox = nullptr;
     UnitComboBox *mUnits = nullptr;
     QCheckBox *mRecursiveCheckBox = nullptr;
+    QCheckBox *mIncrementalCheckBox = nullptr;
+    QCheckBox *mDeduplicatedCheckBox = nullptr;
     KUrlRequester *mPath = nullptr;
     QSpinBox *mDays = nullptr;
     QSpinBox *mMaximumArchive = nullptr;
+    QLabel *mMaximumArchiveLabel = nullptr;
 
     ArchiveMailInfo *mInfo = nullptr;
     QPushButton *mOkButton = nullptr;
@@ -42,6 +42,8 @@ ArchiveMailInfo::ArchiveMailInfo(const ArchiveMailInfo &info)
     mSaveSubCollection = info.saveSubCollection();
     mPath = info.url();
     mIsEnabled = info.isEnabled();
+    mIncremental = info.isIncremental();
+    mDeduplicated = info.isDeduplicated();
 }
 
 ArchiveMailInfo::~ArchiveMailInfo()
@@ -59,6 +61,8 @@ ArchiveMailInfo &ArchiveMailInfo::operator=(const ArchiveMailInfo &old)
     mSaveSubCollection = old.saveSubCollection();
     mPath = old.url();
     mIsEnabled = old.isEnabled();
+    mIncremental = old.isIncremental();
+    mDeduplicated = old.isDeduplicated();
     return *this;
 }
 
@@ -97,6 +101,20 @@ QUrl ArchiveMailInfo::realUrl(const QString &folderName, bool &dirExist) const
     return real;
 }
 
+QString ArchiveMailInfo::manifestPath(const QString &folderName, bool &dirExist) const
+{
+    const QString dirPath = dirArchive(dirExist);
+    return dirPath + QLatin1String("/.") + i18nc("Start of the filename for a mail archive file", "Archive")
+           + QLatin1Char('_') + normalizeFolderName(folderName) + QLatin1String(".manifest");
+}
+
+QString ArchiveMailInfo::storePath(const QString &folderName, bool &dirExist) const
+{
+    const QString dirPath = dirArchive(dirExist);
+    return dirPath + QLatin1Char('/') + i18nc("Start of the filename for a mail archive file", "Archive")
+           + QLatin1Char('_') + normalizeFolderName(folderName) + QLatin1String(".store");
+}
+
 QStringList ArchiveMailInfo::listOfArchive(const QString &folderName, bool &dirExist) const
 {
     const int numExtensions = 4;
@@ -175,6 +193,8 @@ void ArchiveMailInfo::readConfig(const KConfigGroup &config)
         mSaveCollectionId = tId;
     }
     mIsEnabled = config.readEntry("enabled", true);
+    mIncremental = config.readEntry("incremental", false);
+    mDeduplicated = config.readEntry("deduplicated", false);
 }
 
 void ArchiveMailInfo::writeConfig(KConfigGroup &config)
@@ -195,6 +215,8 @@ void ArchiveMailInfo::writeConfig(KConfigGroup &config)
     config.writeEntry("archiveAge", mArchiveAge);
     config.writeEntry("maximumArchiveCount", mMaximumArchiveCount);
     config.writeEntry("enabled", mIsEnabled);
+    config.writeEntry("incremental", mIncremental);
+    config.writeEntry("deduplicated", mDeduplicated);
     config.sync();
 }
 
@@ -248,6 +270,26 @@ void ArchiveMailInfo::setEnabled(bool b)
     mIsEnabled = b;
 }
 
+bool ArchiveMailInfo::isIncremental() const
+{
+    return mIncremental;
+}
+
+void ArchiveMailInfo::setIncremental(bool b)
+{
+    mIncremental = b;
+}
+
+bool ArchiveMailInfo::isDeduplicated() const
+{
+    return mDeduplicated;
+}
+
+void ArchiveMailInfo::setDeduplicated(bool b)
+{
+    mDeduplicated = b;
+}
+
 bool ArchiveMailInfo::operator==(const ArchiveMailInfo &other) const
 {
     return saveCollectionId() == other.saveCollectionId()
@@ -258,5 +300,7 @@ bool ArchiveMailInfo::operator==(const ArchiveMailInfo &other) const
            && archiveAge() == other.archiveAge()
            && lastDateSaved() == other.lastDateSaved()
            && maximumArchiveCount() == other.maximumArchiveCount()
-           && isEnabled() == other.isEnabled();
+           && isEnabled() == other.isEnabled()
+           && isIncremental() == other.isIncremental()
+           && isDeduplicated() == other.isDeduplicated();
 }
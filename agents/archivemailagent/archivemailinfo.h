@@ -78,6 +78,33 @@ public:
     bool isEnabled() const;
     void setEnabled(bool b);
 
+    /**
+     * In incremental mode each run only archives the messages added or
+     * changed since the previous run, see IncrementalArchiveJob.
+     */
+    bool isIncremental() const;
+    void setIncremental(bool b);
+
+    /**
+     * Returns the file remembering the messages already archived from
+     * @p folderName in incremental mode.
+     */
+    QString manifestPath(const QString &folderName, bool &dirExist) const;
+
+    /**
+     * In deduplicated mode the archives of a folder are generations of an
+     * ArchiveStore, which stores each message only once across generations.
+     * The archive type and incremental mode don't apply then, and
+     * maximumArchiveCount() limits the number of generations.
+     */
+    bool isDeduplicated() const;
+    void setDeduplicated(bool b);
+
+    /**
+     * Returns the directory of the ArchiveStore of @p folderName.
+     */
+    QString storePath(const QString &folderName, bool &dirExist) const;
+
     bool operator ==(const ArchiveMailInfo &other) const;
 
 private:
@@ -91,6 +118,8 @@ private:
     int mMaximumArchiveCount = 0;
     bool mSaveSubCollection = false;
     bool mIsEnabled = true;
+    bool mIncremental = false;
+    bool mDeduplicated = false;
 };
 
 #endif // ARCHIVEMAILINFO_H
@@ -19,7 +19,8 @@
 
 #include "archivemailmanager.h"
 #include "archivemailinfo.h"
-#include "job/archivejob.h"
+#include "job/archivejobscheduler.h"
+#include "archivemailagentsettings.h"
 #include "archivemailkernel.h"
 #include "archivemailagentutil.h"
 
@@ -42,11 +43,13 @@ ArchiveMailManager::ArchiveMailManager(QObject *parent)
     CommonKernel->registerKernelIf(mArchiveMailKernel);   //register KernelIf early, it is used by the Filter classes
     CommonKernel->registerSettingsIf(mArchiveMailKernel);   //SettingsIf is used in FolderTreeWidget
     mConfig = KSharedConfig::openConfig();
+    mScheduler = new ArchiveJobScheduler(this, this);
+    mScheduler->setMaximumRunningJobs(ArchiveMailAgentSettings::maximumConcurrentArchives());
+    mScheduler->writeBudget()->setBytesPerSecond(qint64(ArchiveMailAgentSettings::maximumWriteRate()) * 1024);
 }
 
 ArchiveMailManager::~ArchiveMailManager()
 {
-    qDeleteAll(mListArchiveInfo);
 }
 
 void ArchiveMailManager::slotArchiveNow(ArchiveMailInfo *info)
@@ -54,40 +57,20 @@ void ArchiveMailManager::slotArchiveNow(ArchiveMailInfo *info)
     if (!info) {
         return;
     }
-    ArchiveMailInfo *stockInfo = new ArchiveMailInfo(*info);
-    mListArchiveInfo.append(stockInfo);
-    ScheduledArchiveTask *task = new ScheduledArchiveTask(this, stockInfo, Akonadi::Collection(stockInfo->saveCollectionId()), true /*immediat*/);
-    mArchiveMailKernel->jobScheduler()->registerTask(task);
+    mScheduler->enqueue(*info, true /*immediat*/);
 }
 
 void ArchiveMailManager::load()
 {
-    qDeleteAll(mListArchiveInfo);
-    mListArchiveInfo.clear();
-
     const QStringList collectionList = mConfig->groupList().filter(QRegularExpression(QStringLiteral("ArchiveMailCollection \\d+")));
     const int numberOfCollection = collectionList.count();
     for (int i = 0; i < numberOfCollection; ++i) {
         KConfigGroup group = mConfig->group(collectionList.at(i));
-        ArchiveMailInfo *info = new ArchiveMailInfo(group);
-
-        if (ArchiveMailAgentUtil::needToArchive(info)) {
-            for (ArchiveMailInfo *oldInfo : qAsConst(mListArchiveInfo)) {
-                if (oldInfo->saveCollectionId() == info->saveCollectionId()) {
-                    //already in jobscheduler
-                    delete info;
-                    info = nullptr;
-                    break;
-                }
-            }
-            if (info) {
-                //Store task started
-                mListArchiveInfo.append(info);
-                ScheduledArchiveTask *task = new ScheduledArchiveTask(this, info, Akonadi::Collection(info->saveCollectionId()), /*immediate*/ false);
-                mArchiveMailKernel->jobScheduler()->registerTask(task);
-            }
-        } else {
-            delete info;
+        ArchiveMailInfo info(group);
+
+        if (ArchiveMailAgentUtil::needToArchive(&info)) {
+            //Skipped when already in jobscheduler
+            mScheduler->enqueue(info, /*immediate*/ false);
         }
     }
 }
@@ -105,11 +88,8 @@ void ArchiveMailManager::removeCollectionId(Akonadi::Collection::Id id)
         group.deleteGroup();
         mConfig->sync();
         mConfig->reparseConfiguration();
-        foreach (ArchiveMailInfo *info, mListArchiveInfo) { //Don't port to for(...:...)
-            if (info->saveCollectionId() == id) {
-                mListArchiveInfo.removeAll(info);
-            }
-        }
+        // Archives already running finish, waiting ones are dropped
+        mScheduler->dequeue(id);
     }
 }
 
@@ -126,7 +106,9 @@ void ArchiveMailManager::backupDone(ArchiveMailInfo *info)
     const QString realPath = MailCommon::Util::fullCollectionPath(collection);
     bool dirExist = true;
     const QStringList lst = info->listOfArchive(realPath, dirExist);
-    if (dirExist) {
+    // Each incremental archive only holds the changes of one run, none can be dropped.
+    // A deduplicated store expires its generations itself.
+    if (dirExist && !info->isIncremental() && !info->isDeduplicated()) {
         if (info->maximumArchiveCount() != 0) {
             if (lst.count() > info->maximumArchiveCount()) {
                 const int diff = (lst.count() - info->maximumArchiveCount());
@@ -138,7 +120,6 @@ void ArchiveMailManager::backupDone(ArchiveMailInfo *info)
             }
         }
     }
-    mListArchiveInfo.removeAll(info);
 
     Q_EMIT needUpdateConfigDialogBox();
 }
@@ -146,44 +127,43 @@ void ArchiveMailManager::backupDone(ArchiveMailInfo *info)
 void ArchiveMailManager::collectionDoesntExist(ArchiveMailInfo *info)
 {
     removeCollectionId(info->saveCollectionId());
-    mListArchiveInfo.removeAll(info);
     Q_EMIT needUpdateConfigDialogBox();
 }
 
 void ArchiveMailManager::pause()
 {
-    mArchiveMailKernel->jobScheduler()->pause();
+    mScheduler->pause();
 }
 
 void ArchiveMailManager::resume()
 {
-    mArchiveMailKernel->jobScheduler()->resume();
+    mScheduler->resume();
 }
 
 QString ArchiveMailManager::printCurrentListInfo()
 {
-    QString infoStr;
-    if (mListArchiveInfo.isEmpty()) {
-        infoStr = QStringLiteral("No archive in queue");
+    QString infoStr = mScheduler->toString() + QLatin1Char('\n');
+    const QVector<const ArchiveMailInfo *> infos = mScheduler->infos();
+    if (infos.isEmpty()) {
+        infoStr += QStringLiteral("No archive in queue");
     } else {
-        for (ArchiveMailInfo *info : qAsConst(mListArchiveInfo)) {
-            if (!infoStr.isEmpty()) {
-                infoStr += QLatin1Char('\n');
-            }
-            infoStr += infoToStr(info);
+        for (const ArchiveMailInfo *info : infos) {
+            infoStr += QLatin1Char('\n') + infoToStr(info);
         }
     }
     return infoStr;
 }
 
-QString ArchiveMailManager::infoToStr(ArchiveMailInfo *info) const
+QString ArchiveMailManager::infoToStr(const ArchiveMailInfo *info) const
 {
     QString infoStr = QLatin1String("collectionId: ") + QString::number(info->saveCollectionId()) + QLatin1Char('\n');
     infoStr += QLatin1String("save sub collection: ") + (info->saveSubCollection() ? QStringLiteral("true") : QStringLiteral("false")) + QLatin1Char('\n');
     infoStr += QLatin1String("last Date Saved: ") + info->lastDateSaved().toString() + QLatin1Char('\n');
     infoStr += QLatin1String("maximum archive number: ") + QString::number(info->maximumArchiveCount()) + QLatin1Char('\n');
     infoStr += QLatin1String("directory: ") + info->url().toDisplayString() + QLatin1Char('\n');
-    infoStr += QLatin1String("Enabled: ") + (info->isEnabled() ? QStringLiteral("true") : QStringLiteral("false"));
+    infoStr += QLatin1String("Enabled: ") + (info->isEnabled() ? QStringLiteral("true") : QStringLiteral("false")) + QLatin1Char('\n');
+    infoStr += QLatin1String("Incremental: ") + (info->isIncremental() ? QStringLiteral("true") : QStringLiteral("false")) + QLatin1Char('\n');
+    infoStr += QLatin1String("Deduplicated: ") + (info->isDeduplicated() ? QStringLiteral("true") : QStringLiteral("false"));
     return infoStr;
 }
 
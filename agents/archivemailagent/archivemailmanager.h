@@ -27,6 +27,7 @@
 
 class ArchiveMailKernel;
 class ArchiveMailInfo;
+class ArchiveJobScheduler;
 
 class ArchiveMailManager : public QObject
 {
@@ -51,6 +52,11 @@ public:
         return mArchiveMailKernel;
     }
 
+    ArchiveJobScheduler *scheduler() const
+    {
+        return mScheduler;
+    }
+
 public Q_SLOTS:
     void load();
     void slotArchiveNow(ArchiveMailInfo *info);
@@ -60,11 +66,11 @@ Q_SIGNALS:
 
 private:
     Q_DISABLE_COPY(ArchiveMailManager)
-    QString infoToStr(ArchiveMailInfo *info) const;
+    QString infoToStr(const ArchiveMailInfo *info) const;
     void removeCollectionId(Akonadi::Collection::Id id);
     KSharedConfig::Ptr mConfig;
-    QList<ArchiveMailInfo *> mListArchiveInfo;
     ArchiveMailKernel *mArchiveMailKernel = nullptr;
+    ArchiveJobScheduler *mScheduler = nullptr;
 };
 
 #endif /* ARCHIVEMAILMANAGER_H */
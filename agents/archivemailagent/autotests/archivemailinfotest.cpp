@@ -47,6 +47,8 @@ void ArchiveMailInfoTest::shouldHaveDefaultValue()
     QCOMPARE(info.lastDateSaved(), QDate());
     QCOMPARE(info.maximumArchiveCount(), 0);
     QCOMPARE(info.isEnabled(), true);
+    QCOMPARE(info.isIncremental(), false);
+    QCOMPARE(info.isDeduplicated(), false);
 }
 
 void ArchiveMailInfoTest::shouldRestoreFromSettings()
@@ -60,6 +62,8 @@ void ArchiveMailInfoTest::shouldRestoreFromSettings()
     info.setLastDateSaved(QDate::currentDate());
     info.setMaximumArchiveCount(5);
     info.setEnabled(false);
+    info.setIncremental(true);
+    info.setDeduplicated(true);
 
     KConfigGroup grp(KSharedConfig::openConfig(), "testsettings");
     info.writeConfig(grp);
@@ -79,6 +83,8 @@ void ArchiveMailInfoTest::shouldCopyArchiveInfo()
     info.setLastDateSaved(QDate::currentDate());
     info.setMaximumArchiveCount(5);
     info.setEnabled(false);
+    info.setIncremental(true);
+    info.setDeduplicated(true);
 
     ArchiveMailInfo copyInfo(info);
     QCOMPARE(info, copyInfo);
@@ -0,0 +1,134 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "archivemanifesttest.h"
+#include "../job/archivemanifest.h"
+#include <QFile>
+#include <QTemporaryDir>
+#include <qtest.h>
+
+ArchiveManifestTest::ArchiveManifestTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+static Akonadi::Item createItem(Akonadi::Item::Id id, int revision)
+{
+    Akonadi::Item item(id);
+    item.setRevision(revision);
+    return item;
+}
+
+void ArchiveManifestTest::shouldHaveDefaultValue()
+{
+    ArchiveManifest manifest;
+    QVERIFY(manifest.isEmpty());
+    QCOMPARE(manifest.count(), 0);
+    QVERIFY(manifest.needsArchiving(createItem(1, 0)));
+}
+
+void ArchiveManifestTest::shouldDetectNewAndModifiedItems()
+{
+    ArchiveManifest manifest;
+    manifest.markArchived(createItem(1, 3));
+    manifest.markArchived(createItem(2, 0));
+    QCOMPARE(manifest.count(), 2);
+    QVERIFY(!manifest.needsArchiving(createItem(1, 3)));
+    QVERIFY(!manifest.needsArchiving(createItem(2, 0)));
+    // modified since
+    QVERIFY(manifest.needsArchiving(createItem(1, 4)));
+    // new
+    QVERIFY(manifest.needsArchiving(createItem(3, 0)));
+
+    manifest.markArchived(createItem(1, 4));
+    QCOMPARE(manifest.count(), 2);
+    QVERIFY(!manifest.needsArchiving(createItem(1, 4)));
+}
+
+void ArchiveManifestTest::shouldSaveAndLoad()
+{
+    QTemporaryDir dir;
+    const QString fileName = dir.path() + QStringLiteral("/archive.manifest");
+
+    // a missing manifest means nothing was archived yet
+    ArchiveManifest manifest;
+    QVERIFY(manifest.load(fileName));
+    QVERIFY(manifest.isEmpty());
+
+    for (int i = 0; i < 1000; ++i) {
+        manifest.markArchived(createItem(i, i % 7));
+    }
+    QVERIFY(manifest.save(fileName));
+
+    ArchiveManifest restored;
+    QVERIFY(restored.load(fileName));
+    QCOMPARE(restored.count(), 1000);
+    QVERIFY(!restored.needsArchiving(createItem(500, 500 % 7)));
+    QVERIFY(restored.needsArchiving(createItem(500, 42)));
+    QVERIFY(restored.needsArchiving(createItem(1000, 0)));
+}
+
+void ArchiveManifestTest::shouldRejectInvalidFile()
+{
+    QTemporaryDir dir;
+    const QString fileName = dir.path() + QStringLiteral("/archive.manifest");
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("not a manifest");
+    file.close();
+
+    ArchiveManifest manifest;
+    manifest.markArchived(createItem(1, 0));
+    QVERIFY(!manifest.load(fileName));
+    QVERIFY(manifest.isEmpty());
+}
+
+void ArchiveManifestTest::shouldDropUnlistedItemsOnSave()
+{
+    QTemporaryDir dir;
+    const QString fileName = dir.path() + QStringLiteral("/archive.manifest");
+
+    ArchiveManifest manifest;
+    for (int i = 0; i < 10; ++i) {
+        manifest.markArchived(createItem(i, 1));
+    }
+    // items 0 to 3 were deleted from the folder
+    for (int i = 4; i < 10; ++i) {
+        manifest.markListed(createItem(i, 1));
+    }
+    QCOMPARE(manifest.unlistedCount(), 0);
+    QVERIFY(manifest.save(fileName));
+
+    // an incomplete listing keeps every entry
+    ArchiveManifest restored;
+    QVERIFY(restored.load(fileName));
+    QCOMPARE(restored.count(), 10);
+
+    manifest.setListingComplete();
+    QCOMPARE(manifest.unlistedCount(), 4);
+    QVERIFY(manifest.save(fileName));
+
+    QVERIFY(restored.load(fileName));
+    QCOMPARE(restored.count(), 6);
+    QCOMPARE(restored.unlistedCount(), 0);
+    QVERIFY(restored.needsArchiving(createItem(0, 1)));
+    QVERIFY(!restored.needsArchiving(createItem(4, 1)));
+}
+
+QTEST_MAIN(ArchiveManifestTest)
@@ -0,0 +1,323 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "archivestoretest.h"
+#include "../job/archivestore.h"
+#include <QFile>
+#include <QHash>
+#include <QTemporaryDir>
+#include <qtest.h>
+
+ArchiveStoreTest::ArchiveStoreTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+// A message of a few KiB which doesn't compress away
+static QByteArray createMessage(qint64 id)
+{
+    QByteArray message = "Message-ID: <" + QByteArray::number(id) + "@example.org>\nSubject: message " + QByteArray::number(id) + "\n\n";
+    quint32 seed = quint32(id) * 2654435761u + 1;
+    for (int i = 0; i < 4096; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        message += char('a' + (seed >> 16) % 26);
+        if (i % 72 == 71) {
+            message += '\n';
+        }
+    }
+    return message;
+}
+
+static ArchiveStore::Entry createEntry(qint64 id, int revision, const QByteArray &hash)
+{
+    ArchiveStore::Entry entry;
+    entry.itemId = id;
+    entry.revision = revision;
+    entry.path = QStringLiteral("inbox");
+    entry.hash = hash;
+    entry.time = QDateTime(QDate(2018, 1, 1), QTime(12, 0));
+    return entry;
+}
+
+// Same steps as DeduplicatedArchiveJob, @p folder maps item ids to revisions
+static bool archiveGeneration(ArchiveStore &store, const QHash<qint64, int> &folder, int maximumGenerations, qint64 *written, int *fetched)
+{
+    QHash<qint64, ArchiveStore::Entry> previous;
+    ArchiveStore::Generation entries;
+    if (!store.latestGeneration().isEmpty()) {
+        if (!store.readGeneration(store.latestGeneration(), entries)) {
+            return false;
+        }
+        for (const ArchiveStore::Entry &entry : qAsConst(entries)) {
+            previous.insert(entry.itemId, entry);
+        }
+        entries.clear();
+    }
+    *written = 0;
+    *fetched = 0;
+    for (auto it = folder.constBegin(); it != folder.constEnd(); ++it) {
+        const auto old = previous.constFind(it.key());
+        if (old != previous.constEnd() && old->revision == it.value()) {
+            entries.append(old.value());
+            continue;
+        }
+        qint64 size = 0;
+        const QByteArray hash = store.insert(createMessage(it.key()), &size);
+        if (hash.isEmpty()) {
+            return false;
+        }
+        *written += size;
+        ++*fetched;
+        entries.append(createEntry(it.key(), it.value(), hash));
+    }
+    if (store.writeGeneration(entries).isEmpty()) {
+        return false;
+    }
+    store.expire(maximumGenerations);
+    return true;
+}
+
+void ArchiveStoreTest::shouldStoreMessagesOnce()
+{
+    QTemporaryDir dir;
+    ArchiveStore store(dir.path() + QStringLiteral("/store"));
+    QVERIFY(store.open());
+    QCOMPARE(store.objectCount(), 0);
+
+    const QByteArray message = createMessage(1);
+    qint64 written = -1;
+    const QByteArray hash = store.insert(message, &written);
+    QCOMPARE(hash, ArchiveStore::hash(message));
+    QVERIFY(written > 0);
+    QVERIFY(written < message.size());
+    QVERIFY(store.contains(hash));
+
+    QCOMPARE(store.insert(message, &written), hash);
+    QCOMPARE(written, qint64(0));
+    QCOMPARE(store.objectCount(), 1);
+    QCOMPARE(store.message(hash), message);
+
+    QVERIFY(!store.contains(ArchiveStore::hash(createMessage(2))));
+}
+
+void ArchiveStoreTest::shouldWriteGenerationsInOrder()
+{
+    QTemporaryDir dir;
+    ArchiveStore store(dir.path());
+    QVERIFY(store.open());
+    QVERIFY(store.generations().isEmpty());
+    QVERIFY(store.latestGeneration().isEmpty());
+
+    ArchiveStore::Generation entries;
+    QStringList names;
+    for (int i = 0; i < 12; ++i) {
+        entries.append(createEntry(i, i, store.insert(createMessage(i))));
+        const QString name = store.writeGeneration(entries, QDate(2018, 1, 1));
+        QVERIFY(!name.isEmpty());
+        names << name;
+    }
+    QCOMPARE(store.generations(), names);
+    QCOMPARE(store.latestGeneration(), names.last());
+
+    ArchiveStore::Generation restored;
+    QVERIFY(store.readGeneration(names.at(4), restored));
+    QCOMPARE(restored.count(), 5);
+    QCOMPARE(restored.at(3).itemId, qint64(3));
+    QCOMPARE(restored.at(3).revision, 3);
+    QCOMPARE(restored.at(3).path, QStringLiteral("inbox"));
+    QCOMPARE(restored.at(3).hash, ArchiveStore::hash(createMessage(3)));
+    QCOMPARE(restored.at(3).time, entries.at(3).time);
+}
+
+void ArchiveStoreTest::shouldRejectInvalidGeneration()
+{
+    QTemporaryDir dir;
+    ArchiveStore store(dir.path());
+    QVERIFY(store.open());
+    QFile file(dir.path() + QStringLiteral("/generations/000001_2018-01-01.gen"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("not a generation");
+    file.close();
+
+    ArchiveStore::Generation entries;
+    entries.append(createEntry(1, 1, "1234"));
+    QVERIFY(!store.readGeneration(QStringLiteral("000001_2018-01-01"), entries));
+    QVERIFY(entries.isEmpty());
+    // Nothing is removed while a generation can't be read
+    store.insert(createMessage(1));
+    QCOMPARE(store.collectGarbage(), 0);
+    QCOMPARE(store.objectCount(), 1);
+}
+
+void ArchiveStoreTest::shouldExpireOnlyUnreferencedMessages()
+{
+    QTemporaryDir dir;
+    ArchiveStore store(dir.path());
+    QVERIFY(store.open());
+    const QByteArray a = store.insert(createMessage(1));
+    const QByteArray b = store.insert(createMessage(2));
+    const QByteArray c = store.insert(createMessage(3));
+
+    store.writeGeneration({ createEntry(1, 0, a), createEntry(2, 0, b) });
+    store.writeGeneration({ createEntry(2, 0, b), createEntry(3, 0, c) });
+    QCOMPARE(store.expire(0), 0);
+    QCOMPARE(store.generations().count(), 2);
+
+    qint64 freed = 0;
+    QCOMPARE(store.expire(1, &freed), 1);
+    QCOMPARE(store.generations().count(), 1);
+    QVERIFY(freed > 0);
+    QVERIFY(!store.contains(a));
+    QVERIFY(store.contains(b));
+    QVERIFY(store.contains(c));
+    QCOMPARE(store.message(b), createMessage(2));
+}
+
+void ArchiveStoreTest::shouldCollectOrphanMessages()
+{
+    QTemporaryDir dir;
+    ArchiveStore store(dir.path());
+    QVERIFY(store.open());
+    const QByteArray a = store.insert(createMessage(1));
+    store.writeGeneration({ createEntry(1, 0, a) });
+    // stored by an interrupted run, no generation references it
+    const QByteArray orphan = store.insert(createMessage(2));
+
+    QCOMPARE(store.collectGarbage(), 1);
+    QVERIFY(store.contains(a));
+    QVERIFY(!store.contains(orphan));
+}
+
+void ArchiveStoreTest::shouldSaveSpaceAcrossGenerations()
+{
+    // A folder receiving new mail between runs, some old messages get their
+    // flags changed (new revision, same content) and a few are deleted.
+    const int generationCount = 60;
+    const int newMessagesPerRun = 40;
+    const int changedPerRun = 10;
+    const int maximumGenerations = 10;
+
+    QTemporaryDir dir;
+    ArchiveStore store(dir.path());
+    QVERIFY(store.open());
+
+    QHash<qint64, int> folder; // item id -> revision
+    qint64 nextId = 0;
+    qint64 fullArchiveSize = 0;
+    QVector<qint64> fullArchiveSizes;
+    QVector<qint64> writtenSizes;
+    QVector<int> fetchedCounts;
+
+    for (int generation = 0; generation < generationCount; ++generation) {
+        for (int i = 0; i < newMessagesPerRun; ++i) {
+            const qint64 id = nextId++;
+            folder.insert(id, 0);
+            fullArchiveSize += qCompress(createMessage(id)).size();
+        }
+        for (int i = 0; i < changedPerRun && generation > 0; ++i) {
+            const qint64 id = (generation * 7919 + i * 104729) % (nextId - newMessagesPerRun);
+            if (folder.contains(id)) {
+                folder[id] += 1;
+            }
+        }
+        if (generation % 5 == 4) {
+            const qint64 id = (generation * 31) % nextId;
+            if (folder.remove(id)) {
+                fullArchiveSize -= qCompress(createMessage(id)).size();
+            }
+        }
+
+        qint64 written = 0;
+        int fetched = 0;
+        QVERIFY(archiveGeneration(store, folder, maximumGenerations, &written, &fetched));
+
+        fullArchiveSizes.append(fullArchiveSize);
+        writtenSizes.append(written);
+        fetchedCounts.append(fetched);
+    }
+
+    // The full archives kept by maximumArchiveCount
+    qint64 keptFullArchives = 0;
+    for (int i = generationCount - maximumGenerations; i < generationCount; ++i) {
+        keptFullArchives += fullArchiveSizes.at(i);
+    }
+    const qint64 storeSize = store.size();
+    QCOMPARE(store.generations().count(), maximumGenerations);
+    QVERIFY(storeSize * 4 < keptFullArchives);
+
+    // Every run only fetches the new and changed messages, and only writes
+    // the new ones, whatever the size of the folder
+    const qint64 newMessagesSize = qCompress(createMessage(nextId - 1)).size() * newMessagesPerRun;
+    for (int generation = 1; generation < generationCount; ++generation) {
+        QVERIFY(fetchedCounts.at(generation) <= newMessagesPerRun + changedPerRun);
+        QVERIFY(writtenSizes.at(generation) < newMessagesSize * 11 / 10);
+    }
+
+    // Every message of the kept generations is still readable
+    ArchiveStore::Generation oldest;
+    QVERIFY(store.readGeneration(store.generations().first(), oldest));
+    for (const ArchiveStore::Entry &entry : qAsConst(oldest)) {
+        QCOMPARE(store.message(entry.hash), createMessage(entry.itemId));
+    }
+    QCOMPARE(store.collectGarbage(), 0);
+}
+
+void ArchiveStoreTest::benchmarkFirstGeneration()
+{
+    QTemporaryDir dir;
+    ArchiveStore store(dir.path());
+    QVERIFY(store.open());
+    QHash<qint64, int> folder;
+    for (qint64 id = 0; id < 2000; ++id) {
+        folder.insert(id, 0);
+    }
+    qint64 written = 0;
+    int fetched = 0;
+    // the store keeps the messages, only the first run writes them all
+    QBENCHMARK_ONCE {
+        QVERIFY(archiveGeneration(store, folder, 10, &written, &fetched));
+    }
+    QCOMPARE(fetched, folder.count());
+}
+
+void ArchiveStoreTest::benchmarkNextGeneration()
+{
+    QTemporaryDir dir;
+    ArchiveStore store(dir.path());
+    QVERIFY(store.open());
+    QHash<qint64, int> folder;
+    qint64 nextId = 0;
+    for (; nextId < 2000; ++nextId) {
+        folder.insert(nextId, 0);
+    }
+    qint64 written = 0;
+    int fetched = 0;
+    QVERIFY(archiveGeneration(store, folder, 10, &written, &fetched));
+
+    // every run archives the new messages of a folder of the same size
+    QBENCHMARK {
+        for (int i = 0; i < 40; ++i) {
+            folder.insert(nextId++, 0);
+        }
+        QVERIFY(archiveGeneration(store, folder, 10, &written, &fetched));
+    }
+    QCOMPARE(fetched, 40);
+}
+
+QTEST_MAIN(ArchiveStoreTest)
@@ -0,0 +1,65 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "archivewritebudgettest.h"
+#include "../job/archivewritebudget.h"
+#include <qtest.h>
+
+ArchiveWriteBudgetTest::ArchiveWriteBudgetTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void ArchiveWriteBudgetTest::shouldHaveDefaultValue()
+{
+    ArchiveWriteBudget budget;
+    QCOMPARE(budget.bytesPerSecond(), qint64(0));
+    QCOMPARE(budget.totalBytes(), qint64(0));
+}
+
+void ArchiveWriteBudgetTest::shouldNotThrottleWhenUnlimited()
+{
+    ArchiveWriteBudget budget;
+    QCOMPARE(budget.reserve(1024 * 1024, 0), qint64(0));
+    QCOMPARE(budget.reserve(1024 * 1024, 0), qint64(0));
+    QCOMPARE(budget.totalBytes(), qint64(2 * 1024 * 1024));
+}
+
+void ArchiveWriteBudgetTest::shouldShareRateBetweenWriters()
+{
+    ArchiveWriteBudget budget;
+    budget.setBytesPerSecond(1000);
+    // two writers writing 500 bytes at the same time, the second waits for the first
+    QCOMPARE(budget.reserve(500, 0), qint64(500));
+    QCOMPARE(budget.reserve(500, 0), qint64(1000));
+    // a third one half a second later
+    QCOMPARE(budget.reserve(1000, 500), qint64(1500));
+    QCOMPARE(budget.totalBytes(), qint64(2000));
+}
+
+void ArchiveWriteBudgetTest::shouldNotSaveUpUnusedBudget()
+{
+    ArchiveWriteBudget budget;
+    budget.setBytesPerSecond(1000);
+    QCOMPARE(budget.reserve(100, 0), qint64(100));
+    // idle for ten seconds doesn't allow a burst afterwards
+    QCOMPARE(budget.reserve(1000, 10000), qint64(1000));
+}
+
+QTEST_MAIN(ArchiveWriteBudgetTest)
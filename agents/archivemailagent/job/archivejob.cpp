@@ -18,6 +18,9 @@
 */
 
 #include "archivejob.h"
+#include "archivejobscheduler.h"
+#include "deduplicatedarchivejob.h"
+#include "incrementalarchivejob.h"
 #include "archivemailinfo.h"
 #include "archivemailmanager.h"
 #include "archivemailkernel.h"
@@ -39,11 +42,16 @@ ArchiveJob::ArchiveJob(ArchiveMailManager *manager, ArchiveMailInfo *info, const
     , mManager(manager)
 {
     mPixmap = QIcon::fromTheme(QStringLiteral("kmail")).pixmap(KIconLoader::SizeSmall, KIconLoader::SizeSmall);
+    // An incremental archive can be interrupted and resumed later
+    setCancellable(info && (info->isIncremental() || info->isDeduplicated()));
 }
 
 ArchiveJob::~ArchiveJob()
 {
-    delete mInfo;
+    // An interrupted task is scheduled again with the same info
+    if (!mInterrupted) {
+        delete mInfo;
+    }
 }
 
 void ArchiveJob::execute()
@@ -78,8 +86,38 @@ void ArchiveJob::execute()
             return;
         }
 
+        const Akonadi::Collection rootFolder = Akonadi::EntityTreeModel::updatedCollection(mManager->kernel()->collectionModel(), collection);
+        const QString summary = i18n("Start to archive %1", realPath);
+        KNotification::event(QStringLiteral("archivemailstarted"),
+                             summary,
+                             mPixmap,
+                             nullptr,
+                             KNotification::CloseOnTimeout,
+                             QStringLiteral("akonadi_archivemail_agent"));
+        if (mInfo->isIncremental() || mInfo->isDeduplicated()) {
+            if (mInfo->isDeduplicated()) {
+                DeduplicatedArchiveJob *job = new DeduplicatedArchiveJob(this);
+                job->setSaveLocation(QUrl::fromLocalFile(mInfo->storePath(realPath, dirExit)));
+                job->setMaximumGenerations(mInfo->maximumArchiveCount());
+                mIncrementalJob = job;
+            } else {
+                mIncrementalJob = new IncrementalArchiveJob(this);
+                mIncrementalJob->setSaveLocation(archivePath);
+                mIncrementalJob->setManifestPath(mInfo->manifestPath(realPath, dirExit));
+                mIncrementalJob->setArchiveType(mInfo->archiveType());
+            }
+            mIncrementalJob->setRootFolder(rootFolder);
+            mIncrementalJob->setRecursive(mInfo->saveSubCollection());
+            mIncrementalJob->setRealPath(realPath);
+            mIncrementalJob->setWriteBudget(mManager->scheduler()->writeBudget());
+            connect(mIncrementalJob.data(), &IncrementalArchiveJob::archiveDone, this, &ArchiveJob::slotBackupDone);
+            connect(mIncrementalJob.data(), &IncrementalArchiveJob::error, this, &ArchiveJob::slotError);
+            mIncrementalJob->start();
+            return;
+        }
+
         MailCommon::BackupJob *backupJob = new MailCommon::BackupJob();
-        backupJob->setRootFolder(Akonadi::EntityTreeModel::updatedCollection(mManager->kernel()->collectionModel(), collection));
+        backupJob->setRootFolder(rootFolder);
 
         backupJob->setSaveLocation(archivePath);
         backupJob->setArchiveType(mInfo->archiveType());
@@ -87,13 +125,6 @@ void ArchiveJob::execute()
         backupJob->setRecursive(mInfo->saveSubCollection());
         backupJob->setDisplayMessageBox(false);
         backupJob->setRealPath(realPath);
-        const QString summary = i18n("Start to archive %1", realPath);
-        KNotification::event(QStringLiteral("archivemailstarted"),
-                             summary,
-                             mPixmap,
-                             nullptr,
-                             KNotification::CloseOnTimeout,
-                             QStringLiteral("akonadi_archivemail_agent"));
         connect(backupJob, &MailCommon::BackupJob::backupDone, this, &ArchiveJob::slotBackupDone);
         connect(backupJob, &MailCommon::BackupJob::error, this, &ArchiveJob::slotError);
         backupJob->start();
@@ -126,10 +157,12 @@ void ArchiveJob::slotBackupDone(const QString &info)
 
 void ArchiveJob::kill()
 {
+    if (mIncrementalJob) {
+        // Keeps the messages archived so far, the next run resumes from there
+        mIncrementalJob->disconnect(this);
+        mIncrementalJob->stop();
+        mInterrupted = true;
+        Q_EMIT interrupted();
+    }
     ScheduledJob::kill();
 }
-
-MailCommon::ScheduledJob *ScheduledArchiveTask::run()
-{
-    return folder().isValid() ? new ArchiveJob(mManager, mInfo, folder(), isImmediate()) : nullptr;
-}
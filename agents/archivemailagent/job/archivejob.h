@@ -23,7 +23,9 @@
 #include <MailCommon/JobScheduler>
 #include <Collection>
 #include <QPixmap>
+#include <QPointer>
 class ArchiveMailInfo;
+class IncrementalArchiveJob;
 class ArchiveMailManager;
 
 class ArchiveJob : public MailCommon::ScheduledJob
@@ -36,41 +38,21 @@ public:
     void execute() override;
     void kill() override;
 
+Q_SIGNALS:
+    /**
+     * Emitted when kill() stopped an incremental archive which has to be
+     * resumed later. The info is then not deleted with the job.
+     */
+    void interrupted();
+
 private:
     void slotBackupDone(const QString &info);
     void slotError(const QString &error);
     QPixmap mPixmap;
     ArchiveMailInfo *mInfo = nullptr;
     ArchiveMailManager *mManager = nullptr;
-};
-
-/// A scheduled "expire mails in this folder" task.
-class ScheduledArchiveTask : public MailCommon::ScheduledTask
-{
-public:
-    /// If immediate is set, the job will execute synchronously. This is used when
-    /// the user requests explicitly that the operation should happen immediately.
-    ScheduledArchiveTask(ArchiveMailManager *manager, ArchiveMailInfo *info, const Akonadi::Collection &folder, bool immediate)
-        : MailCommon::ScheduledTask(folder, immediate)
-        , mInfo(info)
-        , mManager(manager)
-    {
-    }
-
-    ~ScheduledArchiveTask()
-    {
-    }
-
-    MailCommon::ScheduledJob *run() override;
-
-    int taskTypeId() const override
-    {
-        return 2;
-    }
-
-private:
-    ArchiveMailInfo *mInfo = nullptr;
-    ArchiveMailManager *mManager = nullptr;
+    QPointer<IncrementalArchiveJob> mIncrementalJob;
+    bool mInterrupted = false;
 };
 
 #endif // ARCHIVEJOB_H
@@ -0,0 +1,283 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "archivejobscheduler.h"
+#include "archivejob.h"
+#include "archivemailinfo.h"
+#include "archivemailagent_debug.h"
+
+#include <AkonadiCore/CollectionStatistics>
+#include <AkonadiCore/CollectionStatisticsJob>
+
+#include <QDate>
+
+#include <algorithm>
+
+ArchiveJobScheduler::ArchiveJobScheduler(ArchiveMailManager *manager, QObject *parent)
+    : QObject(parent)
+    , mManager(manager)
+{
+}
+
+ArchiveJobScheduler::~ArchiveJobScheduler()
+{
+    // the infos of running archives are owned by their job
+    for (const Entry &entry : qAsConst(mQueue)) {
+        delete entry.info;
+    }
+    for (const Entry &entry : qAsConst(mStatisticsJobs)) {
+        delete entry.info;
+    }
+    for (const Entry &entry : qAsConst(mInterrupted)) {
+        delete entry.info;
+    }
+}
+
+void ArchiveJobScheduler::setMaximumRunningJobs(int count)
+{
+    mMaximumRunningJobs = qMax(1, count);
+    startJobs();
+}
+
+int ArchiveJobScheduler::maximumRunningJobs() const
+{
+    return mMaximumRunningJobs;
+}
+
+ArchiveWriteBudget *ArchiveJobScheduler::writeBudget()
+{
+    return &mWriteBudget;
+}
+
+bool ArchiveJobScheduler::contains(Akonadi::Collection::Id id) const
+{
+    for (const Entry &entry : qAsConst(mQueue)) {
+        if (entry.info->saveCollectionId() == id) {
+            return true;
+        }
+    }
+    for (const Entry &entry : qAsConst(mStatisticsJobs)) {
+        if (entry.info && entry.info->saveCollectionId() == id) {
+            return true;
+        }
+    }
+    for (const Entry &entry : qAsConst(mRunning)) {
+        if (entry.info->saveCollectionId() == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ArchiveJobScheduler::enqueue(const ArchiveMailInfo &info, bool immediate)
+{
+    const Akonadi::Collection::Id id = info.saveCollectionId();
+    if (contains(id)) {
+        if (immediate) {
+            // Don't archive the folder twice, but don't make the user wait either
+            for (int i = 0; i < mQueue.count(); ++i) {
+                if (mQueue.at(i).info->saveCollectionId() == id && !mQueue.at(i).immediate) {
+                    Entry entry = mQueue.takeAt(i);
+                    entry.immediate = true;
+                    insert(entry);
+                    break;
+                }
+            }
+            for (auto it = mStatisticsJobs.begin(), end = mStatisticsJobs.end(); it != end; ++it) {
+                if (it->info && it->info->saveCollectionId() == id) {
+                    it->immediate = true;
+                }
+            }
+            startJobs();
+        }
+        return false;
+    }
+    Entry entry;
+    entry.info = new ArchiveMailInfo(info);
+    entry.immediate = immediate;
+    if (immediate) {
+        // requested by the user, don't wait for the folder size
+        insert(entry);
+        startJobs();
+        return true;
+    }
+    Akonadi::CollectionStatisticsJob *job = new Akonadi::CollectionStatisticsJob(Akonadi::Collection(id), this);
+    connect(job, &KJob::result, this, &ArchiveJobScheduler::slotStatisticsFetched);
+    mStatisticsJobs.insert(job, entry);
+    return true;
+}
+
+void ArchiveJobScheduler::slotStatisticsFetched(KJob *job)
+{
+    Entry entry = mStatisticsJobs.take(job);
+    if (!entry.info) {
+        // dequeued in the meantime
+        return;
+    }
+    if (!job->error()) {
+        entry.size = static_cast<Akonadi::CollectionStatisticsJob *>(job)->statistics().size();
+    }
+    insert(entry);
+    startJobs();
+}
+
+bool ArchiveJobScheduler::hasPriority(const Entry &lhs, const Entry &rhs)
+{
+    if (lhs.immediate != rhs.immediate) {
+        return lhs.immediate;
+    }
+    // Never archived folders first, then the ones archived longest ago
+    const QDate lhsDate = lhs.info->lastDateSaved();
+    const QDate rhsDate = rhs.info->lastDateSaved();
+    if (lhsDate != rhsDate) {
+        if (!lhsDate.isValid() || !rhsDate.isValid()) {
+            return !lhsDate.isValid();
+        }
+        return lhsDate < rhsDate;
+    }
+    // Start the longest archives first
+    return lhs.size > rhs.size;
+}
+
+void ArchiveJobScheduler::insert(const Entry &entry)
+{
+    const auto it = std::upper_bound(mQueue.begin(), mQueue.end(), entry, &ArchiveJobScheduler::hasPriority);
+    mQueue.insert(it, entry);
+}
+
+void ArchiveJobScheduler::dequeue(Akonadi::Collection::Id id)
+{
+    for (auto it = mQueue.begin(); it != mQueue.end();) {
+        if (it->info->saveCollectionId() == id) {
+            delete it->info;
+            it = mQueue.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = mStatisticsJobs.begin(), end = mStatisticsJobs.end(); it != end; ++it) {
+        if (it->info && it->info->saveCollectionId() == id) {
+            delete it->info;
+            it->info = nullptr;
+        }
+    }
+}
+
+QVector<const ArchiveMailInfo *> ArchiveJobScheduler::infos() const
+{
+    QVector<const ArchiveMailInfo *> result;
+    for (const Entry &entry : qAsConst(mRunning)) {
+        result << entry.info;
+    }
+    for (const Entry &entry : qAsConst(mQueue)) {
+        result << entry.info;
+    }
+    for (const Entry &entry : qAsConst(mStatisticsJobs)) {
+        if (entry.info) {
+            result << entry.info;
+        }
+    }
+    return result;
+}
+
+void ArchiveJobScheduler::startJobs()
+{
+    while (!mPaused && mRunning.count() < mMaximumRunningJobs && !mQueue.isEmpty()) {
+        const Entry entry = mQueue.takeFirst();
+        ArchiveJob *job = new ArchiveJob(mManager, entry.info, Akonadi::Collection(entry.info->saveCollectionId()), entry.immediate);
+        mRunning.insert(job, entry);
+        connect(job, &QObject::destroyed, this, &ArchiveJobScheduler::slotJobDestroyed);
+        connect(job, &ArchiveJob::interrupted, this, [this, job, entry]() {
+            mInterrupted.insert(job, entry);
+        });
+        qCDebug(ARCHIVEMAILAGENT_LOG) << "Start archiving collection" << entry.info->saveCollectionId()
+                                      << "running:" << mRunning.count() << "queued:" << mQueue.count();
+        job->start();
+    }
+}
+
+void ArchiveJobScheduler::slotJobDestroyed(QObject *job)
+{
+    mRunning.remove(job);
+    const auto it = mInterrupted.find(job);
+    if (it != mInterrupted.end()) {
+        // resumed from its manifest when it runs again
+        insert(it.value());
+        mInterrupted.erase(it);
+    }
+    startJobs();
+}
+
+void ArchiveJobScheduler::pause()
+{
+    mPaused = true;
+    // Only incremental archives can be interrupted without losing work, the
+    // others finish what they started
+    const QList<QObject *> running = mRunning.keys();
+    for (QObject *object : running) {
+        ArchiveJob *job = static_cast<ArchiveJob *>(object);
+        if (job->isCancellable()) {
+            job->kill();
+        }
+    }
+}
+
+void ArchiveJobScheduler::resume()
+{
+    mPaused = false;
+    startJobs();
+}
+
+bool ArchiveJobScheduler::isPaused() const
+{
+    return mPaused;
+}
+
+int ArchiveJobScheduler::runningCount() const
+{
+    return mRunning.count();
+}
+
+int ArchiveJobScheduler::queuedCount() const
+{
+    return mQueue.count() + mStatisticsJobs.count();
+}
+
+QString ArchiveJobScheduler::toString() const
+{
+    QString str = QStringLiteral("Running archives: %1/%2%3\n").arg(mRunning.count()).arg(mMaximumRunningJobs)
+                  .arg(mPaused ? QStringLiteral(" (paused)") : QString());
+    if (mWriteBudget.bytesPerSecond() > 0) {
+        str += QStringLiteral("Write rate limit: %1 KiB/s\n").arg(mWriteBudget.bytesPerSecond() / 1024);
+    } else {
+        str += QStringLiteral("Write rate limit: unlimited\n");
+    }
+    str += QStringLiteral("Written by incremental archives: %1 bytes\n").arg(mWriteBudget.totalBytes());
+    for (const Entry &entry : qAsConst(mRunning)) {
+        str += QStringLiteral("running: collectionId %1\n").arg(entry.info->saveCollectionId());
+    }
+    str += QStringLiteral("Queued archives: %1").arg(queuedCount());
+    for (int i = 0; i < mQueue.count(); ++i) {
+        const Entry &entry = mQueue.at(i);
+        str += QStringLiteral("\n%1. collectionId %2, size: %3, last archive: %4%5").arg(i + 1).arg(entry.info->saveCollectionId())
+               .arg(entry.size).arg(entry.info->lastDateSaved().toString(Qt::ISODate))
+               .arg(entry.immediate ? QStringLiteral(" (immediate)") : QString());
+    }
+    return str;
+}
@@ -0,0 +1,113 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef ARCHIVEJOBSCHEDULER_H
+#define ARCHIVEJOBSCHEDULER_H
+
+#include "archivewritebudget.h"
+
+#include <AkonadiCore/Collection>
+
+#include <QHash>
+#include <QObject>
+#include <QVector>
+
+class ArchiveMailInfo;
+class ArchiveMailManager;
+class KJob;
+
+/**
+ * @short Runs several archive jobs at the same time within a global budget.
+ *
+ * At most maximumRunningJobs() archives are written concurrently, which
+ * bounds the CPU spent compressing, and incremental archives share the disk
+ * write rate of writeBudget(). Waiting archives are started in priority
+ * order: explicitly requested ones first, then the folders whose last
+ * archive is oldest, then the biggest folders, so that the longest archives
+ * don't end up running alone at the end.
+ */
+class ArchiveJobScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ArchiveJobScheduler(ArchiveMailManager *manager, QObject *parent = nullptr);
+    ~ArchiveJobScheduler() override;
+
+    void setMaximumRunningJobs(int count);
+    int maximumRunningJobs() const;
+
+    ArchiveWriteBudget *writeBudget();
+
+    /**
+     * Queues the archive of a copy of @p info. Returns false when the folder
+     * is already waiting or being archived, a waiting archive is then only
+     * moved ahead if @p immediate is set.
+     */
+    bool enqueue(const ArchiveMailInfo &info, bool immediate);
+
+    /**
+     * Returns whether an archive of @p id is waiting or running.
+     */
+    bool contains(Akonadi::Collection::Id id) const;
+
+    /**
+     * Removes the waiting archives of @p id from the queue.
+     */
+    void dequeue(Akonadi::Collection::Id id);
+
+    /**
+     * Returns the infos of the running and waiting archives.
+     */
+    QVector<const ArchiveMailInfo *> infos() const;
+
+    void pause();
+    void resume();
+    bool isPaused() const;
+
+    int runningCount() const;
+    int queuedCount() const;
+
+    QString toString() const;
+
+private:
+    struct Entry {
+        ArchiveMailInfo *info = nullptr;
+        // total size of the folder in bytes, -1 while unknown
+        qint64 size = -1;
+        bool immediate = false;
+    };
+
+    static bool hasPriority(const Entry &lhs, const Entry &rhs);
+    void slotStatisticsFetched(KJob *job);
+    void insert(const Entry &entry);
+    void startJobs();
+    void slotJobDestroyed(QObject *job);
+
+    ArchiveMailManager *mManager = nullptr;
+    ArchiveWriteBudget mWriteBudget;
+    QVector<Entry> mQueue;
+    QHash<QObject *, Entry> mRunning;
+    QHash<QObject *, Entry> mInterrupted;
+    // entries waiting for the size of their folder
+    QHash<KJob *, Entry> mStatisticsJobs;
+    int mMaximumRunningJobs = 2;
+    bool mPaused = false;
+};
+
+#endif // ARCHIVEJOBSCHEDULER_H
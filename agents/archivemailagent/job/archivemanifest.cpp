@@ -0,0 +1,141 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "archivemanifest.h"
+#include "archivemailagent_debug.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+
+namespace {
+const quint32 manifestMagic = 0x414d4d46; // "AMMF"
+const quint32 manifestVersion = 1;
+}
+
+ArchiveManifest::ArchiveManifest()
+{
+}
+
+bool ArchiveManifest::load(const QString &fileName)
+{
+    clear();
+    QFile file(fileName);
+    if (!file.exists()) {
+        return true;
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Impossible to open archive manifest" << fileName << file.errorString();
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_9);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != manifestMagic || version != manifestVersion) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Invalid archive manifest" << fileName;
+        return false;
+    }
+    stream >> mRevisions;
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Corrupted archive manifest" << fileName;
+        mRevisions.clear();
+        return false;
+    }
+    return true;
+}
+
+bool ArchiveManifest::save(const QString &fileName) const
+{
+    // QSaveFile keeps the previous manifest if we're interrupted while writing
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Impossible to write archive manifest" << fileName << file.errorString();
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_9);
+    if (unlistedCount() > 0) {
+        // drop the messages deleted from the folder since
+        QHash<Akonadi::Item::Id, int> revisions;
+        revisions.reserve(mListed.count());
+        for (auto it = mRevisions.constBegin(), end = mRevisions.constEnd(); it != end; ++it) {
+            if (mListed.contains(it.key())) {
+                revisions.insert(it.key(), it.value());
+            }
+        }
+        stream << manifestMagic << manifestVersion << revisions;
+    } else {
+        stream << manifestMagic << manifestVersion << mRevisions;
+    }
+    return file.commit();
+}
+
+bool ArchiveManifest::needsArchiving(const Akonadi::Item &item) const
+{
+    const auto it = mRevisions.constFind(item.id());
+    return it == mRevisions.constEnd() || it.value() != item.revision();
+}
+
+void ArchiveManifest::markArchived(const Akonadi::Item &item)
+{
+    mRevisions.insert(item.id(), item.revision());
+}
+
+void ArchiveManifest::markListed(const Akonadi::Item &item)
+{
+    mListed.insert(item.id());
+}
+
+void ArchiveManifest::setListingComplete()
+{
+    mListingComplete = true;
+}
+
+int ArchiveManifest::unlistedCount() const
+{
+    if (!mListingComplete) {
+        return 0;
+    }
+    int count = 0;
+    for (auto it = mRevisions.constBegin(), end = mRevisions.constEnd(); it != end; ++it) {
+        if (!mListed.contains(it.key())) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+int ArchiveManifest::count() const
+{
+    return mRevisions.count();
+}
+
+bool ArchiveManifest::isEmpty() const
+{
+    return mRevisions.isEmpty();
+}
+
+void ArchiveManifest::clear()
+{
+    mRevisions.clear();
+    mListed.clear();
+    mListingComplete = false;
+}
@@ -0,0 +1,81 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef ARCHIVEMANIFEST_H
+#define ARCHIVEMANIFEST_H
+
+#include <AkonadiCore/Item>
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+/**
+ * @short Remembers which messages an incremental archive already contains.
+ *
+ * For every archived message the manifest keeps the Akonadi revision it was
+ * archived with, so that the next run only has to write messages which were
+ * added or changed since. The manifest is only saved once the archive file
+ * holding the recorded messages has been closed successfully, so an
+ * interrupted run is resumed from the last complete archive file.
+ *
+ * Once the whole folder was listed, the messages which were not listed have
+ * been deleted and their entries are dropped when the manifest is saved.
+ */
+class ArchiveManifest
+{
+public:
+    ArchiveManifest();
+
+    /**
+     * Loads the manifest from @p fileName. A missing file gives an empty
+     * manifest, i.e. the next run archives everything.
+     */
+    bool load(const QString &fileName);
+    bool save(const QString &fileName) const;
+
+    bool needsArchiving(const Akonadi::Item &item) const;
+    void markArchived(const Akonadi::Item &item);
+
+    /**
+     * Records that @p item is still in the archived folder.
+     */
+    void markListed(const Akonadi::Item &item);
+
+    /**
+     * Called once every message of the folder was passed to markListed().
+     */
+    void setListingComplete();
+
+    /**
+     * Returns the number of entries of messages which are not in the folder
+     * anymore, 0 until the listing is complete.
+     */
+    int unlistedCount() const;
+
+    int count() const;
+    bool isEmpty() const;
+    void clear();
+
+private:
+    QHash<Akonadi::Item::Id, int> mRevisions;
+    QSet<Akonadi::Item::Id> mListed;
+    bool mListingComplete = false;
+};
+
+#endif // ARCHIVEMANIFEST_H
@@ -0,0 +1,282 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "archivestore.h"
+#include "archivemailagent_debug.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+
+namespace {
+const quint32 generationMagic = 0x414d4447; // "AMDG"
+const quint32 generationVersion = 1;
+const QString objectsDir = QStringLiteral("objects");
+const QString generationsDir = QStringLiteral("generations");
+const QString generationSuffix = QStringLiteral(".gen");
+}
+
+ArchiveStore::ArchiveStore(const QString &path)
+    : mPath(path)
+{
+}
+
+QString ArchiveStore::path() const
+{
+    return mPath;
+}
+
+bool ArchiveStore::open()
+{
+    QDir dir(mPath);
+    if (!dir.mkpath(objectsDir) || !dir.mkpath(generationsDir)) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Impossible to create archive store" << mPath;
+        return false;
+    }
+    return true;
+}
+
+QByteArray ArchiveStore::hash(const QByteArray &data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+}
+
+QString ArchiveStore::objectFileName(const QByteArray &hash) const
+{
+    // Spread the objects over 256 directories to keep them small
+    const QString name = QString::fromLatin1(hash);
+    return mPath + QLatin1Char('/') + objectsDir + QLatin1Char('/') + name.left(2) + QLatin1Char('/') + name.mid(2);
+}
+
+QString ArchiveStore::generationFileName(const QString &name) const
+{
+    return mPath + QLatin1Char('/') + generationsDir + QLatin1Char('/') + name + generationSuffix;
+}
+
+bool ArchiveStore::contains(const QByteArray &hash) const
+{
+    return QFile::exists(objectFileName(hash));
+}
+
+QByteArray ArchiveStore::insert(const QByteArray &data, qint64 *writtenSize)
+{
+    if (writtenSize) {
+        *writtenSize = 0;
+    }
+    const QByteArray messageHash = hash(data);
+    const QString fileName = objectFileName(messageHash);
+    if (QFile::exists(fileName)) {
+        return messageHash;
+    }
+    if (!QDir(mPath + QLatin1Char('/') + objectsDir).mkpath(QString::fromLatin1(messageHash.left(2)))) {
+        return QByteArray();
+    }
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Impossible to write archive object" << fileName << file.errorString();
+        return QByteArray();
+    }
+    const QByteArray compressed = qCompress(data);
+    file.write(compressed);
+    if (!file.commit()) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Impossible to write archive object" << fileName << file.errorString();
+        return QByteArray();
+    }
+    if (writtenSize) {
+        *writtenSize = compressed.size();
+    }
+    return messageHash;
+}
+
+QByteArray ArchiveStore::message(const QByteArray &hash) const
+{
+    QFile file(objectFileName(hash));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return qUncompress(file.readAll());
+}
+
+QStringList ArchiveStore::generations() const
+{
+    // The names start with a sequence number, so they sort by age
+    QDir dir(mPath + QLatin1Char('/') + generationsDir);
+    QStringList names = dir.entryList(QStringList() << QLatin1Char('*') + generationSuffix, QDir::Files, QDir::Name);
+    for (QString &name : names) {
+        name.chop(generationSuffix.length());
+    }
+    return names;
+}
+
+QString ArchiveStore::latestGeneration() const
+{
+    const QStringList names = generations();
+    return names.isEmpty() ? QString() : names.last();
+}
+
+bool ArchiveStore::readGeneration(const QString &name, Generation &entries) const
+{
+    entries.clear();
+    QFile file(generationFileName(name));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Impossible to open archive generation" << file.fileName() << file.errorString();
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_9);
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 count = 0;
+    stream >> magic >> version >> count;
+    if (magic != generationMagic || version != generationVersion || count < 0) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Invalid archive generation" << file.fileName();
+        return false;
+    }
+    entries.reserve(count);
+    for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        Entry entry;
+        qint64 itemId;
+        qint32 revision;
+        stream >> itemId >> revision >> entry.path >> entry.hash >> entry.time;
+        entry.itemId = itemId;
+        entry.revision = revision;
+        entries.append(entry);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Corrupted archive generation" << file.fileName();
+        entries.clear();
+        return false;
+    }
+    return true;
+}
+
+QString ArchiveStore::writeGeneration(const Generation &entries, const QDate &date)
+{
+    const QString latest = latestGeneration();
+    const int sequence = latest.section(QLatin1Char('_'), 0, 0).toInt() + 1;
+    const QString name = QStringLiteral("%1_%2").arg(sequence, 6, 10, QLatin1Char('0')).arg(date.toString(Qt::ISODate));
+
+    QSaveFile file(generationFileName(name));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Impossible to write archive generation" << file.fileName() << file.errorString();
+        return QString();
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_9);
+    stream << generationMagic << generationVersion << qint32(entries.count());
+    for (const Entry &entry : entries) {
+        stream << qint64(entry.itemId) << qint32(entry.revision) << entry.path << entry.hash << entry.time;
+    }
+    if (!file.commit()) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Impossible to write archive generation" << file.fileName() << file.errorString();
+        return QString();
+    }
+    return name;
+}
+
+bool ArchiveStore::removeGeneration(const QString &name)
+{
+    return QFile::remove(generationFileName(name));
+}
+
+int ArchiveStore::expire(int maximumGenerations, qint64 *freedSize)
+{
+    if (freedSize) {
+        *freedSize = 0;
+    }
+    if (maximumGenerations <= 0) {
+        return 0;
+    }
+    const QStringList names = generations();
+    int removed = 0;
+    for (int i = 0, total = names.count() - maximumGenerations; i < total; ++i) {
+        if (removeGeneration(names.at(i))) {
+            ++removed;
+        }
+    }
+    if (removed > 0) {
+        collectGarbage(freedSize);
+    }
+    return removed;
+}
+
+int ArchiveStore::collectGarbage(qint64 *freedSize)
+{
+    if (freedSize) {
+        *freedSize = 0;
+    }
+    QSet<QByteArray> referenced;
+    const QStringList names = generations();
+    for (const QString &name : names) {
+        Generation entries;
+        if (!readGeneration(name, entries)) {
+            // Better keep too much than lose messages of an unreadable generation
+            qCWarning(ARCHIVEMAILAGENT_LOG) << "Skipping garbage collection of" << mPath;
+            return 0;
+        }
+        for (const Entry &entry : qAsConst(entries)) {
+            referenced.insert(entry.hash);
+        }
+    }
+
+    int removed = 0;
+    QDirIterator it(mPath + QLatin1Char('/') + objectsDir, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        const QByteArray objectHash = info.dir().dirName().toLatin1() + info.fileName().toLatin1();
+        if (!referenced.contains(objectHash)) {
+            const qint64 objectSize = info.size();
+            if (QFile::remove(info.filePath())) {
+                ++removed;
+                if (freedSize) {
+                    *freedSize += objectSize;
+                }
+            }
+        }
+    }
+    return removed;
+}
+
+int ArchiveStore::objectCount() const
+{
+    int count = 0;
+    QDirIterator it(mPath + QLatin1Char('/') + objectsDir, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        ++count;
+    }
+    return count;
+}
+
+qint64 ArchiveStore::size() const
+{
+    qint64 total = 0;
+    QDirIterator it(mPath, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        total += it.fileInfo().size();
+    }
+    return total;
+}
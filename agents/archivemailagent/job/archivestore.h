@@ -0,0 +1,118 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef ARCHIVESTORE_H
+#define ARCHIVESTORE_H
+
+#include <AkonadiCore/Item>
+#include <QDateTime>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @short A deduplicating, content-addressed mail archive.
+ *
+ * The store is a directory holding two kinds of files:
+ * - objects/ contains every archived message exactly once, compressed and
+ *   named after the SHA-1 of its content, whatever the number of archive
+ *   generations or folders referencing it;
+ * - generations/ contains one small index per archive run, listing the
+ *   messages of the archived folders at that time with their object.
+ *
+ * A generation is only written once all the objects it references are
+ * stored, and removing generations never removes an object still referenced
+ * by another generation, see expire() and collectGarbage().
+ */
+class ArchiveStore
+{
+public:
+    struct Entry {
+        Akonadi::Item::Id itemId = -1;
+        int revision = -1;
+        // folder of the message, relative to the archived root folder
+        QString path;
+        QByteArray hash;
+        QDateTime time;
+    };
+    typedef QVector<Entry> Generation;
+
+    explicit ArchiveStore(const QString &path);
+
+    QString path() const;
+
+    /**
+     * Creates the store directories if needed.
+     */
+    bool open();
+
+    static QByteArray hash(const QByteArray &data);
+
+    bool contains(const QByteArray &hash) const;
+
+    /**
+     * Stores @p data unless an identical message is already stored and
+     * returns its hash, or an empty hash on error. @p writtenSize receives
+     * the number of bytes written, 0 if the message was already stored.
+     */
+    QByteArray insert(const QByteArray &data, qint64 *writtenSize = nullptr);
+    QByteArray message(const QByteArray &hash) const;
+
+    /**
+     * Returns the names of the generations, oldest first.
+     */
+    QStringList generations() const;
+    QString latestGeneration() const;
+    bool readGeneration(const QString &name, Generation &entries) const;
+
+    /**
+     * Writes @p entries as the newest generation and returns its name,
+     * or an empty string on error.
+     */
+    QString writeGeneration(const Generation &entries, const QDate &date = QDate::currentDate());
+    bool removeGeneration(const QString &name);
+
+    /**
+     * Removes the oldest generations to keep at most @p maximumGenerations
+     * (0 keeps all of them) followed by the objects no longer referenced.
+     * Returns the number of removed generations.
+     */
+    int expire(int maximumGenerations, qint64 *freedSize = nullptr);
+
+    /**
+     * Removes the objects not referenced by any generation, e.g. those of
+     * expired generations or of an interrupted run, and returns their number.
+     */
+    int collectGarbage(qint64 *freedSize = nullptr);
+
+    int objectCount() const;
+
+    /**
+     * Returns the disk space used by the objects and the generations.
+     */
+    qint64 size() const;
+
+private:
+    QString objectFileName(const QByteArray &hash) const;
+    QString generationFileName(const QString &name) const;
+
+    QString mPath;
+};
+
+#endif // ARCHIVESTORE_H
@@ -0,0 +1,57 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "archivewritebudget.h"
+
+ArchiveWriteBudget::ArchiveWriteBudget()
+{
+    mClock.start();
+}
+
+void ArchiveWriteBudget::setBytesPerSecond(qint64 rate)
+{
+    mBytesPerSecond = qMax(qint64(0), rate);
+}
+
+qint64 ArchiveWriteBudget::bytesPerSecond() const
+{
+    return mBytesPerSecond;
+}
+
+qint64 ArchiveWriteBudget::reserve(qint64 bytes)
+{
+    return reserve(bytes, mClock.elapsed());
+}
+
+qint64 ArchiveWriteBudget::reserve(qint64 bytes, qint64 now)
+{
+    mTotalBytes += bytes;
+    if (mBytesPerSecond <= 0) {
+        return 0;
+    }
+    // Unused budget isn't saved up, so a writer starting later doesn't get a burst
+    const qint64 start = qMax(now, mAvailableAt);
+    mAvailableAt = start + bytes * 1000 / mBytesPerSecond;
+    return mAvailableAt - now;
+}
+
+qint64 ArchiveWriteBudget::totalBytes() const
+{
+    return mTotalBytes;
+}
@@ -0,0 +1,60 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef ARCHIVEWRITEBUDGET_H
+#define ARCHIVEWRITEBUDGET_H
+
+#include <QElapsedTimer>
+
+/**
+ * @short Shares a maximum disk write rate between all running archive jobs.
+ *
+ * Writers account for the bytes they wrote with reserve() and wait for the
+ * returned delay before writing more. The budget hands out consecutive time
+ * slots, so concurrent writers together never exceed the configured rate.
+ */
+class ArchiveWriteBudget
+{
+public:
+    ArchiveWriteBudget();
+
+    /**
+     * Sets the maximum write rate, 0 means unlimited.
+     */
+    void setBytesPerSecond(qint64 rate);
+    qint64 bytesPerSecond() const;
+
+    /**
+     * Accounts for @p bytes written and returns the number of milliseconds
+     * the writer has to wait before writing again.
+     */
+    qint64 reserve(qint64 bytes);
+    qint64 reserve(qint64 bytes, qint64 now);
+
+    qint64 totalBytes() const;
+
+private:
+    QElapsedTimer mClock;
+    qint64 mBytesPerSecond = 0;
+    // time in ms at which the budget is available again
+    qint64 mAvailableAt = 0;
+    qint64 mTotalBytes = 0;
+};
+
+#endif // ARCHIVEWRITEBUDGET_H
@@ -0,0 +1,136 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "deduplicatedarchivejob.h"
+#include "archivemailagent_debug.h"
+
+#include <KFormat>
+#include <KLocalizedString>
+
+DeduplicatedArchiveJob::DeduplicatedArchiveJob(QObject *parent)
+    : IncrementalArchiveJob(parent)
+{
+}
+
+DeduplicatedArchiveJob::~DeduplicatedArchiveJob()
+{
+}
+
+void DeduplicatedArchiveJob::setMaximumGenerations(int count)
+{
+    mMaximumGenerations = count;
+}
+
+bool DeduplicatedArchiveJob::prepare()
+{
+    mStore.reset(new ArchiveStore(saveLocation().toLocalFile()));
+    if (!mStore->open()) {
+        return false;
+    }
+    const QString latest = mStore->latestGeneration();
+    if (!latest.isEmpty()) {
+        ArchiveStore::Generation previous;
+        if (mStore->readGeneration(latest, previous)) {
+            mPreviousCount = previous.count();
+            mPreviousEntries.reserve(previous.count());
+            for (const ArchiveStore::Entry &entry : qAsConst(previous)) {
+                mPreviousEntries.insert(entry.itemId, entry);
+            }
+        } else {
+            // Still correct, only slower: every message is fetched and hashed again
+            qCWarning(ARCHIVEMAILAGENT_LOG) << "Unable to read the latest generation of" << mStore->path();
+        }
+    }
+    return true;
+}
+
+bool DeduplicatedArchiveJob::needsArchiving(const Akonadi::Item &item, const QString &folderPath)
+{
+    const auto it = mPreviousEntries.constFind(item.id());
+    if (it == mPreviousEntries.constEnd() || it->revision != item.revision()) {
+        return true;
+    }
+    // Unchanged, the new generation references the same object
+    ArchiveStore::Entry entry = it.value();
+    entry.path = folderPath;
+    mGeneration.append(entry);
+    return false;
+}
+
+bool DeduplicatedArchiveJob::openArchive()
+{
+    return true;
+}
+
+qint64 DeduplicatedArchiveJob::writeItem(const Akonadi::Item &item, const QString &folderPath, const QByteArray &data)
+{
+    qint64 written = 0;
+    ArchiveStore::Entry entry;
+    entry.hash = mStore->insert(data, &written);
+    if (entry.hash.isEmpty()) {
+        return -1;
+    }
+    entry.itemId = item.id();
+    entry.revision = item.revision();
+    entry.path = folderPath;
+    entry.time = item.modificationTime();
+    mGeneration.append(entry);
+    return written;
+}
+
+bool DeduplicatedArchiveJob::closeArchive(bool complete)
+{
+    if (!complete) {
+        // A generation has to describe the complete folder
+        return false;
+    }
+    mGenerationName = mStore->writeGeneration(mGeneration);
+    if (mGenerationName.isEmpty()) {
+        return false;
+    }
+    mExpiredCount = mStore->expire(mMaximumGenerations, &mFreedSize);
+    return true;
+}
+
+void DeduplicatedArchiveJob::discardArchive()
+{
+    // Stored objects without generation are removed by the next garbage collection
+}
+
+bool DeduplicatedArchiveJob::hasChanges() const
+{
+    // Also true if messages were removed from the folder
+    return archivedItemCount() > 0 || mGeneration.count() != mPreviousCount;
+}
+
+QString DeduplicatedArchiveJob::summary() const
+{
+    if (!hasChanges()) {
+        return i18n("Archiving folder '%1' successfully completed. No new or modified message since the last archive (%2 messages unchanged).",
+                    realPath(), unchangedItemCount());
+    }
+    QString info = i18np("Archiving folder '%2' successfully completed. One new or modified message (%3 written) was stored in generation %4, %5 messages unchanged.",
+                         "Archiving folder '%2' successfully completed. %1 new or modified messages (%3 written) were stored in generation %4, %5 messages unchanged.",
+                         archivedItemCount(), realPath(), KFormat().formatByteSize(archivedSize()), mGenerationName, unchangedItemCount());
+    if (mExpiredCount > 0) {
+        info += QLatin1Char(' ') + i18np("One old generation was removed, freeing %2.", "%1 old generations were removed, freeing %2.",
+                                         mExpiredCount, KFormat().formatByteSize(mFreedSize));
+    }
+    return info;
+}
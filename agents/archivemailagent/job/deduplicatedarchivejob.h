@@ -0,0 +1,73 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef DEDUPLICATEDARCHIVEJOB_H
+#define DEDUPLICATEDARCHIVEJOB_H
+
+#include "incrementalarchivejob.h"
+#include "archivestore.h"
+
+#include <QScopedPointer>
+
+/**
+ * @short Archives a folder into a deduplicating ArchiveStore.
+ *
+ * Each run adds one generation to the store, describing the complete
+ * folder, while only the messages added or changed since the previous
+ * generation are fetched and only those not stored yet are written. Older
+ * generations beyond the maximum count are expired afterwards, dropping the
+ * messages no remaining generation references.
+ *
+ * An interrupted run writes no generation; the messages it already stored
+ * are found again by the next run and not written twice.
+ */
+class DeduplicatedArchiveJob : public IncrementalArchiveJob
+{
+    Q_OBJECT
+public:
+    explicit DeduplicatedArchiveJob(QObject *parent = nullptr);
+    ~DeduplicatedArchiveJob() override;
+
+    /**
+     * Keeps at most @p count generations, 0 keeps all of them.
+     */
+    void setMaximumGenerations(int count);
+
+protected:
+    bool prepare() override;
+    bool needsArchiving(const Akonadi::Item &item, const QString &folderPath) override;
+    bool openArchive() override;
+    qint64 writeItem(const Akonadi::Item &item, const QString &folderPath, const QByteArray &data) override;
+    bool closeArchive(bool complete) override;
+    void discardArchive() override;
+    bool hasChanges() const override;
+    QString summary() const override;
+
+private:
+    QScopedPointer<ArchiveStore> mStore;
+    QHash<Akonadi::Item::Id, ArchiveStore::Entry> mPreviousEntries;
+    ArchiveStore::Generation mGeneration;
+    QString mGenerationName;
+    qint64 mFreedSize = 0;
+    int mPreviousCount = 0;
+    int mMaximumGenerations = 0;
+    int mExpiredCount = 0;
+};
+
+#endif // DEDUPLICATEDARCHIVEJOB_H
@@ -0,0 +1,426 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "incrementalarchivejob.h"
+#include "archivewritebudget.h"
+#include "archivemailagent_debug.h"
+
+#include <AkonadiCore/CollectionFetchJob>
+#include <AkonadiCore/CollectionFetchScope>
+#include <AkonadiCore/ItemFetchJob>
+#include <AkonadiCore/ItemFetchScope>
+#include <Akonadi/KMime/MessageParts>
+
+#include <KFormat>
+#include <KLocalizedString>
+#include <KTar>
+#include <KZip>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QTimer>
+
+#include <functional>
+
+namespace {
+// Number of messages held in memory while writing the archive
+const int chunkSize = 100;
+const QString partSuffix = QStringLiteral(".part");
+}
+
+IncrementalArchiveJob::IncrementalArchiveJob(QObject *parent)
+    : QObject(parent)
+{
+}
+
+IncrementalArchiveJob::~IncrementalArchiveJob()
+{
+    if (mCurrentJob) {
+        mCurrentJob->kill(KJob::Quietly);
+    }
+    delete mArchive;
+}
+
+void IncrementalArchiveJob::setRootFolder(const Akonadi::Collection &rootFolder)
+{
+    mRootFolder = rootFolder;
+}
+
+void IncrementalArchiveJob::setRecursive(bool recursive)
+{
+    mRecursive = recursive;
+}
+
+void IncrementalArchiveJob::setArchiveType(MailCommon::BackupJob::ArchiveType type)
+{
+    mArchiveType = type;
+}
+
+void IncrementalArchiveJob::setSaveLocation(const QUrl &url)
+{
+    mSaveLocation = url;
+}
+
+QUrl IncrementalArchiveJob::saveLocation() const
+{
+    return mSaveLocation;
+}
+
+void IncrementalArchiveJob::setManifestPath(const QString &path)
+{
+    mManifestPath = path;
+}
+
+void IncrementalArchiveJob::setRealPath(const QString &path)
+{
+    mRealPath = path;
+}
+
+void IncrementalArchiveJob::setWriteBudget(ArchiveWriteBudget *budget)
+{
+    mWriteBudget = budget;
+}
+
+int IncrementalArchiveJob::archivedItemCount() const
+{
+    return mArchivedItemCount;
+}
+
+int IncrementalArchiveJob::unchangedItemCount() const
+{
+    return mUnchangedItemCount;
+}
+
+qint64 IncrementalArchiveJob::archivedSize() const
+{
+    return mArchivedSize;
+}
+
+QString IncrementalArchiveJob::realPath() const
+{
+    return mRealPath;
+}
+
+bool IncrementalArchiveJob::prepare()
+{
+    if (!mManifest.load(mManifestPath)) {
+        // Without a usable manifest the next archive has to contain everything
+        mManifest.clear();
+    }
+    return true;
+}
+
+bool IncrementalArchiveJob::needsArchiving(const Akonadi::Item &item, const QString &folderPath)
+{
+    Q_UNUSED(folderPath);
+    return mManifest.needsArchiving(item);
+}
+
+void IncrementalArchiveJob::start()
+{
+    if (!prepare()) {
+        abort(i18n("Unable to open archive \"%1\".", archiveFileName()));
+        return;
+    }
+    mCollections.clear();
+    mCollectionPaths.clear();
+    mCollections << mRootFolder;
+    mCollectionPaths.insert(mRootFolder.id(), mRootFolder.name());
+    if (!mRecursive) {
+        fetchNextCollection();
+        return;
+    }
+
+    Akonadi::CollectionFetchJob *job = new Akonadi::CollectionFetchJob(mRootFolder, Akonadi::CollectionFetchJob::Recursive, this);
+    job->fetchScope().setAncestorRetrieval(Akonadi::CollectionFetchScope::Parent);
+    connect(job, &KJob::result, this, &IncrementalArchiveJob::slotCollectionsFetched);
+    mCurrentJob = job;
+}
+
+void IncrementalArchiveJob::slotCollectionsFetched(KJob *job)
+{
+    if (job->error()) {
+        abort(job->errorString());
+        return;
+    }
+    const Akonadi::Collection::List collections = static_cast<Akonadi::CollectionFetchJob *>(job)->collections();
+    QHash<Akonadi::Collection::Id, Akonadi::Collection> byId;
+    for (const Akonadi::Collection &collection : collections) {
+        byId.insert(collection.id(), collection);
+    }
+    // Same layout as MailCommon::BackupJob: one directory per folder below the root
+    std::function<QString(const Akonadi::Collection &)> pathOf = [&](const Akonadi::Collection &collection) -> QString {
+        const auto it = mCollectionPaths.constFind(collection.id());
+        if (it != mCollectionPaths.constEnd()) {
+            return it.value();
+        }
+        const Akonadi::Collection parent = byId.value(collection.parentCollection().id());
+        const QString path = (parent.isValid() ? pathOf(parent) + QLatin1Char('/') : QString()) + collection.name();
+        mCollectionPaths.insert(collection.id(), path);
+        return path;
+    };
+    for (const Akonadi::Collection &collection : collections) {
+        pathOf(collection);
+        mCollections << collection;
+    }
+    fetchNextCollection();
+}
+
+void IncrementalArchiveJob::fetchNextCollection()
+{
+    if (mStopped) {
+        return;
+    }
+    if (mCollectionIndex >= mCollections.count()) {
+        mManifest.setListingComplete();
+        if (mPendingItems.isEmpty()) {
+            // Nothing to fetch, but removed messages can still be a change
+            finish();
+            return;
+        }
+        if (!openArchive()) {
+            abort(i18n("Unable to open archive file \"%1\".", archiveFileName()));
+            return;
+        }
+        writeNextChunk();
+        return;
+    }
+
+    // Only list the items first, the payload is fetched for the changed ones
+    Akonadi::ItemFetchJob *job = new Akonadi::ItemFetchJob(mCollections.at(mCollectionIndex), this);
+    job->fetchScope().fetchFullPayload(false);
+    job->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
+    connect(job, &KJob::result, this, &IncrementalArchiveJob::slotItemsListed);
+    mCurrentJob = job;
+}
+
+void IncrementalArchiveJob::slotItemsListed(KJob *job)
+{
+    if (job->error()) {
+        abort(job->errorString());
+        return;
+    }
+    const Akonadi::Item::List items = static_cast<Akonadi::ItemFetchJob *>(job)->items();
+    for (const Akonadi::Item &item : items) {
+        mManifest.markListed(item);
+        if (needsArchiving(item, mCollectionPaths.value(item.parentCollection().id(), mRootFolder.name()))) {
+            mPendingItems << item;
+        } else {
+            ++mUnchangedItemCount;
+        }
+    }
+    ++mCollectionIndex;
+    fetchNextCollection();
+}
+
+void IncrementalArchiveJob::writeNextChunk()
+{
+    if (mStopped) {
+        return;
+    }
+    if (mPendingIndex >= mPendingItems.count()) {
+        finish();
+        return;
+    }
+    const Akonadi::Item::List chunk = mPendingItems.mid(mPendingIndex, chunkSize);
+    mPendingIndex += chunk.count();
+
+    Akonadi::ItemFetchJob *job = new Akonadi::ItemFetchJob(chunk, this);
+    job->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Body, true);
+    job->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Header, true);
+    job->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
+    connect(job, &KJob::result, this, &IncrementalArchiveJob::slotItemsFetched);
+    mCurrentJob = job;
+}
+
+void IncrementalArchiveJob::slotItemsFetched(KJob *job)
+{
+    if (job->error()) {
+        // Keep what was written so far, the next run will retry the rest
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Unable to fetch messages to archive:" << job->errorString();
+        if (closeArchive(false)) {
+            Q_EMIT error(i18n("Archiving %1 was interrupted: %2", mRealPath, job->errorString()));
+        } else {
+            Q_EMIT error(job->errorString());
+        }
+        deleteLater();
+        return;
+    }
+    const Akonadi::Item::List items = static_cast<Akonadi::ItemFetchJob *>(job)->items();
+    qint64 chunkBytes = 0;
+    for (const Akonadi::Item &item : items) {
+        const QString folderPath = mCollectionPaths.value(item.parentCollection().id(), mRootFolder.name());
+        const qint64 written = writeItem(item, folderPath, item.payloadData());
+        if (written < 0) {
+            abort(i18n("Failed to write a message into the archive folder \"%1\".", mRealPath));
+            return;
+        }
+        mArchivedSize += written;
+        chunkBytes += written;
+        ++mArchivedItemCount;
+    }
+    const qint64 delay = mWriteBudget ? mWriteBudget->reserve(chunkBytes) : 0;
+    if (delay > 0) {
+        QTimer::singleShot(delay, this, &IncrementalArchiveJob::writeNextChunk);
+    } else {
+        writeNextChunk();
+    }
+}
+
+QString IncrementalArchiveJob::archiveFileName() const
+{
+    return mArchiveFileName.isEmpty() ? mSaveLocation.toLocalFile() : mArchiveFileName;
+}
+
+bool IncrementalArchiveJob::openArchive()
+{
+    // Several runs on the same day (e.g. resumed ones) each get their own file
+    const QString fileName = mSaveLocation.toLocalFile();
+    mArchiveFileName = fileName;
+    const QFileInfo info(fileName);
+    const QString suffix = fileName.mid(info.absolutePath().length() + 1 + info.baseName().length());
+    for (int i = 1; QFile::exists(mArchiveFileName); ++i) {
+        mArchiveFileName = info.absolutePath() + QLatin1Char('/') + info.baseName() + QLatin1Char('_') + QString::number(i) + suffix;
+    }
+
+    const QString partFileName = mArchiveFileName + partSuffix;
+    switch (mArchiveType) {
+    case MailCommon::BackupJob::Zip: {
+        KZip *zip = new KZip(partFileName);
+        zip->setCompression(KZip::DeflateCompression);
+        mArchive = zip;
+        break;
+    }
+    case MailCommon::BackupJob::Tar:
+        mArchive = new KTar(partFileName, QStringLiteral("application/x-tar"));
+        break;
+    case MailCommon::BackupJob::TarGz:
+        mArchive = new KTar(partFileName, QStringLiteral("application/x-gzip"));
+        break;
+    case MailCommon::BackupJob::TarBz2:
+        mArchive = new KTar(partFileName, QStringLiteral("application/x-bzip"));
+        break;
+    }
+    if (!mArchive->open(QIODevice::WriteOnly)) {
+        delete mArchive;
+        mArchive = nullptr;
+        return false;
+    }
+    return true;
+}
+
+qint64 IncrementalArchiveJob::writeItem(const Akonadi::Item &item, const QString &folderPath, const QByteArray &data)
+{
+    const QString fileName = folderPath + QLatin1String("/cur/") + QString::number(item.id());
+    const QDateTime time = item.modificationTime();
+    if (!mArchive->writeFile(fileName, data, 0100644, QString(), QString(), time, time, time)) {
+        return -1;
+    }
+    mManifest.markArchived(item);
+    return data.size();
+}
+
+bool IncrementalArchiveJob::closeArchive(bool complete)
+{
+    // A partial archive file is still valid, the manifest lists what it holds
+    Q_UNUSED(complete);
+    if (!mArchive) {
+        return false;
+    }
+    const QString partFileName = mArchiveFileName + partSuffix;
+    const bool closed = mArchive->close();
+    delete mArchive;
+    mArchive = nullptr;
+    if (!closed || mArchivedItemCount == 0) {
+        QFile::remove(partFileName);
+        return false;
+    }
+    if (!QFile::rename(partFileName, mArchiveFileName)) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Unable to rename" << partFileName << "to" << mArchiveFileName;
+        QFile::remove(partFileName);
+        return false;
+    }
+    // Only now the archived messages are safe, record them for the next run
+    return mManifest.save(mManifestPath);
+}
+
+bool IncrementalArchiveJob::hasChanges() const
+{
+    return mArchivedItemCount > 0;
+}
+
+QString IncrementalArchiveJob::summary() const
+{
+    if (mArchivedItemCount == 0) {
+        return i18n("Archiving folder '%1' successfully completed. No new or modified message since the last archive (%2 messages unchanged).",
+                    mRealPath, mUnchangedItemCount);
+    }
+    return i18np("Archiving folder '%2' successfully completed. One message (%3) was written to %4, %5 messages unchanged.",
+                 "Archiving folder '%2' successfully completed. %1 messages (%3) were written to %4, %5 messages unchanged.",
+                 mArchivedItemCount, mRealPath, KFormat().formatByteSize(mArchivedSize),
+                 QFileInfo(mArchiveFileName).fileName(), mUnchangedItemCount);
+}
+
+void IncrementalArchiveJob::finish()
+{
+    if (hasChanges()) {
+        if (!closeArchive(true)) {
+            abort(i18n("Unable to finalize archive file \"%1\".", archiveFileName()));
+            return;
+        }
+    } else if (!mManifestPath.isEmpty() && mManifest.unlistedCount() > 0) {
+        // Nothing new to archive, but forget the messages deleted since
+        mManifest.save(mManifestPath);
+    }
+    Q_EMIT archiveDone(summary());
+    deleteLater();
+}
+
+void IncrementalArchiveJob::stop()
+{
+    if (mStopped) {
+        return;
+    }
+    mStopped = true;
+    if (mCurrentJob) {
+        mCurrentJob->kill(KJob::Quietly);
+    }
+    if (closeArchive(false)) {
+        qCDebug(ARCHIVEMAILAGENT_LOG) << "Archiving" << mRealPath << "interrupted after" << mArchivedItemCount << "messages, will resume";
+    }
+    deleteLater();
+}
+
+void IncrementalArchiveJob::discardArchive()
+{
+    if (mArchive) {
+        // Drop the incomplete file, the manifest still describes the previous state
+        mArchive->close();
+        delete mArchive;
+        mArchive = nullptr;
+        QFile::remove(mArchiveFileName + partSuffix);
+    }
+}
+
+void IncrementalArchiveJob::abort(const QString &errorMessage)
+{
+    discardArchive();
+    Q_EMIT error(errorMessage);
+    deleteLater();
+}
@@ -0,0 +1,164 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef INCREMENTALARCHIVEJOB_H
+#define INCREMENTALARCHIVEJOB_H
+
+#include "archivemanifest.h"
+
+#include <MailCommon/BackupJob>
+#include <AkonadiCore/Collection>
+#include <AkonadiCore/Item>
+
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QUrl>
+
+class ArchiveWriteBudget;
+class KArchive;
+class KJob;
+
+/**
+ * @short Archives only the messages added or changed since the previous run.
+ *
+ * The messages already archived are remembered in an ArchiveManifest stored
+ * next to the archives. Each run writes the new and modified messages into
+ * a new archive file, streaming them in chunks so that only one chunk of
+ * messages is held in memory at a time.
+ *
+ * stop() closes the archive file written so far and records its messages in
+ * the manifest, so the next run resumes where this one stopped instead of
+ * starting from scratch.
+ *
+ * Subclasses can store the messages differently by reimplementing the
+ * protected hooks, see DeduplicatedArchiveJob.
+ *
+ * The job deletes itself once it emitted archiveDone() or error().
+ */
+class IncrementalArchiveJob : public QObject
+{
+    Q_OBJECT
+public:
+    explicit IncrementalArchiveJob(QObject *parent = nullptr);
+    ~IncrementalArchiveJob() override;
+
+    void setRootFolder(const Akonadi::Collection &rootFolder);
+    void setRecursive(bool recursive);
+    void setArchiveType(MailCommon::BackupJob::ArchiveType type);
+    void setSaveLocation(const QUrl &url);
+    QUrl saveLocation() const;
+    void setManifestPath(const QString &path);
+    void setRealPath(const QString &path);
+
+    /**
+     * Throttles writing to the rate of @p budget, shared with other jobs.
+     */
+    void setWriteBudget(ArchiveWriteBudget *budget);
+
+    void start();
+
+    /**
+     * Stops the job, keeping what was archived so far.
+     */
+    void stop();
+
+    int archivedItemCount() const;
+    int unchangedItemCount() const;
+    qint64 archivedSize() const;
+    QString realPath() const;
+
+Q_SIGNALS:
+    void archiveDone(const QString &info);
+    void error(const QString &error);
+
+protected:
+    /**
+     * Called by start(), returns false if the job can't run.
+     */
+    virtual bool prepare();
+
+    /**
+     * Returns whether @p item, found in the folder @p folderPath, has to be
+     * fetched and passed to writeItem().
+     */
+    virtual bool needsArchiving(const Akonadi::Item &item, const QString &folderPath);
+
+    /**
+     * Called before the first writeItem() of the run.
+     */
+    virtual bool openArchive();
+
+    /**
+     * Stores the message @p data of @p item and returns the number of bytes
+     * written, or -1 on error.
+     */
+    virtual qint64 writeItem(const Akonadi::Item &item, const QString &folderPath, const QByteArray &data);
+
+    /**
+     * Makes what was written so far permanent. @p complete is false when
+     * the run is interrupted before all messages were written.
+     */
+    virtual bool closeArchive(bool complete);
+
+    /**
+     * Drops what was written so far after an error.
+     */
+    virtual void discardArchive();
+
+    /**
+     * Returns whether the run has something to commit with closeArchive().
+     */
+    virtual bool hasChanges() const;
+
+    virtual QString summary() const;
+
+private:
+    void slotCollectionsFetched(KJob *job);
+    void fetchNextCollection();
+    void slotItemsListed(KJob *job);
+    void writeNextChunk();
+    void slotItemsFetched(KJob *job);
+    QString archiveFileName() const;
+    void finish();
+    void abort(const QString &errorMessage);
+
+    ArchiveManifest mManifest;
+    Akonadi::Collection mRootFolder;
+    Akonadi::Collection::List mCollections;
+    QHash<Akonadi::Collection::Id, QString> mCollectionPaths;
+    Akonadi::Item::List mPendingItems;
+    QUrl mSaveLocation;
+    QString mManifestPath;
+    QString mRealPath;
+    QString mArchiveFileName;
+    KArchive *mArchive = nullptr;
+    ArchiveWriteBudget *mWriteBudget = nullptr;
+    QPointer<KJob> mCurrentJob;
+    MailCommon::BackupJob::ArchiveType mArchiveType = MailCommon::BackupJob::Zip;
+    qint64 mArchivedSize = 0;
+    int mArchivedItemCount = 0;
+    int mUnchangedItemCount = 0;
+    int mPendingIndex = 0;
+    int mCollectionIndex = 0;
+    bool mRecursive = false;
+    bool mStopped = false;
+};
+
+#endif // INCREMENTALARCHIVEJOB_H
@@ -0,0 +1,320 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "agentstatestore.h"
+#include "agentstatestore_debug.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+const quint32 snapshotMagic = 0x41535353; // "ASSS"
+const quint32 journalMagic = 0x4153534a; // "ASSJ"
+const quint32 storeVersion = 1;
+const int journalHeaderSize = 8;
+// Record: quint32 payload size, payload, quint16 checksum of the payload
+const int recordOverhead = 6;
+// Below this size the journal is never merged into the snapshot
+const qint64 minimumCompactionSize = 64 * 1024;
+const QString journalSuffix = QStringLiteral(".journal");
+}
+
+AgentStateStore::AgentStateStore(const QString &fileName)
+    : mFileName(fileName)
+{
+}
+
+AgentStateStore::~AgentStateStore()
+{
+    close();
+}
+
+QString AgentStateStore::defaultFileName(const QString &name)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + QLatin1Char('/') + name;
+}
+
+QString AgentStateStore::fileName() const
+{
+    return mFileName;
+}
+
+bool AgentStateStore::open()
+{
+    close();
+    mValues.clear();
+    QDir().mkpath(QFileInfo(mFileName).absolutePath());
+    if (!readSnapshot()) {
+        // Keep the unreadable file for inspection, start from the journal
+        QFile::remove(mFileName + QStringLiteral(".corrupted"));
+        QFile::rename(mFileName, mFileName + QStringLiteral(".corrupted"));
+        mValues.clear();
+        mSnapshotSize = 0;
+    }
+    if (!replayJournal()) {
+        return false;
+    }
+    compactIfNeeded();
+    return true;
+}
+
+bool AgentStateStore::isOpen() const
+{
+    return mJournal.isOpen();
+}
+
+void AgentStateStore::close()
+{
+    if (mJournal.isOpen()) {
+        mJournal.close();
+    }
+}
+
+bool AgentStateStore::readSnapshot()
+{
+    mSnapshotSize = 0;
+    QFile file(mFileName);
+    if (!file.exists()) {
+        return true;
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCWarning(AGENTSTATESTORE_LOG) << "Impossible to open" << mFileName << file.errorString();
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_9);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != snapshotMagic || version != storeVersion) {
+        qCWarning(AGENTSTATESTORE_LOG) << "Invalid store" << mFileName;
+        return false;
+    }
+    stream >> mValues;
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(AGENTSTATESTORE_LOG) << "Corrupted store" << mFileName;
+        return false;
+    }
+    mSnapshotSize = file.size();
+    return true;
+}
+
+bool AgentStateStore::replayJournal()
+{
+    mJournalRecordCount = 0;
+    mJournal.setFileName(mFileName + journalSuffix);
+    if (!mJournal.open(QIODevice::ReadWrite)) {
+        qCWarning(AGENTSTATESTORE_LOG) << "Impossible to open" << mJournal.fileName() << mJournal.errorString();
+        return false;
+    }
+
+    QDataStream stream(&mJournal);
+    stream.setVersion(QDataStream::Qt_5_9);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (stream.status() != QDataStream::Ok || magic != journalMagic || version != storeVersion) {
+        if (mJournal.size() > 0) {
+            qCWarning(AGENTSTATESTORE_LOG) << "Ignoring invalid journal" << mJournal.fileName();
+        }
+        mJournal.resize(0);
+        mJournal.seek(0);
+        stream.resetStatus();
+        stream << journalMagic << storeVersion;
+        mJournal.flush();
+        return true;
+    }
+
+    qint64 validSize = journalHeaderSize;
+    while (!stream.atEnd()) {
+        quint32 payloadSize = 0;
+        stream >> payloadSize;
+        if (stream.status() != QDataStream::Ok || payloadSize > mJournal.size() - mJournal.pos()) {
+            break;
+        }
+        const QByteArray payload = mJournal.read(payloadSize);
+        quint16 checksum = 0;
+        stream >> checksum;
+        if (stream.status() != QDataStream::Ok || payload.size() != int(payloadSize)
+            || checksum != qChecksum(payload.constData(), payload.size())) {
+            break;
+        }
+
+        QDataStream record(payload);
+        record.setVersion(QDataStream::Qt_5_9);
+        quint8 operation = 0;
+        qint64 key = 0;
+        QByteArray value;
+        record >> operation >> key >> value;
+        switch (operation) {
+        case Insert:
+            mValues.insert(key, value);
+            break;
+        case Remove:
+            mValues.remove(key);
+            break;
+        case Clear:
+            mValues.clear();
+            break;
+        default:
+            qCWarning(AGENTSTATESTORE_LOG) << "Unknown journal operation" << operation;
+            break;
+        }
+        ++mJournalRecordCount;
+        validSize = mJournal.pos();
+    }
+
+    if (validSize != mJournal.size()) {
+        // Interrupted while appending the last record
+        qCWarning(AGENTSTATESTORE_LOG) << "Dropping incomplete journal record in" << mJournal.fileName();
+        mJournal.resize(validSize);
+    }
+    mJournal.seek(validSize);
+    return true;
+}
+
+bool AgentStateStore::appendRecord(Operation operation, qint64 key, const QByteArray &value)
+{
+    if (!mJournal.isOpen()) {
+        return false;
+    }
+    QByteArray payload;
+    {
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_5_9);
+        stream << quint8(operation) << key << value;
+    }
+    QByteArray record;
+    record.reserve(payload.size() + recordOverhead);
+    {
+        QDataStream stream(&record, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_5_9);
+        stream << quint32(payload.size());
+        stream.writeRawData(payload.constData(), payload.size());
+        stream << qChecksum(payload.constData(), payload.size());
+    }
+    // One write per record, so a crash can only cut the last one
+    if (mJournal.write(record) != record.size() || !mJournal.flush()) {
+        qCWarning(AGENTSTATESTORE_LOG) << "Impossible to write" << mJournal.fileName() << mJournal.errorString();
+        return false;
+    }
+    ++mJournalRecordCount;
+    compactIfNeeded();
+    return true;
+}
+
+void AgentStateStore::compactIfNeeded()
+{
+    const qint64 journalSize = mJournal.isOpen() ? mJournal.size() : 0;
+    if (journalSize > minimumCompactionSize && journalSize > mSnapshotSize) {
+        compact();
+    }
+}
+
+bool AgentStateStore::compact()
+{
+    QSaveFile file(mFileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(AGENTSTATESTORE_LOG) << "Impossible to write" << mFileName << file.errorString();
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_9);
+    stream << snapshotMagic << storeVersion << mValues;
+    if (!file.commit()) {
+        qCWarning(AGENTSTATESTORE_LOG) << "Impossible to write" << mFileName << file.errorString();
+        return false;
+    }
+    mSnapshotSize = QFileInfo(mFileName).size();
+
+    // Replaying the old journal over the new snapshot gives the same values,
+    // so being interrupted here is harmless.
+    if (mJournal.isOpen()) {
+        mJournal.resize(journalHeaderSize);
+        mJournal.seek(journalHeaderSize);
+        mJournal.flush();
+    }
+    mJournalRecordCount = 0;
+    return true;
+}
+
+bool AgentStateStore::contains(qint64 key) const
+{
+    return mValues.contains(key);
+}
+
+QByteArray AgentStateStore::value(qint64 key) const
+{
+    return mValues.value(key);
+}
+
+QList<qint64> AgentStateStore::keys() const
+{
+    return mValues.keys();
+}
+
+const QHash<qint64, QByteArray> &AgentStateStore::values() const
+{
+    return mValues;
+}
+
+int AgentStateStore::count() const
+{
+    return mValues.count();
+}
+
+bool AgentStateStore::isEmpty() const
+{
+    return mValues.isEmpty();
+}
+
+bool AgentStateStore::insert(qint64 key, const QByteArray &value)
+{
+    const auto it = mValues.constFind(key);
+    if (it != mValues.constEnd() && it.value() == value) {
+        return true;
+    }
+    mValues.insert(key, value);
+    return appendRecord(Insert, key, value);
+}
+
+bool AgentStateStore::remove(qint64 key)
+{
+    if (!mValues.remove(key)) {
+        return true;
+    }
+    return appendRecord(Remove, key);
+}
+
+void AgentStateStore::clear()
+{
+    if (mValues.isEmpty()) {
+        return;
+    }
+    mValues.clear();
+    appendRecord(Clear, 0);
+}
+
+int AgentStateStore::journalRecordCount() const
+{
+    return mJournalRecordCount;
+}
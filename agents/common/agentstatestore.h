@@ -0,0 +1,102 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef AGENTSTATESTORE_H
+#define AGENTSTATESTORE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QString>
+
+/**
+ * @short A small persistent key/value store for the state of the agents.
+ *
+ * All values are kept in memory, indexed by their key. On disk the store is
+ * a snapshot file and a journal next to it: every insert() or remove()
+ * appends one checksummed record to the journal, so a change costs the size
+ * of that change and not of the whole store. When the journal has grown
+ * larger than the snapshot it is merged into a new snapshot.
+ *
+ * The store is crash-safe: the snapshot is replaced atomically, and a
+ * journal record which was only partially written is ignored and cut off
+ * when the store is opened again.
+ */
+class AgentStateStore
+{
+public:
+    /**
+     * Creates a store saved in @p fileName and @p fileName + ".journal".
+     */
+    explicit AgentStateStore(const QString &fileName);
+    ~AgentStateStore();
+
+    /**
+     * Returns the default location of the store called @p name.
+     */
+    static QString defaultFileName(const QString &name);
+
+    QString fileName() const;
+
+    /**
+     * Loads the snapshot and replays the journal. Returns false if the
+     * store can't be written; the values read so far are still available.
+     */
+    bool open();
+    bool isOpen() const;
+    void close();
+
+    bool contains(qint64 key) const;
+    QByteArray value(qint64 key) const;
+    QList<qint64> keys() const;
+    const QHash<qint64, QByteArray> &values() const;
+    int count() const;
+    bool isEmpty() const;
+
+    bool insert(qint64 key, const QByteArray &value);
+    bool remove(qint64 key);
+    void clear();
+
+    /**
+     * Writes all values into a new snapshot and empties the journal.
+     */
+    bool compact();
+
+    int journalRecordCount() const;
+
+private:
+    enum Operation {
+        Insert = 1,
+        Remove = 2,
+        Clear = 3
+    };
+
+    bool readSnapshot();
+    bool replayJournal();
+    bool appendRecord(Operation operation, qint64 key, const QByteArray &value = QByteArray());
+    void compactIfNeeded();
+
+    QHash<qint64, QByteArray> mValues;
+    QString mFileName;
+    QFile mJournal;
+    qint64 mSnapshotSize = 0;
+    int mJournalRecordCount = 0;
+};
+
+#endif // AGENTSTATESTORE_H
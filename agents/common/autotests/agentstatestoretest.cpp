@@ -0,0 +1,338 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "agentstatestoretest.h"
+#include "agentstatestore.h"
+
+#include <KConfigGroup>
+#include <KSharedConfig>
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <qtest.h>
+
+namespace {
+// Number of entries of the benchmarks, a large set of scheduled messages
+const int benchmarkCount = 10000;
+
+QByteArray createValue(int key, int size = 150)
+{
+    QByteArray value = QByteArray::number(key) + ':';
+    value += QByteArray(size - value.size(), 'x');
+    return value;
+}
+
+QByteArray readFile(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+void writeFile(const QString &fileName, const QByteArray &data)
+{
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QCOMPARE(file.write(data), qint64(data.size()));
+}
+}
+
+AgentStateStoreTest::AgentStateStoreTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void AgentStateStoreTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(mDir.isValid());
+}
+
+QString AgentStateStoreTest::fileName(const QString &name) const
+{
+    return mDir.path() + QLatin1Char('/') + name;
+}
+
+void AgentStateStoreTest::shouldBeEmpty()
+{
+    AgentStateStore store(fileName(QStringLiteral("empty.store")));
+    QVERIFY(!store.isOpen());
+    QVERIFY(store.open());
+    QVERIFY(store.isOpen());
+    QVERIFY(store.isEmpty());
+    QCOMPARE(store.count(), 0);
+    QVERIFY(!store.contains(1));
+    QVERIFY(store.value(1).isNull());
+    QCOMPARE(store.journalRecordCount(), 0);
+    QVERIFY(QFile::exists(store.fileName() + QStringLiteral(".journal")));
+}
+
+void AgentStateStoreTest::shouldKeepValuesAfterReopen()
+{
+    const QString name = fileName(QStringLiteral("reopen.store"));
+    {
+        AgentStateStore store(name);
+        QVERIFY(store.open());
+        for (int i = 0; i < 10; ++i) {
+            QVERIFY(store.insert(i, createValue(i)));
+        }
+        QVERIFY(store.remove(3));
+        QVERIFY(store.insert(5, QByteArrayLiteral("changed")));
+        QCOMPARE(store.journalRecordCount(), 12);
+    }
+
+    AgentStateStore store(name);
+    QVERIFY(store.open());
+    QCOMPARE(store.count(), 9);
+    QVERIFY(!store.contains(3));
+    QCOMPARE(store.value(5), QByteArrayLiteral("changed"));
+    QCOMPARE(store.value(7), createValue(7));
+
+    store.clear();
+    store.close();
+    QVERIFY(store.open());
+    QVERIFY(store.isEmpty());
+}
+
+void AgentStateStoreTest::shouldReplayJournalOverSnapshot()
+{
+    const QString name = fileName(QStringLiteral("snapshot.store"));
+    const QString journal = name + QStringLiteral(".journal");
+    {
+        AgentStateStore store(name);
+        QVERIFY(store.open());
+        for (int i = 0; i < 10; ++i) {
+            store.insert(i, createValue(i));
+        }
+        store.remove(2);
+        QVERIFY(store.compact());
+        QCOMPARE(store.journalRecordCount(), 0);
+        store.insert(20, createValue(20));
+        store.remove(4);
+    }
+    {
+        AgentStateStore store(name);
+        QVERIFY(store.open());
+        QCOMPARE(store.count(), 9);
+        QVERIFY(store.contains(20));
+        QVERIFY(!store.contains(2));
+        QVERIFY(!store.contains(4));
+        QCOMPARE(store.journalRecordCount(), 2);
+    }
+
+    // Interrupted between writing the snapshot and emptying the journal:
+    // replaying the old records gives the same values.
+    QByteArray journalBeforeCompaction;
+    QHash<qint64, QByteArray> expected;
+    {
+        AgentStateStore store(name);
+        QVERIFY(store.open());
+        journalBeforeCompaction = readFile(journal);
+        expected = store.values();
+        QVERIFY(store.compact());
+    }
+    writeFile(journal, journalBeforeCompaction);
+    AgentStateStore store(name);
+    QVERIFY(store.open());
+    QVERIFY(store.contains(20));
+    QVERIFY(!store.contains(2));
+    QCOMPARE(store.values(), expected);
+}
+
+void AgentStateStoreTest::shouldIgnoreTruncatedRecord()
+{
+    const QString name = fileName(QStringLiteral("truncated.store"));
+    const QString journal = name + QStringLiteral(".journal");
+    {
+        AgentStateStore store(name);
+        QVERIFY(store.open());
+        for (int i = 0; i < 5; ++i) {
+            store.insert(i, createValue(i));
+        }
+    }
+    const QByteArray data = readFile(journal);
+    writeFile(journal, data.left(data.size() - 3));
+
+    {
+        AgentStateStore store(name);
+        QVERIFY(store.open());
+        QCOMPARE(store.count(), 4);
+        QVERIFY(!store.contains(4));
+        QCOMPARE(store.journalRecordCount(), 4);
+        // The incomplete record is cut off, so new records are readable
+        QVERIFY(QFileInfo(journal).size() < data.size());
+        store.insert(10, createValue(10));
+    }
+
+    AgentStateStore store(name);
+    QVERIFY(store.open());
+    QCOMPARE(store.count(), 5);
+    QCOMPARE(store.value(10), createValue(10));
+}
+
+void AgentStateStoreTest::shouldIgnoreCorruptedRecord()
+{
+    const QString name = fileName(QStringLiteral("corrupted.store"));
+    const QString journal = name + QStringLiteral(".journal");
+    {
+        AgentStateStore store(name);
+        QVERIFY(store.open());
+        for (int i = 0; i < 3; ++i) {
+            store.insert(i, createValue(i));
+        }
+    }
+    QByteArray data = readFile(journal);
+    // Inside the value of the last record
+    data[data.size() - 10] = 'y';
+    writeFile(journal, data);
+
+    AgentStateStore store(name);
+    QVERIFY(store.open());
+    QCOMPARE(store.count(), 2);
+    QVERIFY(!store.contains(2));
+}
+
+void AgentStateStoreTest::shouldCompactLargeJournal()
+{
+    const QString name = fileName(QStringLiteral("compact.store"));
+    const QString journal = name + QStringLiteral(".journal");
+    {
+        AgentStateStore store(name);
+        QVERIFY(store.open());
+        // Many changes of a few values
+        for (int i = 0; i < 2000; ++i) {
+            store.insert(i % 10, createValue(i));
+        }
+        QVERIFY(store.journalRecordCount() < 2000);
+        QVERIFY(QFile::exists(name));
+        QVERIFY(QFileInfo(journal).size() < 2000 * 150);
+    }
+
+    AgentStateStore store(name);
+    QVERIFY(store.open());
+    QCOMPARE(store.count(), 10);
+    for (int i = 0; i < 10; ++i) {
+        QCOMPARE(store.value(i), createValue(1990 + i));
+    }
+}
+
+void AgentStateStoreTest::shouldNotWriteUnchangedValues()
+{
+    AgentStateStore store(fileName(QStringLiteral("unchanged.store")));
+    QVERIFY(store.open());
+    store.insert(1, createValue(1));
+    store.insert(1, createValue(1));
+    store.remove(2);
+    store.clear();
+    store.clear();
+    QCOMPARE(store.journalRecordCount(), 2);
+}
+
+void AgentStateStoreTest::benchmarkStoreLoad()
+{
+    const QString name = fileName(QStringLiteral("benchmark.store"));
+    {
+        AgentStateStore store(name);
+        QVERIFY(store.open());
+        for (int i = 0; i < benchmarkCount; ++i) {
+            store.insert(i, createValue(i));
+        }
+        // A few changes since the last compaction
+        for (int i = 0; i < 100; ++i) {
+            store.insert(i, createValue(i, 160));
+        }
+    }
+
+    AgentStateStore store(name);
+    QBENCHMARK {
+        store.open();
+    }
+    QCOMPARE(store.count(), benchmarkCount);
+}
+
+void AgentStateStoreTest::benchmarkStoreUpdate()
+{
+    AgentStateStore store(fileName(QStringLiteral("benchmark.store")));
+    QVERIFY(store.open());
+    QCOMPARE(store.count(), benchmarkCount);
+    int key = 0;
+    QBENCHMARK {
+        // Removing a sent message and scheduling a new one
+        store.remove(key);
+        store.insert(key, createValue(key));
+        key = (key + 1) % benchmarkCount;
+    }
+    QCOMPARE(store.count(), benchmarkCount);
+}
+
+void AgentStateStoreTest::benchmarkConfigLoad()
+{
+    // The same data as "SendLaterItem" groups, as stored before
+    const QString name = fileName(QStringLiteral("benchmarkrc"));
+    {
+        KConfig config(name, KConfig::SimpleConfig);
+        for (int i = 0; i < benchmarkCount; ++i) {
+            KConfigGroup group = config.group(QStringLiteral("SendLaterItem %1").arg(i));
+            group.writeEntry("itemId", i);
+            group.writeEntry("subject", createValue(i, 100));
+            group.writeEntry("to", QStringLiteral("kde.org"));
+            group.writeEntry("date", QDateTime::currentDateTime());
+            group.writeEntry("recurrence", false);
+        }
+        config.sync();
+    }
+
+    int count = 0;
+    QBENCHMARK {
+        KConfig config(name, KConfig::SimpleConfig);
+        const QStringList itemList = config.groupList().filter(QRegularExpression(QStringLiteral("SendLaterItem \\d+")));
+        count = 0;
+        for (const QString &groupName : itemList) {
+            const KConfigGroup group = config.group(groupName);
+            if (group.readEntry("itemId", -1) != -1) {
+                ++count;
+            }
+        }
+    }
+    QCOMPARE(count, benchmarkCount);
+}
+
+void AgentStateStoreTest::benchmarkConfigUpdate()
+{
+    KSharedConfig::Ptr config = KSharedConfig::openConfig(fileName(QStringLiteral("benchmarkrc")), KConfig::SimpleConfig);
+    int key = 0;
+    QBENCHMARK {
+        const QString groupName = QStringLiteral("SendLaterItem %1").arg(key);
+        KConfigGroup group = config->group(groupName);
+        group.deleteGroup();
+        group.sync();
+        group = config->group(groupName);
+        group.writeEntry("itemId", key);
+        group.writeEntry("subject", createValue(key, 100));
+        group.sync();
+        key = (key + 1) % benchmarkCount;
+    }
+}
+
+QTEST_MAIN(AgentStateStoreTest)
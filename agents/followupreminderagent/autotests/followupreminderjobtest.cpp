@@ -0,0 +1,71 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "followupreminderjobtest.h"
+#include "../jobs/followupreminderjob.h"
+
+#include <qtest.h>
+
+FollowUpReminderJobTest::FollowUpReminderJobTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void FollowUpReminderJobTest::shouldNormalizeMessageId_data()
+{
+    QTest::addColumn<QString>("messageId");
+    QTest::addColumn<QString>("result");
+    QTest::newRow("empty") << QString() << QString();
+    QTest::newRow("brackets") << QStringLiteral("<foo@kde.org>") << QStringLiteral("foo@kde.org");
+    QTest::newRow("spaces") << QStringLiteral(" <foo@kde.org> ") << QStringLiteral("foo@kde.org");
+    QTest::newRow("plain") << QStringLiteral("foo@kde.org") << QStringLiteral("foo@kde.org");
+}
+
+void FollowUpReminderJobTest::shouldNormalizeMessageId()
+{
+    QFETCH(QString, messageId);
+    QFETCH(QString, result);
+    QCOMPARE(FollowUpReminderJob::normalizedMessageId(messageId), result);
+}
+
+void FollowUpReminderJobTest::shouldReturnReferencedMessageIds_data()
+{
+    QTest::addColumn<QByteArray>("headers");
+    QTest::addColumn<QStringList>("result");
+    QTest::newRow("none") << QByteArrayLiteral("Subject: foo\n") << QStringList();
+    QTest::newRow("in-reply-to") << QByteArrayLiteral("In-Reply-To: <a@kde.org>\n")
+                                 << (QStringList() << QStringLiteral("a@kde.org"));
+    QTest::newRow("references") << QByteArrayLiteral("References: <a@kde.org> <b@kde.org>\n")
+                                << (QStringList() << QStringLiteral("b@kde.org") << QStringLiteral("a@kde.org"));
+    QTest::newRow("both") << QByteArrayLiteral("In-Reply-To: <c@kde.org>\nReferences: <a@kde.org> <b@kde.org> <c@kde.org>\n")
+                          << (QStringList() << QStringLiteral("c@kde.org") << QStringLiteral("b@kde.org") << QStringLiteral("a@kde.org"));
+}
+
+void FollowUpReminderJobTest::shouldReturnReferencedMessageIds()
+{
+    QFETCH(QByteArray, headers);
+    QFETCH(QStringList, result);
+    KMime::Message::Ptr message(new KMime::Message);
+    message->setContent(headers + "\nbody\n");
+    message->parse();
+    QCOMPARE(FollowUpReminderJob::referencedMessageIds(message), result);
+    QVERIFY(FollowUpReminderJob::referencedMessageIds(KMime::Message::Ptr()).isEmpty());
+}
+
+QTEST_MAIN(FollowUpReminderJobTest)
@@ -0,0 +1,151 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "followupreminderstoretest.h"
+#include "../followupreminderstore.h"
+#include "FollowupReminder/FollowUpReminderInfo"
+#include "FollowupReminder/FollowUpReminderUtil"
+
+#include <KConfigGroup>
+
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <qtest.h>
+
+namespace {
+FollowUpReminder::FollowUpReminderInfo createInfo(const QString &messageId)
+{
+    FollowUpReminder::FollowUpReminderInfo info;
+    info.setMessageId(messageId);
+    info.setOriginalMessageItemId(42);
+    info.setFollowUpReminderDate(QDate(2018, 1, 1));
+    info.setTo(QStringLiteral("kde.org"));
+    info.setSubject(QStringLiteral("Subject"));
+    return info;
+}
+}
+
+FollowUpReminderStoreTest::FollowUpReminderStoreTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void FollowUpReminderStoreTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(mDir.isValid());
+}
+
+QString FollowUpReminderStoreTest::storeFileName(const QString &name) const
+{
+    return mDir.path() + QLatin1Char('/') + name;
+}
+
+void FollowUpReminderStoreTest::shouldSerializeInfo()
+{
+    FollowUpReminder::FollowUpReminderInfo info = createInfo(QStringLiteral("foo"));
+    info.setUniqueIdentifier(3);
+    info.setTodoId(5);
+    info.setAnswerWasReceived(true);
+    info.setAnswerMessageItemId(7);
+    FollowUpReminder::FollowUpReminderInfo *result = FollowUpReminderStore::deserialize(FollowUpReminderStore::serialize(info));
+    QVERIFY(result);
+    QCOMPARE(*result, info);
+    delete result;
+
+    QVERIFY(!FollowUpReminderStore::deserialize(QByteArray()));
+}
+
+void FollowUpReminderStoreTest::shouldAssignUniqueIdentifiers()
+{
+    const QString fileName = storeFileName(QStringLiteral("identifiers.store"));
+    {
+        FollowUpReminderStore store(fileName);
+        FollowUpReminder::FollowUpReminderInfo info = createInfo(QStringLiteral("foo"));
+        info.setUniqueIdentifier(10);
+        store.save(&info);
+        FollowUpReminder::FollowUpReminderInfo other = createInfo(QStringLiteral("bar"));
+        store.save(&other);
+        QCOMPARE(other.uniqueIdentifier(), 11);
+        QCOMPARE(store.count(), 2);
+    }
+
+    // The next identifier survives a restart
+    FollowUpReminderStore store(fileName);
+    QCOMPARE(store.count(), 2);
+    FollowUpReminder::FollowUpReminderInfo info = createInfo(QStringLiteral("baz"));
+    store.save(&info);
+    QCOMPARE(info.uniqueIdentifier(), 12);
+
+    // Invalid infos are not stored
+    FollowUpReminder::FollowUpReminderInfo invalid;
+    store.save(&invalid);
+    QCOMPARE(store.count(), 3);
+}
+
+void FollowUpReminderStoreTest::shouldRemoveItems()
+{
+    const QString fileName = storeFileName(QStringLiteral("remove.store"));
+    {
+        FollowUpReminderStore store(fileName);
+        for (int i = 0; i < 5; ++i) {
+            FollowUpReminder::FollowUpReminderInfo info = createInfo(QStringLiteral("id%1").arg(i));
+            store.save(&info);
+        }
+        QVERIFY(store.remove(QList<qint32>() << 1 << 3));
+        QVERIFY(!store.remove(QList<qint32>() << 1 << 42));
+    }
+
+    FollowUpReminderStore store(fileName);
+    QCOMPARE(store.count(), 3);
+    QVERIFY(!store.contains(1));
+    QVERIFY(!store.contains(3));
+    FollowUpReminder::FollowUpReminderInfo *info = store.info(4);
+    QVERIFY(info);
+    QCOMPARE(info->messageId(), QStringLiteral("id4"));
+    delete info;
+}
+
+void FollowUpReminderStoreTest::shouldImportConfigGroups()
+{
+    KSharedConfig::Ptr config = KSharedConfig::openConfig(QStringLiteral("test-followupreminderstore.rc"), KConfig::SimpleConfig);
+    for (int i = 0; i < 3; ++i) {
+        FollowUpReminder::FollowUpReminderInfo info = createInfo(QStringLiteral("id%1").arg(i));
+        FollowUpReminder::FollowUpReminderUtil::writeFollowupReminderInfo(config, &info, false);
+    }
+    QCOMPARE(config->group(QStringLiteral("General")).readEntry("Number", 0), 3);
+
+    FollowUpReminderStore store(storeFileName(QStringLiteral("import.store")));
+    FollowUpReminder::FollowUpReminderInfo existing = createInfo(QStringLiteral("existing"));
+    existing.setUniqueIdentifier(20);
+    store.save(&existing);
+
+    QList<qint32> identifiers = store.importConfig(config);
+    std::sort(identifiers.begin(), identifiers.end());
+    QCOMPARE(identifiers, QList<qint32>() << 0 << 1 << 2);
+    QCOMPARE(store.count(), 4);
+
+    config->reparseConfiguration();
+    QVERIFY(config->groupList().filter(QRegularExpression(QStringLiteral("FollowupReminderItem \\d+"))).isEmpty());
+    // The composer must not reuse an identifier of the store
+    QCOMPARE(config->group(QStringLiteral("General")).readEntry("Number", 0), 21);
+    QVERIFY(store.importConfig(config).isEmpty());
+}
+
+QTEST_MAIN(FollowUpReminderStoreTest)
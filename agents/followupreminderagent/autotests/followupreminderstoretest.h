@@ -0,0 +1,45 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef FOLLOWUPREMINDERSTORETEST_H
+#define FOLLOWUPREMINDERSTORETEST_H
+
+#include <QObject>
+#include <QTemporaryDir>
+
+class FollowUpReminderStoreTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FollowUpReminderStoreTest(QObject *parent = nullptr);
+    ~FollowUpReminderStoreTest() = default;
+
+private Q_SLOTS:
+    void initTestCase();
+    void shouldSerializeInfo();
+    void shouldAssignUniqueIdentifiers();
+    void shouldRemoveItems();
+    void shouldImportConfigGroups();
+
+private:
+    QString storeFileName(const QString &name) const;
+    QTemporaryDir mDir;
+};
+
+#endif // FOLLOWUPREMINDERSTORETEST_H
@@ -19,7 +19,7 @@
 
 #include "followupreminderagent.h"
 #include "followupremindermanager.h"
-#include "FollowupReminder/FollowUpReminderUtil"
+#include "followupreminderstore.h"
 #include "followupreminderadaptor.h"
 #include "followupreminderinfodialog.h"
 #include "followupreminderagentsettings.h"
@@ -28,6 +28,7 @@
 
 #include <AkonadiCore/ChangeRecorder>
 #include <AkonadiCore/ItemFetchScope>
+#include <Akonadi/KMime/MessageParts>
 #include <kdbusconnectionpool.h>
 
 #include <Kdelibs4ConfigMigrator>
@@ -55,6 +56,8 @@ FollowUpReminderAgent::FollowUpReminderAgent(const QString &id)
 
     changeRecorder()->setMimeTypeMonitored(KMime::Message::mimeType());
     changeRecorder()->itemFetchScope().setCacheOnly(true);
+    // In-Reply-To and References are part of the envelope
+    changeRecorder()->itemFetchScope().fetchPayloadPart(Akonadi::MessagePart::Envelope);
     changeRecorder()->itemFetchScope().setFetchModificationTime(false);
     changeRecorder()->fetchCollection(true);
     changeRecorder()->setChangeRecordingEnabled(false);
@@ -106,7 +109,7 @@ void FollowUpReminderAgent::configure(WId windowId)
     }
     if (dialog->exec()) {
         const QList<qint32> lstRemoveItem = dialog->listRemoveId();
-        if (FollowUpReminder::FollowUpReminderUtil::removeFollowupReminderInfo(FollowUpReminder::FollowUpReminderUtil::defaultConfig(), lstRemoveItem, true)) {
+        if (FollowUpReminderStore::self()->remove(lstRemoveItem)) {
             mManager->load();
         }
     }
@@ -18,7 +18,7 @@
 */
 #include "followupreminderinfowidget.h"
 #include "FollowupReminder/FollowUpReminderInfo"
-#include "FollowupReminder/FollowUpReminderUtil"
+#include "followupreminderstore.h"
 #include "jobs/followupremindershowmessagejob.h"
 #include "followupreminderagent_debug.h"
 
@@ -34,12 +34,6 @@
 #include <KMessageBox>
 
 // #define DEBUG_MESSAGE_ID
-namespace {
-inline QString followUpItemPattern()
-{
-    return QStringLiteral("FollowupReminderItem \\d+");
-}
-}
 
 FollowUpReminderInfoItem::FollowUpReminderInfoItem(QTreeWidget *parent)
     : QTreeWidgetItem(parent)
@@ -109,13 +103,10 @@ void FollowUpReminderInfoWidget::setInfo(const QList<FollowUpReminder::FollowUpR
 
 void FollowUpReminderInfoWidget::load()
 {
-    KSharedConfig::Ptr config = KSharedConfig::openConfig();
-    const QStringList filterGroups = config->groupList().filter(QRegularExpression(followUpItemPattern()));
-    const int numberOfItem = filterGroups.count();
-    for (int i = 0; i < numberOfItem; ++i) {
-        KConfigGroup group = config->group(filterGroups.at(i));
-
-        FollowUpReminder::FollowUpReminderInfo *info = new FollowUpReminder::FollowUpReminderInfo(group);
+    FollowUpReminderStore *store = FollowUpReminderStore::self();
+    store->importConfig(KSharedConfig::openConfig());
+    const QList<FollowUpReminder::FollowUpReminderInfo *> infos = store->infos();
+    for (FollowUpReminder::FollowUpReminderInfo *info : infos) {
         if (info->isValid()) {
             createOrUpdateItem(info);
         } else {
@@ -160,28 +151,9 @@ bool FollowUpReminderInfoWidget::save()
     if (!mChanged) {
         return false;
     }
-    KSharedConfig::Ptr config = KSharedConfig::openConfig();
-
-    // first, delete all filter groups:
-    const QStringList filterGroups = config->groupList().filter(QRegularExpression(followUpItemPattern()));
-
-    for (const QString &group : filterGroups) {
-        config->deleteGroup(group);
-    }
-
-    const int numberOfItem(mTreeWidget->topLevelItemCount());
-    int i = 0;
-    for (; i < numberOfItem; ++i) {
-        FollowUpReminderInfoItem *mailItem = static_cast<FollowUpReminderInfoItem *>(mTreeWidget->topLevelItem(i));
-        if (mailItem->info()) {
-            KConfigGroup group = config->group(FollowUpReminder::FollowUpReminderUtil::followUpReminderPattern().arg(i));
-            mailItem->info()->writeConfig(group, i);
-        }
-    }
-    ++i;
-    KConfigGroup general = config->group(QStringLiteral("General"));
-    general.writeEntry("Number", i);
-    config->sync();
+    // Only items can be removed here, and the widget may show a subset of
+    // the reminders, so don't rewrite the others.
+    FollowUpReminderStore::self()->remove(mListRemoveId);
     return true;
 }
 
@@ -20,21 +20,18 @@
 #include "followupremindermanager.h"
 #include "followupreminderagent_debug.h"
 #include "FollowupReminder/FollowUpReminderInfo"
-#include "FollowupReminder/FollowUpReminderUtil"
 #include "followupremindernoanswerdialog.h"
+#include "followupreminderstore.h"
 #include "jobs/followupreminderjob.h"
 #include "jobs/followupreminderfinishtaskjob.h"
 #include <Akonadi/KMime/SpecialMailCollections>
 
 #include <QIcon>
 
-#include <KConfigGroup>
-#include <KConfig>
 #include <KSharedConfig>
 #include <knotification.h>
 #include <KLocalizedString>
 #include <KIconLoader>
-#include <QRegularExpression>
 using namespace FollowUpReminder;
 
 FollowUpReminderManager::FollowUpReminderManager(QObject *parent)
@@ -47,6 +44,7 @@ FollowUpReminderManager::~FollowUpReminderManager()
 {
     qDeleteAll(mFollowUpReminderInfoList);
     mFollowUpReminderInfoList.clear();
+    mMessageIdIndex.clear();
 }
 
 void FollowUpReminderManager::load(bool forceReloadConfig)
@@ -54,24 +52,20 @@ void FollowUpReminderManager::load(bool forceReloadConfig)
     if (forceReloadConfig) {
         mConfig->reparseConfiguration();
     }
-    const QStringList itemList = mConfig->groupList().filter(QRegularExpression(QStringLiteral("FollowupReminderItem \\d+")));
-    const int numberOfItems = itemList.count();
+    FollowUpReminderStore *store = FollowUpReminderStore::self();
+    store->importConfig(mConfig);
+
+    mMessageIdIndex.clear();
+    qDeleteAll(mFollowUpReminderInfoList);
+    mFollowUpReminderInfoList.clear();
+    const QList<FollowUpReminderInfo *> infos = store->infos();
     QList<FollowUpReminder::FollowUpReminderInfo *> noAnswerList;
-    for (int i = 0; i < numberOfItems; ++i) {
-        KConfigGroup group = mConfig->group(itemList.at(i));
-
-        FollowUpReminderInfo *info = new FollowUpReminderInfo(group);
-        if (info->isValid()) {
-            if (!info->answerWasReceived()) {
-                mFollowUpReminderInfoList.append(info);
-                if (!mInitialize) {
-                    FollowUpReminderInfo *noAnswerInfo = new FollowUpReminderInfo(*info);
-                    noAnswerList.append(noAnswerInfo);
-                } else {
-                    delete info;
-                }
-            } else {
-                delete info;
+    for (FollowUpReminderInfo *info : infos) {
+        if (info->isValid() && !info->answerWasReceived()) {
+            mFollowUpReminderInfoList.append(info);
+            mMessageIdIndex.insert(FollowUpReminderJob::normalizedMessageId(info->messageId()), info);
+            if (!mInitialize) {
+                noAnswerList.append(new FollowUpReminderInfo(*info));
             }
         } else {
             delete info;
@@ -95,7 +89,7 @@ void FollowUpReminderManager::slotReparseConfiguration()
 
 void FollowUpReminderManager::checkFollowUp(const Akonadi::Item &item, const Akonadi::Collection &col)
 {
-    if (mFollowUpReminderInfoList.isEmpty()) {
+    if (mMessageIdIndex.isEmpty()) {
         return;
     }
 
@@ -111,20 +105,33 @@ void FollowUpReminderManager::checkFollowUp(const Akonadi::Item &item, const Ako
         break;
     }
 
+    // The agent monitors new mails with their envelope, so usually there
+    // is nothing to fetch.
+    if (item.hasPayload<KMime::Message::Ptr>()) {
+        const QStringList messageIds = FollowUpReminderJob::referencedMessageIds(item.payload<KMime::Message::Ptr>());
+        if (!messageIds.isEmpty()) {
+            slotCheckFollowUpFinished(messageIds, item.id());
+        }
+        return;
+    }
+
     FollowUpReminderJob *job = new FollowUpReminderJob(this);
     connect(job, &FollowUpReminderJob::finished, this, &FollowUpReminderManager::slotCheckFollowUpFinished);
     job->setItem(item);
     job->start();
 }
 
-void FollowUpReminderManager::slotCheckFollowUpFinished(const QString &messageId, Akonadi::Item::Id id)
+void FollowUpReminderManager::slotCheckFollowUpFinished(const QStringList &messageIds, Akonadi::Item::Id id)
 {
-    for (FollowUpReminderInfo *info : qAsConst(mFollowUpReminderInfoList)) {
-        qCDebug(FOLLOWUPREMINDERAGENT_LOG) << "FollowUpReminderManager::slotCheckFollowUpFinished info:" << info;
-        if (!info) {
+    for (const QString &messageId : messageIds) {
+        // An answer late in a thread also answers the earlier tracked messages
+        const QList<FollowUpReminderInfo *> infos = mMessageIdIndex.values(messageId);
+        if (infos.isEmpty()) {
             continue;
         }
-        if (info->messageId() == messageId) {
+        mMessageIdIndex.remove(messageId);
+        for (FollowUpReminderInfo *info : infos) {
+            qCDebug(FOLLOWUPREMINDERAGENT_LOG) << "FollowUpReminderManager::slotCheckFollowUpFinished info:" << info;
             info->setAnswerMessageItemId(id);
             info->setAnswerWasReceived(true);
             answerReceived(info->to());
@@ -135,8 +142,7 @@ void FollowUpReminderManager::slotCheckFollowUpFinished(const QString &messageId
                 job->start();
             }
             //Save item
-            FollowUpReminder::FollowUpReminderUtil::writeFollowupReminderInfo(FollowUpReminder::FollowUpReminderUtil::defaultConfig(), info, true);
-            break;
+            FollowUpReminderStore::self()->save(info);
         }
     }
 }
@@ -166,15 +172,12 @@ void FollowUpReminderManager::answerReceived(const QString &from)
 
 QString FollowUpReminderManager::printDebugInfo()
 {
-    QString infoStr;
+    QString infoStr = QStringLiteral("Waiting for an answer: %1\n").arg(mMessageIdIndex.count());
     if (mFollowUpReminderInfoList.isEmpty()) {
-        infoStr = QStringLiteral("No mail");
+        infoStr += QStringLiteral("No mail");
     } else {
         for (FollowUpReminder::FollowUpReminderInfo *info : qAsConst(mFollowUpReminderInfoList)) {
-            if (!infoStr.isEmpty()) {
-                infoStr += QLatin1Char('\n');
-            }
-            infoStr += infoToStr(info);
+            infoStr += QLatin1Char('\n') + infoToStr(info);
         }
     }
     return infoStr;
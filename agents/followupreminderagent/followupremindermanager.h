@@ -20,6 +20,7 @@
 #ifndef FOLLOWUPREMINDERMANAGER_H
 #define FOLLOWUPREMINDERMANAGER_H
 
+#include <QMultiHash>
 #include <QObject>
 #include <KSharedConfig>
 #include <AkonadiCore/Item>
@@ -41,7 +42,7 @@ public:
     QString printDebugInfo();
 private:
     Q_DISABLE_COPY(FollowUpReminderManager)
-    void slotCheckFollowUpFinished(const QString &messageId, Akonadi::Item::Id id);
+    void slotCheckFollowUpFinished(const QStringList &messageIds, Akonadi::Item::Id id);
 
     void slotFinishTaskDone();
     void slotFinishTaskFailed();
@@ -51,6 +52,8 @@ private:
 
     KSharedConfig::Ptr mConfig;
     QList<FollowUpReminder::FollowUpReminderInfo *> mFollowUpReminderInfoList;
+    // Normalized Message-ID -> reminders still waiting for an answer
+    QMultiHash<QString, FollowUpReminder::FollowUpReminderInfo *> mMessageIdIndex;
     QPointer<FollowUpReminderNoAnswerDialog> mNoAnswerDialog;
     bool mInitialize = false;
 };
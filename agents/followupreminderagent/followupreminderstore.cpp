@@ -0,0 +1,200 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "followupreminderstore.h"
+#include "followupreminderagent_debug.h"
+#include "FollowupReminder/FollowUpReminderInfo"
+
+#include <KConfigGroup>
+
+#include <QDataStream>
+#include <QRegularExpression>
+
+namespace {
+const quint8 infoVersion = 1;
+}
+
+Q_GLOBAL_STATIC_WITH_ARGS(FollowUpReminderStore, s_followUpReminderStore, (AgentStateStore::defaultFileName(QStringLiteral("followupreminder.store"))))
+
+FollowUpReminderStore::FollowUpReminderStore(const QString &fileName)
+    : mStore(fileName)
+{
+    if (!mStore.open()) {
+        qCWarning(FOLLOWUPREMINDERAGENT_LOG) << "Changes to the follow up reminders can't be saved in" << fileName;
+    }
+    const QList<qint64> keys = mStore.keys();
+    for (qint64 key : keys) {
+        mNextIdentifier = qMax(mNextIdentifier, qint32(key) + 1);
+    }
+}
+
+FollowUpReminderStore::~FollowUpReminderStore()
+{
+}
+
+FollowUpReminderStore *FollowUpReminderStore::self()
+{
+    return s_followUpReminderStore;
+}
+
+QList<FollowUpReminder::FollowUpReminderInfo *> FollowUpReminderStore::infos() const
+{
+    QList<FollowUpReminder::FollowUpReminderInfo *> lst;
+    lst.reserve(mStore.count());
+    const QHash<qint64, QByteArray> &values = mStore.values();
+    for (auto it = values.cbegin(), end = values.cend(); it != end; ++it) {
+        if (FollowUpReminder::FollowUpReminderInfo *info = deserialize(it.value())) {
+            lst.append(info);
+        }
+    }
+    return lst;
+}
+
+FollowUpReminder::FollowUpReminderInfo *FollowUpReminderStore::info(qint32 identifier) const
+{
+    if (!mStore.contains(identifier)) {
+        return nullptr;
+    }
+    return deserialize(mStore.value(identifier));
+}
+
+bool FollowUpReminderStore::contains(qint32 identifier) const
+{
+    return mStore.contains(identifier);
+}
+
+int FollowUpReminderStore::count() const
+{
+    return mStore.count();
+}
+
+void FollowUpReminderStore::save(FollowUpReminder::FollowUpReminderInfo *info)
+{
+    if (!info || !info->isValid()) {
+        return;
+    }
+    if (info->uniqueIdentifier() < 0) {
+        info->setUniqueIdentifier(mNextIdentifier);
+    }
+    mNextIdentifier = qMax(mNextIdentifier, info->uniqueIdentifier() + 1);
+    mStore.insert(info->uniqueIdentifier(), serialize(*info));
+}
+
+bool FollowUpReminderStore::remove(qint32 identifier)
+{
+    if (!mStore.contains(identifier)) {
+        return false;
+    }
+    mStore.remove(identifier);
+    return true;
+}
+
+bool FollowUpReminderStore::remove(const QList<qint32> &identifiers)
+{
+    bool removed = false;
+    for (qint32 identifier : identifiers) {
+        if (remove(identifier)) {
+            removed = true;
+        }
+    }
+    return removed;
+}
+
+QList<qint32> FollowUpReminderStore::importConfig(const KSharedConfig::Ptr &config)
+{
+    QList<qint32> identifiers;
+    const QStringList itemList = config->groupList().filter(QRegularExpression(QStringLiteral("FollowupReminderItem \\d+")));
+    if (itemList.isEmpty()) {
+        return identifiers;
+    }
+    for (const QString &groupName : itemList) {
+        KConfigGroup group = config->group(groupName);
+        FollowUpReminder::FollowUpReminderInfo info(group);
+        if (info.isValid()) {
+            save(&info);
+            identifiers.append(info.uniqueIdentifier());
+        }
+        config->deleteGroup(groupName);
+    }
+    // The composer numbers new reminders from General/Number, keep it
+    // above the identifiers already in use.
+    KConfigGroup general = config->group(QStringLiteral("General"));
+    if (general.readEntry("Number", 0) < mNextIdentifier) {
+        general.writeEntry("Number", mNextIdentifier);
+    }
+    config->sync();
+    qCDebug(FOLLOWUPREMINDERAGENT_LOG) << "Imported" << identifiers.count() << "follow up reminders from" << config->name();
+    return identifiers;
+}
+
+QByteArray FollowUpReminderStore::serialize(const FollowUpReminder::FollowUpReminderInfo &info)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_9);
+    stream << infoVersion
+           << info.uniqueIdentifier()
+           << info.originalMessageItemId()
+           << info.messageId()
+           << info.followUpReminderDate()
+           << info.to()
+           << info.subject()
+           << info.todoId()
+           << info.answerWasReceived()
+           << info.answerMessageItemId();
+    return data;
+}
+
+FollowUpReminder::FollowUpReminderInfo *FollowUpReminderStore::deserialize(const QByteArray &data)
+{
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_9);
+    quint8 version = 0;
+    stream >> version;
+    if (version != infoVersion) {
+        qCWarning(FOLLOWUPREMINDERAGENT_LOG) << "Unknown follow up reminder version" << version;
+        return nullptr;
+    }
+    qint32 identifier = -1;
+    qint64 originalMessageItemId = -1;
+    QString messageId;
+    QDate date;
+    QString to;
+    QString subject;
+    qint64 todoId = -1;
+    bool answerWasReceived = false;
+    qint64 answerMessageItemId = -1;
+    stream >> identifier >> originalMessageItemId >> messageId >> date >> to >> subject
+           >> todoId >> answerWasReceived >> answerMessageItemId;
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(FOLLOWUPREMINDERAGENT_LOG) << "Corrupted follow up reminder";
+        return nullptr;
+    }
+    FollowUpReminder::FollowUpReminderInfo *info = new FollowUpReminder::FollowUpReminderInfo;
+    info->setUniqueIdentifier(identifier);
+    info->setOriginalMessageItemId(originalMessageItemId);
+    info->setMessageId(messageId);
+    info->setFollowUpReminderDate(date);
+    info->setTo(to);
+    info->setSubject(subject);
+    info->setTodoId(todoId);
+    info->setAnswerWasReceived(answerWasReceived);
+    info->setAnswerMessageItemId(answerMessageItemId);
+    return info;
+}
@@ -0,0 +1,82 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef FOLLOWUPREMINDERSTORE_H
+#define FOLLOWUPREMINDERSTORE_H
+
+#include "agentstatestore.h"
+
+#include <KSharedConfig>
+
+namespace FollowUpReminder {
+class FollowUpReminderInfo;
+}
+
+/**
+ * @short The messages tracked by the follow up reminder agent.
+ *
+ * The infos are kept in an AgentStateStore indexed by their unique
+ * identifier. The composer writes new reminders as "FollowupReminderItem"
+ * groups into the agent configuration, importConfig() moves them into the
+ * store.
+ */
+class FollowUpReminderStore
+{
+public:
+    explicit FollowUpReminderStore(const QString &fileName);
+    ~FollowUpReminderStore();
+
+    static FollowUpReminderStore *self();
+
+    /**
+     * Returns copies of all stored infos, owned by the caller.
+     */
+    QList<FollowUpReminder::FollowUpReminderInfo *> infos() const;
+
+    /**
+     * Returns a copy of the info of @p identifier owned by the caller, or nullptr.
+     */
+    FollowUpReminder::FollowUpReminderInfo *info(qint32 identifier) const;
+
+    bool contains(qint32 identifier) const;
+    int count() const;
+
+    /**
+     * Stores @p info, after giving it a unique identifier if it has none yet.
+     */
+    void save(FollowUpReminder::FollowUpReminderInfo *info);
+    bool remove(qint32 identifier);
+    bool remove(const QList<qint32> &identifiers);
+
+    /**
+     * Moves the "FollowupReminderItem" groups of @p config into the store and
+     * returns the identifiers of the imported infos.
+     */
+    QList<qint32> importConfig(const KSharedConfig::Ptr &config);
+
+    static QByteArray serialize(const FollowUpReminder::FollowUpReminderInfo &info);
+    static FollowUpReminder::FollowUpReminderInfo *deserialize(const QByteArray &data);
+
+private:
+    Q_DISABLE_COPY(FollowUpReminderStore)
+    AgentStateStore mStore;
+    qint32 mNextIdentifier = 0;
+};
+
+#endif // FOLLOWUPREMINDERSTORE_H
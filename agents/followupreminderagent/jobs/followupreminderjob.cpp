@@ -23,8 +23,6 @@
 #include <AkonadiCore/ItemFetchScope>
 #include <Akonadi/KMime/MessageParts>
 
-#include <KMime/Message>
-
 #include "followupreminderagent_debug.h"
 
 FollowUpReminderJob::FollowUpReminderJob(QObject *parent)
@@ -77,13 +75,46 @@ void FollowUpReminderJob::slotItemFetchJobDone(KJob *job)
         deleteLater();
         return;
     }
-    const KMime::Message::Ptr msg = item.payload<KMime::Message::Ptr>();
-    if (msg) {
-        KMime::Headers::InReplyTo *replyTo = msg->inReplyTo(false);
-        if (replyTo) {
-            const QString replyToIdStr = replyTo->asUnicodeString();
-            Q_EMIT finished(replyToIdStr, item.id());
-        }
+    const QStringList messageIds = referencedMessageIds(item.payload<KMime::Message::Ptr>());
+    if (!messageIds.isEmpty()) {
+        Q_EMIT finished(messageIds, item.id());
     }
     deleteLater();
 }
+
+QStringList FollowUpReminderJob::referencedMessageIds(const KMime::Message::Ptr &message)
+{
+    QStringList messageIds;
+    if (!message) {
+        return messageIds;
+    }
+    if (KMime::Headers::InReplyTo *replyTo = message->inReplyTo(false)) {
+        const auto identifiers = replyTo->identifiers();
+        for (const QByteArray &identifier : identifiers) {
+            messageIds.append(normalizedMessageId(QString::fromLatin1(identifier)));
+        }
+    }
+    if (KMime::Headers::References *references = message->references(false)) {
+        const auto identifiers = references->identifiers();
+        for (int i = identifiers.count() - 1; i >= 0; --i) {
+            const QString messageId = normalizedMessageId(QString::fromLatin1(identifiers.at(i)));
+            if (!messageIds.contains(messageId)) {
+                messageIds.append(messageId);
+            }
+        }
+    }
+    messageIds.removeAll(QString());
+    return messageIds;
+}
+
+QString FollowUpReminderJob::normalizedMessageId(const QString &messageId)
+{
+    QString result = messageId.trimmed();
+    if (result.startsWith(QLatin1Char('<'))) {
+        result.remove(0, 1);
+    }
+    if (result.endsWith(QLatin1Char('>'))) {
+        result.chop(1);
+    }
+    return result;
+}
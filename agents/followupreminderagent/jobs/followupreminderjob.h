@@ -23,6 +23,7 @@
 #include <QObject>
 
 #include <AkonadiCore/Item>
+#include <KMime/Message>
 
 class FollowUpReminderJob : public QObject
 {
@@ -35,8 +36,20 @@ public:
 
     void start();
 
+    /**
+     * Returns the normalized Message-IDs @p message answers, from its
+     * In-Reply-To header first and then from its References, the most
+     * recent first.
+     */
+    static QStringList referencedMessageIds(const KMime::Message::Ptr &message);
+
+    /**
+     * Returns @p messageId without surrounding spaces and angle brackets.
+     */
+    static QString normalizedMessageId(const QString &messageId);
+
 Q_SIGNALS:
-    void finished(const QString &messageId, Akonadi::Item::Id id);
+    void finished(const QStringList &messageIds, Akonadi::Item::Id id);
 
 private:
     Q_DISABLE_COPY(FollowUpReminderJob)
@@ -0,0 +1,209 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+#include "filtercommitstagetest.h"
+#include "../filtercommitstage.h"
+
+#include <QTest>
+
+using namespace MailCommon;
+
+namespace {
+ItemContext createContext(Akonadi::Item::Id id, Akonadi::Collection::Id source = 1)
+{
+    Akonadi::Item item(id);
+    item.setParentCollection(Akonadi::Collection(source));
+    return ItemContext(item, false);
+}
+
+// The test items had neither flags nor tags before filtering
+Akonadi::Item::List originals(const QList<ItemContext> &contexts)
+{
+    Akonadi::Item::List items;
+    for (ItemContext context : contexts) {
+        items << Akonadi::Item(context.item().id());
+    }
+    return items;
+}
+}
+
+FilterCommitStageTest::FilterCommitStageTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void FilterCommitStageTest::shouldHaveDefaultValue()
+{
+    FilterCommitStage stage;
+    QCOMPARE(stage.jobsInFlight(), 0);
+    QCOMPARE(stage.queuedOperationCount(), 0);
+    QCOMPARE(stage.committedItemCount(), qint64(0));
+    QCOMPARE(stage.createdJobCount(), qint64(0));
+    QVERIFY(stage.maximumJobsInFlight() > 0);
+    QVERIFY(stage.maximumItemsPerJob() > 0);
+    QVERIFY(FilterCommitStage::plan(QList<ItemContext>(), Akonadi::Item::List(), 10).isEmpty());
+}
+
+void FilterCommitStageTest::shouldGroupByTargetCollection()
+{
+    QList<ItemContext> contexts;
+    for (int i = 0; i < 10; ++i) {
+        ItemContext context = createContext(i + 1);
+        context.setMoveTargetCollection(Akonadi::Collection(i % 2 ? 10 : 11));
+        contexts << context;
+    }
+    // not moved: already in the target collection
+    ItemContext context = createContext(100, 10);
+    context.setMoveTargetCollection(Akonadi::Collection(10));
+    contexts << context;
+    ItemContext deleted = createContext(101);
+    deleted.setDeleteItem();
+    contexts << deleted;
+
+    const QVector<FilterCommitStage::Operation> operations = FilterCommitStage::plan(contexts, originals(contexts), 100);
+    QCOMPARE(operations.count(), 3);
+    QCOMPARE(operations.at(0).type, FilterCommitStage::Operation::Delete);
+    QCOMPARE(operations.at(0).items.count(), 1);
+    QCOMPARE(operations.at(1).type, FilterCommitStage::Operation::Move);
+    QCOMPARE(operations.at(1).items.count(), 5);
+    QCOMPARE(operations.at(2).type, FilterCommitStage::Operation::Move);
+    QCOMPARE(operations.at(2).items.count(), 5);
+}
+
+void FilterCommitStageTest::shouldGroupFlagChanges()
+{
+    QList<ItemContext> contexts;
+    for (int i = 0; i < 9; ++i) {
+        ItemContext context = createContext(i + 1);
+        context.item().setFlag(i % 3 ? QByteArray("\\SEEN") : QByteArray("$TODO"));
+        context.setNeedsFlagStore();
+        contexts << context;
+    }
+    const QVector<FilterCommitStage::Operation> operations = FilterCommitStage::plan(contexts, originals(contexts), 100);
+    QCOMPARE(operations.count(), 2);
+    for (const FilterCommitStage::Operation &operation : operations) {
+        QCOMPARE(operation.type, FilterCommitStage::Operation::ModifyFlags);
+        for (const Akonadi::Item &item : operation.items) {
+            QVERIFY(item.remoteId().isEmpty());
+            QCOMPARE(item.flags(), operation.items.first().flags());
+        }
+    }
+}
+
+void FilterCommitStageTest::shouldOnlySendFlagChanges()
+{
+    QList<ItemContext> contexts;
+    Akonadi::Item::List originalItems;
+    for (int i = 0; i < 4; ++i) {
+        ItemContext context = createContext(i + 1);
+        context.item().setFlags(Akonadi::Item::Flags() << "\\SEEN" << "$IMPORTANT");
+        if (i % 2) {
+            context.item().setFlag("$REPLIED");
+        }
+        originalItems << context.item();
+        if (i < 3) {
+            context.item().setFlag("$TODO");
+            context.item().clearFlag("$IMPORTANT");
+        }
+        context.setNeedsFlagStore();
+        contexts << context;
+    }
+    const QVector<FilterCommitStage::Operation> operations = FilterCommitStage::plan(contexts, originalItems, 100);
+    // the last item didn't change
+    QCOMPARE(operations.count(), 1);
+    QCOMPARE(operations.at(0).type, FilterCommitStage::Operation::ModifyFlags);
+    QCOMPARE(operations.at(0).items.count(), 3);
+    for (const Akonadi::Item &item : operations.at(0).items) {
+        QCOMPARE(item.flags(), Akonadi::Item::Flags() << "$TODO");
+    }
+}
+
+void FilterCommitStageTest::shouldKeepPayloadChangesSeparate()
+{
+    QList<ItemContext> contexts;
+    for (int i = 0; i < 3; ++i) {
+        ItemContext context = createContext(i + 1);
+        context.setNeedsPayloadStore();
+        contexts << context;
+    }
+    const QVector<FilterCommitStage::Operation> operations = FilterCommitStage::plan(contexts, originals(contexts), 100);
+    QCOMPARE(operations.count(), 3);
+    for (const FilterCommitStage::Operation &operation : operations) {
+        QCOMPARE(operation.type, FilterCommitStage::Operation::ModifyPayload);
+        QCOMPARE(operation.items.count(), 1);
+        QVERIFY(operation.ignorePayload);
+    }
+}
+
+void FilterCommitStageTest::shouldSplitLargeGroups()
+{
+    QList<ItemContext> contexts;
+    for (int i = 0; i < 250; ++i) {
+        ItemContext context = createContext(i + 1);
+        context.setMoveTargetCollection(Akonadi::Collection(10));
+        contexts << context;
+    }
+    const QVector<FilterCommitStage::Operation> operations = FilterCommitStage::plan(contexts, originals(contexts), 100);
+    QCOMPARE(operations.count(), 3);
+    QCOMPARE(operations.at(0).items.count(), 100);
+    QCOMPARE(operations.at(1).items.count(), 100);
+    QCOMPARE(operations.at(2).items.count(), 50);
+}
+
+void FilterCommitStageTest::benchmarkJobsPerMessage_data()
+{
+    QTest::addColumn<int>("messages");
+    QTest::addColumn<int>("targets");
+
+    QTest::newRow("1000 messages, 10 folders") << 1000 << 10;
+    QTest::newRow("50000 messages, 50 folders") << 50000 << 50;
+}
+
+void FilterCommitStageTest::benchmarkJobsPerMessage()
+{
+    QFETCH(int, messages);
+    QFETCH(int, targets);
+
+    // A typical "apply filters to folder" result: most mails are moved,
+    // all of them get their flags changed, a few are deleted.
+    QList<ItemContext> contexts;
+    contexts.reserve(messages);
+    for (int i = 0; i < messages; ++i) {
+        ItemContext context = createContext(i + 1);
+        if (i % 100 == 0) {
+            context.setDeleteItem();
+        } else {
+            context.setMoveTargetCollection(Akonadi::Collection(100 + i % targets));
+            context.item().setFlag(i % 2 ? QByteArray("\\SEEN") : QByteArray("$TODO"));
+            context.setNeedsFlagStore();
+        }
+        contexts << context;
+    }
+
+    const Akonadi::Item::List originalItems = originals(contexts);
+    QVector<FilterCommitStage::Operation> operations;
+    QBENCHMARK {
+        operations = FilterCommitStage::plan(contexts, originalItems, 500);
+    }
+
+    // Without grouping, every message needed one or two jobs
+    const double jobsPerMessage = static_cast<double>(operations.count()) / messages;
+    QVERIFY(jobsPerMessage < 0.1);
+}
+
+QTEST_MAIN(FilterCommitStageTest)
@@ -0,0 +1,145 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+#include "filterenginetest.h"
+#include "../filterengine.h"
+
+#include <MailCommon/MailFilter>
+#include <QTest>
+
+using namespace MailCommon;
+
+namespace {
+Akonadi::Item createItem()
+{
+    KMime::Message::Ptr msg(new KMime::Message);
+    msg->setContent("From: Foo Bar <foo@kde.org>\n"
+                    "To: bar@kde.org\n"
+                    "Subject: [kde-pim] Filter engine\n"
+                    "List-Id: <kde-pim.kde.org>\n"
+                    "\n"
+                    "body\n");
+    msg->parse();
+    Akonadi::Item item(42);
+    item.setMimeType(KMime::Message::mimeType());
+    item.setPayload<KMime::Message::Ptr>(msg);
+    return item;
+}
+
+MailFilter *createFilter(SearchPattern::Operator op, const QList<SearchRule::Ptr> &rules)
+{
+    MailFilter *filter = new MailFilter;
+    filter->pattern()->setOp(op);
+    for (const SearchRule::Ptr &rule : rules) {
+        filter->pattern()->append(rule);
+    }
+    return filter;
+}
+}
+
+FilterEngineTest::FilterEngineTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void FilterEngineTest::shouldBeEmptyByDefault()
+{
+    FilterEngine engine;
+    QCOMPARE(engine.fieldCount(), 0);
+    QCOMPARE(engine.predicateCount(), 0);
+}
+
+void FilterEngineTest::shouldShareFieldsAndPredicates()
+{
+    QList<MailFilter *> filters;
+    filters << createFilter(SearchPattern::OpAnd, {SearchRule::createInstance("Subject", SearchRule::FuncContains, QStringLiteral("kde")),
+                                                   SearchRule::createInstance("From", SearchRule::FuncContains, QStringLiteral("foo"))});
+    filters << createFilter(SearchPattern::OpOr, {SearchRule::createInstance("subject", SearchRule::FuncContains, QStringLiteral("kde")),
+                                                  SearchRule::createInstance("List-Id", SearchRule::FuncEquals, QStringLiteral("<kde-pim.kde.org>"))});
+    filters << createFilter(SearchPattern::OpAnd, {SearchRule::createInstance("<size>", SearchRule::FuncIsGreater, QStringLiteral("1"))});
+
+    FilterEngine engine;
+    engine.compile(filters);
+    QCOMPARE(engine.fieldCount(), 3);
+    QCOMPARE(engine.predicateCount(), 3);
+
+    const Akonadi::Item item = createItem();
+    FilterEngine::MessageState state(item);
+    for (const MailFilter *filter : qAsConst(filters)) {
+        QVERIFY(engine.contains(filter));
+        QCOMPARE(engine.matches(state, filter), filter->pattern()->matches(item));
+    }
+    qDeleteAll(filters);
+}
+
+void FilterEngineTest::shouldMatchLikeSearchPattern_data()
+{
+    QTest::addColumn<QByteArray>("field");
+    QTest::addColumn<int>("function");
+    QTest::addColumn<QString>("contents");
+
+    QTest::newRow("contains") << QByteArray("Subject") << int(SearchRule::FuncContains) << QStringLiteral("FILTER");
+    QTest::newRow("containsnot") << QByteArray("Subject") << int(SearchRule::FuncContainsNot) << QStringLiteral("kmail");
+    QTest::newRow("equals") << QByteArray("To") << int(SearchRule::FuncEquals) << QStringLiteral("BAR@kde.org");
+    QTest::newRow("notequal") << QByteArray("To") << int(SearchRule::FuncNotEqual) << QStringLiteral("bar@kde.org");
+    QTest::newRow("regexp") << QByteArray("From") << int(SearchRule::FuncRegExp) << QStringLiteral("foo@.*\\.org");
+    QTest::newRow("notregexp") << QByteArray("From") << int(SearchRule::FuncNotRegExp) << QStringLiteral("^bar");
+    QTest::newRow("missingheader") << QByteArray("X-Spam-Flag") << int(SearchRule::FuncContainsNot) << QStringLiteral("yes");
+    QTest::newRow("notcompiled") << QByteArray("<recipients>") << int(SearchRule::FuncContains) << QStringLiteral("bar");
+}
+
+void FilterEngineTest::shouldMatchLikeSearchPattern()
+{
+    QFETCH(QByteArray, field);
+    QFETCH(int, function);
+    QFETCH(QString, contents);
+
+    QList<MailFilter *> filters;
+    filters << createFilter(SearchPattern::OpAnd, {SearchRule::createInstance(field, static_cast<SearchRule::Function>(function), contents)});
+
+    FilterEngine engine;
+    engine.compile(filters);
+
+    const Akonadi::Item item = createItem();
+    FilterEngine::MessageState state(item);
+    QCOMPARE(engine.matches(state, filters.first()), filters.first()->pattern()->matches(item));
+    qDeleteAll(filters);
+}
+
+void FilterEngineTest::shouldEvaluateThreadSafeFilters()
+{
+    QList<MailFilter *> filters;
+    filters << createFilter(SearchPattern::OpAnd, {SearchRule::createInstance("Subject", SearchRule::FuncContains, QStringLiteral("filter"))});
+    filters << createFilter(SearchPattern::OpAnd, {SearchRule::createInstance("<body>", SearchRule::FuncContains, QStringLiteral("nothere"))});
+    filters << createFilter(SearchPattern::OpAnd, {SearchRule::createInstance("From", SearchRule::FuncIsInAddressbook, QString())});
+
+    FilterEngine engine;
+    engine.compile(filters);
+    QVERIFY(engine.isThreadSafe(filters.at(0)));
+    QVERIFY(engine.isThreadSafe(filters.at(1)));
+    QVERIFY(!engine.isThreadSafe(filters.at(2)));
+
+    const Akonadi::Item item = createItem();
+    FilterEngine::MessageState state(item);
+    engine.evaluate(state, filters);
+    QCOMPARE(engine.matches(state, filters.at(0)), true);
+    QCOMPARE(engine.matches(state, filters.at(1)), false);
+    qDeleteAll(filters);
+}
+
+QTEST_MAIN(FilterEngineTest)
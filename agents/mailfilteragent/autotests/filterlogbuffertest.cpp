@@ -0,0 +1,189 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+#include "filterlogbuffertest.h"
+#include "../filterlogbuffer.h"
+#include <MailCommon/FilterLog>
+#include <MailCommon/MailFilter>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace MailCommon;
+
+FilterLogBufferTest::FilterLogBufferTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void FilterLogBufferTest::shouldHaveDefaultValue()
+{
+    FilterLogBuffer buffer;
+    QVERIFY(!buffer.isEnabled());
+    QCOMPARE(buffer.count(), 0);
+    QCOMPARE(buffer.firstSequence(), qint64(0));
+    QCOMPARE(buffer.capacity(), 10000);
+    QVERIFY(!buffer.recordMismatches());
+    QVERIFY(!buffer.showPatternDescription());
+    QVERIFY(!buffer.logRuleResults());
+    QVERIFY(!buffer.logAppliedActions());
+    QVERIFY(buffer.streamFileName().isEmpty());
+}
+
+void FilterLogBufferTest::shouldNotRecordWhenDisabled()
+{
+    FilterLogBuffer buffer;
+    buffer.addMessage(1, QStringLiteral("subject"), QStringLiteral("from"));
+    buffer.addDetail(QStringLiteral("detail"));
+    QCOMPARE(buffer.count(), 0);
+}
+
+void FilterLogBufferTest::shouldDropOldestRecords()
+{
+    FilterLogBuffer buffer;
+    buffer.setEnabled(true);
+    buffer.setCapacity(3);
+    QSignalSpy spy(&buffer, &FilterLogBuffer::changed);
+    for (int i = 0; i < 5; ++i) {
+        buffer.addMessage(i, QString::number(i), QString());
+    }
+    QCOMPARE(buffer.count(), 3);
+    QCOMPARE(buffer.firstSequence(), qint64(2));
+    QCOMPARE(buffer.record(0).itemId, qint64(2));
+    QCOMPARE(buffer.record(2).itemId, qint64(4));
+
+    // signaled once for all records added in this event loop iteration
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.count(), 1);
+
+    buffer.clear();
+    QCOMPARE(buffer.count(), 0);
+    QCOMPARE(buffer.firstSequence(), qint64(5));
+    buffer.addMessage(5, QString(), QString());
+    QCOMPARE(buffer.record(0).itemId, qint64(5));
+}
+
+void FilterLogBufferTest::shouldKeepNewestRecordsWhenShrinking()
+{
+    FilterLogBuffer buffer;
+    buffer.setEnabled(true);
+    buffer.setCapacity(4);
+    for (int i = 0; i < 6; ++i) {
+        buffer.addMessage(i, QString(), QString());
+    }
+    buffer.setCapacity(2);
+    QCOMPARE(buffer.count(), 2);
+    QCOMPARE(buffer.firstSequence(), qint64(4));
+    QCOMPARE(buffer.record(0).itemId, qint64(4));
+    QCOMPARE(buffer.record(1).itemId, qint64(5));
+
+    buffer.setCapacity(10);
+    buffer.addMessage(6, QString(), QString());
+    QCOMPARE(buffer.count(), 3);
+    QCOMPARE(buffer.record(2).itemId, qint64(6));
+}
+
+void FilterLogBufferTest::shouldSkipMismatches()
+{
+    MailFilter filter;
+    FilterLogBuffer buffer;
+    buffer.setEnabled(true);
+    buffer.setFilters({&filter});
+    buffer.addEvaluation(1, &filter, false);
+    QCOMPARE(buffer.count(), 0);
+    buffer.addEvaluation(1, &filter, true);
+    QCOMPARE(buffer.count(), 1);
+    QCOMPARE(buffer.record(0).filterId, filter.identifier());
+    QVERIFY(buffer.record(0).matched);
+
+    buffer.setRecordMismatches(true);
+    buffer.addEvaluation(1, &filter, false);
+    QCOMPARE(buffer.count(), 2);
+    QVERIFY(!buffer.formatRecord(buffer.record(1)).isEmpty());
+}
+
+void FilterLogBufferTest::shouldSaveToFile()
+{
+    QTemporaryDir dir;
+    const QString fileName = dir.path() + QStringLiteral("/filter.log");
+    FilterLogBuffer buffer;
+    buffer.setEnabled(true);
+    buffer.addMessage(42, QStringLiteral("subject"), QStringLiteral("from"));
+    buffer.addDetail(QStringLiteral("<b>detail</b>"));
+    QVERIFY(buffer.saveToFile(fileName));
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Text));
+    const QStringList lines = QString::fromUtf8(file.readAll()).split(QLatin1Char('\n'), QString::SkipEmptyParts);
+    QCOMPARE(lines.count(), 2);
+    QCOMPARE(lines.at(0).section(QLatin1Char('\t'), 1, 1), QStringLiteral("42"));
+    QVERIFY(lines.at(1).endsWith(QStringLiteral("\tdetail")));
+}
+
+void FilterLogBufferTest::shouldRecordWhileStreaming()
+{
+    QTemporaryDir dir;
+    const QString fileName = dir.path() + QStringLiteral("/filter.log");
+    FilterLogBuffer buffer;
+    QVERIFY(buffer.startStreaming(fileName));
+    QVERIFY(buffer.isEnabled());
+    QCOMPARE(buffer.streamFileName(), fileName);
+    buffer.addMessage(42, QStringLiteral("subject"), QStringLiteral("from"));
+    QCOMPARE(buffer.count(), 1);
+    buffer.stopStreaming();
+    QVERIFY(!buffer.isEnabled());
+    QVERIFY(buffer.streamFileName().isEmpty());
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Text));
+    const QStringList lines = QString::fromUtf8(file.readAll()).split(QLatin1Char('\n'), QString::SkipEmptyParts);
+    QCOMPARE(lines.count(), 1);
+
+    // an enabled buffer stays enabled
+    buffer.setEnabled(true);
+    QVERIFY(buffer.startStreaming(fileName));
+    buffer.stopStreaming();
+    QVERIFY(buffer.isEnabled());
+
+    QVERIFY(!buffer.startStreaming(dir.path() + QStringLiteral("/missing/filter.log")));
+    QVERIFY(buffer.streamFileName().isEmpty());
+}
+
+void FilterLogBufferTest::shouldConfigureDetailLogging()
+{
+    FilterLog *log = FilterLog::instance();
+    FilterLogBuffer buffer;
+    buffer.setDetailLogging(true, false);
+    QVERIFY(buffer.logRuleResults());
+    QVERIFY(!buffer.logAppliedActions());
+    QVERIFY(log->isContentTypeEnabled(FilterLog::RuleResult));
+    QVERIFY(!log->isContentTypeEnabled(FilterLog::AppliedAction));
+    QVERIFY(!log->isLogging());
+
+    buffer.setEnabled(true);
+    QVERIFY(log->isLogging());
+    buffer.setDetailLogging(false, false);
+    QVERIFY(!log->isLogging());
+    buffer.setDetailLogging(false, true);
+    QVERIFY(log->isContentTypeEnabled(FilterLog::AppliedAction));
+    QVERIFY(log->isLogging());
+    buffer.setEnabled(false);
+    QVERIFY(!log->isLogging());
+}
+
+QTEST_MAIN(FilterLogBufferTest)
@@ -0,0 +1,86 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+#include "filterstatisticstest.h"
+#include "../filterstatistics.h"
+#include <MailCommon/MailFilter>
+#include <QTest>
+
+using namespace MailCommon;
+
+FilterStatisticsTest::FilterStatisticsTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void FilterStatisticsTest::shouldHaveDefaultValue()
+{
+    FilterStatistics statistics;
+    QVERIFY(statistics.entries().isEmpty());
+    QCOMPARE(statistics.toString(), QStringLiteral("No filter defined!"));
+}
+
+void FilterStatisticsTest::shouldCountEvaluationsAndActions()
+{
+    MailFilter first;
+    MailFilter second;
+    FilterStatistics statistics;
+    statistics.setFilters({&first, &second});
+
+    statistics.addEvaluation(&first, true, 100);
+    statistics.addEvaluation(&first, false, 50);
+    statistics.addActions(&first, 1000);
+    statistics.addEvaluation(&second, false, 10);
+
+    MailFilter unknown;
+    statistics.addEvaluation(&unknown, true, 10);
+
+    const QVector<FilterStatistics::Entry> entries = statistics.entries();
+    QCOMPARE(entries.count(), 2);
+    QCOMPARE(entries.at(0).identifier, first.identifier());
+    QCOMPARE(entries.at(0).evaluations, qint64(2));
+    QCOMPARE(entries.at(0).matches, qint64(1));
+    QCOMPARE(entries.at(0).matchTime, qint64(150));
+    QCOMPARE(entries.at(0).actionTime, qint64(1000));
+    QCOMPARE(entries.at(1).evaluations, qint64(1));
+    QCOMPARE(entries.at(1).matches, qint64(0));
+
+    statistics.reset();
+    QCOMPARE(statistics.entries().at(0).evaluations, qint64(0));
+    QCOMPARE(statistics.entries().at(0).matchTime, qint64(0));
+}
+
+void FilterStatisticsTest::shouldKeepCountersOnReload()
+{
+    MailFilter *filter = new MailFilter;
+    FilterStatistics statistics;
+    statistics.setFilters({filter});
+    statistics.addEvaluation(filter, true, 10);
+
+    // a reloaded filter is a new object with the same identifier
+    MailFilter *reloaded = new MailFilter(*filter);
+    delete filter;
+    statistics.setFilters({reloaded});
+    QCOMPARE(statistics.entries().count(), 1);
+    QCOMPARE(statistics.entries().at(0).evaluations, qint64(1));
+    statistics.addEvaluation(reloaded, false, 10);
+    QCOMPARE(statistics.entries().at(0).evaluations, qint64(2));
+    delete reloaded;
+}
+
+QTEST_MAIN(FilterStatisticsTest)
@@ -0,0 +1,71 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+#include "inboundfilterstatisticstest.h"
+#include "../inboundfilterstatistics.h"
+#include <QTest>
+
+InboundFilterStatisticsTest::InboundFilterStatisticsTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void InboundFilterStatisticsTest::shouldHaveDefaultValue()
+{
+    InboundFilterStatistics statistics;
+    QCOMPARE(statistics.batchCount(), 0);
+    QCOMPARE(statistics.lastBatchSize(), 0);
+    QCOMPARE(statistics.maximumBatchSize(), 0);
+    QCOMPARE(statistics.filteredItemCount(), qint64(0));
+    QCOMPARE(statistics.bodyFetchCount(), qint64(0));
+    QCOMPARE(statistics.averageBatchSize(), 0.0);
+    QCOMPARE(statistics.latencyPercentile(50), qint64(-1));
+}
+
+void InboundFilterStatisticsTest::shouldRecordBatches()
+{
+    InboundFilterStatistics statistics;
+    statistics.addBatch(10);
+    statistics.addBatch(30);
+    statistics.addBatch(20);
+    statistics.addBodyFetches(2);
+    QCOMPARE(statistics.batchCount(), 3);
+    QCOMPARE(statistics.bodyFetchCount(), qint64(2));
+    QCOMPARE(statistics.lastBatchSize(), 20);
+    QCOMPARE(statistics.maximumBatchSize(), 30);
+    QCOMPARE(statistics.filteredItemCount(), qint64(60));
+    QCOMPARE(statistics.averageBatchSize(), 20.0);
+
+    statistics.clear();
+    QCOMPARE(statistics.batchCount(), 0);
+    QCOMPARE(statistics.filteredItemCount(), qint64(0));
+}
+
+void InboundFilterStatisticsTest::shouldComputeLatencyPercentiles()
+{
+    InboundFilterStatistics statistics;
+    for (int i = 100; i > 0; --i) {
+        statistics.addLatency(i);
+    }
+    QCOMPARE(statistics.latencyPercentile(50), qint64(50));
+    QCOMPARE(statistics.latencyPercentile(90), qint64(90));
+    QCOMPARE(statistics.latencyPercentile(99), qint64(99));
+    QCOMPARE(statistics.latencyPercentile(100), qint64(100));
+}
+
+QTEST_MAIN(InboundFilterStatisticsTest)
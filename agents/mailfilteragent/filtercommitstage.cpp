@@ -0,0 +1,302 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "filtercommitstage.h"
+
+#include <AkonadiCore/itemdeletejob.h>
+#include <AkonadiCore/itemmodifyjob.h>
+#include <AkonadiCore/itemmovejob.h>
+#include <AkonadiCore/tag.h>
+
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QTimer>
+
+using namespace MailCommon;
+
+namespace {
+// What filtering changed in the flags and tags of an item
+struct ChangeSet {
+    QSet<QByteArray> addedFlags;
+    QSet<QByteArray> removedFlags;
+    QSet<Akonadi::Tag::Id> addedTags;
+    QSet<Akonadi::Tag::Id> removedTags;
+
+    bool isEmpty() const
+    {
+        return addedFlags.isEmpty() && removedFlags.isEmpty() && addedTags.isEmpty() && removedTags.isEmpty();
+    }
+
+    bool operator==(const ChangeSet &other) const
+    {
+        return addedFlags == other.addedFlags && removedFlags == other.removedFlags
+               && addedTags == other.addedTags && removedTags == other.removedTags;
+    }
+};
+
+uint qHash(const ChangeSet &changes, uint seed = 0)
+{
+    return qHash(changes.addedFlags, seed) ^ qHash(changes.removedFlags, seed + 1)
+           ^ qHash(changes.addedTags, seed + 2) ^ qHash(changes.removedTags, seed + 3);
+}
+
+QSet<Akonadi::Tag::Id> tagIds(const Akonadi::Tag::List &tags, bool *valid)
+{
+    QSet<Akonadi::Tag::Id> ids;
+    for (const Akonadi::Tag &tag : tags) {
+        if (tag.id() < 0) {
+            *valid = false;
+        }
+        ids.insert(tag.id());
+    }
+    return ids;
+}
+
+void appendChunked(QVector<FilterCommitStage::Operation> &operations, FilterCommitStage::Operation::Type type, const Akonadi::Item::List &items, int maximumItemsPerJob,
+                   const Akonadi::Collection &target = Akonadi::Collection())
+{
+    const int chunkSize = qMax(1, maximumItemsPerJob);
+    for (int i = 0; i < items.count(); i += chunkSize) {
+        FilterCommitStage::Operation operation;
+        operation.type = type;
+        operation.items = items.mid(i, chunkSize);
+        operation.target = target;
+        operations.append(operation);
+    }
+}
+
+// The storage collection is only known for fetched items
+Akonadi::Collection::Id storageCollectionId(const Akonadi::Item &item)
+{
+    if (item.storageCollectionId() > 0) {
+        return item.storageCollectionId();
+    }
+    return item.parentCollection().id();
+}
+}
+
+FilterCommitStage::FilterCommitStage(QObject *parent)
+    : QObject(parent)
+{
+}
+
+FilterCommitStage::~FilterCommitStage()
+{
+}
+
+QVector<FilterCommitStage::Operation> FilterCommitStage::plan(const QList<ItemContext> &contexts, const Akonadi::Item::List &originals, int maximumItemsPerJob)
+{
+    Akonadi::Item::List deleteItems;
+    QMap<Akonadi::Collection::Id, Akonadi::Item::List> moveItems;
+    QMap<Akonadi::Collection::Id, Akonadi::Collection> moveTargets;
+    // Items with the same changes can share one bulk modify job
+    QHash<ChangeSet, Akonadi::Item::List> flagItems;
+    QVector<Operation> payloadOperations;
+
+    for (int i = 0, total = contexts.count(); i < total; ++i) {
+        ItemContext context = contexts.at(i);
+        if (context.deleteItem()) {
+            deleteItems << context.item();
+            continue;
+        }
+
+        if (context.moveTargetCollection().isValid() && storageCollectionId(context.item()) != context.moveTargetCollection().id()) {
+            moveItems[context.moveTargetCollection().id()] << context.item();
+            moveTargets.insert(context.moveTargetCollection().id(), context.moveTargetCollection());
+        }
+
+        if (context.needsPayloadStore() || context.needsFlagStore()) {
+            Akonadi::Item item = context.item();
+            //the item might be in a new collection with a different remote id, so don't try to force on it
+            //the previous remote id. Example: move to another collection on another resource => new remoteId, but our context.item()
+            //remoteid still holds the old one. Without clearing it, we try to enforce that on the new location, which is
+            //anything but good (and the server replies with "NO Only resources can modify remote identifiers"
+            item.setRemoteId(QString());
+            bool tagsKnown = true;
+            if (!context.needsPayloadStore()) {
+                // A bulk modify job applies the changes of its first item to
+                // all, so only what filtering changed is sent, keeping what
+                // others changed in the meantime
+                const Akonadi::Item &original = originals.at(i);
+                ChangeSet changes;
+                const QSet<QByteArray> flags = item.flags();
+                const QSet<QByteArray> originalFlags = original.flags();
+                changes.addedFlags = flags - originalFlags;
+                changes.removedFlags = originalFlags - flags;
+                const QSet<Akonadi::Tag::Id> tags = tagIds(item.tags(), &tagsKnown);
+                const QSet<Akonadi::Tag::Id> originalTags = tagIds(original.tags(), &tagsKnown);
+                changes.addedTags = tags - originalTags;
+                changes.removedTags = originalTags - tags;
+                if (tagsKnown) {
+                    if (changes.isEmpty()) {
+                        continue;
+                    }
+                    Akonadi::Item change(item.id());
+                    for (const QByteArray &flag : qAsConst(changes.addedFlags)) {
+                        change.setFlag(flag);
+                    }
+                    for (const QByteArray &flag : qAsConst(changes.removedFlags)) {
+                        change.clearFlag(flag);
+                    }
+                    for (Akonadi::Tag::Id id : qAsConst(changes.addedTags)) {
+                        change.setTag(Akonadi::Tag(id));
+                    }
+                    for (Akonadi::Tag::Id id : qAsConst(changes.removedTags)) {
+                        change.clearTag(Akonadi::Tag(id));
+                    }
+                    flagItems[changes] << change;
+                    continue;
+                }
+            }
+            // payload changes and tags not stored yet can't be done in bulk
+            Operation operation;
+            operation.type = context.needsPayloadStore() ? Operation::ModifyPayload : Operation::ModifyFlags;
+            operation.items << item;
+            //The below is a safety check to ignore modifying payloads if it was not requested,
+            //as in that case we might change the payload to an invalid one
+            operation.ignorePayload = !context.needsPayloadStore() || !context.needsFullPayload();
+            payloadOperations.append(operation);
+        }
+    }
+
+    // Keep the order of the single item code path: delete, move, then modify
+    QVector<Operation> operations;
+    appendChunked(operations, Operation::Delete, deleteItems, maximumItemsPerJob);
+    for (auto it = moveItems.constBegin(), end = moveItems.constEnd(); it != end; ++it) {
+        appendChunked(operations, Operation::Move, it.value(), maximumItemsPerJob, moveTargets.value(it.key()));
+    }
+    operations += payloadOperations;
+    for (auto it = flagItems.constBegin(), end = flagItems.constEnd(); it != end; ++it) {
+        appendChunked(operations, Operation::ModifyFlags, it.value(), maximumItemsPerJob);
+    }
+    return operations;
+}
+
+void FilterCommitStage::add(const ItemContext &context, const Akonadi::Item &original)
+{
+    mPendingContexts.append(context);
+    mPendingOriginals.append(original);
+    // Don't let a huge batch pile up in memory
+    if (mPendingContexts.count() >= 4 * mMaximumItemsPerJob) {
+        flush();
+    }
+}
+
+void FilterCommitStage::flush()
+{
+    mFlushScheduled = false;
+    if (mPendingContexts.isEmpty()) {
+        return;
+    }
+    mCommittedItemCount += mPendingContexts.count();
+    const QVector<Operation> operations = plan(mPendingContexts, mPendingOriginals, mMaximumItemsPerJob);
+    mPendingContexts.clear();
+    mPendingOriginals.clear();
+    for (const Operation &operation : operations) {
+        mOperations.enqueue(operation);
+    }
+    startJobs();
+}
+
+void FilterCommitStage::scheduleFlush()
+{
+    if (!mFlushScheduled) {
+        mFlushScheduled = true;
+        QTimer::singleShot(0, this, &FilterCommitStage::flush);
+    }
+}
+
+void FilterCommitStage::startJobs()
+{
+    while (!mOperations.isEmpty() && mJobsInFlight < mMaximumJobsInFlight) {
+        const Operation operation = mOperations.dequeue();
+        KJob *job = nullptr;
+        switch (operation.type) {
+        case Operation::Delete:
+            job = new Akonadi::ItemDeleteJob(operation.items, this);
+            break;
+        case Operation::Move:
+            job = new Akonadi::ItemMoveJob(operation.items, operation.target, this);
+            break;
+        case Operation::ModifyPayload:
+        case Operation::ModifyFlags: {
+            Akonadi::ItemModifyJob *modifyJob = operation.items.count() == 1
+                                                ? new Akonadi::ItemModifyJob(operation.items.first(), this)
+                                                : new Akonadi::ItemModifyJob(operation.items, this);
+            modifyJob->disableRevisionCheck(); //no conflict handling for mails as no other process could change the mail body and we don't care about flag conflicts
+            modifyJob->setIgnorePayload(operation.ignorePayload);
+            job = modifyJob;
+            break;
+        }
+        }
+        ++mJobsInFlight;
+        ++mCreatedJobCount;
+        connect(job, &KJob::result, this, &FilterCommitStage::slotJobResult);
+    }
+}
+
+void FilterCommitStage::slotJobResult(KJob *job)
+{
+    --mJobsInFlight;
+    if (job->error()) {
+        Q_EMIT jobFailed(job);
+    }
+    startJobs();
+}
+
+void FilterCommitStage::setMaximumJobsInFlight(int count)
+{
+    mMaximumJobsInFlight = qMax(1, count);
+}
+
+int FilterCommitStage::maximumJobsInFlight() const
+{
+    return mMaximumJobsInFlight;
+}
+
+void FilterCommitStage::setMaximumItemsPerJob(int count)
+{
+    mMaximumItemsPerJob = qMax(1, count);
+}
+
+int FilterCommitStage::maximumItemsPerJob() const
+{
+    return mMaximumItemsPerJob;
+}
+
+int FilterCommitStage::jobsInFlight() const
+{
+    return mJobsInFlight;
+}
+
+int FilterCommitStage::queuedOperationCount() const
+{
+    return mOperations.count();
+}
+
+qint64 FilterCommitStage::committedItemCount() const
+{
+    return mCommittedItemCount;
+}
+
+qint64 FilterCommitStage::createdJobCount() const
+{
+    return mCreatedJobCount;
+}
@@ -0,0 +1,119 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef FILTERCOMMITSTAGE_H
+#define FILTERCOMMITSTAGE_H
+
+#include <QObject>
+#include <QQueue>
+#include <QVector>
+
+#include <AkonadiCore/collection.h>
+#include <AkonadiCore/item.h>
+#include <MailCommon/ItemContext>
+
+class KJob;
+
+/**
+ * @short Commits the results of filtering to the Akonadi server.
+ *
+ * The filtered item contexts are collected and turned into as few jobs as
+ * possible: one delete job for all deleted items, one move job per target
+ * collection, one modify job per distinct change of flags and tags. Payload
+ * changes still need one modify job per item. Large groups are split into
+ * chunks, and only a limited number of jobs is handed to the session at a
+ * time, the others are started when earlier ones finished.
+ */
+class FilterCommitStage : public QObject
+{
+    Q_OBJECT
+public:
+    struct Operation {
+        enum Type {
+            Delete,
+            Move,
+            ModifyPayload,
+            ModifyFlags
+        };
+        Type type = Delete;
+        Akonadi::Item::List items;
+        Akonadi::Collection target;
+        bool ignorePayload = true;
+    };
+
+    explicit FilterCommitStage(QObject *parent = nullptr);
+    ~FilterCommitStage() override;
+
+    /**
+     * Groups the changes of @p contexts into operations of at most
+     * @p maximumItemsPerJob items each. @p originals holds the items as they
+     * were before filtering, in the same order as @p contexts.
+     */
+    static QVector<Operation> plan(const QList<MailCommon::ItemContext> &contexts, const Akonadi::Item::List &originals, int maximumItemsPerJob);
+
+    /**
+     * Queues the changes of @p context made to @p original. They are
+     * committed with the next flush().
+     */
+    void add(const MailCommon::ItemContext &context, const Akonadi::Item &original);
+
+    /**
+     * Turns all queued changes into jobs.
+     */
+    void flush();
+
+    /**
+     * Calls flush() once control returns to the event loop.
+     */
+    void scheduleFlush();
+
+    void setMaximumJobsInFlight(int count);
+    int maximumJobsInFlight() const;
+
+    void setMaximumItemsPerJob(int count);
+    int maximumItemsPerJob() const;
+
+    int jobsInFlight() const;
+    int queuedOperationCount() const;
+
+    /**
+     * Number of items committed and jobs created since the stage was created.
+     */
+    qint64 committedItemCount() const;
+    qint64 createdJobCount() const;
+
+Q_SIGNALS:
+    void jobFailed(KJob *job);
+
+private:
+    void startJobs();
+    void slotJobResult(KJob *job);
+
+    QList<MailCommon::ItemContext> mPendingContexts;
+    Akonadi::Item::List mPendingOriginals;
+    QQueue<Operation> mOperations;
+    int mMaximumJobsInFlight = 4;
+    int mMaximumItemsPerJob = 500;
+    int mJobsInFlight = 0;
+    qint64 mCommittedItemCount = 0;
+    qint64 mCreatedJobCount = 0;
+    bool mFlushScheduled = false;
+};
+
+#endif // FILTERCOMMITSTAGE_H
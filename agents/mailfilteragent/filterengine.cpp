@@ -0,0 +1,383 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "filterengine.h"
+
+#include <MailCommon/MailFilter>
+
+#include <QElapsedTimer>
+
+using namespace MailCommon;
+
+FilterEngine::MessageState::MessageState(const Akonadi::Item &item)
+{
+    invalidate(item);
+}
+
+void FilterEngine::MessageState::invalidate(const Akonadi::Item &item)
+{
+    mItem = item;
+    mMessage = item.hasPayload<KMime::Message::Ptr>() ? item.payload<KMime::Message::Ptr>() : KMime::Message::Ptr();
+    mFieldValues.clear();
+    mFieldLoaded.clear();
+    mPredicateResults.clear();
+    mFilterResults.clear();
+    mFilterTimes.clear();
+}
+
+FilterEngine::FilterEngine()
+{
+}
+
+FilterEngine::~FilterEngine()
+{
+}
+
+void FilterEngine::clear()
+{
+    mFields.clear();
+    mPredicates.clear();
+    mFilters.clear();
+    mFilterIndex.clear();
+}
+
+bool FilterEngine::isCompilable(const SearchRule::Ptr &rule)
+{
+    if (!rule || rule->isEmpty()) {
+        return false;
+    }
+    // Pseudo headers like <message>, <body>, <recipients>, <status>, <size>
+    // or <date> need more than a single decoded header value.
+    const QByteArray field = rule->field();
+    if (field.isEmpty() || field.startsWith('<')) {
+        return false;
+    }
+    switch (rule->function()) {
+    case SearchRule::FuncContains:
+    case SearchRule::FuncContainsNot:
+    case SearchRule::FuncEquals:
+    case SearchRule::FuncNotEqual:
+    case SearchRule::FuncRegExp:
+    case SearchRule::FuncNotRegExp:
+        return true;
+    default:
+        break;
+    }
+    return false;
+}
+
+bool FilterEngine::isThreadSafe(const SearchRule::Ptr &rule)
+{
+    if (!rule) {
+        return true;
+    }
+    switch (rule->function()) {
+    case SearchRule::FuncIsInAddressbook:
+    case SearchRule::FuncIsNotInAddressbook:
+    case SearchRule::FuncIsInCategory:
+    case SearchRule::FuncIsNotInCategory:
+        // these run Akonadi searches
+        return false;
+    default:
+        break;
+    }
+    const QByteArray field = rule->field();
+    if (!field.startsWith('<')) {
+        return true;
+    }
+    static const QList<QByteArray> safeFields = {
+        QByteArrayLiteral("<message>"), QByteArrayLiteral("<body>"), QByteArrayLiteral("<any header>"),
+        QByteArrayLiteral("<recipients>"), QByteArrayLiteral("<status>"), QByteArrayLiteral("<size>"),
+        QByteArrayLiteral("<age in days>"), QByteArrayLiteral("<date>")
+    };
+    return safeFields.contains(field);
+}
+
+int FilterEngine::fieldIndex(const QByteArray &name)
+{
+    const QByteArray key = name.toLower();
+    for (int i = 0, total = mFields.count(); i < total; ++i) {
+        if (mFields.at(i).name.toLower() == key) {
+            return i;
+        }
+    }
+    Field field;
+    field.name = name;
+    mFields.append(field);
+    return mFields.count() - 1;
+}
+
+int FilterEngine::predicateIndex(const SearchRule::Ptr &rule)
+{
+    const int field = fieldIndex(rule->field());
+    const SearchRule::Function function = rule->function();
+    const QString contents = rule->contents();
+    for (int i = 0, total = mPredicates.count(); i < total; ++i) {
+        const Predicate &predicate = mPredicates.at(i);
+        if (predicate.field == field && predicate.function == function && predicate.contents == contents) {
+            return i;
+        }
+    }
+
+    Predicate predicate;
+    predicate.field = field;
+    predicate.function = function;
+    predicate.contents = contents;
+    predicate.rule = rule;
+    if (function == SearchRule::FuncRegExp || function == SearchRule::FuncNotRegExp) {
+        predicate.regExp = QRegExp(contents, Qt::CaseInsensitive);
+    }
+    mPredicates.append(predicate);
+    const int index = mPredicates.count() - 1;
+
+    if (function == SearchRule::FuncEquals) {
+        Field &f = mFields[field];
+        f.equalsIndex[contents.toLower()].append(index);
+        f.equalsPredicates.append(index);
+    }
+    return index;
+}
+
+void FilterEngine::compile(const QList<MailFilter *> &filters)
+{
+    clear();
+    mFilters.reserve(filters.count());
+    for (const MailFilter *filter : filters) {
+        const SearchPattern *pattern = filter->pattern();
+        CompiledFilter compiled;
+        compiled.pattern = pattern;
+        compiled.op = pattern->op();
+        compiled.rules.reserve(pattern->count());
+        for (const SearchRule::Ptr &rule : *pattern) {
+            CompiledRule compiledRule;
+            compiledRule.rule = rule;
+            if (isCompilable(rule)) {
+                compiledRule.predicate = predicateIndex(rule);
+            }
+            compiled.threadSafe = compiled.threadSafe && isThreadSafe(rule);
+            compiled.rules.append(compiledRule);
+        }
+        mFilterIndex.insert(filter, mFilters.count());
+        mFilters.append(compiled);
+    }
+}
+
+bool FilterEngine::contains(const MailFilter *filter) const
+{
+    return mFilterIndex.contains(filter);
+}
+
+bool FilterEngine::isThreadSafe(const MailFilter *filter) const
+{
+    const auto it = mFilterIndex.constFind(filter);
+    return it != mFilterIndex.constEnd() && mFilters.at(it.value()).threadSafe;
+}
+
+void FilterEngine::evaluate(MessageState &state, const QList<MailFilter *> &filters) const
+{
+    if (!state.mMessage) {
+        return;
+    }
+    prepare(state);
+    if (state.mFilterTimes.count() != mFilters.count()) {
+        state.mFilterTimes.fill(-1, mFilters.count());
+    }
+    QElapsedTimer timer;
+    for (const MailFilter *filter : filters) {
+        const auto it = mFilterIndex.constFind(filter);
+        if (it == mFilterIndex.constEnd()) {
+            continue;
+        }
+        const CompiledFilter &compiled = mFilters.at(it.value());
+        if (compiled.threadSafe && state.mFilterResults.at(it.value()) == Unknown) {
+            timer.start();
+            state.mFilterResults[it.value()] = evaluateFilter(state, compiled) ? True : False;
+            state.mFilterTimes[it.value()] = timer.nsecsElapsed();
+        }
+    }
+}
+
+qint64 FilterEngine::evaluationTime(const MessageState &state, const MailFilter *filter) const
+{
+    const auto it = mFilterIndex.constFind(filter);
+    if (it == mFilterIndex.constEnd() || it.value() >= state.mFilterTimes.count()) {
+        return -1;
+    }
+    return state.mFilterTimes.at(it.value());
+}
+
+int FilterEngine::fieldCount() const
+{
+    return mFields.count();
+}
+
+int FilterEngine::predicateCount() const
+{
+    return mPredicates.count();
+}
+
+void FilterEngine::prepare(MessageState &state) const
+{
+    if (state.mFieldLoaded.count() != mFields.count()) {
+        state.mFieldValues.fill(QString(), mFields.count());
+        state.mFieldLoaded.fill(0, mFields.count());
+    }
+    if (state.mPredicateResults.count() != mPredicates.count()) {
+        state.mPredicateResults.fill(Unknown, mPredicates.count());
+    }
+    if (state.mFilterResults.count() != mFilters.count()) {
+        state.mFilterResults.fill(Unknown, mFilters.count());
+    }
+}
+
+const QString &FilterEngine::fieldValue(MessageState &state, int field) const
+{
+    if (!state.mFieldLoaded.at(field)) {
+        state.mFieldLoaded[field] = 1;
+        QString value;
+        if (auto header = state.mMessage->headerByType(mFields.at(field).name.constData())) {
+            value = header->asUnicodeString();
+        }
+        state.mFieldValues[field] = value;
+
+        // Resolve all "equals" rules on this field with one lookup.
+        const Field &f = mFields.at(field);
+        if (!value.isEmpty() && !f.equalsPredicates.isEmpty()) {
+            for (int predicate : f.equalsPredicates) {
+                state.mPredicateResults[predicate] = False;
+            }
+            const auto it = f.equalsIndex.constFind(value.toLower());
+            if (it != f.equalsIndex.constEnd()) {
+                for (int predicate : it.value()) {
+                    state.mPredicateResults[predicate] = True;
+                }
+            }
+        }
+    }
+    return state.mFieldValues.at(field);
+}
+
+bool FilterEngine::predicateMatches(MessageState &state, int predicate) const
+{
+    const char cached = state.mPredicateResults.at(predicate);
+    if (cached != Unknown) {
+        return cached == True;
+    }
+
+    const Predicate &p = mPredicates.at(predicate);
+    const QString &value = fieldValue(state, p.field);
+    // fieldValue() may have resolved the predicate through the equals index
+    if (state.mPredicateResults.at(predicate) != Unknown) {
+        return state.mPredicateResults.at(predicate) == True;
+    }
+
+    bool result = false;
+    if (value.isEmpty()) {
+        // Leave the corner cases of missing headers to the rule itself.
+        result = p.rule->matches(state.mItem);
+    } else {
+        switch (p.function) {
+        case SearchRule::FuncContains:
+            result = value.contains(p.contents, Qt::CaseInsensitive);
+            break;
+        case SearchRule::FuncContainsNot:
+            result = !value.contains(p.contents, Qt::CaseInsensitive);
+            break;
+        case SearchRule::FuncEquals:
+            result = (QString::compare(value.toLower(), p.contents.toLower()) == 0);
+            break;
+        case SearchRule::FuncNotEqual:
+            result = (QString::compare(value.toLower(), p.contents.toLower()) != 0);
+            break;
+        case SearchRule::FuncRegExp: {
+            // QRegExp keeps its match state, so use a copy per evaluation
+            QRegExp regExp(p.regExp);
+            result = (regExp.indexIn(value) >= 0);
+            break;
+        }
+        case SearchRule::FuncNotRegExp: {
+            QRegExp regExp(p.regExp);
+            result = (regExp.indexIn(value) < 0);
+            break;
+        }
+        default:
+            result = p.rule->matches(state.mItem);
+            break;
+        }
+    }
+    state.mPredicateResults[predicate] = result ? True : False;
+    return result;
+}
+
+bool FilterEngine::ruleMatches(MessageState &state, const CompiledRule &rule) const
+{
+    if (rule.predicate < 0) {
+        return rule.rule->matches(state.mItem);
+    }
+    return predicateMatches(state, rule.predicate);
+}
+
+bool FilterEngine::matches(MessageState &state, const MailFilter *filter) const
+{
+    const auto it = mFilterIndex.constFind(filter);
+    if (it == mFilterIndex.constEnd()) {
+        return filter->pattern()->matches(state.mItem);
+    }
+
+    const CompiledFilter &compiled = mFilters.at(it.value());
+    if (!state.mMessage) {
+        return compiled.rules.isEmpty();
+    }
+    prepare(state);
+    const char cached = state.mFilterResults.at(it.value());
+    if (cached != Unknown) {
+        return cached == True;
+    }
+    return evaluateFilter(state, compiled);
+}
+
+bool FilterEngine::evaluateFilter(MessageState &state, const CompiledFilter &compiled) const
+{
+    // Same semantics as SearchPattern::matches()
+    if (compiled.rules.isEmpty()) {
+        return true;
+    }
+
+    switch (compiled.op) {
+    case SearchPattern::OpAnd:
+        for (const CompiledRule &rule : compiled.rules) {
+            if (!ruleMatches(state, rule)) {
+                return false;
+            }
+        }
+        return true;
+    case SearchPattern::OpOr:
+        for (const CompiledRule &rule : compiled.rules) {
+            if (ruleMatches(state, rule)) {
+                return true;
+            }
+        }
+        return false;
+    case SearchPattern::OpAll:
+        return true;
+    default:
+        break;
+    }
+    return false;
+}
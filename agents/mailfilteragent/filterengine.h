@@ -0,0 +1,191 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef FILTERENGINE_H
+#define FILTERENGINE_H
+
+#include <AkonadiCore/item.h>
+#include <KMime/Message>
+
+#include "MailCommon/SearchPattern"
+
+#include <QHash>
+#include <QRegExp>
+#include <QVector>
+
+namespace MailCommon {
+class MailFilter;
+}
+
+/**
+ * @short A compiled representation of a list of mail filters.
+ *
+ * The filter patterns are compiled once when the filter list is loaded.
+ * Rules that compare a plain header field against a string are turned into
+ * shared predicates: every distinct header field is read and decoded at most
+ * once per message, every distinct predicate is evaluated at most once per
+ * message, and all "equals" rules on the same field are resolved by a single
+ * hash lookup. Rules that can't be compiled (status, size, date, body, ...)
+ * are evaluated through MailCommon::SearchRule::matches() as before.
+ *
+ * The result of matches() is always identical to
+ * MailCommon::SearchPattern::matches().
+ *
+ * The engine is immutable once compiled, so evaluate() can be used from
+ * several threads at the same time as long as each uses its own MessageState.
+ */
+class FilterEngine
+{
+public:
+    /**
+     * Per-message evaluation state. Create one for each message to filter
+     * and pass it to all matches() calls for that message.
+     */
+    class MessageState
+    {
+    public:
+        MessageState() = default;
+        explicit MessageState(const Akonadi::Item &item);
+
+        /**
+         * Drops all cached header values and predicate results, e.g. after
+         * filter actions have modified the message.
+         */
+        void invalidate(const Akonadi::Item &item);
+
+    private:
+        friend class FilterEngine;
+        Akonadi::Item mItem;
+        KMime::Message::Ptr mMessage;
+        QVector<QString> mFieldValues;
+        QVector<char> mFieldLoaded;
+        QVector<char> mPredicateResults;
+        QVector<char> mFilterResults;
+        QVector<qint64> mFilterTimes;
+    };
+
+    FilterEngine();
+    ~FilterEngine();
+
+    /**
+     * Compiles the patterns of @p filters. The filters must stay alive as
+     * long as the engine references them.
+     */
+    void compile(const QList<MailCommon::MailFilter *> &filters);
+
+    /**
+     * Forgets all compiled filters.
+     */
+    void clear();
+
+    /**
+     * Returns whether @p filter is part of the compiled filter set.
+     */
+    bool contains(const MailCommon::MailFilter *filter) const;
+
+    /**
+     * Returns whether the pattern of @p filter matches the message of @p state.
+     * Falls back to the uncompiled pattern if @p filter is unknown.
+     */
+    bool matches(MessageState &state, const MailCommon::MailFilter *filter) const;
+
+    /**
+     * Returns whether the pattern of @p filter can be evaluated outside of
+     * the main thread, i.e. none of its rules needs an Akonadi job or the
+     * filter log.
+     */
+    bool isThreadSafe(const MailCommon::MailFilter *filter) const;
+
+    /**
+     * Evaluates all thread safe filters of @p filters for the message of
+     * @p state and keeps the results in @p state, where later matches()
+     * calls pick them up until the state is invalidated. Different states
+     * can be evaluated concurrently from worker threads.
+     */
+    void evaluate(MessageState &state, const QList<MailCommon::MailFilter *> &filters) const;
+
+    /**
+     * Returns the time in nanoseconds evaluate() needed to match @p filter
+     * for the message of @p state, or -1 if it wasn't evaluated ahead.
+     */
+    qint64 evaluationTime(const MessageState &state, const MailCommon::MailFilter *filter) const;
+
+    /**
+     * Returns the number of distinct header fields referenced by compiled rules.
+     */
+    int fieldCount() const;
+
+    /**
+     * Returns the number of distinct predicates shared by all compiled rules.
+     */
+    int predicateCount() const;
+
+private:
+    enum PredicateState {
+        Unknown = 0,
+        False,
+        True
+    };
+
+    struct Predicate {
+        int field = -1;
+        MailCommon::SearchRule::Function function = MailCommon::SearchRule::FuncNone;
+        QString contents;
+        QRegExp regExp;
+        // used when the header is missing or empty, to keep the exact semantics
+        MailCommon::SearchRule::Ptr rule;
+    };
+
+    struct CompiledRule {
+        // index into mPredicates, or -1 if the rule is evaluated through rule
+        int predicate = -1;
+        MailCommon::SearchRule::Ptr rule;
+    };
+
+    struct CompiledFilter {
+        const MailCommon::SearchPattern *pattern = nullptr;
+        MailCommon::SearchPattern::Operator op = MailCommon::SearchPattern::OpAnd;
+        QVector<CompiledRule> rules;
+        bool threadSafe = true;
+    };
+
+    struct Field {
+        QByteArray name;
+        // lower-cased "equals" contents -> predicates comparing for equality
+        QHash<QString, QVector<int> > equalsIndex;
+        QVector<int> equalsPredicates;
+    };
+
+    static bool isCompilable(const MailCommon::SearchRule::Ptr &rule);
+    static bool isThreadSafe(const MailCommon::SearchRule::Ptr &rule);
+    bool evaluateFilter(MessageState &state, const CompiledFilter &compiled) const;
+    int fieldIndex(const QByteArray &name);
+    int predicateIndex(const MailCommon::SearchRule::Ptr &rule);
+    void prepare(MessageState &state) const;
+    bool ruleMatches(MessageState &state, const CompiledRule &rule) const;
+    bool predicateMatches(MessageState &state, int predicate) const;
+    const QString &fieldValue(MessageState &state, int field) const;
+
+    QVector<Field> mFields;
+    QVector<Predicate> mPredicates;
+    QVector<CompiledFilter> mFilters;
+    QHash<const MailCommon::MailFilter *, int> mFilterIndex;
+};
+
+#endif // FILTERENGINE_H
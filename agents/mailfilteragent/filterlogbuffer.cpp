@@ -0,0 +1,353 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "filterlogbuffer.h"
+
+#include <MailCommon/FilterLog>
+#include <MailCommon/MailFilter>
+#include <MailCommon/SearchPattern>
+
+#include <KLocalizedString>
+
+#include <QDateTime>
+#include <QFile>
+#include <QLocale>
+#include <QTextDocumentFragment>
+#include <QTextStream>
+#include <QTimer>
+
+namespace {
+// MailCommon keeps its own copy of the details it logs, the records live in the buffer
+const long detailLogSize = 16 * 1024;
+}
+
+FilterLogBuffer::FilterLogBuffer(QObject *parent)
+    : QObject(parent)
+{
+}
+
+FilterLogBuffer::~FilterLogBuffer()
+{
+    stopStreaming();
+}
+
+void FilterLogBuffer::setEnabled(bool enabled)
+{
+    mEnabled = enabled;
+    mEnabledForStreaming = false;
+    updateDetailLogging();
+}
+
+bool FilterLogBuffer::isEnabled() const
+{
+    return mEnabled;
+}
+
+void FilterLogBuffer::setCapacity(int capacity)
+{
+    capacity = qMax(1, capacity);
+    if (capacity == mCapacity) {
+        return;
+    }
+
+    // keep the newest records, in order, starting at index 0
+    const int kept = qMin(mCount, capacity);
+    QVector<Record> records;
+    records.reserve(kept);
+    for (int i = mCount - kept; i < mCount; ++i) {
+        records.append(record(i));
+    }
+    mFirstSequence += mCount - kept;
+    mRecords = records;
+    mStart = 0;
+    mCount = kept;
+    mCapacity = capacity;
+    scheduleChanged();
+}
+
+int FilterLogBuffer::capacity() const
+{
+    return mCapacity;
+}
+
+void FilterLogBuffer::setRecordMismatches(bool record)
+{
+    mRecordMismatches = record;
+}
+
+bool FilterLogBuffer::recordMismatches() const
+{
+    return mRecordMismatches;
+}
+
+void FilterLogBuffer::setShowPatternDescription(bool show)
+{
+    mShowPatternDescription = show;
+}
+
+bool FilterLogBuffer::showPatternDescription() const
+{
+    return mShowPatternDescription;
+}
+
+void FilterLogBuffer::setDetailLogging(bool ruleResults, bool appliedActions)
+{
+    mLogRuleResults = ruleResults;
+    mLogAppliedActions = appliedActions;
+    updateDetailLogging();
+}
+
+bool FilterLogBuffer::logRuleResults() const
+{
+    return mLogRuleResults;
+}
+
+bool FilterLogBuffer::logAppliedActions() const
+{
+    return mLogAppliedActions;
+}
+
+void FilterLogBuffer::updateDetailLogging()
+{
+    // MailCommon only logs the details of rules and actions, the rest is recorded here
+    MailCommon::FilterLog *log = MailCommon::FilterLog::instance();
+    log->setContentTypeEnabled(MailCommon::FilterLog::PatternDescription, false);
+    log->setContentTypeEnabled(MailCommon::FilterLog::PatternResult, false);
+    log->setContentTypeEnabled(MailCommon::FilterLog::RuleResult, mLogRuleResults);
+    log->setContentTypeEnabled(MailCommon::FilterLog::AppliedAction, mLogAppliedActions);
+    if (log->maxLogSize() != detailLogSize) {
+        log->setMaxLogSize(detailLogSize);
+    }
+    const bool logDetails = mEnabled && (mLogRuleResults || mLogAppliedActions);
+    if (log->isLogging() != logDetails) {
+        log->setLogging(logDetails);
+    }
+}
+
+void FilterLogBuffer::setFilters(const QList<MailCommon::MailFilter *> &filters)
+{
+    // Keep the names of removed filters, older records may still refer to them
+    for (const MailCommon::MailFilter *filter : filters) {
+        FilterInfo info;
+        info.name = filter->name();
+        info.description = filter->pattern()->asString();
+        mFilterInfos.insert(filter->identifier(), info);
+    }
+}
+
+void FilterLogBuffer::addMessage(qint64 itemId, const QString &subject, const QString &from)
+{
+    if (!mEnabled) {
+        return;
+    }
+    Record record;
+    record.type = MessageBegin;
+    record.itemId = itemId;
+    record.text = subject;
+    record.secondaryText = from;
+    append(record);
+}
+
+void FilterLogBuffer::addEvaluation(qint64 itemId, const MailCommon::MailFilter *filter, bool matched)
+{
+    if (!mEnabled || (!matched && !mRecordMismatches)) {
+        return;
+    }
+    Record record;
+    record.type = FilterEvaluated;
+    record.itemId = itemId;
+    record.filterId = filter->identifier();
+    record.matched = matched;
+    append(record);
+}
+
+void FilterLogBuffer::addActions(qint64 itemId, const MailCommon::MailFilter *filter)
+{
+    if (!mEnabled) {
+        return;
+    }
+    Record record;
+    record.type = ActionsApplied;
+    record.itemId = itemId;
+    record.filterId = filter->identifier();
+    append(record);
+}
+
+void FilterLogBuffer::addDetail(const QString &text)
+{
+    if (!mEnabled) {
+        return;
+    }
+    Record record;
+    record.type = Detail;
+    record.text = text;
+    append(record);
+}
+
+int FilterLogBuffer::count() const
+{
+    return mCount;
+}
+
+qint64 FilterLogBuffer::firstSequence() const
+{
+    return mFirstSequence;
+}
+
+const FilterLogBuffer::Record &FilterLogBuffer::record(int index) const
+{
+    return mRecords.at((mStart + index) % mRecords.count());
+}
+
+void FilterLogBuffer::clear()
+{
+    mFirstSequence += mCount;
+    mRecords.clear();
+    mStart = 0;
+    mCount = 0;
+    scheduleChanged();
+}
+
+void FilterLogBuffer::append(const Record &record)
+{
+    Record *slot = nullptr;
+    if (mCount < mCapacity) {
+        // records are only dropped from the front, so not full means not wrapped
+        mRecords.append(Record());
+        slot = &mRecords.last();
+        ++mCount;
+    } else {
+        // full: overwrite the oldest record
+        slot = &mRecords[mStart];
+        mStart = (mStart + 1) % mRecords.count();
+        ++mFirstSequence;
+    }
+    *slot = record;
+    slot->time = QDateTime::currentMSecsSinceEpoch();
+
+    if (mStream) {
+        *mStream << formatLine(*slot) << QLatin1Char('\n');
+    }
+    scheduleChanged();
+}
+
+void FilterLogBuffer::scheduleChanged()
+{
+    if (mChangedScheduled) {
+        return;
+    }
+    mChangedScheduled = true;
+    QTimer::singleShot(0, this, [this]() {
+        mChangedScheduled = false;
+        if (mStream) {
+            mStream->flush();
+        }
+        Q_EMIT changed();
+    });
+}
+
+QString FilterLogBuffer::formatRecord(const Record &record) const
+{
+    switch (record.type) {
+    case MessageBegin:
+        return i18n("Begin filtering on message \"%1\" from \"%2\"", record.text, record.secondaryText);
+    case FilterEvaluated: {
+        const FilterInfo info = mFilterInfos.value(record.filterId);
+        const QString name = info.name.isEmpty() ? record.filterId : info.name;
+        QString text = record.matched ? i18n("Filter \"%1\" has matched.", name)
+                                      : i18n("Filter \"%1\" has not matched.", name);
+        if (mShowPatternDescription && !info.description.isEmpty()) {
+            text += QLatin1Char(' ') + info.description.simplified();
+        }
+        return text;
+    }
+    case ActionsApplied: {
+        const FilterInfo info = mFilterInfos.value(record.filterId);
+        return i18n("Actions of filter \"%1\" applied.", info.name.isEmpty() ? record.filterId : info.name);
+    }
+    case Detail:
+        // MailCommon logs rich text
+        return QTextDocumentFragment::fromHtml(record.text).toPlainText();
+    }
+    return QString();
+}
+
+QString FilterLogBuffer::formatLine(const Record &record) const
+{
+    QString line = QDateTime::fromMSecsSinceEpoch(record.time).toString(Qt::ISODateWithMs);
+    line += QLatin1Char('\t');
+    if (record.itemId >= 0) {
+        line += QString::number(record.itemId);
+    }
+    line += QLatin1Char('\t') + record.filterId;
+    line += QLatin1Char('\t') + formatRecord(record).replace(QLatin1Char('\n'), QLatin1Char(' '));
+    return line;
+}
+
+bool FilterLogBuffer::saveToFile(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream stream(&file);
+    stream.setCodec("UTF-8");
+    for (int i = 0; i < mCount; ++i) {
+        stream << formatLine(record(i)) << QLatin1Char('\n');
+    }
+    stream.flush();
+    return file.error() == QFile::NoError;
+}
+
+bool FilterLogBuffer::startStreaming(const QString &fileName)
+{
+    stopStreaming();
+    mStreamFile = new QFile(fileName);
+    if (!mStreamFile->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        delete mStreamFile;
+        mStreamFile = nullptr;
+        return false;
+    }
+    mStream = new QTextStream(mStreamFile);
+    mStream->setCodec("UTF-8");
+    if (!mEnabled) {
+        setEnabled(true);
+        mEnabledForStreaming = true;
+    }
+    return true;
+}
+
+void FilterLogBuffer::stopStreaming()
+{
+    if (mStream) {
+        mStream->flush();
+        delete mStream;
+        mStream = nullptr;
+    }
+    delete mStreamFile;
+    mStreamFile = nullptr;
+    if (mEnabledForStreaming) {
+        setEnabled(false);
+    }
+}
+
+QString FilterLogBuffer::streamFileName() const
+{
+    return mStreamFile ? mStreamFile->fileName() : QString();
+}
@@ -0,0 +1,187 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef FILTERLOGBUFFER_H
+#define FILTERLOGBUFFER_H
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+class QFile;
+class QTextStream;
+namespace MailCommon {
+class MailFilter;
+}
+
+/**
+ * @short A bounded, structured log of the filter activities.
+ *
+ * Records are kept in a ring buffer of fixed capacity, the oldest records
+ * are overwritten once it is full. Recording a record only copies a few
+ * implicitly shared strings; the text shown to the user is formatted on
+ * demand by formatRecord(), i.e. only for the rows actually looked at.
+ *
+ * Every record has a sequence number which keeps growing, so views can
+ * find out which records were added and which were dropped since they
+ * last looked at the buffer.
+ *
+ * Optionally all records are streamed to a file as tab separated lines.
+ *
+ * The details of rule evaluations and applied actions are still logged by
+ * MailCommon's FilterLog, which the buffer configures and whose entries are
+ * recorded with addDetail().
+ */
+class FilterLogBuffer : public QObject
+{
+    Q_OBJECT
+public:
+    enum RecordType {
+        MessageBegin = 0,
+        FilterEvaluated,
+        ActionsApplied,
+        Detail
+    };
+
+    struct Record {
+        qint64 time = 0; // msecs since epoch
+        qint64 itemId = -1;
+        RecordType type = Detail;
+        bool matched = false;
+        QString filterId;
+        // subject for MessageBegin, the text logged by MailCommon for Detail
+        QString text;
+        // sender for MessageBegin
+        QString secondaryText;
+    };
+
+    explicit FilterLogBuffer(QObject *parent = nullptr);
+    ~FilterLogBuffer() override;
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    /**
+     * Sets the maximum number of records kept in memory. Shrinking the
+     * buffer drops the oldest records.
+     */
+    void setCapacity(int capacity);
+    int capacity() const;
+
+    /**
+     * Whether evaluations which didn't match are recorded as well.
+     */
+    void setRecordMismatches(bool record);
+    bool recordMismatches() const;
+
+    /**
+     * Whether formatRecord() adds the pattern description to evaluations.
+     */
+    void setShowPatternDescription(bool show);
+    bool showPatternDescription() const;
+
+    /**
+     * Whether MailCommon logs the result of every single rule and the
+     * actions applied, while the buffer is enabled.
+     */
+    void setDetailLogging(bool ruleResults, bool appliedActions);
+    bool logRuleResults() const;
+    bool logAppliedActions() const;
+
+    /**
+     * Remembers the names and pattern descriptions of @p filters, records
+     * only keep the filter identifier.
+     */
+    void setFilters(const QList<MailCommon::MailFilter *> &filters);
+
+    void addMessage(qint64 itemId, const QString &subject, const QString &from);
+    void addEvaluation(qint64 itemId, const MailCommon::MailFilter *filter, bool matched);
+    void addActions(qint64 itemId, const MailCommon::MailFilter *filter);
+    void addDetail(const QString &text);
+
+    /**
+     * Number of records currently kept.
+     */
+    int count() const;
+
+    /**
+     * Sequence number of the oldest record kept; the record at @p index
+     * has the sequence number firstSequence() + @p index.
+     */
+    qint64 firstSequence() const;
+
+    /**
+     * Returns the record at @p index, 0 being the oldest one.
+     */
+    const Record &record(int index) const;
+
+    void clear();
+
+    QString formatRecord(const Record &record) const;
+
+    /**
+     * Writes all records kept to @p fileName, one tab separated line each.
+     */
+    bool saveToFile(const QString &fileName) const;
+
+    /**
+     * Appends every new record to @p fileName until stopStreaming() is called.
+     * A disabled buffer is enabled while streaming.
+     */
+    bool startStreaming(const QString &fileName);
+    void stopStreaming();
+    QString streamFileName() const;
+
+Q_SIGNALS:
+    /**
+     * Emitted once per event loop iteration when records were added,
+     * dropped or cleared.
+     */
+    void changed();
+
+private:
+    struct FilterInfo {
+        QString name;
+        QString description;
+    };
+
+    void append(const Record &record);
+    void scheduleChanged();
+    void updateDetailLogging();
+    QString formatLine(const Record &record) const;
+
+    QVector<Record> mRecords;
+    QHash<QString, FilterInfo> mFilterInfos;
+    qint64 mFirstSequence = 0;
+    int mStart = 0;
+    int mCount = 0;
+    int mCapacity = 10000;
+    bool mEnabled = false;
+    bool mRecordMismatches = false;
+    bool mShowPatternDescription = false;
+    bool mLogRuleResults = false;
+    bool mLogAppliedActions = false;
+    bool mEnabledForStreaming = false;
+    bool mChangedScheduled = false;
+    QFile *mStreamFile = nullptr;
+    QTextStream *mStream = nullptr;
+};
+
+#endif // FILTERLOGBUFFER_H
@@ -28,26 +28,27 @@
 */
 
 #include "filterlogdialog.h"
+#include "filterlogbuffer.h"
+#include "filterlogmodel.h"
+#include "filterprofilewidget.h"
 #include <MailCommon/FilterLog>
-#include "kpimtextedit/plaintexteditorwidget.h"
-#include "kpimtextedit/plaintexteditor.h"
 
 #include "mailfilteragent_debug.h"
 #include <QFileDialog>
 #include <KLocalizedString>
 #include <kmessagebox.h>
-#include <KStandardAction>
 #include <QVBoxLayout>
 #include <QIcon>
 
 #include <QCheckBox>
+#include <QHeaderView>
 #include <QLabel>
+#include <QScrollBar>
 #include <QSpinBox>
-#include <QStringList>
 #include <QGroupBox>
-#include <QAction>
-#include <QMenu>
 #include <QPointer>
+#include <QTabWidget>
+#include <QTreeView>
 
 #include <errno.h>
 #include <KSharedConfig>
@@ -59,8 +60,13 @@
 
 using namespace MailCommon;
 
-FilterLogDialog::FilterLogDialog(QWidget *parent)
+namespace {
+const int defaultLogRecords = 10000;
+}
+
+FilterLogDialog::FilterLogDialog(FilterLogBuffer *filterLog, QWidget *parent)
     : QDialog(parent)
+    , mFilterLog(filterLog)
     , mIsInitialized(false)
 {
     setWindowTitle(i18n("Filter Log Viewer"));
@@ -76,28 +82,33 @@ FilterLogDialog::FilterLogDialog(QWidget *parent)
     buttonBox->button(QDialogButtonBox::Close)->setDefault(true);
     KGuiItem::assign(mUser1Button, KStandardGuiItem::clear());
     KGuiItem::assign(mUser2Button, KStandardGuiItem::saveAs());
+    mTabWidget = new QTabWidget(this);
+    mainLayout->addWidget(mTabWidget);
     QFrame *page = new QFrame(this);
 
     QVBoxLayout *pageVBoxLayout = new QVBoxLayout;
     page->setLayout(pageVBoxLayout);
-    pageVBoxLayout->setMargin(0);
-    mainLayout->addWidget(page);
-
-    mTextEdit = new KPIMTextEdit::PlainTextEditorWidget(new FilterLogTextEdit(this), page);
-    pageVBoxLayout->addWidget(mTextEdit);
-
-    mTextEdit->setReadOnly(true);
-    mTextEdit->editor()->setWordWrapMode(QTextOption::NoWrap);
-    const QStringList logEntries = FilterLog::instance()->logEntries();
-    QStringList::ConstIterator end(logEntries.constEnd());
-    for (QStringList::ConstIterator it = logEntries.constBegin();
-         it != end; ++it) {
-        mTextEdit->editor()->appendHtml(*it);
-    }
+    mTabWidget->addTab(page, i18n("Log"));
+
+    // The model formats only the rows the view shows
+    mLogModel = new FilterLogModel(mFilterLog, this);
+    mLogView = new QTreeView(page);
+    mLogView->setObjectName(QStringLiteral("logview"));
+    mLogView->setRootIsDecorated(false);
+    mLogView->setUniformRowHeights(true);
+    mLogView->setAlternatingRowColors(true);
+    mLogView->setModel(mLogModel);
+    mLogView->header()->setStretchLastSection(true);
+    mLogView->header()->setSectionResizeMode(FilterLogModel::TimeColumn, QHeaderView::ResizeToContents);
+    mLogView->header()->setSectionResizeMode(FilterLogModel::MessageColumn, QHeaderView::ResizeToContents);
+    pageVBoxLayout->addWidget(mLogView);
+    connect(mLogModel, &FilterLogModel::rowsAboutToBeInserted, this, &FilterLogDialog::slotRowsAboutToBeInserted);
+    connect(mLogModel, &FilterLogModel::rowsInserted, this, &FilterLogDialog::slotRowsInserted);
+    connect(mFilterLog, &FilterLogBuffer::changed, this, &FilterLogDialog::slotLogChanged);
 
     mLogActiveBox = new QCheckBox(i18n("&Log filter activities"), page);
     pageVBoxLayout->addWidget(mLogActiveBox);
-    mLogActiveBox->setChecked(FilterLog::instance()->isLogging());
+    mLogActiveBox->setChecked(mFilterLog->isEnabled());
     connect(mLogActiveBox, &QCheckBox::clicked, this, &FilterLogDialog::slotSwitchLogState);
     mLogActiveBox->setWhatsThis(
         i18n("You can turn logging of filter activities on and off here. "
@@ -113,8 +124,7 @@ FilterLogDialog::FilterLogDialog(QWidget *parent)
 
     mLogPatternDescBox = new QCheckBox(i18n("Log pattern description"));
     layout->addWidget(mLogPatternDescBox);
-    mLogPatternDescBox->setChecked(
-        FilterLog::instance()->isContentTypeEnabled(FilterLog::PatternDescription));
+    mLogPatternDescBox->setChecked(mFilterLog->showPatternDescription());
     connect(mLogPatternDescBox, &QCheckBox::clicked, this, &FilterLogDialog::slotChangeLogDetail);
     // TODO
     //QWhatsThis::add( mLogPatternDescBox,
@@ -122,8 +132,7 @@ FilterLogDialog::FilterLogDialog(QWidget *parent)
 
     mLogRuleEvaluationBox = new QCheckBox(i18n("Log filter &rule evaluation"));
     layout->addWidget(mLogRuleEvaluationBox);
-    mLogRuleEvaluationBox->setChecked(
-        FilterLog::instance()->isContentTypeEnabled(FilterLog::RuleResult));
+    mLogRuleEvaluationBox->setChecked(mFilterLog->logRuleResults());
     connect(mLogRuleEvaluationBox, &QCheckBox::clicked, this, &FilterLogDialog::slotChangeLogDetail);
     mLogRuleEvaluationBox->setWhatsThis(
         i18n("You can control the feedback in the log concerning the "
@@ -135,17 +144,15 @@ FilterLogDialog::FilterLogDialog(QWidget *parent)
 
     mLogPatternResultBox = new QCheckBox(i18n("Log filter pattern evaluation"));
     layout->addWidget(mLogPatternResultBox);
-    mLogPatternResultBox->setChecked(
-        FilterLog::instance()->isContentTypeEnabled(FilterLog::PatternResult));
+    mLogPatternResultBox->setChecked(mFilterLog->recordMismatches());
     connect(mLogPatternResultBox, &QCheckBox::clicked, this, &FilterLogDialog::slotChangeLogDetail);
-    // TODO
-    //QWhatsThis::add( mLogPatternResultBox,
-    //    i18n( "" ) );
+    mLogPatternResultBox->setWhatsThis(
+        i18n("Having this option checked logs the filters which did not "
+             "match as well; otherwise only matching filters are logged."));
 
     mLogFilterActionBox = new QCheckBox(i18n("Log filter actions"));
     layout->addWidget(mLogFilterActionBox);
-    mLogFilterActionBox->setChecked(
-        FilterLog::instance()->isContentTypeEnabled(FilterLog::AppliedAction));
+    mLogFilterActionBox->setChecked(mFilterLog->logAppliedActions());
     connect(mLogFilterActionBox, &QCheckBox::clicked, this, &FilterLogDialog::slotChangeLogDetail);
     // TODO
     //QWhatsThis::add( mLogFilterActionBox,
@@ -160,41 +167,61 @@ FilterLogDialog::FilterLogDialog(QWidget *parent)
     hboxHBoxLayout->addWidget(logSizeLab);
     mLogMemLimitSpin = new QSpinBox(hbox);
     hboxHBoxLayout->addWidget(mLogMemLimitSpin);
-    mLogMemLimitSpin->setMinimum(1);
-    mLogMemLimitSpin->setMaximum(1024 * 256);   // 256 MB
-    // value in the QSpinBox is in KB while it's in Byte in the FilterLog
-    mLogMemLimitSpin->setValue(FilterLog::instance()->maxLogSize() / 1024);
-    mLogMemLimitSpin->setSuffix(i18n(" KB"));
-    mLogMemLimitSpin->setSpecialValueText(
-        i18nc("@label:spinbox Set the size of the logfile to unlimited.", "unlimited"));
+    mLogMemLimitSpin->setMinimum(100);
+    mLogMemLimitSpin->setMaximum(1000000);
+    mLogMemLimitSpin->setSingleStep(1000);
+    mLogMemLimitSpin->setValue(mFilterLog->capacity());
+    mLogMemLimitSpin->setSuffix(i18n(" entries"));
     connect(mLogMemLimitSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, &FilterLogDialog::slotChangeLogMemLimit);
     mLogMemLimitSpin->setWhatsThis(
         i18n("Collecting log data uses memory to temporarily store the "
-             "log data; here you can limit the maximum amount of memory "
-             "to be used: if the size of the collected log data exceeds "
-             "this limit then the oldest data will be discarded until "
-             "the limit is no longer exceeded. "));
-
-    connect(FilterLog::instance(), &FilterLog::logEntryAdded, this, &FilterLogDialog::slotLogEntryAdded);
-    connect(FilterLog::instance(), &FilterLog::logShrinked, this, &FilterLogDialog::slotLogShrinked);
-    connect(FilterLog::instance(), &FilterLog::logStateChanged, this, &FilterLogDialog::slotLogStateChanged);
+             "log data; here you can limit the number of entries kept: "
+             "if the log exceeds this limit then the oldest entries "
+             "will be discarded. "));
+
+    mProfileWidget = new FilterProfileWidget(this);
+    mTabWidget->addTab(mProfileWidget, i18n("Profile"));
+    connect(mTabWidget, &QTabWidget::currentChanged, this, [this](int index) {
+        if (mTabWidget->widget(index) == mProfileWidget) {
+            mProfileWidget->refresh();
+        }
+    });
 
     mainLayout->addWidget(buttonBox);
 
     connect(mUser1Button, &QPushButton::clicked, this, &FilterLogDialog::slotUser1);
     connect(mUser2Button, &QPushButton::clicked, this, &FilterLogDialog::slotUser2);
-    connect(mTextEdit->editor(), &KPIMTextEdit::PlainTextEditor::textChanged, this, &FilterLogDialog::slotTextChanged);
 
-    slotTextChanged();
     readConfig();
+    slotLogChanged();
+    mLogView->scrollToBottom();
     mIsInitialized = true;
 }
 
-void FilterLogDialog::slotTextChanged()
+void FilterLogDialog::setFilterStatistics(FilterStatistics *statistics)
 {
-    const bool hasText = !mTextEdit->isEmpty();
-    mUser2Button->setEnabled(hasText);
-    mUser1Button->setEnabled(hasText);
+    mProfileWidget->setFilterStatistics(statistics);
+}
+
+void FilterLogDialog::slotLogChanged()
+{
+    const bool hasEntries = mFilterLog->count() > 0;
+    mUser2Button->setEnabled(hasEntries);
+    mUser1Button->setEnabled(hasEntries);
+}
+
+void FilterLogDialog::slotRowsAboutToBeInserted()
+{
+    // only follow new entries while the user looks at the end of the log
+    const QScrollBar *scrollBar = mLogView->verticalScrollBar();
+    mFollowLog = scrollBar->value() == scrollBar->maximum();
+}
+
+void FilterLogDialog::slotRowsInserted()
+{
+    if (mFollowLog) {
+        mLogView->scrollToBottom();
+    }
 }
 
 void FilterLogDialog::readConfig()
@@ -206,26 +233,20 @@ void FilterLogDialog::readConfig()
     const bool isLogRuleResult = group.readEntry("LogRuleResult", false);
     const bool isLogPatternResult = group.readEntry("LogPatternResult", false);
     const bool isLogAppliedAction = group.readEntry("LogAppliedAction", false);
-    const int maxLogSize = group.readEntry("maxLogSize", -1);
+    const int maxLogRecords = group.readEntry("maxLogRecords", defaultLogRecords);
 
-    if (isEnabled != FilterLog::instance()->isLogging()) {
-        FilterLog::instance()->setLogging(isEnabled);
-    }
-    if (isLogPatternDescription != FilterLog::instance()->isContentTypeEnabled(FilterLog::PatternDescription)) {
-        FilterLog::instance()->setContentTypeEnabled(FilterLog::PatternDescription, isLogPatternDescription);
-    }
-    if (isLogRuleResult != FilterLog::instance()->isContentTypeEnabled(FilterLog::RuleResult)) {
-        FilterLog::instance()->setContentTypeEnabled(FilterLog::RuleResult, isLogRuleResult);
-    }
-    if (isLogPatternResult != FilterLog::instance()->isContentTypeEnabled(FilterLog::PatternResult)) {
-        FilterLog::instance()->setContentTypeEnabled(FilterLog::PatternResult, isLogPatternResult);
-    }
-    if (isLogAppliedAction != FilterLog::instance()->isContentTypeEnabled(FilterLog::AppliedAction)) {
-        FilterLog::instance()->setContentTypeEnabled(FilterLog::AppliedAction, isLogAppliedAction);
-    }
-    if (FilterLog::instance()->maxLogSize() != maxLogSize) {
-        FilterLog::instance()->setMaxLogSize(maxLogSize);
-    }
+    mLogActiveBox->setChecked(isEnabled);
+    mLogPatternDescBox->setChecked(isLogPatternDescription);
+    mLogRuleEvaluationBox->setChecked(isLogRuleResult);
+    mLogPatternResultBox->setChecked(isLogPatternResult);
+    mLogFilterActionBox->setChecked(isLogAppliedAction);
+    mLogMemLimitSpin->setValue(maxLogRecords);
+
+    mFilterLog->setEnabled(isEnabled);
+    mFilterLog->setShowPatternDescription(isLogPatternDescription);
+    mFilterLog->setRecordMismatches(isLogPatternResult);
+    mFilterLog->setCapacity(mLogMemLimitSpin->value());
+    updateDetailLogging();
 
     KConfigGroup geometryGroup(config, "Geometry");
     const QSize size = geometryGroup.readEntry("filterLogSize", QSize(600, 400));
@@ -238,7 +259,6 @@ void FilterLogDialog::readConfig()
 
 FilterLogDialog::~FilterLogDialog()
 {
-    disconnect(mTextEdit->editor(), &KPIMTextEdit::PlainTextEditor::textChanged, this, &FilterLogDialog::slotTextChanged);
     KConfigGroup myGroup(KSharedConfig::openConfig(), "Geometry");
     myGroup.writeEntry("filterLogSize", size());
     myGroup.sync();
@@ -252,99 +272,46 @@ void FilterLogDialog::writeConfig()
 
     KSharedConfig::Ptr config = KSharedConfig::openConfig();
     KConfigGroup group(config, "FilterLog");
-    group.writeEntry("Enabled", FilterLog::instance()->isLogging());
-    group.writeEntry("LogPatternDescription", FilterLog::instance()->isContentTypeEnabled(FilterLog::PatternDescription));
-    group.writeEntry("LogRuleResult", FilterLog::instance()->isContentTypeEnabled(FilterLog::RuleResult));
-    group.writeEntry("LogPatternResult", FilterLog::instance()->isContentTypeEnabled(FilterLog::PatternResult));
-    group.writeEntry("LogAppliedAction", FilterLog::instance()->isContentTypeEnabled(FilterLog::AppliedAction));
-    group.writeEntry("maxLogSize", static_cast<int>(FilterLog::instance()->maxLogSize()));
+    group.writeEntry("Enabled", mFilterLog->isEnabled());
+    group.writeEntry("LogPatternDescription", mFilterLog->showPatternDescription());
+    group.writeEntry("LogRuleResult", mFilterLog->logRuleResults());
+    group.writeEntry("LogPatternResult", mFilterLog->recordMismatches());
+    group.writeEntry("LogAppliedAction", mFilterLog->logAppliedActions());
+    group.writeEntry("maxLogRecords", mFilterLog->capacity());
     group.sync();
 }
 
-void FilterLogDialog::slotLogEntryAdded(const QString &logEntry)
+void FilterLogDialog::updateDetailLogging()
 {
-    mTextEdit->editor()->appendHtml(logEntry);
-}
-
-void FilterLogDialog::slotLogShrinked()
-{
-    // limit the size of the shown log lines as soon as
-    // the log has reached it's memory limit
-    if (mTextEdit->editor()->document()->maximumBlockCount() <= 0) {
-        mTextEdit->editor()->document()->setMaximumBlockCount(mTextEdit->editor()->document()->blockCount());
-    }
-}
-
-void FilterLogDialog::slotLogStateChanged()
-{
-    mLogActiveBox->setChecked(FilterLog::instance()->isLogging());
-    mLogPatternDescBox->setChecked(
-        FilterLog::instance()->isContentTypeEnabled(FilterLog::PatternDescription));
-    mLogRuleEvaluationBox->setChecked(
-        FilterLog::instance()->isContentTypeEnabled(FilterLog::RuleResult));
-    mLogPatternResultBox->setChecked(
-        FilterLog::instance()->isContentTypeEnabled(FilterLog::PatternResult));
-    mLogFilterActionBox->setChecked(
-        FilterLog::instance()->isContentTypeEnabled(FilterLog::AppliedAction));
-
-    // value in the QSpinBox is in KB while it's in Byte in the FilterLog
-    int newLogSize = FilterLog::instance()->maxLogSize() / 1024;
-    if (mLogMemLimitSpin->value() != newLogSize) {
-        if (newLogSize <= 0) {
-            mLogMemLimitSpin->setValue(1);
-        } else {
-            mLogMemLimitSpin->setValue(newLogSize);
-        }
-    }
-    writeConfig();
+    mFilterLog->setDetailLogging(mLogRuleEvaluationBox->isChecked(), mLogFilterActionBox->isChecked());
 }
 
 void FilterLogDialog::slotChangeLogDetail()
 {
-    if (mLogPatternDescBox->isChecked()
-        != FilterLog::instance()->isContentTypeEnabled(FilterLog::PatternDescription)) {
-        FilterLog::instance()->setContentTypeEnabled(FilterLog::PatternDescription,
-                                                     mLogPatternDescBox->isChecked());
-    }
-
-    if (mLogRuleEvaluationBox->isChecked()
-        != FilterLog::instance()->isContentTypeEnabled(FilterLog::RuleResult)) {
-        FilterLog::instance()->setContentTypeEnabled(FilterLog::RuleResult,
-                                                     mLogRuleEvaluationBox->isChecked());
-    }
-
-    if (mLogPatternResultBox->isChecked()
-        != FilterLog::instance()->isContentTypeEnabled(FilterLog::PatternResult)) {
-        FilterLog::instance()->setContentTypeEnabled(FilterLog::PatternResult,
-                                                     mLogPatternResultBox->isChecked());
-    }
-
-    if (mLogFilterActionBox->isChecked()
-        != FilterLog::instance()->isContentTypeEnabled(FilterLog::AppliedAction)) {
-        FilterLog::instance()->setContentTypeEnabled(FilterLog::AppliedAction,
-                                                     mLogFilterActionBox->isChecked());
-    }
+    mFilterLog->setShowPatternDescription(mLogPatternDescBox->isChecked());
+    mFilterLog->setRecordMismatches(mLogPatternResultBox->isChecked());
+    updateDetailLogging();
+    mLogView->viewport()->update();
+    writeConfig();
 }
 
 void FilterLogDialog::slotSwitchLogState()
 {
-    FilterLog::instance()->setLogging(mLogActiveBox->isChecked());
+    mFilterLog->setEnabled(mLogActiveBox->isChecked());
+    updateDetailLogging();
+    writeConfig();
 }
 
 void FilterLogDialog::slotChangeLogMemLimit(int value)
 {
-    mTextEdit->editor()->document()->setMaximumBlockCount(0);   //Reset value
-    if (value == 1) { //unilimited
-        FilterLog::instance()->setMaxLogSize(-1);
-    } else {
-        FilterLog::instance()->setMaxLogSize(value * 1024);
-    }
+    mFilterLog->setCapacity(value);
+    writeConfig();
 }
 
 void FilterLogDialog::slotUser1()
 {
     FilterLog::instance()->clear();
-    mTextEdit->editor()->clear();
+    mFilterLog->clear();
 }
 
 void FilterLogDialog::slotUser2()
@@ -353,11 +320,11 @@ void FilterLogDialog::slotUser2()
 
     fdlg->setAcceptMode(QFileDialog::AcceptSave);
     fdlg->setFileMode(QFileDialog::AnyFile);
-    fdlg->selectFile(QStringLiteral("kmail-filter.html"));
+    fdlg->selectFile(QStringLiteral("kmail-filter.log"));
     if (fdlg->exec() == QDialog::Accepted) {
         const QStringList fileName = fdlg->selectedFiles();
 
-        if (!fileName.isEmpty() && !FilterLog::instance()->saveToFile(fileName.at(0))) {
+        if (!fileName.isEmpty() && !mFilterLog->saveToFile(fileName.at(0))) {
             KMessageBox::error(this,
                                i18n("Could not write the file %1:\n"
                                     "\"%2\" is the detailed error description.",
@@ -368,20 +335,3 @@ void FilterLogDialog::slotUser2()
     }
     delete fdlg;
 }
-
-FilterLogTextEdit::FilterLogTextEdit(QWidget *parent)
-    : KPIMTextEdit::PlainTextEditor(parent)
-{
-}
-
-void FilterLogTextEdit::addExtraMenuEntry(QMenu *menu, QPoint pos)
-{
-    Q_UNUSED(pos);
-    if (!document()->isEmpty()) {
-        QAction *sep = new QAction(menu);
-        sep->setSeparator(true);
-        menu->addAction(sep);
-        QAction *clearAllAction = KStandardAction::clear(this, &FilterLogTextEdit::clear, menu);
-        menu->addAction(clearAllAction);
-    }
-}
@@ -31,12 +31,16 @@
 
 #include <QDialog>
 
-#include <KPIMTextEdit/PlainTextEditor>
-
 class QCheckBox;
 class QSpinBox;
 class QGroupBox;
 class QPushButton;
+class QTabWidget;
+class QTreeView;
+class FilterLogBuffer;
+class FilterLogModel;
+class FilterProfileWidget;
+class FilterStatistics;
 /**
   @short KMail Filter Log Collector.
   @author Andreas Gungl <a.gungl@gmx.de>
@@ -44,35 +48,24 @@ class QPushButton;
   The filter log dialog allows a continued observation of the
   filter log of MailFilterAgent.
 */
-namespace KPIMTextEdit {
-class PlainTextEditorWidget;
-}
-
-class FilterLogTextEdit : public KPIMTextEdit::PlainTextEditor
-{
-    Q_OBJECT
-public:
-    explicit FilterLogTextEdit(QWidget *parent = nullptr);
-    ~FilterLogTextEdit() override = default;
-
-protected:
-    void addExtraMenuEntry(QMenu *menu, QPoint pos) override;
-};
-
 class FilterLogDialog : public QDialog
 {
     Q_OBJECT
 
 public:
     /** constructor */
-    explicit FilterLogDialog(QWidget *parent);
+    explicit FilterLogDialog(FilterLogBuffer *filterLog, QWidget *parent);
     ~FilterLogDialog();
 
+    /**
+     * Shows the counters of @p statistics in the profile tab.
+     */
+    void setFilterStatistics(FilterStatistics *statistics);
+
 private:
-    void slotTextChanged();
-    void slotLogEntryAdded(const QString &logEntry);
-    void slotLogShrinked();
-    void slotLogStateChanged();
+    void slotLogChanged();
+    void slotRowsAboutToBeInserted();
+    void slotRowsInserted();
     void slotChangeLogDetail();
     void slotSwitchLogState();
     void slotChangeLogMemLimit(int value);
@@ -82,8 +75,11 @@ private:
 
     void readConfig();
     void writeConfig();
+    void updateDetailLogging();
 
-    KPIMTextEdit::PlainTextEditorWidget *mTextEdit = nullptr;
+    FilterLogBuffer *mFilterLog = nullptr;
+    FilterLogModel *mLogModel = nullptr;
+    QTreeView *mLogView = nullptr;
     QCheckBox *mLogActiveBox = nullptr;
     QGroupBox *mLogDetailsBox = nullptr;
     QCheckBox *mLogPatternDescBox = nullptr;
@@ -93,8 +89,11 @@ private:
     QSpinBox *mLogMemLimitSpin = nullptr;
     QPushButton *mUser1Button = nullptr;
     QPushButton *mUser2Button = nullptr;
+    QTabWidget *mTabWidget = nullptr;
+    FilterProfileWidget *mProfileWidget = nullptr;
 
     bool mIsInitialized = false;
+    bool mFollowLog = true;
 };
 
 #endif
@@ -0,0 +1,129 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "filterlogmodel.h"
+#include "filterlogbuffer.h"
+
+#include <KLocalizedString>
+
+#include <QDateTime>
+#include <QFont>
+#include <QLocale>
+
+FilterLogModel::FilterLogModel(FilterLogBuffer *buffer, QObject *parent)
+    : QAbstractTableModel(parent)
+    , mBuffer(buffer)
+    , mFirstSequence(buffer->firstSequence())
+    , mEndSequence(buffer->firstSequence() + buffer->count())
+{
+    connect(mBuffer, &FilterLogBuffer::changed, this, &FilterLogModel::slotBufferChanged);
+}
+
+FilterLogModel::~FilterLogModel()
+{
+}
+
+int FilterLogModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    return static_cast<int>(mEndSequence - mFirstSequence);
+}
+
+int FilterLogModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    return ColumnCount;
+}
+
+QVariant FilterLogModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount()) {
+        return QVariant();
+    }
+    const int bufferIndex = static_cast<int>(mFirstSequence + index.row() - mBuffer->firstSequence());
+    if (bufferIndex < 0 || bufferIndex >= mBuffer->count()) {
+        return QVariant();
+    }
+    const FilterLogBuffer::Record &record = mBuffer->record(bufferIndex);
+
+    if (role == Qt::DisplayRole || role == Qt::ToolTipRole) {
+        switch (index.column()) {
+        case TimeColumn:
+            return QLocale().toString(QDateTime::fromMSecsSinceEpoch(record.time).time(), QStringLiteral("HH:mm:ss.zzz"));
+        case MessageColumn:
+            return record.itemId >= 0 ? QString::number(record.itemId) : QString();
+        case EventColumn:
+            return mBuffer->formatRecord(record);
+        default:
+            break;
+        }
+    } else if (role == Qt::FontRole && record.type == FilterLogBuffer::MessageBegin) {
+        QFont font;
+        font.setBold(true);
+        return font;
+    }
+    return QVariant();
+}
+
+QVariant FilterLogModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+    switch (section) {
+    case TimeColumn:
+        return i18n("Time");
+    case MessageColumn:
+        return i18n("Message");
+    case EventColumn:
+        return i18n("Event");
+    default:
+        break;
+    }
+    return QVariant();
+}
+
+void FilterLogModel::slotBufferChanged()
+{
+    const qint64 first = mBuffer->firstSequence();
+    const qint64 end = first + mBuffer->count();
+    if (first > mEndSequence || end < mEndSequence) {
+        // cleared or shrunk beyond what is shown
+        beginResetModel();
+        mFirstSequence = first;
+        mEndSequence = end;
+        endResetModel();
+        return;
+    }
+    if (first > mFirstSequence) {
+        beginRemoveRows(QModelIndex(), 0, static_cast<int>(first - mFirstSequence) - 1);
+        mFirstSequence = first;
+        endRemoveRows();
+    }
+    if (end > mEndSequence) {
+        const int row = rowCount();
+        beginInsertRows(QModelIndex(), row, row + static_cast<int>(end - mEndSequence) - 1);
+        mEndSequence = end;
+        endInsertRows();
+    }
+}
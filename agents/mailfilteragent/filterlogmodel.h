@@ -0,0 +1,62 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef FILTERLOGMODEL_H
+#define FILTERLOGMODEL_H
+
+#include <QAbstractTableModel>
+
+class FilterLogBuffer;
+
+/**
+ * @short Exposes the records of a FilterLogBuffer to views.
+ *
+ * Rows are only formatted when a view asks for them, and new or dropped
+ * records are announced as row insertions and removals so that views
+ * keep their position.
+ */
+class FilterLogModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum Column {
+        TimeColumn = 0,
+        MessageColumn,
+        EventColumn,
+        ColumnCount
+    };
+
+    explicit FilterLogModel(FilterLogBuffer *buffer, QObject *parent = nullptr);
+    ~FilterLogModel() override;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+    void slotBufferChanged();
+
+    FilterLogBuffer *mBuffer = nullptr;
+    // sequence numbers of the rows currently exposed
+    qint64 mFirstSequence = 0;
+    qint64 mEndSequence = 0;
+};
+
+#endif // FILTERLOGMODEL_H
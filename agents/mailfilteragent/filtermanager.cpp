@@ -18,6 +18,10 @@
  *
  */
 #include "filtermanager.h"
+#include "filtercommitstage.h"
+#include "filterengine.h"
+#include "filterlogbuffer.h"
+#include "filterstatistics.h"
 
 #include <AkonadiCore/agentmanager.h>
 #include <AkonadiCore/changerecorder.h>
@@ -48,7 +52,13 @@
 #include <algorithm>
 #include <errno.h>
 #include <KSharedConfig>
-#include <QLocale>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+
+#include <functional>
 
 using namespace MailCommon;
 
@@ -63,24 +73,70 @@ public:
         , mInboundFiltersExist(false)
     {
         pixmapNotification = QIcon::fromTheme(QStringLiteral("view-filter")).pixmap(KIconLoader::SizeSmall, KIconLoader::SizeSmall);
-    }
+        mCommitStage = new FilterCommitStage(q);
+        QObject::connect(mCommitStage, &FilterCommitStage::jobFailed, q, [this](KJob *job) {
+            commitJobFailed(job);
+        });
+        mFilterLog = new FilterLogBuffer(q);
+        // Rule and action details are still logged by MailCommon
+        QObject::connect(FilterLog::instance(), &FilterLog::logEntryAdded, mFilterLog, &FilterLogBuffer::addDetail);
+        mClock.start();
+    }
+
+    typedef std::function<void (QVector<FilterEngine::MessageState> &)> MatchedFunction;
+
+    // A batch of messages whose patterns are matched on the worker threads
+    struct PendingMatch {
+        QVector<FilterEngine::MessageState> states;
+        // one per chunk of states still being matched
+        QVector<QFutureWatcher<void> *> watchers;
+        MatchedFunction matched;
+    };
 
     void itemsFetchJobForFilterDone(KJob *job);
     void itemFetchJobForFilterDone(KJob *job);
+    void commitJobFailed(KJob *job);
     void moveJobResult(KJob *);
     void modifyJobResult(KJob *);
     void deleteJobResult(KJob *);
     void slotItemsFetchedForFilter(const Akonadi::Item::List &items);
     void showNotification(const QString &errorMsg, const QString &jobErrorString);
 
-    bool isMatching(const Akonadi::Item &item, const MailCommon::MailFilter *filter);
+    bool isMatching(FilterEngine::MessageState &state, const Akonadi::Item &item, const MailCommon::MailFilter *filter);
     void beginFiltering(const Akonadi::Item &item) const;
     void endFiltering(const Akonadi::Item &item) const;
+    bool filterContext(const QList<MailCommon::MailFilter *> &mailFilters, MailCommon::ItemContext &context, FilterEngine::MessageState &state, FilterManager::FilterSet set, bool account,
+                       const QString &accountId);
+    bool processItem(const QList<MailCommon::MailFilter *> &mailFilters, const Akonadi::Item &item, FilterEngine::MessageState &state, bool needsFullPayload, FilterManager::FilterSet set,
+                     bool account, const QString &accountId);
+    bool isApplicable(const MailCommon::MailFilter *filter, FilterManager::FilterSet set, bool account, const QString &accountId) const;
+    bool needsFullPayload(FilterEngine::MessageState &state, FilterManager::FilterSet set, bool account, const QString &accountId);
+    void matchInParallel(const Akonadi::Item::List &items, const QList<MailCommon::MailFilter *> &mailFilters, FilterManager::FilterSet set, const MatchedFunction &matched);
+    void applyFinishedMatches();
+    void finishPendingMatches(bool apply);
+    void filterFetchedItems(const Akonadi::Item::List &items, const QList<MailCommon::MailFilter *> &mailFilters, QVector<FilterEngine::MessageState> &states, bool needsFullPayload,
+                            FilterManager::FilterSet set);
+    void filterBatch(const Akonadi::Item::List &items, QVector<FilterEngine::MessageState> &states, bool needsFullPayload, FilterManager::FilterSet set, bool account, const QString &accountId);
+    void benchmarkItems(const Akonadi::Item::List &items, const QList<MailCommon::MailFilter *> &mailFilters, FilterManager::FilterSet set);
     bool atLeastOneFilterAppliesTo(const QString &accountId) const;
     bool atLeastOneIncomingFilterAppliesTo(const QString &accountId) const;
     FilterManager *q;
     QList<MailCommon::MailFilter *> mFilters;
+    FilterEngine mFilterEngine;
+    FilterStatistics mFilterStatistics;
+    FilterLogBuffer *mFilterLog = nullptr;
+    FilterCommitStage *mCommitStage = nullptr;
+    QThreadPool mThreadPool;
+    // in arrival order, which is the order their actions are applied in
+    QList<PendingMatch *> mPendingMatches;
+    QElapsedTimer mClock;
+    qint64 mBenchmarkMessageCount = 0;
+    qint64 mBenchmarkElapsed = 0;
+    qint64 mBenchmarkEnd = 0;
+    bool mBenchmarkMode = false;
     QMap<QString, SearchRule::RequiredPart> mRequiredParts;
+    // parts needed by the filters which don't need the complete message
+    QMap<QString, SearchRule::RequiredPart> mHeaderPassParts;
     QPixmap pixmapNotification;
     SearchRule::RequiredPart mRequiredPartsBasedOnAll;
     int mTotalProgressCount = 0;
@@ -116,7 +172,22 @@ void FilterManager::Private::slotItemsFetchedForFilter(const Akonadi::Item::List
 
     bool needsFullPayload = q->sender()->property("needsFullPayload").toBool();
 
-    for (const Akonadi::Item &item : qAsConst(items)) {
+    if (mBenchmarkMode) {
+        benchmarkItems(items, listMailFilters, filterSet);
+        return;
+    }
+
+    // match in parallel first, actions are then applied in message order
+    matchInParallel(items, listMailFilters, filterSet, [this, items, listMailFilters, needsFullPayload, filterSet](QVector<FilterEngine::MessageState> &states) {
+        filterFetchedItems(items, listMailFilters, states, needsFullPayload, filterSet);
+    });
+}
+
+void FilterManager::Private::filterFetchedItems(const Akonadi::Item::List &items, const QList<MailCommon::MailFilter *> &listMailFilters, QVector<FilterEngine::MessageState> &states,
+                                                bool needsFullPayload, FilterManager::FilterSet filterSet)
+{
+    for (int i = 0, total = items.count(); i < total; ++i) {
+        const Akonadi::Item &item = items.at(i);
         ++mCurrentProgressCount;
 
         if ((mTotalProgressCount > 0) && (mCurrentProgressCount != mTotalProgressCount)) {
@@ -128,7 +199,7 @@ void FilterManager::Private::slotItemsFetchedForFilter(const Akonadi::Item::List
             Q_EMIT q->percent(0);
         }
 
-        const bool filterResult = q->process(listMailFilters, item, needsFullPayload, filterSet);
+        const bool filterResult = processItem(listMailFilters, item, states[i], needsFullPayload, filterSet, false, QString());
 
         if (mCurrentProgressCount == mTotalProgressCount) {
             mTotalProgressCount = 0;
@@ -141,6 +212,143 @@ void FilterManager::Private::slotItemsFetchedForFilter(const Akonadi::Item::List
             //CommonKernel->emergencyExit( i18n( "Unable to process messages: " ) + QString::fromLocal8Bit( strerror( errno ) ) );
         }
     }
+    // commit the changes of the whole fetched batch at once
+    mCommitStage->flush();
+}
+
+bool FilterManager::Private::isApplicable(const MailCommon::MailFilter *filter, FilterManager::FilterSet set, bool account, const QString &accountId) const
+{
+    if (!filter->isEnabled()) {
+        return false;
+    }
+    const bool inboundOk = ((set & Inbound) && filter->applyOnInbound());
+    const bool outboundOk = ((set & Outbound) && filter->applyOnOutbound());
+    const bool beforeOutboundOk = ((set & BeforeOutbound) && filter->applyBeforeOutbound());
+    const bool explicitOk = ((set & Explicit) && filter->applyOnExplicit());
+    const bool allFoldersOk = ((set & AllFolders) && filter->applyOnAllFoldersInbound());
+    const bool accountOk = (!account || filter->applyOnAccount(accountId));
+
+    return (inboundOk && accountOk) || (allFoldersOk && accountOk) || outboundOk || beforeOutboundOk || explicitOk;
+}
+
+bool FilterManager::Private::needsFullPayload(FilterEngine::MessageState &state, FilterManager::FilterSet set, bool account, const QString &accountId)
+{
+    // Dry run of filterContext() without executing actions. As long as no
+    // filter matched, no action can have changed the message, so a first
+    // matching filter that stops processing decides the message for sure.
+    bool matchedBefore = false;
+    for (const MailCommon::MailFilter *filter : qAsConst(mFilters)) {
+        if (!isApplicable(filter, set, account, accountId)) {
+            continue;
+        }
+        if (filter->requiredPart(accountId) == SearchRule::CompleteMessage) {
+            return true;
+        }
+        if (mFilterEngine.matches(state, filter)) {
+            if (!matchedBefore && filter->stopProcessingHere()) {
+                return false;
+            }
+            matchedBefore = true;
+        }
+    }
+    return false;
+}
+
+void FilterManager::Private::matchInParallel(const Akonadi::Item::List &items, const QList<MailCommon::MailFilter *> &mailFilters, FilterManager::FilterSet set,
+                                             const MatchedFunction &matched)
+{
+    PendingMatch *match = new PendingMatch;
+    match->matched = matched;
+    match->states.reserve(items.count());
+    for (const Akonadi::Item &item : items) {
+        match->states.append(FilterEngine::MessageState(item));
+    }
+    mPendingMatches.append(match);
+
+    // The rules log from whichever thread evaluates them, keep the log in order
+    const int workers = mThreadPool.maxThreadCount();
+    QList<MailCommon::MailFilter *> parallelFilters;
+    if (workers > 1 && items.count() > 1 && !FilterLog::instance()->isLogging()) {
+        for (MailCommon::MailFilter *filter : mailFilters) {
+            if (isApplicable(filter, set, false, QString()) && mFilterEngine.isThreadSafe(filter)) {
+                parallelFilters << filter;
+            }
+        }
+    }
+
+    if (!parallelFilters.isEmpty()) {
+        // The states are not touched from here on until all chunks are matched
+        const int total = match->states.count();
+        const int chunkSize = qMax(1, total / (workers * 4));
+        FilterEngine::MessageState *data = match->states.data();
+        for (int begin = 0; begin < total; begin += chunkSize) {
+            FilterEngine::MessageState *states = data + begin;
+            const int count = qMin(chunkSize, total - begin);
+            QFutureWatcher<void> *watcher = new QFutureWatcher<void>(q);
+            QObject::connect(watcher, &QFutureWatcher<void>::finished, q, [this, match, watcher]() {
+                match->watchers.removeOne(watcher);
+                watcher->deleteLater();
+                applyFinishedMatches();
+            });
+            match->watchers.append(watcher);
+            watcher->setFuture(QtConcurrent::run(&mThreadPool, [this, states, count, parallelFilters]() {
+                for (int i = 0; i < count; ++i) {
+                    mFilterEngine.evaluate(states[i], parallelFilters);
+                }
+            }));
+        }
+    }
+    // without workers the batch is applied right away, unless older batches are still matched
+    applyFinishedMatches();
+}
+
+void FilterManager::Private::applyFinishedMatches()
+{
+    while (!mPendingMatches.isEmpty() && mPendingMatches.first()->watchers.isEmpty()) {
+        QScopedPointer<PendingMatch> match(mPendingMatches.takeFirst());
+        match->matched(match->states);
+    }
+}
+
+void FilterManager::Private::finishPendingMatches(bool apply)
+{
+    // The workers use the filters, they have to be done before the filters change
+    mThreadPool.waitForDone();
+    for (PendingMatch *match : qAsConst(mPendingMatches)) {
+        qDeleteAll(match->watchers);
+        match->watchers.clear();
+    }
+    if (apply) {
+        applyFinishedMatches();
+    } else {
+        qDeleteAll(mPendingMatches);
+        mPendingMatches.clear();
+    }
+}
+
+void FilterManager::Private::benchmarkItems(const Akonadi::Item::List &items, const QList<MailCommon::MailFilter *> &mailFilters, FilterManager::FilterSet set)
+{
+    const qint64 startTime = mClock.nsecsElapsed();
+    matchInParallel(items, mailFilters, set, [this, items, mailFilters, set, startTime](QVector<FilterEngine::MessageState> &states) {
+        for (int i = 0, total = items.count(); i < total; ++i) {
+            // only evaluate the patterns, don't execute any action
+            for (const MailCommon::MailFilter *filter : mailFilters) {
+                if (isApplicable(filter, set, false, QString())) {
+                    mFilterEngine.matches(states[i], filter);
+                }
+            }
+        }
+        // batches are matched while the previous ones are, don't count that time twice
+        const qint64 now = mClock.nsecsElapsed();
+        mBenchmarkElapsed += now - qMax(startTime, mBenchmarkEnd);
+        mBenchmarkEnd = now;
+        mBenchmarkMessageCount += items.count();
+        mCurrentProgressCount += items.count();
+        if (mCurrentProgressCount >= mTotalProgressCount) {
+            mTotalProgressCount = 0;
+            mCurrentProgressCount = 0;
+        }
+    });
 }
 
 void FilterManager::Private::itemsFetchJobForFilterDone(KJob *job)
@@ -197,6 +405,17 @@ void FilterManager::Private::itemFetchJobForFilterDone(KJob *job)
     }
 }
 
+void FilterManager::Private::commitJobFailed(KJob *job)
+{
+    if (qobject_cast<Akonadi::ItemMoveJob *>(job)) {
+        moveJobResult(job);
+    } else if (qobject_cast<Akonadi::ItemDeleteJob *>(job)) {
+        deleteJobResult(job);
+    } else {
+        modifyJobResult(job);
+    }
+}
+
 void FilterManager::Private::moveJobResult(KJob *job)
 {
     if (job->error()) {
@@ -237,41 +456,27 @@ void FilterManager::Private::showNotification(const QString &errorMsg, const QSt
     notify->sendEvent();
 }
 
-bool FilterManager::Private::isMatching(const Akonadi::Item &item, const MailCommon::MailFilter *filter)
+bool FilterManager::Private::isMatching(FilterEngine::MessageState &state, const Akonadi::Item &item, const MailCommon::MailFilter *filter)
 {
-    bool result = false;
-    if (FilterLog::instance()->isLogging()) {
-        QString logText(i18n("<b>Evaluating filter rules:</b> "));
-        logText.append(filter->pattern()->asString());
-        FilterLog::instance()->add(logText, FilterLog::PatternDescription);
-    }
-
-    if (filter->pattern()->matches(item)) {
-        if (FilterLog::instance()->isLogging()) {
-            FilterLog::instance()->add(i18n("<b>Filter rules have matched.</b>"),
-                                       FilterLog::PatternResult);
-        }
-
-        result = true;
-    }
-
-    return result;
+    // Matching ahead on a worker thread was already timed there
+    qint64 elapsed = mFilterEngine.evaluationTime(state, filter);
+    QElapsedTimer timer;
+    timer.start();
+    // The rules themselves log every comparison, so bypass the compiled engine when logging
+    const bool matches = FilterLog::instance()->isLogging() ? filter->pattern()->matches(item) : mFilterEngine.matches(state, filter);
+    if (elapsed < 0) {
+        elapsed = timer.nsecsElapsed();
+    }
+    mFilterStatistics.addEvaluation(filter, matches, elapsed);
+    mFilterLog->addEvaluation(item.id(), filter, matches);
+    return matches;
 }
 
 void FilterManager::Private::beginFiltering(const Akonadi::Item &item) const
 {
-    if (FilterLog::instance()->isLogging()) {
-        FilterLog::instance()->addSeparator();
-        if (item.hasPayload<KMime::Message::Ptr>()) {
-            KMime::Message::Ptr msg = item.payload<KMime::Message::Ptr>();
-            const QString subject = msg->subject()->asUnicodeString();
-            const QString from = msg->from()->asUnicodeString();
-            const QDateTime dateTime = msg->date()->dateTime();
-            const QString date = QLocale().toString(dateTime, QLocale::LongFormat);
-            const QString logText(i18n("<b>Begin filtering on message \"%1\" from \"%2\" at \"%3\" :</b>",
-                                       subject, from, date));
-            FilterLog::instance()->add(logText, FilterLog::PatternDescription);
-        }
+    if (mFilterLog->isEnabled() && item.hasPayload<KMime::Message::Ptr>()) {
+        const KMime::Message::Ptr msg = item.payload<KMime::Message::Ptr>();
+        mFilterLog->addMessage(item.id(), msg->subject()->asUnicodeString(), msg->from()->asUnicodeString());
     }
 }
 
@@ -317,6 +522,8 @@ FilterManager::~FilterManager()
 
 void FilterManager::clear()
 {
+    d->finishPendingMatches(false);
+    d->mFilterEngine.clear();
     qDeleteAll(d->mFilters);
     d->mFilters.clear();
 }
@@ -325,11 +532,19 @@ void FilterManager::readConfig()
 {
     KSharedConfig::Ptr config = KSharedConfig::openConfig(); // use akonadi_mailfilter_agentrc
     config->reparseConfiguration();
+    // batches received until now are still filtered with the previous filters
+    d->finishPendingMatches(true);
     clear();
 
     QStringList emptyFilters;
     d->mFilters = FilterImporterExporter::readFiltersFromConfig(config, emptyFilters);
+    d->mFilterEngine.compile(d->mFilters);
+    d->mFilterStatistics.setFilters(d->mFilters);
+    d->mFilterLog->setFilters(d->mFilters);
+    const KConfigGroup generalGroup(config, "General");
+    setWorkerCount(generalGroup.readEntry("WorkerThreads", QThread::idealThreadCount()));
     d->mRequiredParts.clear();
+    d->mHeaderPassParts.clear();
 
     d->mRequiredPartsBasedOnAll = SearchRule::Envelope;
     if (!d->mFilters.isEmpty()) {
@@ -343,6 +558,15 @@ void FilterManager::readConfig()
             });
             d->mRequiredParts[id] = (*it)->requiredPart(id);
             d->mRequiredPartsBasedOnAll = qMax(d->mRequiredPartsBasedOnAll, d->mRequiredParts[id]);
+
+            SearchRule::RequiredPart headerPassPart = SearchRule::Envelope;
+            for (const MailCommon::MailFilter *filter : qAsConst(d->mFilters)) {
+                const SearchRule::RequiredPart part = filter->requiredPart(id);
+                if (part != SearchRule::CompleteMessage) {
+                    headerPassPart = qMax(headerPassPart, part);
+                }
+            }
+            d->mHeaderPassParts[id] = headerPassPart;
         }
     }
     // check if at least one filter is to be applied on inbound mail
@@ -435,7 +659,8 @@ bool FilterManager::process(const Akonadi::Item &item, bool needsFullPayload, co
         return false;
     }
 
-    if (d->isMatching(item, filter)) {
+    FilterEngine::MessageState state(item);
+    if (d->isMatching(state, item, filter)) {
         // do the actual filtering stuff
         d->beginFiltering(item);
 
@@ -443,13 +668,18 @@ bool FilterManager::process(const Akonadi::Item &item, bool needsFullPayload, co
 
         bool stopIt = false;
         bool applyOnOutbound = false;
-        if (filter->execActions(context, stopIt, applyOnOutbound) == MailCommon::MailFilter::CriticalError) {
+        QElapsedTimer timer;
+        timer.start();
+        const MailCommon::MailFilter::ReturnCode result = filter->execActions(context, stopIt, applyOnOutbound);
+        d->mFilterStatistics.addActions(filter, timer.nsecsElapsed());
+        d->mFilterLog->addActions(item.id(), filter);
+        if (result == MailCommon::MailFilter::CriticalError) {
             return false;
         }
 
         d->endFiltering(item);
 
-        if (!processContextItem(context)) {
+        if (!processContextItem(context, item)) {
             return false;
         }
     }
@@ -457,7 +687,7 @@ bool FilterManager::process(const Akonadi::Item &item, bool needsFullPayload, co
     return true;
 }
 
-bool FilterManager::processContextItem(ItemContext context)
+bool FilterManager::processContextItem(ItemContext context, const Akonadi::Item &original)
 {
     const KMime::Message::Ptr msg = context.item().payload<KMime::Message::Ptr>();
     msg->assemble();
@@ -465,48 +695,64 @@ bool FilterManager::processContextItem(ItemContext context)
     auto col = Akonadi::EntityTreeModel::updatedCollection(MailCommon::Kernel::self()->kernelIf()->collectionModel(),
                                                            context.item().parentCollection());
     const bool itemCanDelete = (col.rights() & Akonadi::Collection::CanDeleteItem);
-    if (context.deleteItem()) {
-        if (itemCanDelete) {
-            Akonadi::ItemDeleteJob *deleteJob = new Akonadi::ItemDeleteJob(context.item(), this);
-            connect(deleteJob, &Akonadi::ItemDeleteJob::result, this, [this](KJob *job) {
-                d->deleteJobResult(job);
-            });
-        } else {
-            return false;
+    const bool needsMove = context.moveTargetCollection().isValid() && context.item().storageCollectionId() != context.moveTargetCollection().id();
+    if ((context.deleteItem() || needsMove) && !itemCanDelete) {
+        return false;
+    }
+
+    // The commit stage groups the changes of all items filtered in this event loop iteration
+    d->mCommitStage->add(context, original);
+    d->mCommitStage->scheduleFlush();
+    return true;
+}
+
+void FilterManager::processContextItems(const QList<ItemContext> &contexts, const Akonadi::Item::List &originals)
+{
+    for (int i = 0, total = contexts.count(); i < total; ++i) {
+        ItemContext context = contexts.at(i);
+        if (!processContextItem(context, originals.at(i))) {
+            Q_EMIT filteringFailed(context.item());
         }
-    } else {
-        if (context.moveTargetCollection().isValid() && context.item().storageCollectionId() != context.moveTargetCollection().id()) {
-            if (itemCanDelete) {
-                Akonadi::ItemMoveJob *moveJob = new Akonadi::ItemMoveJob(context.item(), context.moveTargetCollection(), this);
-                connect(moveJob, &Akonadi::ItemMoveJob::result, this, [this](KJob *job) {
-                    d->moveJobResult(job);
-                });
-            } else {
-                return false;
+    }
+    d->mCommitStage->flush();
+}
+
+bool FilterManager::Private::filterContext(const QList<MailCommon::MailFilter *> &mailFilters, ItemContext &context, FilterEngine::MessageState &state, FilterManager::FilterSet set, bool account,
+                                           const QString &accountId)
+{
+    bool stopIt = false;
+
+    beginFiltering(context.item());
+
+    QList<MailCommon::MailFilter *>::const_iterator end(mailFilters.constEnd());
+
+    const bool applyOnOutbound = ((set & Outbound) || (set & BeforeOutbound));
+
+    for (QList<MailCommon::MailFilter *>::const_iterator it = mailFilters.constBegin();
+         !stopIt && it != end; ++it) {
+        if (isApplicable(*it, set, account, accountId)) {
+            if (isMatching(state, context.item(), *it)) {
+                // execute actions:
+                QElapsedTimer timer;
+                timer.start();
+                const MailCommon::MailFilter::ReturnCode result = (*it)->execActions(context, stopIt, applyOnOutbound);
+                mFilterStatistics.addActions(*it, timer.nsecsElapsed());
+                mFilterLog->addActions(context.item().id(), *it);
+                if (result == MailCommon::MailFilter::CriticalError) {
+                    return false;
+                }
+                // actions may have changed headers or flags
+                state.invalidate(context.item());
             }
         }
-        if (context.needsPayloadStore() || context.needsFlagStore()) {
-            Akonadi::Item item = context.item();
-            //the item might be in a new collection with a different remote id, so don't try to force on it
-            //the previous remote id. Example: move to another collection on another resource => new remoteId, but our context.item()
-            //remoteid still holds the old one. Without clearing it, we try to enforce that on the new location, which is
-            //anything but good (and the server replies with "NO Only resources can modify remote identifiers"
-            item.setRemoteId(QString());
-            Akonadi::ItemModifyJob *modifyJob = new Akonadi::ItemModifyJob(item, this);
-            modifyJob->disableRevisionCheck(); //no conflict handling for mails as no other process could change the mail body and we don't care about flag conflicts
-            //The below is a safety check to ignore modifying payloads if it was not requested,
-            //as in that case we might change the payload to an invalid one
-            modifyJob->setIgnorePayload(!context.needsFullPayload());
-            connect(modifyJob, &Akonadi::ItemModifyJob::result, this, [this](KJob *job) {
-                d->modifyJobResult(job);
-            });
-        }
     }
 
+    endFiltering(context.item());
     return true;
 }
 
-bool FilterManager::process(const QList< MailFilter * > &mailFilters, const Akonadi::Item &item, bool needsFullPayload, FilterManager::FilterSet set, bool account, const QString &accountId)
+bool FilterManager::Private::processItem(const QList<MailCommon::MailFilter *> &mailFilters, const Akonadi::Item &item, FilterEngine::MessageState &state, bool needsFullPayload,
+                                         FilterManager::FilterSet set, bool account, const QString &accountId)
 {
     if (set == NoSet) {
         qCDebug(MAILFILTERAGENT_LOG) << "FilterManager: process() called with not filter set selected";
@@ -518,44 +764,61 @@ bool FilterManager::process(const QList< MailFilter * > &mailFilters, const Akon
         return false;
     }
 
-    bool stopIt = false;
+    ItemContext context(item, needsFullPayload);
+    if (!filterContext(mailFilters, context, state, set, account, accountId)) {
+        return false;
+    }
 
-    d->beginFiltering(item);
+    if (!q->processContextItem(context, item)) {
+        return false;
+    }
 
-    ItemContext context(item, needsFullPayload);
-    QList<MailCommon::MailFilter *>::const_iterator end(mailFilters.constEnd());
+    return true;
+}
 
-    const bool applyOnOutbound = ((set & Outbound) || (set & BeforeOutbound));
+bool FilterManager::process(const QList< MailFilter * > &mailFilters, const Akonadi::Item &item, bool needsFullPayload, FilterManager::FilterSet set, bool account, const QString &accountId)
+{
+    FilterEngine::MessageState state(item);
+    return d->processItem(mailFilters, item, state, needsFullPayload, set, account, accountId);
+}
 
-    for (QList<MailCommon::MailFilter *>::const_iterator it = mailFilters.constBegin();
-         !stopIt && it != end; ++it) {
-        if ((*it)->isEnabled()) {
-            const bool inboundOk = ((set & Inbound) && (*it)->applyOnInbound());
-            const bool outboundOk = ((set & Outbound) && (*it)->applyOnOutbound());
-            const bool beforeOutboundOk = ((set & BeforeOutbound) && (*it)->applyBeforeOutbound());
-            const bool explicitOk = ((set & Explicit) && (*it)->applyOnExplicit());
-            const bool allFoldersOk = ((set & AllFolders) && (*it)->applyOnAllFoldersInbound());
-            const bool accountOk = (!account || (*it)->applyOnAccount(accountId));
-
-            if ((inboundOk && accountOk) || (allFoldersOk && accountOk) || outboundOk || beforeOutboundOk || explicitOk) {
-                // filter is applicable
-
-                if (d->isMatching(context.item(), *it)) {
-                    // execute actions:
-                    if ((*it)->execActions(context, stopIt, applyOnOutbound) == MailCommon::MailFilter::CriticalError) {
-                        return false;
-                    }
-                }
-            }
-        }
+void FilterManager::process(const Akonadi::Item::List &items, bool needsFullPayload, FilterSet set, bool account, const QString &accountId)
+{
+    if (set == NoSet) {
+        qCDebug(MAILFILTERAGENT_LOG) << "FilterManager: process() called with not filter set selected";
+        return;
     }
 
-    d->endFiltering(item);
-    if (!processContextItem(context)) {
-        return false;
+    d->matchInParallel(items, d->mFilters, set, [this, items, needsFullPayload, set, account, accountId](QVector<FilterEngine::MessageState> &states) {
+        d->filterBatch(items, states, needsFullPayload, set, account, accountId);
+    });
+}
+
+void FilterManager::Private::filterBatch(const Akonadi::Item::List &items, QVector<FilterEngine::MessageState> &states, bool needsFullPayload, FilterManager::FilterSet set, bool account,
+                                         const QString &accountId)
+{
+    QList<ItemContext> contexts;
+    contexts.reserve(items.count());
+    Akonadi::Item::List originals;
+    originals.reserve(items.count());
+    for (int i = 0, total = items.count(); i < total; ++i) {
+        const Akonadi::Item &item = items.at(i);
+        if (!item.hasPayload<KMime::Message::Ptr>()) {
+            qCCritical(MAILFILTERAGENT_LOG) << "Filter is null or item doesn't have correct payload.";
+            Q_EMIT q->filteringFailed(item);
+            continue;
+        }
+
+        ItemContext context(item, needsFullPayload);
+        if (filterContext(mFilters, context, states[i], set, account, accountId)) {
+            contexts.append(context);
+            originals.append(item);
+        } else {
+            Q_EMIT q->filteringFailed(item);
+        }
     }
 
-    return true;
+    q->processContextItems(contexts, originals);
 }
 
 bool FilterManager::process(const Akonadi::Item &item, bool needsFullPayload, FilterSet set, bool account, const QString &accountId)
@@ -595,6 +858,28 @@ MailCommon::SearchRule::RequiredPart FilterManager::requiredPart(const QString &
     return d->mRequiredParts.contains(id) ? d->mRequiredParts[id] : SearchRule::Envelope;
 }
 
+MailCommon::SearchRule::RequiredPart FilterManager::headerPassPart(const QString &id) const
+{
+    return d->mHeaderPassParts.value(id, SearchRule::Envelope);
+}
+
+Akonadi::Item::List FilterManager::takeItemsNeedingFullPayload(Akonadi::Item::List &items, FilterSet set, bool account, const QString &accountId)
+{
+    Akonadi::Item::List needingFullPayload;
+    Akonadi::Item::List decided;
+    decided.reserve(items.count());
+    for (const Akonadi::Item &item : qAsConst(items)) {
+        FilterEngine::MessageState state(item);
+        if (d->needsFullPayload(state, set, account, accountId)) {
+            needingFullPayload << item;
+        } else {
+            decided << item;
+        }
+    }
+    items = decided;
+    return needingFullPayload;
+}
+
 void FilterManager::dump() const
 {
     for (const MailCommon::MailFilter *filter : qAsConst(d->mFilters)) {
@@ -658,6 +943,50 @@ void FilterManager::applyFilters(const Akonadi::Item::List &selectedMessages, Fi
     });
 }
 
+void FilterManager::setWorkerCount(int count)
+{
+    d->mThreadPool.setMaxThreadCount(qMax(1, count));
+}
+
+int FilterManager::workerCount() const
+{
+    return d->mThreadPool.maxThreadCount();
+}
+
+void FilterManager::setBenchmarkMode(bool enabled)
+{
+    d->mBenchmarkMode = enabled;
+    d->mBenchmarkMessageCount = 0;
+    d->mBenchmarkElapsed = 0;
+}
+
+bool FilterManager::benchmarkMode() const
+{
+    return d->mBenchmarkMode;
+}
+
+QString FilterManager::benchmarkResult() const
+{
+    const double seconds = d->mBenchmarkElapsed / 1000000000.0;
+    QString result;
+    result += QStringLiteral("Benchmark mode: %1\n").arg(d->mBenchmarkMode ? QStringLiteral("enabled") : QStringLiteral("disabled"));
+    result += QStringLiteral("Worker threads: %1\n").arg(workerCount());
+    result += QStringLiteral("Messages matched: %1\n").arg(d->mBenchmarkMessageCount);
+    result += QStringLiteral("Matching time: %1 s\n").arg(seconds, 0, 'f', 3);
+    result += QStringLiteral("Messages per second: %1").arg(seconds > 0 ? d->mBenchmarkMessageCount / seconds : 0.0, 0, 'f', 1);
+    return result;
+}
+
+FilterLogBuffer *FilterManager::filterLog() const
+{
+    return d->mFilterLog;
+}
+
+FilterStatistics *FilterManager::statistics() const
+{
+    return &d->mFilterStatistics;
+}
+
 bool FilterManager::hasAllFoldersFilter() const
 {
     return d->mAllFoldersFiltersExist;
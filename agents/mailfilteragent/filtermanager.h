@@ -29,6 +29,8 @@ namespace MailCommon {
 class MailFilter;
 class ItemContext;
 }
+class FilterLogBuffer;
+class FilterStatistics;
 
 class FilterManager : public QObject
 {
@@ -99,6 +101,18 @@ public:
     bool process(const QList<MailCommon::MailFilter *> &mailFilters, const Akonadi::Item &item, bool needsFullPayload, FilterSet set = Inbound, bool account = false,
                  const QString &accountId = QString());
 
+    /**
+     * Process a batch of message items with the filter set @p set.
+     *
+     * Moves, deletions and flag changes resulting from the filter actions
+     * are committed with as few jobs as possible. Items that could not be
+     * filtered are reported through filteringFailed().
+     *
+     * The patterns are matched on worker threads, the actions are applied
+     * once the batch is matched, after those of the previous batches.
+     */
+    void process(const Akonadi::Item::List &items, bool needsFullPayload, FilterSet set = Inbound, bool account = false, const QString &accountId = QString());
+
     /**
      * For ad-hoc filters.
      *
@@ -122,18 +136,59 @@ public:
      */
     MailCommon::SearchRule::RequiredPart requiredPart(const QString &id) const;
 
+    /**
+     * Returns the message part needed by all filters of the account @p id
+     * which can be decided without the complete message. Messages are
+     * fetched with this part first, see takeItemsNeedingFullPayload().
+     */
+    MailCommon::SearchRule::RequiredPart headerPassPart(const QString &id) const;
+
+    /**
+     * Removes the messages from @p items which reach a filter needing the
+     * complete message before a stop processing filter fired, and returns them.
+     * @p items must have been fetched with at least headerPassPart().
+     */
+    Akonadi::Item::List takeItemsNeedingFullPayload(Akonadi::Item::List &items, FilterSet set, bool account, const QString &accountId);
+
     void mailCollectionRemoved(const Akonadi::Collection &collection);
     void agentRemoved(const QString &identifier);
 
     bool hasAllFoldersFilter() const;
 
+    /**
+     * Sets the number of threads used to match filter patterns.
+     * Filter actions are always applied on the main thread, in message order.
+     */
+    void setWorkerCount(int count);
+    int workerCount() const;
+
+    /**
+     * In benchmark mode, applyFilters() and applySpecificFilters() only
+     * evaluate the filter patterns without executing any action, and
+     * measure the matching throughput. Changing the mode resets the result.
+     */
+    void setBenchmarkMode(bool enabled);
+    bool benchmarkMode() const;
+    QString benchmarkResult() const;
+
+    /**
+     * Returns the per filter counters, which are always recorded.
+     */
+    FilterStatistics *statistics() const;
+
+    /**
+     * Returns the structured log of the filter activities.
+     */
+    FilterLogBuffer *filterLog() const;
+
     /**
      * Outputs all filter rules to console. Used for debugging.
      */
     void dump() const;
 
 protected:
-    bool processContextItem(MailCommon::ItemContext context);
+    bool processContextItem(MailCommon::ItemContext context, const Akonadi::Item &original);
+    void processContextItems(const QList<MailCommon::ItemContext> &contexts, const Akonadi::Item::List &originals);
 
 Q_SIGNALS:
     /**
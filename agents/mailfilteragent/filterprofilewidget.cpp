@@ -0,0 +1,133 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "filterprofilewidget.h"
+#include "filterstatistics.h"
+
+#include <KLocalizedString>
+
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLocale>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+namespace {
+enum Column {
+    NameColumn = 0,
+    EvaluationsColumn,
+    MatchesColumn,
+    MatchTimeColumn,
+    ActionTimeColumn
+};
+
+// Sorts numerically on the raw value kept in Qt::UserRole
+class FilterProfileItem : public QTreeWidgetItem
+{
+public:
+    using QTreeWidgetItem::QTreeWidgetItem;
+
+    bool operator<(const QTreeWidgetItem &other) const override
+    {
+        const int column = treeWidget() ? treeWidget()->sortColumn() : NameColumn;
+        if (column == NameColumn) {
+            return QTreeWidgetItem::operator<(other);
+        }
+        return data(column, Qt::UserRole).toLongLong() < other.data(column, Qt::UserRole).toLongLong();
+    }
+};
+}
+
+FilterProfileWidget::FilterProfileWidget(QWidget *parent)
+    : QWidget(parent)
+{
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    mainLayout->setMargin(0);
+
+    mTreeWidget = new QTreeWidget(this);
+    mTreeWidget->setObjectName(QStringLiteral("profiletreewidget"));
+    mTreeWidget->setRootIsDecorated(false);
+    mTreeWidget->setSortingEnabled(true);
+    mTreeWidget->setHeaderLabels({i18n("Filter"), i18n("Evaluations"), i18n("Matches"),
+                                  i18n("Match Time (ms)"), i18n("Action Time (ms)")});
+    mTreeWidget->header()->setSectionResizeMode(NameColumn, QHeaderView::Stretch);
+    mTreeWidget->header()->setStretchLastSection(false);
+    mTreeWidget->sortByColumn(MatchTimeColumn, Qt::DescendingOrder);
+    mainLayout->addWidget(mTreeWidget);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout;
+    buttonLayout->addStretch(1);
+    QPushButton *refreshButton = new QPushButton(QIcon::fromTheme(QStringLiteral("view-refresh")), i18n("Refresh"), this);
+    refreshButton->setObjectName(QStringLiteral("refreshbutton"));
+    connect(refreshButton, &QPushButton::clicked, this, &FilterProfileWidget::refresh);
+    buttonLayout->addWidget(refreshButton);
+    QPushButton *resetButton = new QPushButton(i18n("Reset"), this);
+    resetButton->setObjectName(QStringLiteral("resetbutton"));
+    connect(resetButton, &QPushButton::clicked, this, &FilterProfileWidget::slotReset);
+    buttonLayout->addWidget(resetButton);
+    mainLayout->addLayout(buttonLayout);
+}
+
+FilterProfileWidget::~FilterProfileWidget()
+{
+}
+
+void FilterProfileWidget::setFilterStatistics(FilterStatistics *statistics)
+{
+    mStatistics = statistics;
+    refresh();
+}
+
+void FilterProfileWidget::refresh()
+{
+    mTreeWidget->clear();
+    if (!mStatistics) {
+        return;
+    }
+    const QLocale locale;
+    const QVector<FilterStatistics::Entry> entries = mStatistics->entries();
+    for (const FilterStatistics::Entry &entry : entries) {
+        QTreeWidgetItem *item = new FilterProfileItem(mTreeWidget);
+        item->setText(NameColumn, entry.name);
+        item->setToolTip(NameColumn, entry.identifier);
+        item->setText(EvaluationsColumn, locale.toString(entry.evaluations));
+        item->setData(EvaluationsColumn, Qt::UserRole, entry.evaluations);
+        item->setText(MatchesColumn, locale.toString(entry.matches));
+        item->setData(MatchesColumn, Qt::UserRole, entry.matches);
+        item->setText(MatchTimeColumn, locale.toString(entry.matchTime / 1000000.0, 'f', 3));
+        item->setData(MatchTimeColumn, Qt::UserRole, entry.matchTime);
+        item->setText(ActionTimeColumn, locale.toString(entry.actionTime / 1000000.0, 'f', 3));
+        item->setData(ActionTimeColumn, Qt::UserRole, entry.actionTime);
+        for (int column = EvaluationsColumn; column <= ActionTimeColumn; ++column) {
+            item->setTextAlignment(column, Qt::AlignRight | Qt::AlignVCenter);
+        }
+    }
+    for (int column = EvaluationsColumn; column <= ActionTimeColumn; ++column) {
+        mTreeWidget->resizeColumnToContents(column);
+    }
+}
+
+void FilterProfileWidget::slotReset()
+{
+    if (mStatistics) {
+        mStatistics->reset();
+    }
+    refresh();
+}
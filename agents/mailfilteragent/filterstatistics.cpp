@@ -0,0 +1,103 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "filterstatistics.h"
+
+#include <MailCommon/MailFilter>
+
+FilterStatistics::FilterStatistics()
+{
+}
+
+void FilterStatistics::setFilters(const QList<MailCommon::MailFilter *> &filters)
+{
+    QHash<QString, Entry> previous;
+    for (const Entry &entry : qAsConst(mEntries)) {
+        previous.insert(entry.identifier, entry);
+    }
+
+    mEntries.clear();
+    mIndex.clear();
+    mEntries.reserve(filters.count());
+    for (const MailCommon::MailFilter *filter : filters) {
+        Entry entry = previous.value(filter->identifier());
+        entry.identifier = filter->identifier();
+        entry.name = filter->name();
+        mIndex.insert(filter, mEntries.count());
+        mEntries.append(entry);
+    }
+}
+
+void FilterStatistics::addEvaluation(const MailCommon::MailFilter *filter, bool matched, qint64 nsecs)
+{
+    const auto it = mIndex.constFind(filter);
+    if (it == mIndex.constEnd()) {
+        return;
+    }
+    Entry &entry = mEntries[it.value()];
+    ++entry.evaluations;
+    if (matched) {
+        ++entry.matches;
+    }
+    entry.matchTime += nsecs;
+}
+
+void FilterStatistics::addActions(const MailCommon::MailFilter *filter, qint64 nsecs)
+{
+    const auto it = mIndex.constFind(filter);
+    if (it == mIndex.constEnd()) {
+        return;
+    }
+    mEntries[it.value()].actionTime += nsecs;
+}
+
+QVector<FilterStatistics::Entry> FilterStatistics::entries() const
+{
+    return mEntries;
+}
+
+void FilterStatistics::reset()
+{
+    for (Entry &entry : mEntries) {
+        entry.evaluations = 0;
+        entry.matches = 0;
+        entry.matchTime = 0;
+        entry.actionTime = 0;
+    }
+}
+
+QString FilterStatistics::toString() const
+{
+    QString str;
+    for (const Entry &entry : mEntries) {
+        if (!str.isEmpty()) {
+            str += QLatin1Char('\n');
+        }
+        str += QStringLiteral("Filter name: %1\n").arg(entry.name);
+        str += QStringLiteral("Filter id: %1\n").arg(entry.identifier);
+        str += QStringLiteral("Evaluations: %1\n").arg(entry.evaluations);
+        str += QStringLiteral("Matches: %1\n").arg(entry.matches);
+        str += QStringLiteral("Match time: %1 ms\n").arg(entry.matchTime / 1000000.0, 0, 'f', 3);
+        str += QStringLiteral("Action time: %1 ms\n").arg(entry.actionTime / 1000000.0, 0, 'f', 3);
+    }
+    if (str.isEmpty()) {
+        str = QStringLiteral("No filter defined!");
+    }
+    return str;
+}
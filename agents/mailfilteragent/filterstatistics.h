@@ -0,0 +1,77 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef FILTERSTATISTICS_H
+#define FILTERSTATISTICS_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+namespace MailCommon {
+class MailFilter;
+}
+
+/**
+ * @short Always-on per filter counters of the mail filter agent.
+ *
+ * Counts how often each filter was evaluated and matched, and how much time
+ * was spent matching its pattern and executing its actions. Recording is a
+ * hash lookup and a few additions, so it doesn't depend on the filter log.
+ * Counters of filters which keep their identifier survive a reload of the
+ * filter list.
+ */
+class FilterStatistics
+{
+public:
+    struct Entry {
+        QString identifier;
+        QString name;
+        qint64 evaluations = 0;
+        qint64 matches = 0;
+        // nanoseconds
+        qint64 matchTime = 0;
+        qint64 actionTime = 0;
+    };
+
+    FilterStatistics();
+
+    void setFilters(const QList<MailCommon::MailFilter *> &filters);
+
+    void addEvaluation(const MailCommon::MailFilter *filter, bool matched, qint64 nsecs);
+    void addActions(const MailCommon::MailFilter *filter, qint64 nsecs);
+
+    /**
+     * Returns the counters of all filters, in filter list order.
+     */
+    QVector<Entry> entries() const;
+
+    /**
+     * Resets all counters to zero.
+     */
+    void reset();
+
+    QString toString() const;
+
+private:
+    QVector<Entry> mEntries;
+    QHash<const MailCommon::MailFilter *, int> mIndex;
+};
+
+#endif // FILTERSTATISTICS_H
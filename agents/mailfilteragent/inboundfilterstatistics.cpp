@@ -0,0 +1,118 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "inboundfilterstatistics.h"
+
+#include <algorithm>
+
+InboundFilterStatistics::InboundFilterStatistics()
+{
+    mLatencies.reserve(MaximumLatencySamples);
+}
+
+void InboundFilterStatistics::addBatch(int size)
+{
+    ++mBatchCount;
+    mLastBatchSize = size;
+    mMaximumBatchSize = qMax(mMaximumBatchSize, size);
+    mFilteredItemCount += size;
+}
+
+void InboundFilterStatistics::addLatency(qint64 msecs)
+{
+    if (mLatencies.count() < MaximumLatencySamples) {
+        mLatencies.append(msecs);
+    } else {
+        mLatencies[mNextLatency] = msecs;
+        mNextLatency = (mNextLatency + 1) % MaximumLatencySamples;
+    }
+}
+
+void InboundFilterStatistics::addBodyFetches(int count)
+{
+    mBodyFetchCount += count;
+}
+
+void InboundFilterStatistics::clear()
+{
+    mLatencies.clear();
+    mNextLatency = 0;
+    mBatchCount = 0;
+    mLastBatchSize = 0;
+    mMaximumBatchSize = 0;
+    mFilteredItemCount = 0;
+    mBodyFetchCount = 0;
+}
+
+int InboundFilterStatistics::batchCount() const
+{
+    return mBatchCount;
+}
+
+int InboundFilterStatistics::lastBatchSize() const
+{
+    return mLastBatchSize;
+}
+
+int InboundFilterStatistics::maximumBatchSize() const
+{
+    return mMaximumBatchSize;
+}
+
+double InboundFilterStatistics::averageBatchSize() const
+{
+    return mBatchCount > 0 ? static_cast<double>(mFilteredItemCount) / mBatchCount : 0.0;
+}
+
+qint64 InboundFilterStatistics::filteredItemCount() const
+{
+    return mFilteredItemCount;
+}
+
+qint64 InboundFilterStatistics::bodyFetchCount() const
+{
+    return mBodyFetchCount;
+}
+
+qint64 InboundFilterStatistics::latencyPercentile(int percent) const
+{
+    if (mLatencies.isEmpty()) {
+        return -1;
+    }
+    QVector<qint64> sorted = mLatencies;
+    const int index = qBound(0, (sorted.count() * qBound(0, percent, 100) + 99) / 100 - 1, sorted.count() - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted.at(index);
+}
+
+QString InboundFilterStatistics::toString(int queueDepth) const
+{
+    QString str;
+    str += QStringLiteral("Queue depth: %1\n").arg(queueDepth);
+    str += QStringLiteral("Batches filtered: %1\n").arg(mBatchCount);
+    str += QStringLiteral("Items filtered: %1\n").arg(mFilteredItemCount);
+    str += QStringLiteral("Items needing a body fetch: %1\n").arg(mBodyFetchCount);
+    str += QStringLiteral("Last batch size: %1\n").arg(mLastBatchSize);
+    str += QStringLiteral("Maximum batch size: %1\n").arg(mMaximumBatchSize);
+    str += QStringLiteral("Average batch size: %1\n").arg(averageBatchSize(), 0, 'f', 1);
+    str += QStringLiteral("Latency p50: %1 ms\n").arg(latencyPercentile(50));
+    str += QStringLiteral("Latency p90: %1 ms\n").arg(latencyPercentile(90));
+    str += QStringLiteral("Latency p99: %1 ms").arg(latencyPercentile(99));
+    return str;
+}
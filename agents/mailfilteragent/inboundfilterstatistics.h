@@ -0,0 +1,72 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef INBOUNDFILTERSTATISTICS_H
+#define INBOUNDFILTERSTATISTICS_H
+
+#include <QString>
+#include <QVector>
+
+/**
+ * @short Keeps track of the batched inbound filtering of MailFilterAgent.
+ *
+ * Records the size of every filtered batch and the latency between the
+ * moment a new message was queued and the moment it was filtered. Only the
+ * most recent latency samples are kept, so memory usage is bounded.
+ */
+class InboundFilterStatistics
+{
+public:
+    InboundFilterStatistics();
+
+    void addBatch(int size);
+    void addLatency(qint64 msecs);
+    void addBodyFetches(int count);
+    void clear();
+
+    int batchCount() const;
+    int lastBatchSize() const;
+    int maximumBatchSize() const;
+    double averageBatchSize() const;
+    qint64 filteredItemCount() const;
+    qint64 bodyFetchCount() const;
+
+    /**
+     * Returns the latency in milliseconds below which @p percent of the
+     * recorded samples lie, or -1 if no sample was recorded yet.
+     */
+    qint64 latencyPercentile(int percent) const;
+
+    QString toString(int queueDepth) const;
+
+private:
+    enum {
+        MaximumLatencySamples = 4096
+    };
+
+    QVector<qint64> mLatencies;
+    int mNextLatency = 0;
+    int mBatchCount = 0;
+    int mLastBatchSize = 0;
+    int mMaximumBatchSize = 0;
+    qint64 mFilteredItemCount = 0;
+    qint64 mBodyFetchCount = 0;
+};
+
+#endif // INBOUNDFILTERSTATISTICS_H
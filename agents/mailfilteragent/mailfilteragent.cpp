@@ -21,7 +21,9 @@
 
 #include "mailcommon/dbusoperators.h"
 #include "dummykernel.h"
+#include "filterlogbuffer.h"
 #include "filterlogdialog.h"
+#include "filterstatistics.h"
 #include "filtermanager.h"
 #include "mailfilteragentadaptor.h"
 #include <AkonadiCore/Pop3ResourceAttribute>
@@ -53,6 +55,13 @@
 
 #include <kdelibs4configmigrator.h>
 
+namespace {
+// Time to wait for more new items before fetching a batch
+const int sFlushDelay = 500;
+// Maximum number of items fetched and filtered together
+const int sMaximumBatchSize = 500;
+}
+
 bool MailFilterAgent::isFilterableCollection(const Akonadi::Collection &collection) const
 {
     if (!collection.contentMimeTypes().contains(KMime::Message::mimeType())) {
@@ -111,7 +120,14 @@ MailFilterAgent::MailFilterAgent(const QString &id)
     KSharedConfig::Ptr config = KSharedConfig::openConfig();
     if (config->hasGroup("FilterLog")) {
         KConfigGroup group(config, "FilterLog");
+        FilterLogBuffer *filterLog = m_filterManager->filterLog();
+        // also used when the log is streamed while disabled
+        filterLog->setCapacity(group.readEntry("maxLogRecords", filterLog->capacity()));
+        filterLog->setShowPatternDescription(group.readEntry("LogPatternDescription", false));
+        filterLog->setRecordMismatches(group.readEntry("LogPatternResult", false));
+        filterLog->setDetailLogging(group.readEntry("LogRuleResult", false), group.readEntry("LogAppliedAction", false));
         if (group.readEntry("Enabled", false)) {
+            filterLog->setEnabled(true);
             const QPixmap pixmap = QIcon::fromTheme(QStringLiteral("view-filter")).pixmap(KIconLoader::SizeSmall, KIconLoader::SizeSmall);
             KNotification *notify = new KNotification(QStringLiteral("mailfilterlogenabled"));
             notify->setComponentName(QApplication::applicationDisplayName());
@@ -132,6 +148,12 @@ MailFilterAgent::MailFilterAgent(const QString &id)
         emitProgress();
     });
 
+    mQueueClock.start();
+    mFlushTimer = new QTimer(this);
+    mFlushTimer->setSingleShot(true);
+    mFlushTimer->setInterval(sFlushDelay);
+    connect(mFlushTimer, &QTimer::timeout, this, &MailFilterAgent::flushPendingItems);
+
     itemMonitor = new Akonadi::Monitor(this);
     itemMonitor->setObjectName(QStringLiteral("MailFilterItemMonitor"));
     itemMonitor->itemFetchScope().setFetchRemoteIdentification(true);
@@ -225,9 +247,36 @@ void MailFilterAgent::slotItemChanged(const Akonadi::Item &item)
 
 void MailFilterAgent::filterItem(const Akonadi::Item &item, const Akonadi::Collection &collection)
 {
-    MailCommon::SearchRule::RequiredPart requiredPart = m_filterManager->requiredPart(collection.resource());
+    const QString resource = collection.resource();
+    mPendingItems[resource] << item;
+    if (!mQueuedSince.contains(item.id())) {
+        mQueuedSince.insert(item.id(), mQueueClock.elapsed());
+    }
+
+    if (mPendingItems[resource].count() >= sMaximumBatchSize) {
+        fetchItemsForFiltering(mPendingItems.take(resource), resource, m_filterManager->headerPassPart(resource));
+    } else if (!mFlushTimer->isActive()) {
+        mFlushTimer->start();
+    }
+}
+
+void MailFilterAgent::flushPendingItems()
+{
+    QHash<QString, Akonadi::Item::List>::const_iterator it = mPendingItems.constBegin();
+    const QHash<QString, Akonadi::Item::List>::const_iterator end = mPendingItems.constEnd();
+    for (; it != end; ++it) {
+        fetchItemsForFiltering(it.value(), it.key(), m_filterManager->headerPassPart(it.key()));
+    }
+    mPendingItems.clear();
+}
+
+void MailFilterAgent::fetchItemsForFiltering(const Akonadi::Item::List &items, const QString &resource, MailCommon::SearchRule::RequiredPart requiredPart)
+{
+    if (items.isEmpty()) {
+        return;
+    }
 
-    Akonadi::ItemFetchJob *job = new Akonadi::ItemFetchJob(item);
+    Akonadi::ItemFetchJob *job = new Akonadi::ItemFetchJob(items);
     connect(job, &Akonadi::ItemFetchJob::itemsReceived,
             this, &MailFilterAgent::itemsReceiviedForFiltering);
     if (requiredPart == MailCommon::SearchRule::CompleteMessage) {
@@ -239,9 +288,25 @@ void MailFilterAgent::filterItem(const Akonadi::Item &item, const Akonadi::Colle
     }
     job->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
     job->fetchScope().fetchAttribute<Akonadi::Pop3ResourceAttribute>();
-    job->setProperty("resource", collection.resource());
+    job->setProperty("resource", resource);
+    job->setProperty("requiredPart", static_cast<int>(requiredPart));
 
-    //TODO: Error handling?
+    const bool bodyPass = (requiredPart == MailCommon::SearchRule::CompleteMessage);
+    connect(job, &Akonadi::ItemFetchJob::result, this, [this, items, bodyPass](KJob *job) {
+        if (job->error()) {
+            qCWarning(MAILFILTERAGENT_LOG) << "Error while fetching items for filtering" << job->errorString();
+        }
+        // forget items which were not delivered (deleted meanwhile etc.),
+        // unless they are waiting for their body
+        for (const Akonadi::Item &item : items) {
+            if (bodyPass) {
+                mBodyPending.remove(item.id());
+            }
+            if (!mBodyPending.contains(item.id())) {
+                mQueuedSince.remove(item.id());
+            }
+        }
+    });
 }
 
 void MailFilterAgent::itemsReceiviedForFiltering(const Akonadi::Item::List &items)
@@ -251,31 +316,78 @@ void MailFilterAgent::itemsReceiviedForFiltering(const Akonadi::Item::List &item
         return;
     }
 
-    Akonadi::Item item = items.first();
-    /*
-    * happens when item no longer exists etc, and queue compression didn't happen yet
-    */
-    if (!item.hasPayload()) {
-        qCDebug(MAILFILTERAGENT_LOG) << "MailFilterAgent::itemsReceiviedForFiltering item has no payload!";
-        return;
-    }
+    const QString defaultResource = sender()->property("resource").toString();
+    const auto fetchedPart = static_cast<MailCommon::SearchRule::RequiredPart>(sender()->property("requiredPart").toInt());
+
+    // group the batch by the account the items were retrieved from
+    QHash<QString, Akonadi::Item::List> itemsByResource;
+    for (const Akonadi::Item &item : items) {
+        /*
+        * happens when item no longer exists etc, and queue compression didn't happen yet
+        */
+        if (!item.hasPayload()) {
+            qCDebug(MAILFILTERAGENT_LOG) << "MailFilterAgent::itemsReceiviedForFiltering item has no payload!";
+            mQueuedSince.remove(item.id());
+            continue;
+        }
 
-    Akonadi::MessageStatus status;
-    status.setStatusFromFlags(item.flags());
-    if (status.isRead() || status.isSpam() || status.isIgnored()) {
-        return;
-    }
+        Akonadi::MessageStatus status;
+        status.setStatusFromFlags(item.flags());
+        if (status.isRead() || status.isSpam() || status.isIgnored()) {
+            mQueuedSince.remove(item.id());
+            continue;
+        }
 
-    QString resource = sender()->property("resource").toString();
-    const Akonadi::Pop3ResourceAttribute *pop3ResourceAttribute = item.attribute<Akonadi::Pop3ResourceAttribute>();
-    if (pop3ResourceAttribute) {
-        resource = pop3ResourceAttribute->pop3AccountName();
+        QString resource = defaultResource;
+        const Akonadi::Pop3ResourceAttribute *pop3ResourceAttribute = item.attribute<Akonadi::Pop3ResourceAttribute>();
+        if (pop3ResourceAttribute) {
+            resource = pop3ResourceAttribute->pop3AccountName();
+        }
+        itemsByResource[resource] << item;
     }
 
-    emitProgressMessage(i18n("Filtering in %1", Akonadi::AgentManager::self()->instance(resource).name()));
-    m_filterManager->process(item, m_filterManager->requiredPart(resource), FilterManager::Inbound, true, resource);
+    QHash<QString, Akonadi::Item::List>::const_iterator it = itemsByResource.constBegin();
+    const QHash<QString, Akonadi::Item::List>::const_iterator end = itemsByResource.constEnd();
+    for (; it != end; ++it) {
+        const QString resource = it.key();
+        Akonadi::Item::List batch = it.value();
+
+        // Only fetch the body of messages which still have undecided body rules
+        Akonadi::Item::List needingBody;
+        if (fetchedPart < m_filterManager->headerPassPart(resource)) {
+            needingBody = batch;
+            batch.clear();
+        } else if (fetchedPart < m_filterManager->requiredPart(resource)) {
+            needingBody = m_filterManager->takeItemsNeedingFullPayload(batch, FilterManager::Inbound, true, resource);
+        }
+        if (!needingBody.isEmpty()) {
+            for (const Akonadi::Item &item : qAsConst(needingBody)) {
+                mBodyPending.insert(item.id());
+            }
+            mInboundStatistics.addBodyFetches(needingBody.count());
+            fetchItemsForFiltering(needingBody, defaultResource, MailCommon::SearchRule::CompleteMessage);
+        }
+        if (batch.isEmpty()) {
+            continue;
+        }
+
+        emitProgressMessage(i18n("Filtering in %1", Akonadi::AgentManager::self()->instance(resource).name()));
+        m_filterManager->process(batch, fetchedPart != MailCommon::SearchRule::Envelope, FilterManager::Inbound, true, resource);
+
+        mInboundStatistics.addBatch(batch.count());
+        const qint64 now = mQueueClock.elapsed();
+        for (const Akonadi::Item &item : batch) {
+            const auto queuedIt = mQueuedSince.find(item.id());
+            if (queuedIt != mQueuedSince.end()) {
+                mInboundStatistics.addLatency(now - queuedIt.value());
+                mQueuedSince.erase(queuedIt);
+            }
+            mBodyPending.remove(item.id());
+        }
+        mProgressCounter += batch.count();
+    }
 
-    emitProgress(++mProgressCounter);
+    emitProgress(mProgressCounter);
 
     mProgressTimer->start(1000);
 }
@@ -382,7 +494,8 @@ void MailFilterAgent::reload()
 void MailFilterAgent::showFilterLogDialog(qlonglong windowId)
 {
     if (!m_filterLogDialog) {
-        m_filterLogDialog = new FilterLogDialog(nullptr);
+        m_filterLogDialog = new FilterLogDialog(m_filterManager->filterLog(), nullptr);
+        m_filterLogDialog->setFilterStatistics(m_filterManager->statistics());
     }
     KWindowSystem::setMainWindow(m_filterLogDialog, windowId);
     m_filterLogDialog->show();
@@ -424,6 +537,51 @@ QString MailFilterAgent::printCollectionMonitored()
     return printDebugCollection;
 }
 
+QString MailFilterAgent::printInboundQueueStatistics()
+{
+    // items are queued until they were filtered or dropped
+    return mInboundStatistics.toString(mQueuedSince.count());
+}
+
+void MailFilterAgent::setFilterWorkerCount(int count)
+{
+    m_filterManager->setWorkerCount(count);
+}
+
+void MailFilterAgent::setFilterBenchmarkMode(bool enabled)
+{
+    m_filterManager->setBenchmarkMode(enabled);
+}
+
+QString MailFilterAgent::printFilterBenchmark()
+{
+    return m_filterManager->benchmarkResult();
+}
+
+QString MailFilterAgent::printFilterStatistics()
+{
+    return m_filterManager->statistics()->toString();
+}
+
+void MailFilterAgent::resetFilterStatistics()
+{
+    m_filterManager->statistics()->reset();
+}
+
+bool MailFilterAgent::startFilterLogStreaming(const QString &fileName)
+{
+    if (!m_filterManager->filterLog()->startStreaming(fileName)) {
+        qCWarning(MAILFILTERAGENT_LOG) << "Unable to stream the filter log to" << fileName;
+        return false;
+    }
+    return true;
+}
+
+void MailFilterAgent::stopFilterLogStreaming()
+{
+    m_filterManager->filterLog()->stopStreaming();
+}
+
 void MailFilterAgent::showConfigureDialog(qlonglong windowId)
 {
     Q_UNUSED(windowId);
@@ -28,6 +28,12 @@
 
 #include <AkonadiCore/AgentInstance>
 
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+
+#include "inboundfilterstatistics.h"
+
 class FilterLogDialog;
 class FilterManager;
 class KJob;
@@ -58,6 +64,15 @@ public:
 
     void showFilterLogDialog(qlonglong windowId = 0);
     QString printCollectionMonitored();
+    QString printInboundQueueStatistics();
+
+    void setFilterWorkerCount(int count);
+    void setFilterBenchmarkMode(bool enabled);
+    QString printFilterBenchmark();
+    QString printFilterStatistics();
+    void resetFilterStatistics();
+    bool startFilterLogStreaming(const QString &fileName);
+    void stopFilterLogStreaming();
 
     void showConfigureDialog(qlonglong windowId = 0);
 
@@ -74,6 +89,7 @@ private Q_SLOTS:
     void emitProgress(int percent = 0);
     void emitProgressMessage(const QString &message);
     void itemsReceiviedForFiltering(const Akonadi::Item::List &items);
+    void flushPendingItems();
     void clearMessage();
     void slotInstanceRemoved(const Akonadi::AgentInstance &instance);
     void slotItemChanged(const Akonadi::Item &item);
@@ -92,7 +108,18 @@ private:
     int mProgressCounter;
     Akonadi::Monitor *itemMonitor = nullptr;
 
+    // new items waiting to be fetched for filtering, per resource
+    QHash<QString, Akonadi::Item::List> mPendingItems;
+    QTimer *mFlushTimer = nullptr;
+    // when each queued item was added, for the latency statistics
+    QHash<Akonadi::Item::Id, qint64> mQueuedSince;
+    // items filtered on their headers which still need the complete message
+    QSet<Akonadi::Item::Id> mBodyPending;
+    QElapsedTimer mQueueClock;
+    InboundFilterStatistics mInboundStatistics;
+
     void filterItem(const Akonadi::Item &item, const Akonadi::Collection &collection);
+    void fetchItemsForFiltering(const Akonadi::Item::List &items, const QString &resource, MailCommon::SearchRule::RequiredPart requiredPart);
 };
 
 #endif
@@ -0,0 +1,144 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "sendlaterstoretest.h"
+#include "../sendlaterstore.h"
+#include "sendlaterinfo.h"
+#include "sendlaterutil.h"
+
+#include <KConfigGroup>
+
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <qtest.h>
+
+namespace {
+SendLater::SendLaterInfo createInfo(Akonadi::Item::Id id)
+{
+    SendLater::SendLaterInfo info;
+    info.setItemId(id);
+    info.setTo(QStringLiteral("kde.org"));
+    info.setSubject(QStringLiteral("Subject %1").arg(id));
+    info.setRecurrence(true);
+    info.setRecurrenceEachValue(2);
+    info.setRecurrenceUnit(SendLater::SendLaterInfo::Weeks);
+    info.setDateTime(QDateTime(QDate(2018, 1, 1), QTime(9, 0)));
+    info.setLastDateTimeSend(QDateTime(QDate(2017, 12, 18), QTime(9, 0)));
+    return info;
+}
+}
+
+SendLaterStoreTest::SendLaterStoreTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void SendLaterStoreTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(mDir.isValid());
+}
+
+QString SendLaterStoreTest::storeFileName(const QString &name) const
+{
+    return mDir.path() + QLatin1Char('/') + name;
+}
+
+void SendLaterStoreTest::shouldBeEmpty()
+{
+    SendLaterStore store(storeFileName(QStringLiteral("empty.store")));
+    QCOMPARE(store.count(), 0);
+    QVERIFY(store.infos().isEmpty());
+    QVERIFY(!store.contains(42));
+    QVERIFY(!store.info(42));
+}
+
+void SendLaterStoreTest::shouldSerializeInfo()
+{
+    const SendLater::SendLaterInfo info = createInfo(42);
+    SendLater::SendLaterInfo *result = SendLaterStore::deserialize(SendLaterStore::serialize(info));
+    QVERIFY(result);
+    QCOMPARE(*result, info);
+    delete result;
+
+    QVERIFY(!SendLaterStore::deserialize(QByteArray()));
+}
+
+void SendLaterStoreTest::shouldKeepInfosAfterReopen()
+{
+    const QString fileName = storeFileName(QStringLiteral("reopen.store"));
+    {
+        SendLaterStore store(fileName);
+        for (Akonadi::Item::Id id = 1; id <= 10; ++id) {
+            const SendLater::SendLaterInfo info = createInfo(id);
+            store.save(&info);
+        }
+        store.remove(5);
+        SendLater::SendLaterInfo changed = createInfo(7);
+        changed.setSubject(QStringLiteral("Changed"));
+        store.save(&changed);
+        // Invalid infos are not stored
+        const SendLater::SendLaterInfo invalid;
+        store.save(&invalid);
+    }
+
+    SendLaterStore store(fileName);
+    QCOMPARE(store.count(), 9);
+    QVERIFY(!store.contains(5));
+    SendLater::SendLaterInfo *info = store.info(7);
+    QVERIFY(info);
+    QCOMPARE(info->subject(), QStringLiteral("Changed"));
+    delete info;
+    info = store.info(3);
+    QVERIFY(info);
+    QCOMPARE(*info, createInfo(3));
+    delete info;
+}
+
+void SendLaterStoreTest::shouldImportConfigGroups()
+{
+    KSharedConfig::Ptr config = KSharedConfig::openConfig(QStringLiteral("test-sendlaterstore.rc"), KConfig::SimpleConfig);
+    for (Akonadi::Item::Id id = 1; id <= 3; ++id) {
+        SendLater::SendLaterInfo info = createInfo(id);
+        KConfigGroup group = config->group(SendLater::SendLaterUtil::sendLaterPattern().arg(id));
+        info.writeConfig(group);
+    }
+    KConfigGroup general = config->group(QStringLiteral("General"));
+    general.writeEntry("Enabled", true);
+    config->sync();
+
+    SendLaterStore store(storeFileName(QStringLiteral("import.store")));
+    QList<Akonadi::Item::Id> ids = store.importConfig(config);
+    std::sort(ids.begin(), ids.end());
+    QCOMPARE(ids, QList<Akonadi::Item::Id>() << 1 << 2 << 3);
+    QCOMPARE(store.count(), 3);
+    SendLater::SendLaterInfo *info = store.info(2);
+    QVERIFY(info);
+    QCOMPARE(info->subject(), createInfo(2).subject());
+    QCOMPARE(info->recurrenceUnit(), SendLater::SendLaterInfo::Weeks);
+    delete info;
+
+    // The groups are gone, other settings are kept
+    config->reparseConfiguration();
+    QVERIFY(config->groupList().filter(QRegularExpression(QStringLiteral("SendLaterItem \\d+"))).isEmpty());
+    QVERIFY(config->hasGroup(QStringLiteral("General")));
+    QVERIFY(store.importConfig(config).isEmpty());
+}
+
+QTEST_MAIN(SendLaterStoreTest)
@@ -0,0 +1,170 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "sendlatertimerwheeltest.h"
+#include "../sendlatertimerwheel.h"
+#include <qtest.h>
+
+namespace {
+// 2018-01-01 09:00:00 UTC
+const qint64 start = 1514797200000;
+}
+
+SendLaterTimerWheelTest::SendLaterTimerWheelTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void SendLaterTimerWheelTest::shouldHaveDefaultValue()
+{
+    SendLaterTimerWheel wheel;
+    QVERIFY(wheel.isEmpty());
+    QCOMPARE(wheel.count(), 0);
+    QCOMPARE(wheel.nextDueTime(), qint64(-1));
+    QCOMPARE(wheel.resolution(), qint64(1000));
+    QVERIFY(wheel.takeDue(start).isEmpty());
+}
+
+void SendLaterTimerWheelTest::shouldTakeDueItemsInOrder()
+{
+    SendLaterTimerWheel wheel;
+    wheel.takeDue(start);
+    wheel.insert(3, start + 30000);
+    wheel.insert(1, start + 10000);
+    wheel.insert(2, start + 20000);
+    QCOMPARE(wheel.count(), 3);
+    QCOMPARE(wheel.nextDueTime(), start + 10000);
+
+    QVERIFY(wheel.takeDue(start + 5000).isEmpty());
+    QCOMPARE(wheel.takeDue(start + 20000), QVector<Akonadi::Item::Id>({1, 2}));
+    QCOMPARE(wheel.nextDueTime(), start + 30000);
+    QVERIFY(!wheel.contains(1));
+    QVERIFY(wheel.contains(3));
+
+    // already overdue when inserted
+    wheel.insert(4, start);
+    QCOMPARE(wheel.nextDueTime(), start);
+    QCOMPARE(wheel.takeDue(start + 21000), QVector<Akonadi::Item::Id>({4}));
+    QCOMPARE(wheel.takeDue(start + 40000), QVector<Akonadi::Item::Id>({3}));
+    QVERIFY(wheel.isEmpty());
+}
+
+void SendLaterTimerWheelTest::shouldRemoveItems()
+{
+    SendLaterTimerWheel wheel;
+    wheel.takeDue(start);
+    wheel.insert(1, start + 10000);
+    wheel.insert(2, start + 10000);
+    wheel.insert(3, start + 24 * 3600 * 1000);
+    QVERIFY(wheel.remove(1));
+    QVERIFY(!wheel.remove(1));
+    QVERIFY(wheel.remove(3));
+    QCOMPARE(wheel.count(), 1);
+    QCOMPARE(wheel.takeDue(start + 48 * 3600 * 1000), QVector<Akonadi::Item::Id>({2}));
+}
+
+void SendLaterTimerWheelTest::shouldRescheduleItems()
+{
+    SendLaterTimerWheel wheel;
+    wheel.takeDue(start);
+    wheel.insert(1, start + 10000);
+    wheel.insert(1, start + 50000);
+    QCOMPARE(wheel.count(), 1);
+    QCOMPARE(wheel.dueTime(1), start + 50000);
+    QVERIFY(wheel.takeDue(start + 10000).isEmpty());
+    QCOMPARE(wheel.takeDue(start + 50000), QVector<Akonadi::Item::Id>({1}));
+}
+
+void SendLaterTimerWheelTest::shouldHandleFarFutureItems()
+{
+    // 10 slots of one second
+    SendLaterTimerWheel wheel(1000, 10);
+    wheel.takeDue(start);
+    wheel.insert(1, start + 100000);
+    wheel.insert(2, start + 5000);
+    wheel.insert(3, start + 15000);
+    QCOMPARE(wheel.nextDueTime(), start + 5000);
+
+    // Turn the wheel second by second
+    QVector<Akonadi::Item::Id> taken;
+    for (qint64 time = start; time <= start + 120000; time += 1000) {
+        const QVector<Akonadi::Item::Id> due = wheel.takeDue(time);
+        for (Akonadi::Item::Id id : due) {
+            QVERIFY(wheel.dueTime(id) < 0);
+            taken << id;
+        }
+        if (time == start + 14000) {
+            QCOMPARE(taken, QVector<Akonadi::Item::Id>({2}));
+            QCOMPARE(wheel.nextDueTime(), start + 15000);
+        }
+    }
+    QCOMPARE(taken, QVector<Akonadi::Item::Id>({2, 3, 1}));
+}
+
+void SendLaterTimerWheelTest::shouldTakeOverdueItemsAfterLongPause()
+{
+    SendLaterTimerWheel wheel(1000, 10);
+    wheel.takeDue(start);
+    wheel.insert(1, start + 3000);
+    wheel.insert(2, start + 60000);
+    wheel.insert(3, start + 3600000);
+    wheel.insert(4, start + 7200000);
+    // e.g. after a suspend of one hour and a half
+    QCOMPARE(wheel.takeDue(start + 5400000), QVector<Akonadi::Item::Id>({1, 2, 3}));
+    QCOMPARE(wheel.nextDueTime(), start + 7200000);
+    QCOMPARE(wheel.takeDue(start + 7200000), QVector<Akonadi::Item::Id>({4}));
+}
+
+void SendLaterTimerWheelTest::shouldReleaseManyItemsDueAtTheSameTime()
+{
+    SendLaterTimerWheel wheel;
+    wheel.takeDue(start - 3600000);
+    for (Akonadi::Item::Id id = 0; id < 500; ++id) {
+        wheel.insert(id, start);
+    }
+    QCOMPARE(wheel.nextDueTime(), start);
+    QVERIFY(wheel.takeDue(start - 1000).isEmpty());
+    // All of them are released at once, at their due time
+    QCOMPARE(wheel.takeDue(start).count(), 500);
+    QVERIFY(wheel.isEmpty());
+}
+
+void SendLaterTimerWheelTest::shouldNeverTakeItemsEarly()
+{
+    // 10 slots of one second
+    SendLaterTimerWheel wheel(1000, 10);
+    wheel.takeDue(start);
+    wheel.insert(1, start + 5500);
+    wheel.insert(2, start + 30001);
+    // the slot is taken once the due time has passed
+    QCOMPARE(wheel.nextDueTime(), start + 6000);
+
+    QVector<Akonadi::Item::Id> taken;
+    for (qint64 time = start; time <= start + 40000; time += 250) {
+        const QVector<Akonadi::Item::Id> due = wheel.takeDue(time);
+        for (Akonadi::Item::Id id : due) {
+            QCOMPARE(time, id == 1 ? start + 6000 : start + 31000);
+            taken << id;
+        }
+    }
+    QCOMPARE(taken, QVector<Akonadi::Item::Id>({1, 2}));
+    QVERIFY(wheel.isEmpty());
+}
+
+QTEST_MAIN(SendLaterTimerWheelTest)
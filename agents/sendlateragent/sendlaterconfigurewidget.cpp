@@ -21,6 +21,7 @@
 #include "sendlaterinfo.h"
 #include "sendlaterutil.h"
 #include "sendlaterdialog.h"
+#include "sendlaterstore.h"
 
 #include <KConfigGroup>
 #include <KLocalizedString>
@@ -28,13 +29,7 @@
 #include <KMessageBox>
 #include <QIcon>
 #include <QPointer>
-
-namespace {
-inline QString sendLaterItemPattern()
-{
-    return QStringLiteral("SendLaterItem \\d+");
-}
-}
+#include <QSet>
 
 //#define DEBUG_MESSAGE_ID
 
@@ -149,19 +144,17 @@ void SendLaterWidget::updateButtons()
 
 void SendLaterWidget::load()
 {
-    KSharedConfig::Ptr config = KSharedConfig::openConfig();
-    const QStringList filterGroups = config->groupList().filter(QRegularExpression(sendLaterItemPattern()));
-    const int numberOfItem = filterGroups.count();
-    for (int i = 0; i < numberOfItem; ++i) {
-        KConfigGroup group = config->group(filterGroups.at(i));
-        SendLater::SendLaterInfo *info = new SendLater::SendLaterInfo(group);
+    SendLaterStore *store = SendLaterStore::self();
+    store->importConfig(KSharedConfig::openConfig());
+    const QList<SendLater::SendLaterInfo *> infos = store->infos();
+    for (SendLater::SendLaterInfo *info : infos) {
         if (info->isValid()) {
             createOrUpdateItem(info);
         } else {
             delete info;
         }
     }
-    mWidget->treeWidget->setShowDefaultText(numberOfItem == 0);
+    mWidget->treeWidget->setShowDefaultText(infos.isEmpty());
 }
 
 void SendLaterWidget::createOrUpdateItem(SendLater::SendLaterInfo *info, SendLaterItem *item)
@@ -185,25 +178,24 @@ void SendLaterWidget::save()
     if (!mChanged) {
         return;
     }
-    KSharedConfig::Ptr config = KSharedConfig::openConfig();
-
-    // first, delete all filter groups:
-    const QStringList filterGroups = config->groupList().filter(QRegularExpression(sendLaterItemPattern()));
-
-    for (const QString &group : filterGroups) {
-        config->deleteGroup(group);
-    }
-
+    SendLaterStore *store = SendLaterStore::self();
+    QSet<Akonadi::Item::Id> keptIds;
     const int numberOfItem(mWidget->treeWidget->topLevelItemCount());
     for (int i = 0; i < numberOfItem; ++i) {
         SendLaterItem *mailItem = static_cast<SendLaterItem *>(mWidget->treeWidget->topLevelItem(i));
         if (mailItem->info()) {
-            KConfigGroup group = config->group(SendLater::SendLaterUtil::sendLaterPattern().arg(mailItem->info()->itemId()));
-            mailItem->info()->writeConfig(group);
+            // Unchanged infos are not written again
+            store->save(mailItem->info());
+            keptIds.insert(mailItem->info()->itemId());
+        }
+    }
+    const QList<SendLater::SendLaterInfo *> infos = store->infos();
+    for (SendLater::SendLaterInfo *info : infos) {
+        if (!keptIds.contains(info->itemId())) {
+            store->remove(info->itemId());
         }
     }
-    config->sync();
-    config->reparseConfiguration();
+    qDeleteAll(infos);
 }
 
 void SendLaterWidget::slotRemoveItem()
@@ -263,8 +255,7 @@ void SendLaterWidget::slotModifyItem()
 void SendLaterWidget::needToReload()
 {
     mWidget->treeWidget->clear();
-    KSharedConfig::Ptr config = KSharedConfig::openConfig();
-    config->reparseConfiguration();
+    KSharedConfig::openConfig()->reparseConfiguration();
     load();
 }
 
@@ -21,167 +21,233 @@
 #include "sendlaterinfo.h"
 #include "sendlaterutil.h"
 #include "sendlaterjob.h"
+#include "sendlaterstore.h"
 
 #include "MessageComposer/AkonadiSender"
 #include <MessageComposer/Util>
 
 #include <KSharedConfig>
-#include <KConfigGroup>
 #include <KMessageBox>
 #include <KLocalizedString>
 #include "sendlateragent_debug.h"
 
-#include <QRegularExpression>
+#include <QDateTime>
 #include <QStringList>
 #include <QTimer>
 
+namespace {
+// Messages kept after a send error are tried again after this delay
+const int retryDelay = 60 * 1000;
+// Wake up regularly anyway, the wall clock can jump (suspend, time change)
+const qint64 maximumTimerInterval = 60 * 60 * 1000;
+}
+
 SendLaterManager::SendLaterManager(QObject *parent)
     : QObject(parent)
-    , mCurrentInfo(nullptr)
-    , mCurrentJob(nullptr)
     , mSender(new MessageComposer::AkonadiSender)
 {
     mConfig = KSharedConfig::openConfig();
     mTimer = new QTimer(this);
-    connect(mTimer, &QTimer::timeout, this, &SendLaterManager::slotCreateJob);
+    mTimer->setSingleShot(true);
+    connect(mTimer, &QTimer::timeout, this, &SendLaterManager::slotTimeout);
 }
 
 SendLaterManager::~SendLaterManager()
 {
     stopAll();
+    // The jobs themselves are children of the manager
+    for (const RunningJob &running : qAsConst(mRunningJobs)) {
+        delete running.info;
+    }
     delete mSender;
 }
 
 void SendLaterManager::stopAll()
 {
+    mActive = false;
     stopTimer();
-    qDeleteAll(mListSendLaterInfo);
-    mListSendLaterInfo.clear();
-    mCurrentJob = nullptr;
+    mTimerWheel.clear();
+    mSendLaterQueue.clear();
+    qDeleteAll(mSendLaterInfos);
+    mSendLaterInfos.clear();
+    // Messages being sent are finished, see sendDone() and sendError()
 }
 
 void SendLaterManager::load(bool forcereload)
 {
-    stopAll();
     if (forcereload) {
         mConfig->reparseConfiguration();
     }
+    SendLaterStore *store = SendLaterStore::self();
+    const QList<Akonadi::Item::Id> importedIds = store->importConfig(mConfig);
+
+    if (forcereload && mActive) {
+        // Only the messages added by the composer since the last load changed
+        for (Akonadi::Item::Id id : importedIds) {
+            if (mRunningJobs.contains(id)) {
+                continue;
+            }
+            unschedule(id);
+            SendLater::SendLaterInfo *info = store->info(id);
+            if (info) {
+                schedule(info, info->dateTime());
+            }
+        }
+        slotTimeout();
+        return;
+    }
 
-    const QStringList itemList = mConfig->groupList().filter(QRegularExpression(QStringLiteral("SendLaterItem \\d+")));
-    const int numberOfItems = itemList.count();
-    for (int i = 0; i < numberOfItems; ++i) {
-        KConfigGroup group = mConfig->group(itemList.at(i));
-        SendLater::SendLaterInfo *info = new SendLater::SendLaterInfo(group);
-        if (info->isValid()) {
-            mListSendLaterInfo.append(info);
+    stopAll();
+    mActive = true;
+    const QList<SendLater::SendLaterInfo *> infos = store->infos();
+    mSendLaterInfos.reserve(infos.count());
+    for (SendLater::SendLaterInfo *info : infos) {
+        if (info->isValid() && !mRunningJobs.contains(info->itemId())) {
+            schedule(info, info->dateTime());
         } else {
             delete info;
         }
     }
-    createSendInfoList();
+    slotTimeout();
 }
 
-void SendLaterManager::createSendInfoList()
+void SendLaterManager::schedule(SendLater::SendLaterInfo *info, const QDateTime &dateTime)
 {
-    mCurrentInfo = nullptr;
-    std::sort(mListSendLaterInfo.begin(), mListSendLaterInfo.end(), SendLater::SendLaterUtil::compareSendLaterInfo);
-
-    //Look at QQueue
-    if (mSendLaterQueue.isEmpty()) {
-        if (!mListSendLaterInfo.isEmpty()) {
-            mCurrentInfo = mListSendLaterInfo.first();
-            const QDateTime now = QDateTime::currentDateTime();
-            const qint64 seconds = now.secsTo(mCurrentInfo->dateTime());
-            if (seconds > 0) {
-                //qCDebug(SENDLATERAGENT_LOG)<<" seconds"<<seconds;
-                mTimer->start(seconds * 1000);
-            } else {
-                //Create job when seconds <0
-                slotCreateJob();
-            }
-        } else {
-            qCDebug(SENDLATERAGENT_LOG) << " list is empty";
-            mTimer->stop();
-        }
-    } else {
-        SendLater::SendLaterInfo *info = searchInfo(mSendLaterQueue.dequeue());
-        if (info) {
-            mCurrentInfo = info;
-            slotCreateJob();
-        } else { //If removed.
-            createSendInfoList();
-        }
+    if (!mActive) {
+        delete info;
+        return;
     }
+    mSendLaterInfos.insert(info->itemId(), info);
+    mTimerWheel.insert(info->itemId(), dateTime.toMSecsSinceEpoch());
 }
 
-void SendLaterManager::stopTimer()
+void SendLaterManager::unschedule(Akonadi::Item::Id id)
 {
-    if (mTimer->isActive()) {
-        mTimer->stop();
+    mTimerWheel.remove(id);
+    mSendLaterQueue.removeAll(id);
+    delete mSendLaterInfos.take(id);
+}
+
+void SendLaterManager::slotTimeout()
+{
+    const QVector<Akonadi::Item::Id> due = mTimerWheel.takeDue(QDateTime::currentMSecsSinceEpoch());
+    for (Akonadi::Item::Id id : due) {
+        mSendLaterQueue.enqueue(id);
     }
+    dispatch();
+    updateTimer();
 }
 
-SendLater::SendLaterInfo *SendLaterManager::searchInfo(Akonadi::Item::Id id)
+void SendLaterManager::updateTimer()
 {
-    for (SendLater::SendLaterInfo *info : qAsConst(mListSendLaterInfo)) {
-        if (info->itemId() == id) {
-            return info;
-        }
+    const qint64 next = mTimerWheel.nextDueTime();
+    if (next < 0) {
+        stopTimer();
+        return;
     }
-    return nullptr;
+    const qint64 delay = next - QDateTime::currentMSecsSinceEpoch();
+    mTimer->start(static_cast<int>(qBound<qint64>(0, delay, maximumTimerInterval)));
 }
 
-void SendLaterManager::sendNow(Akonadi::Item::Id id)
+void SendLaterManager::dispatch()
 {
-    if (!mCurrentJob) {
-        SendLater::SendLaterInfo *info = searchInfo(id);
+    while (mRunningJobs.count() < mMaximumRunningJobs && !mSendLaterQueue.isEmpty()) {
+        SendLater::SendLaterInfo *info = mSendLaterInfos.take(mSendLaterQueue.dequeue());
         if (info) {
-            mCurrentInfo = info;
-            slotCreateJob();
-        } else {
-            qCDebug(SENDLATERAGENT_LOG) << " can't find info about current id: " << id;
-            itemRemoved(id);
+            startJob(info);
+        }
+    }
+}
+
+void SendLaterManager::startJob(SendLater::SendLaterInfo *info)
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    // Messages sent before their time with sendNow() aren't late
+    if (info->dateTime() <= now) {
+        const qint64 lag = info->dateTime().msecsTo(now);
+        ++mLagCount;
+        mTotalLag += lag;
+        mMaximumLag = qMax(mMaximumLag, lag);
+        mLastLag = lag;
+        if (lag > retryDelay) {
+            qCDebug(SENDLATERAGENT_LOG) << "Sending" << info->itemId() << lag / 1000 << "seconds late";
         }
-    } else {
-        //Add to QQueue
-        mSendLaterQueue.enqueue(id);
     }
+
+    RunningJob running;
+    running.info = info;
+    running.job = new SendLaterJob(this, info, this);
+    mRunningJobs.insert(info->itemId(), running);
+    running.job->start();
 }
 
-void SendLaterManager::slotCreateJob()
+void SendLaterManager::setMaximumRunningJobs(int count)
 {
-    if (mCurrentJob) {
-        qCDebug(SENDLATERAGENT_LOG) << " Problem we have already a job" << mCurrentJob;
+    mMaximumRunningJobs = qMax(1, count);
+    dispatch();
+}
+
+int SendLaterManager::maximumRunningJobs() const
+{
+    return mMaximumRunningJobs;
+}
+
+void SendLaterManager::stopTimer()
+{
+    if (mTimer->isActive()) {
+        mTimer->stop();
+    }
+}
+
+SendLater::SendLaterInfo *SendLaterManager::searchInfo(Akonadi::Item::Id id)
+{
+    return mSendLaterInfos.value(id);
+}
+
+void SendLaterManager::sendNow(Akonadi::Item::Id id)
+{
+    if (mRunningJobs.contains(id)) {
+        qCDebug(SENDLATERAGENT_LOG) << " message is already being sent: " << id;
         return;
     }
-    mCurrentJob = new SendLaterJob(this, mCurrentInfo);
-    mCurrentJob->start();
+    SendLater::SendLaterInfo *info = searchInfo(id);
+    if (info) {
+        // Ahead of the other due messages
+        mTimerWheel.remove(id);
+        mSendLaterQueue.removeAll(id);
+        mSendLaterQueue.prepend(id);
+        dispatch();
+        updateTimer();
+    } else {
+        qCDebug(SENDLATERAGENT_LOG) << " can't find info about current id: " << id;
+        itemRemoved(id);
+    }
 }
 
 void SendLaterManager::itemRemoved(Akonadi::Item::Id id)
 {
-    if (mConfig->hasGroup(SendLater::SendLaterUtil::sendLaterPattern().arg(id))) {
+    unschedule(id);
+    if (SendLaterStore::self()->contains(id)) {
         removeInfo(id);
-        mConfig->reparseConfiguration();
         Q_EMIT needUpdateConfigDialogBox();
     }
 }
 
 void SendLaterManager::removeInfo(Akonadi::Item::Id id)
 {
-    KConfigGroup group = mConfig->group(SendLater::SendLaterUtil::sendLaterPattern().arg(id));
-    group.deleteGroup();
-    group.sync();
+    SendLaterStore::self()->remove(id);
 }
 
 void SendLaterManager::sendError(SendLater::SendLaterInfo *info, ErrorType type)
 {
     if (info) {
+        mRunningJobs.remove(info->itemId());
         switch (type) {
         case UnknownError:
         case ItemNotFound:
             //Don't try to resend it. Remove it.
             removeLaterInfo(info);
+            info = nullptr;
             break;
         case MailDispatchDoesntWork:
             //Force to make online maildispatcher
@@ -190,54 +256,94 @@ void SendLaterManager::sendError(SendLater::SendLaterInfo *info, ErrorType type)
             //Remove item which create error ?
             if (!info->isRecurrence()) {
                 removeLaterInfo(info);
+                info = nullptr;
             }
             break;
         default:
             if (KMessageBox::No == KMessageBox::questionYesNo(nullptr, i18n("An error was found. Do you want to resend it?"), i18n("Error found"))) {
                 removeLaterInfo(info);
+                info = nullptr;
             }
             break;
         }
+        if (info) {
+            // Don't fail again right away
+            schedule(info, QDateTime::currentDateTime().addMSecs(retryDelay));
+        }
     }
-    recreateSendList();
-}
-
-void SendLaterManager::recreateSendList()
-{
-    mCurrentJob = nullptr;
     Q_EMIT needUpdateConfigDialogBox();
-    QTimer::singleShot(1000 * 60, this, &SendLaterManager::createSendInfoList);
+    dispatch();
+    updateTimer();
 }
 
 void SendLaterManager::sendDone(SendLater::SendLaterInfo *info)
 {
     if (info) {
+        mRunningJobs.remove(info->itemId());
         if (info->isRecurrence()) {
-            SendLater::SendLaterUtil::changeRecurrentDate(info);
+            updateRecurrence(info);
+            schedule(info, info->dateTime());
         } else {
             removeLaterInfo(info);
         }
     }
-    recreateSendList();
+    Q_EMIT needUpdateConfigDialogBox();
+    dispatch();
+    updateTimer();
+}
+
+void SendLaterManager::updateRecurrence(SendLater::SendLaterInfo *info)
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    const int each = qMax(1, info->recurrenceEachValue());
+    QDateTime next = info->dateTime();
+    do {
+        switch (info->recurrenceUnit()) {
+        case SendLater::SendLaterInfo::Weeks:
+            next = next.addDays(each * 7);
+            break;
+        case SendLater::SendLaterInfo::Months:
+            next = next.addMonths(each);
+            break;
+        case SendLater::SendLaterInfo::Years:
+            next = next.addYears(each);
+            break;
+        case SendLater::SendLaterInfo::Days:
+        default:
+            next = next.addDays(each);
+            break;
+        }
+    } while (next <= now);
+    info->setDateTime(next);
+    info->setLastDateTimeSend(now);
+    SendLaterStore::self()->save(info);
 }
 
 void SendLaterManager::removeLaterInfo(SendLater::SendLaterInfo *info)
 {
-    mListSendLaterInfo.removeAll(mCurrentInfo);
     removeInfo(info->itemId());
+    delete info;
 }
 
 QString SendLaterManager::printDebugInfo()
 {
-    QString infoStr;
-    if (mListSendLaterInfo.isEmpty()) {
-        infoStr = QStringLiteral("No mail");
+    QString infoStr = QStringLiteral("Sending: %1 (maximum %2), due and waiting: %3, scheduled: %4\n")
+                      .arg(mRunningJobs.count()).arg(mMaximumRunningJobs).arg(mSendLaterQueue.count()).arg(mTimerWheel.count());
+    if (mLagCount > 0) {
+        infoStr += QStringLiteral("Lag between due and send time: last %1 ms, average %2 ms, maximum %3 ms (%4 messages)\n")
+                   .arg(mLastLag).arg(mTotalLag / mLagCount).arg(mMaximumLag).arg(mLagCount);
+    }
+
+    QList<SendLater::SendLaterInfo *> infos = mSendLaterInfos.values();
+    std::sort(infos.begin(), infos.end(), SendLater::SendLaterUtil::compareSendLaterInfo);
+    if (infos.isEmpty() && mRunningJobs.isEmpty()) {
+        infoStr += QStringLiteral("No mail");
     } else {
-        for (SendLater::SendLaterInfo *info : qAsConst(mListSendLaterInfo)) {
-            if (!infoStr.isEmpty()) {
-                infoStr += QLatin1Char('\n');
-            }
-            infoStr += infoToStr(info);
+        for (const RunningJob &running : qAsConst(mRunningJobs)) {
+            infoStr += QLatin1String("\nSending: ") + infoToStr(running.info);
+        }
+        for (SendLater::SendLaterInfo *info : qAsConst(infos)) {
+            infoStr += QLatin1Char('\n') + infoToStr(info);
         }
     }
     return infoStr;
@@ -20,6 +20,9 @@
 #ifndef SENDLATERMANAGER_H
 #define SENDLATERMANAGER_H
 
+#include "sendlatertimerwheel.h"
+
+#include <QHash>
 #include <QObject>
 #include <QQueue>
 
@@ -64,6 +67,12 @@ public:
 
     void sendNow(Akonadi::Item::Id id);
 
+    /**
+     * Sets how many messages can be sent at the same time.
+     */
+    void setMaximumRunningJobs(int count);
+    int maximumRunningJobs() const;
+
 Q_SIGNALS:
     void needUpdateConfigDialogBox();
 
@@ -72,21 +81,40 @@ public Q_SLOTS:
 
 private:
     Q_DISABLE_COPY(SendLaterManager)
-    void slotCreateJob();
-    void createSendInfoList();
+    struct RunningJob {
+        SendLaterJob *job = nullptr;
+        SendLater::SendLaterInfo *info = nullptr;
+    };
+
+    void slotTimeout();
+    void schedule(SendLater::SendLaterInfo *info, const QDateTime &dateTime);
+    void unschedule(Akonadi::Item::Id id);
+    void dispatch();
+    void startJob(SendLater::SendLaterInfo *info);
+    void updateTimer();
     QString infoToStr(SendLater::SendLaterInfo *info);
+    void updateRecurrence(SendLater::SendLaterInfo *info);
     void removeLaterInfo(SendLater::SendLaterInfo *info);
     SendLater::SendLaterInfo *searchInfo(Akonadi::Item::Id id);
-    void recreateSendList();
     void stopTimer();
     void removeInfo(Akonadi::Item::Id id);
     KSharedConfig::Ptr mConfig;
-    QList<SendLater::SendLaterInfo *> mListSendLaterInfo;
-    SendLater::SendLaterInfo *mCurrentInfo = nullptr;
-    SendLaterJob *mCurrentJob = nullptr;
+    // Scheduled messages, the running ones are in mRunningJobs
+    QHash<Akonadi::Item::Id, SendLater::SendLaterInfo *> mSendLaterInfos;
+    QHash<Akonadi::Item::Id, RunningJob> mRunningJobs;
+    SendLaterTimerWheel mTimerWheel;
     QTimer *mTimer = nullptr;
     MessageComposer::AkonadiSender *mSender = nullptr;
+    // Due messages waiting for a free job
     QQueue<Akonadi::Item::Id> mSendLaterQueue;
+    int mMaximumRunningJobs = 4;
+    bool mActive = false;
+
+    // Delay between due time and actual start of sending
+    qint64 mLagCount = 0;
+    qint64 mTotalLag = 0;
+    qint64 mMaximumLag = 0;
+    qint64 mLastLag = 0;
 };
 
 #endif // SENDLATERMANAGER_H
@@ -0,0 +1,168 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "sendlaterstore.h"
+#include "sendlaterinfo.h"
+#include "sendlateragent_debug.h"
+
+#include <KConfigGroup>
+
+#include <QDataStream>
+#include <QRegularExpression>
+
+namespace {
+const quint8 infoVersion = 1;
+}
+
+Q_GLOBAL_STATIC_WITH_ARGS(SendLaterStore, s_sendLaterStore, (AgentStateStore::defaultFileName(QStringLiteral("sendlater.store"))))
+
+SendLaterStore::SendLaterStore(const QString &fileName)
+    : mStore(fileName)
+{
+    if (!mStore.open()) {
+        qCWarning(SENDLATERAGENT_LOG) << "Changes to the scheduled messages can't be saved in" << fileName;
+    }
+}
+
+SendLaterStore::~SendLaterStore()
+{
+}
+
+SendLaterStore *SendLaterStore::self()
+{
+    return s_sendLaterStore;
+}
+
+QList<SendLater::SendLaterInfo *> SendLaterStore::infos() const
+{
+    QList<SendLater::SendLaterInfo *> lst;
+    lst.reserve(mStore.count());
+    const QHash<qint64, QByteArray> &values = mStore.values();
+    for (auto it = values.cbegin(), end = values.cend(); it != end; ++it) {
+        if (SendLater::SendLaterInfo *info = deserialize(it.value())) {
+            lst.append(info);
+        }
+    }
+    return lst;
+}
+
+SendLater::SendLaterInfo *SendLaterStore::info(Akonadi::Item::Id id) const
+{
+    if (!mStore.contains(id)) {
+        return nullptr;
+    }
+    return deserialize(mStore.value(id));
+}
+
+bool SendLaterStore::contains(Akonadi::Item::Id id) const
+{
+    return mStore.contains(id);
+}
+
+int SendLaterStore::count() const
+{
+    return mStore.count();
+}
+
+void SendLaterStore::save(const SendLater::SendLaterInfo *info)
+{
+    if (!info || !info->isValid()) {
+        return;
+    }
+    mStore.insert(info->itemId(), serialize(*info));
+}
+
+void SendLaterStore::remove(Akonadi::Item::Id id)
+{
+    mStore.remove(id);
+}
+
+QList<Akonadi::Item::Id> SendLaterStore::importConfig(const KSharedConfig::Ptr &config)
+{
+    QList<Akonadi::Item::Id> ids;
+    const QStringList itemList = config->groupList().filter(QRegularExpression(QStringLiteral("SendLaterItem \\d+")));
+    if (itemList.isEmpty()) {
+        return ids;
+    }
+    for (const QString &groupName : itemList) {
+        KConfigGroup group = config->group(groupName);
+        const SendLater::SendLaterInfo info(group);
+        if (info.isValid()) {
+            save(&info);
+            ids.append(info.itemId());
+        }
+        config->deleteGroup(groupName);
+    }
+    // One write for all imported groups
+    config->sync();
+    qCDebug(SENDLATERAGENT_LOG) << "Imported" << ids.count() << "scheduled messages from" << config->name();
+    return ids;
+}
+
+QByteArray SendLaterStore::serialize(const SendLater::SendLaterInfo &info)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_9);
+    stream << infoVersion
+           << info.itemId()
+           << info.isRecurrence()
+           << qint32(info.recurrenceUnit())
+           << qint32(info.recurrenceEachValue())
+           << info.dateTime()
+           << info.lastDateTimeSend()
+           << info.subject()
+           << info.to();
+    return data;
+}
+
+SendLater::SendLaterInfo *SendLaterStore::deserialize(const QByteArray &data)
+{
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_9);
+    quint8 version = 0;
+    stream >> version;
+    if (version != infoVersion) {
+        qCWarning(SENDLATERAGENT_LOG) << "Unknown scheduled message version" << version;
+        return nullptr;
+    }
+    qint64 itemId = -1;
+    bool recurrence = false;
+    qint32 unit = 0;
+    qint32 eachValue = 1;
+    QDateTime dateTime;
+    QDateTime lastDateTimeSend;
+    QString subject;
+    QString to;
+    stream >> itemId >> recurrence >> unit >> eachValue >> dateTime >> lastDateTimeSend >> subject >> to;
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(SENDLATERAGENT_LOG) << "Corrupted scheduled message";
+        return nullptr;
+    }
+    SendLater::SendLaterInfo *info = new SendLater::SendLaterInfo;
+    info->setItemId(itemId);
+    info->setRecurrence(recurrence);
+    info->setRecurrenceUnit(static_cast<SendLater::SendLaterInfo::RecurrenceUnit>(unit));
+    info->setRecurrenceEachValue(eachValue);
+    info->setDateTime(dateTime);
+    info->setLastDateTimeSend(lastDateTimeSend);
+    info->setSubject(subject);
+    info->setTo(to);
+    return info;
+}
@@ -0,0 +1,79 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef SENDLATERSTORE_H
+#define SENDLATERSTORE_H
+
+#include "agentstatestore.h"
+
+#include <Item>
+
+#include <KSharedConfig>
+
+namespace SendLater {
+class SendLaterInfo;
+}
+
+/**
+ * @short The messages scheduled by the send later agent.
+ *
+ * The infos are kept in an AgentStateStore indexed by item id, so saving or
+ * removing one message only writes that message. The composer still writes
+ * new messages as "SendLaterItem" groups into the agent configuration, they
+ * are moved into the store by importConfig().
+ */
+class SendLaterStore
+{
+public:
+    explicit SendLaterStore(const QString &fileName);
+    ~SendLaterStore();
+
+    static SendLaterStore *self();
+
+    /**
+     * Returns copies of all stored infos, owned by the caller.
+     */
+    QList<SendLater::SendLaterInfo *> infos() const;
+
+    /**
+     * Returns a copy of the info of @p id owned by the caller, or nullptr.
+     */
+    SendLater::SendLaterInfo *info(Akonadi::Item::Id id) const;
+
+    bool contains(Akonadi::Item::Id id) const;
+    int count() const;
+
+    void save(const SendLater::SendLaterInfo *info);
+    void remove(Akonadi::Item::Id id);
+
+    /**
+     * Moves the "SendLaterItem" groups of @p config into the store and
+     * returns the ids of the imported messages.
+     */
+    QList<Akonadi::Item::Id> importConfig(const KSharedConfig::Ptr &config);
+
+    static QByteArray serialize(const SendLater::SendLaterInfo &info);
+    static SendLater::SendLaterInfo *deserialize(const QByteArray &data);
+
+private:
+    Q_DISABLE_COPY(SendLaterStore)
+    AgentStateStore mStore;
+};
+
+#endif // SENDLATERSTORE_H
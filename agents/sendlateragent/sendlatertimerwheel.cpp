@@ -0,0 +1,202 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "sendlatertimerwheel.h"
+
+#include <algorithm>
+
+SendLaterTimerWheel::SendLaterTimerWheel(qint64 resolution, int slotCount)
+    : mSlots(qMax(1, slotCount))
+    , mResolution(qMax<qint64>(1, resolution))
+{
+}
+
+qint64 SendLaterTimerWheel::tickOf(qint64 time) const
+{
+    return time / mResolution;
+}
+
+qint64 SendLaterTimerWheel::dueTickOf(qint64 dueTime) const
+{
+    // Rounded up, so that a message is never taken before its due time
+    return (dueTime + mResolution - 1) / mResolution;
+}
+
+void SendLaterTimerWheel::insert(Akonadi::Item::Id id, qint64 dueTime)
+{
+    remove(id);
+    mDueTimes.insert(id, dueTime);
+    insertEntry({id, dueTime});
+}
+
+void SendLaterTimerWheel::insertEntry(const Entry &entry)
+{
+    const qint64 tick = dueTickOf(entry.dueTime);
+    if (tick < mCursor) {
+        // Already due, taken by the next call to takeDue()
+        mOverdue.append(entry);
+    } else if (tick - mCursor < mSlots.count()) {
+        mSlots[tick % mSlots.count()].append(entry);
+        ++mWheelCount;
+    } else {
+        mOverflow.insert(entry.dueTime, entry.id);
+    }
+}
+
+bool SendLaterTimerWheel::remove(Akonadi::Item::Id id)
+{
+    const auto it = mDueTimes.find(id);
+    if (it == mDueTimes.end()) {
+        return false;
+    }
+    const qint64 dueTime = it.value();
+    mDueTimes.erase(it);
+
+    // Same rule as insertEntry(), which still holds as the cursor moves
+    const qint64 tick = dueTickOf(dueTime);
+    if (tick < mCursor) {
+        for (int i = 0, total = mOverdue.count(); i < total; ++i) {
+            if (mOverdue.at(i).id == id) {
+                mOverdue.remove(i);
+                break;
+            }
+        }
+    } else if (tick - mCursor < mSlots.count()) {
+        QVector<Entry> &slot = mSlots[tick % mSlots.count()];
+        for (int i = 0, total = slot.count(); i < total; ++i) {
+            if (slot.at(i).id == id) {
+                slot.remove(i);
+                --mWheelCount;
+                break;
+            }
+        }
+    } else {
+        mOverflow.remove(dueTime, id);
+    }
+    return true;
+}
+
+bool SendLaterTimerWheel::contains(Akonadi::Item::Id id) const
+{
+    return mDueTimes.contains(id);
+}
+
+qint64 SendLaterTimerWheel::dueTime(Akonadi::Item::Id id) const
+{
+    return mDueTimes.value(id, -1);
+}
+
+void SendLaterTimerWheel::cascade()
+{
+    const qint64 horizon = mCursor + mSlots.count();
+    while (!mOverflow.isEmpty() && dueTickOf(mOverflow.firstKey()) < horizon) {
+        const auto first = mOverflow.begin();
+        const Entry entry = {first.value(), first.key()};
+        mOverflow.erase(first);
+        insertEntry(entry);
+    }
+}
+
+QVector<Akonadi::Item::Id> SendLaterTimerWheel::takeDue(qint64 now)
+{
+    const qint64 nowTick = tickOf(now);
+    QVector<Entry> due = mOverdue;
+    mOverdue.clear();
+    if (nowTick - mCursor >= mSlots.count()) {
+        // Turned more than once since the last call (e.g. after a suspend),
+        // everything in the wheel is due.
+        for (QVector<Entry> &slot : mSlots) {
+            due += slot;
+            slot.clear();
+        }
+        mWheelCount = 0;
+        while (!mOverflow.isEmpty() && dueTickOf(mOverflow.firstKey()) <= nowTick) {
+            const auto first = mOverflow.begin();
+            due.append({first.value(), first.key()});
+            mOverflow.erase(first);
+        }
+        mCursor = nowTick + 1;
+        cascade();
+    } else {
+        while (mCursor <= nowTick) {
+            QVector<Entry> &slot = mSlots[mCursor % mSlots.count()];
+            mWheelCount -= slot.count();
+            due += slot;
+            slot.clear();
+            ++mCursor;
+            cascade();
+        }
+    }
+
+    std::stable_sort(due.begin(), due.end(), [](const Entry &left, const Entry &right) {
+        return left.dueTime < right.dueTime;
+    });
+    QVector<Akonadi::Item::Id> ids;
+    ids.reserve(due.count());
+    for (const Entry &entry : qAsConst(due)) {
+        mDueTimes.remove(entry.id);
+        ids.append(entry.id);
+    }
+    return ids;
+}
+
+qint64 SendLaterTimerWheel::nextDueTime() const
+{
+    if (!mOverdue.isEmpty()) {
+        qint64 next = mOverdue.first().dueTime;
+        for (const Entry &entry : mOverdue) {
+            next = qMin(next, entry.dueTime);
+        }
+        return next;
+    }
+    if (mWheelCount > 0) {
+        for (int i = 0, total = mSlots.count(); i < total; ++i) {
+            if (!mSlots.at((mCursor + i) % total).isEmpty()) {
+                return (mCursor + i) * mResolution;
+            }
+        }
+    }
+    return mOverflow.isEmpty() ? -1 : dueTickOf(mOverflow.firstKey()) * mResolution;
+}
+
+int SendLaterTimerWheel::count() const
+{
+    return mDueTimes.count();
+}
+
+bool SendLaterTimerWheel::isEmpty() const
+{
+    return mDueTimes.isEmpty();
+}
+
+void SendLaterTimerWheel::clear()
+{
+    for (QVector<Entry> &slot : mSlots) {
+        slot.clear();
+    }
+    mOverdue.clear();
+    mOverflow.clear();
+    mDueTimes.clear();
+    mWheelCount = 0;
+}
+
+qint64 SendLaterTimerWheel::resolution() const
+{
+    return mResolution;
+}
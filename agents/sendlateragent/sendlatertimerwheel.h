@@ -0,0 +1,92 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef SENDLATERTIMERWHEEL_H
+#define SENDLATERTIMERWHEEL_H
+
+#include <Item>
+
+#include <QHash>
+#include <QMultiMap>
+#include <QVector>
+
+/**
+ * @short Keeps the scheduled messages ordered by due time.
+ *
+ * A hashed timer wheel: the near future is divided into slots of
+ * resolution() milliseconds, so inserting, removing and taking due
+ * messages cost O(1) per message whatever the number of scheduled ones.
+ * Messages due beyond the wheel are kept aside in a sorted overflow and
+ * moved into the wheel as it turns.
+ *
+ * A message goes into the slot its due time rounds up to, so it is never
+ * taken before its due time, at worst one resolution() after it.
+ *
+ * Times are in milliseconds since the epoch.
+ */
+class SendLaterTimerWheel
+{
+public:
+    explicit SendLaterTimerWheel(qint64 resolution = 1000, int slotCount = 4096);
+
+    void insert(Akonadi::Item::Id id, qint64 dueTime);
+    bool remove(Akonadi::Item::Id id);
+    bool contains(Akonadi::Item::Id id) const;
+    qint64 dueTime(Akonadi::Item::Id id) const;
+
+    /**
+     * Removes and returns the messages due at @p now, earliest first.
+     */
+    QVector<Akonadi::Item::Id> takeDue(qint64 now);
+
+    /**
+     * Returns the earliest time takeDue() returns messages at, or -1 if
+     * nothing is scheduled.
+     */
+    qint64 nextDueTime() const;
+
+    int count() const;
+    bool isEmpty() const;
+    void clear();
+
+    qint64 resolution() const;
+
+private:
+    struct Entry {
+        Akonadi::Item::Id id;
+        qint64 dueTime;
+    };
+
+    qint64 tickOf(qint64 time) const;
+    qint64 dueTickOf(qint64 dueTime) const;
+    void insertEntry(const Entry &entry);
+    void cascade();
+
+    QVector<QVector<Entry> > mSlots;
+    // inserted after their slot was taken
+    QVector<Entry> mOverdue;
+    QMultiMap<qint64, Akonadi::Item::Id> mOverflow;
+    QHash<Akonadi::Item::Id, qint64> mDueTimes;
+    qint64 mResolution;
+    // first tick not taken yet
+    qint64 mCursor = 0;
+    int mWheelCount = 0;
+};
+
+#endif // SENDLATERTIMERWHEEL_H
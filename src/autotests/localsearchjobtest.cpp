@@ -0,0 +1,69 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "localsearchjobtest.h"
+#include "../searchdialog/localsearchjob.h"
+
+#include <QThread>
+#include <qtest.h>
+
+using namespace MailCommon;
+
+LocalSearchJobTest::LocalSearchJobTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+LocalSearchJobTest::~LocalSearchJobTest()
+{
+}
+
+void LocalSearchJobTest::shouldHaveDefaultValue()
+{
+    KMail::LocalSearchJob job{SearchPattern()};
+    QCOMPARE(job.workerCount(), QThread::idealThreadCount());
+    job.setWorkerCount(0);
+    QCOMPARE(job.workerCount(), 1);
+}
+
+void LocalSearchJobTest::shouldDetectThreadSafePatterns_data()
+{
+    QTest::addColumn<QByteArray>("field");
+    QTest::addColumn<int>("function");
+    QTest::addColumn<bool>("threadSafe");
+    QTest::newRow("subject") << QByteArrayLiteral("subject") << int(SearchRule::FuncContains) << true;
+    QTest::newRow("body") << QByteArrayLiteral("<body>") << int(SearchRule::FuncContains) << true;
+    QTest::newRow("status") << QByteArrayLiteral("<status>") << int(SearchRule::FuncContains) << true;
+    QTest::newRow("tag") << QByteArrayLiteral("<tag>") << int(SearchRule::FuncContains) << false;
+    QTest::newRow("addressbook") << QByteArrayLiteral("from") << int(SearchRule::FuncIsInAddressbook) << false;
+    QTest::newRow("category") << QByteArrayLiteral("from") << int(SearchRule::FuncIsInCategory) << false;
+}
+
+void LocalSearchJobTest::shouldDetectThreadSafePatterns()
+{
+    QFETCH(QByteArray, field);
+    QFETCH(int, function);
+    QFETCH(bool, threadSafe);
+
+    SearchPattern pattern;
+    pattern.append(SearchRule::createInstance(field, static_cast<SearchRule::Function>(function), QStringLiteral("foo")));
+    QCOMPARE(KMail::LocalSearchJob::isThreadSafe(pattern), threadSafe);
+}
+
+QTEST_MAIN(LocalSearchJobTest)
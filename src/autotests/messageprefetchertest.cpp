@@ -0,0 +1,132 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "messageprefetchertest.h"
+#include "../messageprefetcher.h"
+
+#include <AkonadiCore/EntityTreeModel>
+
+#include <QStandardItemModel>
+#include <qtest.h>
+
+namespace {
+QStandardItem *messageRow(Akonadi::Item::Id id)
+{
+    QStandardItem *row = new QStandardItem(QString::number(id));
+    row->setData(QVariant::fromValue(Akonadi::Item(id)), Akonadi::EntityTreeModel::ItemRole);
+    return row;
+}
+
+QList<Akonadi::Item::Id> ids(const Akonadi::Item::List &items)
+{
+    QList<Akonadi::Item::Id> result;
+    for (const Akonadi::Item &item : items) {
+        result.append(item.id());
+    }
+    return result;
+}
+}
+
+MessagePrefetcherTest::MessagePrefetcherTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+MessagePrefetcherTest::~MessagePrefetcherTest()
+{
+}
+
+void MessagePrefetcherTest::shouldReturnNoNeighboursForInvalidIndex()
+{
+    QVERIFY(KMail::MessagePrefetcher::neighbours(QModelIndex(), 2, 2).isEmpty());
+}
+
+void MessagePrefetcherTest::shouldReturnClosestNeighboursFirst()
+{
+    QStandardItemModel model;
+    for (int i = 1; i <= 6; ++i) {
+        model.appendRow(messageRow(i));
+    }
+    const QModelIndex current = model.index(2, 0);
+    QCOMPARE(ids(KMail::MessagePrefetcher::neighbours(current, 2, 2)), QList<Akonadi::Item::Id>() << 4 << 2 << 5 << 1);
+    QCOMPARE(ids(KMail::MessagePrefetcher::neighbours(current, 1, 3)), QList<Akonadi::Item::Id>() << 4 << 2 << 5 << 6);
+    QCOMPARE(ids(KMail::MessagePrefetcher::neighbours(current, 0, 1)), QList<Akonadi::Item::Id>() << 4);
+}
+
+void MessagePrefetcherTest::shouldWalkThreadsInDisplayOrder()
+{
+    // 1
+    // 2
+    // +- 3
+    //    +- 4
+    // 5
+    QStandardItemModel model;
+    model.appendRow(messageRow(1));
+    QStandardItem *thread = messageRow(2);
+    QStandardItem *reply = messageRow(3);
+    reply->appendRow(messageRow(4));
+    thread->appendRow(reply);
+    model.appendRow(thread);
+    model.appendRow(messageRow(5));
+
+    const QModelIndex threadIndex = model.index(1, 0);
+    QCOMPARE(ids(KMail::MessagePrefetcher::neighbours(threadIndex, 1, 3)), QList<Akonadi::Item::Id>() << 3 << 1 << 4 << 5);
+
+    const QModelIndex lastIndex = model.index(2, 0);
+    QCOMPARE(ids(KMail::MessagePrefetcher::neighbours(lastIndex, 2, 0)), QList<Akonadi::Item::Id>() << 4 << 3);
+
+    const QModelIndex deepIndex = model.index(0, 0, model.index(0, 0, threadIndex));
+    QCOMPARE(ids(KMail::MessagePrefetcher::neighbours(deepIndex, 1, 1)), QList<Akonadi::Item::Id>() << 5 << 3);
+}
+
+void MessagePrefetcherTest::shouldSkipRowsWithoutMessage()
+{
+    // Group headers like "Today" don't carry a message
+    QStandardItemModel model;
+    QStandardItem *today = new QStandardItem(QStringLiteral("Today"));
+    today->appendRow(messageRow(1));
+    today->appendRow(messageRow(2));
+    QStandardItem *yesterday = new QStandardItem(QStringLiteral("Yesterday"));
+    yesterday->appendRow(messageRow(3));
+    model.appendRow(today);
+    model.appendRow(yesterday);
+
+    const QModelIndex current = model.index(1, 0, model.index(0, 0));
+    QCOMPARE(ids(KMail::MessagePrefetcher::neighbours(current, 2, 2)), QList<Akonadi::Item::Id>() << 3 << 1);
+}
+
+void MessagePrefetcherTest::shouldStopAtModelBoundaries()
+{
+    QStandardItemModel model;
+    model.appendRow(messageRow(1));
+    model.appendRow(messageRow(2));
+    QCOMPARE(ids(KMail::MessagePrefetcher::neighbours(model.index(0, 0), 3, 3)), QList<Akonadi::Item::Id>() << 2);
+    QCOMPARE(ids(KMail::MessagePrefetcher::neighbours(model.index(1, 0), 3, 3)), QList<Akonadi::Item::Id>() << 1);
+}
+
+void MessagePrefetcherTest::shouldNotReturnCachedItemByDefault()
+{
+    KMail::MessagePrefetcher prefetcher;
+    QVERIFY(!prefetcher.cachedItem(42).isValid());
+    // Items without payload are not cached
+    prefetcher.setCurrent(Akonadi::Item(42), QModelIndex());
+    QVERIFY(!prefetcher.cachedItem(42).isValid());
+}
+
+QTEST_MAIN(MessagePrefetcherTest)
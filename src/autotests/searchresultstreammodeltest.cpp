@@ -0,0 +1,124 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "searchresultstreammodeltest.h"
+#include "../searchdialog/searchresultstreammodel.h"
+#include "../searchdialog/kmsearchmessagemodel.h"
+
+#include <AkonadiCore/EntityTreeModel>
+#include <AkonadiCore/ItemModel>
+#include <KMime/Message>
+#include <QSignalSpy>
+#include <qtest.h>
+
+namespace {
+Akonadi::Item createItem(Akonadi::Item::Id id, const QString &subject)
+{
+    KMime::Message::Ptr msg(new KMime::Message);
+    msg->subject()->fromUnicodeString(subject, "utf-8");
+    msg->from()->fromUnicodeString(QStringLiteral("sender@example.org"), "utf-8");
+    msg->to()->fromUnicodeString(QStringLiteral("receiver@example.org"), "utf-8");
+    msg->date()->setDateTime(QDateTime(QDate(2018, 3, 1), QTime(12, 0)));
+    msg->assemble();
+
+    Akonadi::Item item(id);
+    item.setMimeType(KMime::Message::mimeType());
+    item.setParentCollection(Akonadi::Collection(42));
+    item.setSize(1024);
+    item.setPayload<KMime::Message::Ptr>(msg);
+    return item;
+}
+}
+
+SearchResultStreamModelTest::SearchResultStreamModelTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+SearchResultStreamModelTest::~SearchResultStreamModelTest()
+{
+}
+
+void SearchResultStreamModelTest::shouldBeEmptyByDefault()
+{
+    KMail::SearchResultStreamModel model;
+    QCOMPARE(model.rowCount(), 0);
+    QCOMPARE(model.columnCount(), KMSearchMessageModel::Size + 1);
+    QVERIFY(!model.item(0).isValid());
+}
+
+void SearchResultStreamModelTest::shouldAppendItems()
+{
+    KMail::SearchResultStreamModel model;
+    QSignalSpy spy(&model, &QAbstractItemModel::rowsInserted);
+    model.addItems(Akonadi::Item::List() << createItem(1, QStringLiteral("foo")) << createItem(2, QStringLiteral("bar")));
+    QCOMPARE(model.rowCount(), 2);
+    QCOMPARE(spy.count(), 1);
+    model.addItems(Akonadi::Item::List() << createItem(3, QStringLiteral("baz")));
+    QCOMPARE(model.rowCount(), 3);
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(spy.at(1).at(1).toInt(), 2);
+
+    QCOMPARE(model.index(1, KMSearchMessageModel::Subject).data().toString(), QStringLiteral("bar"));
+    QCOMPARE(model.index(1, KMSearchMessageModel::Sender).data().toString(), QStringLiteral("sender@example.org"));
+    QCOMPARE(model.index(1, KMSearchMessageModel::Receiver).data().toString(), QStringLiteral("receiver@example.org"));
+    QCOMPARE(model.index(1, KMSearchMessageModel::Date).data(Qt::EditRole).toDateTime().date(), QDate(2018, 3, 1));
+    QCOMPARE(model.index(1, KMSearchMessageModel::Size).data(Qt::EditRole).toLongLong(), 1024ll);
+}
+
+void SearchResultStreamModelTest::shouldIgnoreKnownItems()
+{
+    KMail::SearchResultStreamModel model;
+    model.addItems(Akonadi::Item::List() << createItem(1, QStringLiteral("foo")));
+    QSignalSpy spy(&model, &QAbstractItemModel::rowsInserted);
+    model.addItems(Akonadi::Item::List() << createItem(1, QStringLiteral("foo")));
+    QCOMPARE(model.rowCount(), 1);
+    QCOMPARE(spy.count(), 0);
+    model.addItems(Akonadi::Item::List() << createItem(1, QStringLiteral("foo")) << createItem(2, QStringLiteral("bar")));
+    QCOMPARE(model.rowCount(), 2);
+    QCOMPARE(spy.count(), 1);
+}
+
+void SearchResultStreamModelTest::shouldProvideItemRoles()
+{
+    KMail::SearchResultStreamModel model;
+    model.addItems(Akonadi::Item::List() << createItem(7, QStringLiteral("foo")));
+
+    const QModelIndex index = model.index(0, KMSearchMessageModel::Subject);
+    const Akonadi::Item item = index.data(Akonadi::ItemModel::ItemRole).value<Akonadi::Item>();
+    QCOMPARE(item.id(), 7ll);
+    QCOMPARE(item.parentCollection().id(), 42ll);
+    // only the envelope is kept, not the message
+    QVERIFY(!item.hasPayload());
+    QCOMPARE(index.data(Akonadi::EntityTreeModel::ItemRole).value<Akonadi::Item>().id(), 7ll);
+    QCOMPARE(index.data(Akonadi::EntityTreeModel::ItemIdRole).toLongLong(), 7ll);
+    QCOMPARE(model.item(0).id(), 7ll);
+}
+
+void SearchResultStreamModelTest::shouldClear()
+{
+    KMail::SearchResultStreamModel model;
+    model.addItems(Akonadi::Item::List() << createItem(1, QStringLiteral("foo")));
+    model.clear();
+    QCOMPARE(model.rowCount(), 0);
+    model.addItems(Akonadi::Item::List() << createItem(1, QStringLiteral("foo")));
+    QCOMPARE(model.rowCount(), 1);
+}
+
+QTEST_MAIN(SearchResultStreamModelTest)
@@ -0,0 +1,130 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "undostacktest.h"
+#include "../undostack.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <qtest.h>
+
+UndoStackTest::UndoStackTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+UndoStackTest::~UndoStackTest()
+{
+}
+
+void UndoStackTest::shouldBeEmptyByDefault()
+{
+    QTemporaryDir dir;
+    KMail::UndoStack stack(20, dir.path());
+    QVERIFY(stack.isEmpty());
+    QCOMPARE(stack.size(), 0);
+    QVERIFY(stack.undoInfo().isEmpty());
+    QCOMPARE(stack.journalPath(), dir.path());
+}
+
+void UndoStackTest::shouldKeepHistoryAcrossSessions()
+{
+    QTemporaryDir dir;
+    {
+        KMail::UndoStack stack(20, dir.path());
+        const int id = stack.newChangeAction(QStringLiteral("Change Status of 3 Messages"));
+        KMail::UndoChange change;
+        change.addedFlags.insert("\\SEEN");
+        for (Akonadi::Item::Id itemId = 1; itemId <= 3; ++itemId) {
+            stack.addChangeToAction(id, Akonadi::Item(itemId), change);
+        }
+        QCOMPARE(stack.size(), 1);
+    }
+    QCOMPARE(QDir(dir.path()).entryList(QStringList() << QStringLiteral("*.undo")).count(), 1);
+
+    KMail::UndoStack stack(20, dir.path());
+    QCOMPARE(stack.size(), 1);
+    QCOMPARE(stack.undoInfo(), QStringLiteral("Change Status of 3 Messages"));
+
+    // new actions continue after the restored ones
+    const int id = stack.newChangeAction(QStringLiteral("Change Message Tags"));
+    QVERIFY(id > 1);
+    QCOMPARE(stack.undoInfo(), QStringLiteral("Change Message Tags"));
+}
+
+void UndoStackTest::shouldWriteJournalOfOpenAction()
+{
+    QTemporaryDir dir;
+    KMail::UndoStack stack(20, dir.path());
+    const int id = stack.newChangeAction(QStringLiteral("Change Message Tags"));
+    KMail::UndoChange change;
+    change.addedTags << 5;
+    stack.addChangeToAction(id, Akonadi::Item(1), change);
+    change.addedTags << 7;
+    stack.addChangeToAction(id, Akonadi::Item(2), change);
+    // flushed once the command is done, the journal survives a crash
+    QTest::qWait(10);
+
+    KMail::UndoStack restored(20, dir.path());
+    QCOMPARE(restored.size(), 1);
+    QCOMPARE(restored.undoInfo(), QStringLiteral("Change Message Tags"));
+}
+
+void UndoStackTest::shouldLimitNumberOfActions()
+{
+    QTemporaryDir dir;
+    KMail::UndoStack stack(3, dir.path());
+    for (int i = 0; i < 5; ++i) {
+        stack.newChangeAction(QString::number(i));
+    }
+    QCOMPARE(stack.size(), 3);
+    QCOMPARE(stack.undoInfo(), QStringLiteral("4"));
+    QCOMPARE(QDir(dir.path()).entryList(QStringList() << QStringLiteral("*.undo")).count(), 3);
+}
+
+void UndoStackTest::shouldClearJournal()
+{
+    QTemporaryDir dir;
+    {
+        KMail::UndoStack stack(20, dir.path());
+        stack.newChangeAction(QStringLiteral("foo"));
+        stack.newChangeAction(QStringLiteral("bla"));
+        stack.clear();
+        QVERIFY(stack.isEmpty());
+    }
+    QVERIFY(QDir(dir.path()).entryList(QStringList() << QStringLiteral("*.undo")).isEmpty());
+    KMail::UndoStack stack(20, dir.path());
+    QVERIFY(stack.isEmpty());
+}
+
+void UndoStackTest::shouldIgnoreInvalidJournal()
+{
+    QTemporaryDir dir;
+    QFile file(dir.path() + QStringLiteral("/3.undo"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("not a journal");
+    file.close();
+
+    KMail::UndoStack stack(20, dir.path());
+    QVERIFY(stack.isEmpty());
+    QVERIFY(!QFile::exists(file.fileName()));
+}
+
+QTEST_MAIN(UndoStackTest)
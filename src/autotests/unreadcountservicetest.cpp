@@ -0,0 +1,137 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "unreadcountservicetest.h"
+#include "unreadcountservice.h"
+
+#include <AkonadiCore/CollectionStatistics>
+#include <QSignalSpy>
+#include <qtest.h>
+
+namespace {
+Akonadi::Collection createCollection(Akonadi::Collection::Id id, Akonadi::Collection::Id parentId, const QString &name, qint64 unread)
+{
+    Akonadi::Collection collection(id);
+    collection.setName(name);
+    collection.setParentCollection(parentId < 0 ? Akonadi::Collection::root() : Akonadi::Collection(parentId));
+    Akonadi::CollectionStatistics statistics;
+    statistics.setCount(unread * 2);
+    statistics.setUnreadCount(unread);
+    collection.setStatistics(statistics);
+    return collection;
+}
+
+Akonadi::CollectionStatistics createStatistics(qint64 unread)
+{
+    Akonadi::CollectionStatistics statistics;
+    statistics.setCount(100);
+    statistics.setUnreadCount(unread);
+    return statistics;
+}
+}
+
+UnreadCountServiceTest::UnreadCountServiceTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+UnreadCountServiceTest::~UnreadCountServiceTest()
+{
+}
+
+void UnreadCountServiceTest::shouldBeEmptyByDefault()
+{
+    KMail::UnreadCountService service(nullptr);
+    QVERIFY(service.isLoaded());
+    QVERIFY(service.unreadCollections().isEmpty());
+    QCOMPARE(service.unreadCount(1), 0ll);
+    QVERIFY(!service.collection(1).isValid());
+    QVERIFY(service.path(1).isEmpty());
+}
+
+void UnreadCountServiceTest::shouldTrackUnreadCollections()
+{
+    KMail::UnreadCountService service(nullptr);
+    service.updateCollection(createCollection(1, -1, QStringLiteral("Local Folders"), 0));
+    service.updateCollection(createCollection(2, 1, QStringLiteral("inbox"), 3));
+    QCOMPARE(service.unreadCollections().count(), 1);
+    QCOMPARE(service.unreadCount(2), 3ll);
+
+    service.updateStatistics(2, createStatistics(0));
+    QVERIFY(service.unreadCollections().isEmpty());
+    QCOMPARE(service.unreadCount(2), 0ll);
+
+    service.updateStatistics(1, createStatistics(5));
+    QCOMPARE(service.unreadCollections().count(), 1);
+    QCOMPARE(service.unreadCollections().at(0).id(), 1ll);
+    QCOMPARE(service.unreadCount(1), 5ll);
+}
+
+void UnreadCountServiceTest::shouldCoalesceChanges()
+{
+    KMail::UnreadCountService service(nullptr);
+    service.setUpdateInterval(10);
+    QCOMPARE(service.updateInterval(), 10);
+    QSignalSpy spy(&service, &KMail::UnreadCountService::unreadCountsChanged);
+    service.updateCollection(createCollection(1, -1, QStringLiteral("inbox"), 1));
+    for (int i = 2; i < 20; ++i) {
+        service.updateStatistics(1, createStatistics(i));
+    }
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(service.unreadCount(1), 19ll);
+
+    // nothing changed
+    service.updateStatistics(1, createStatistics(19));
+    QVERIFY(!spy.wait(100));
+    QCOMPARE(spy.count(), 1);
+}
+
+void UnreadCountServiceTest::shouldKeepStatisticsOnChange()
+{
+    KMail::UnreadCountService service(nullptr);
+    service.updateCollection(createCollection(1, -1, QStringLiteral("inbox"), 4));
+    Akonadi::Collection renamed(1);
+    renamed.setName(QStringLiteral("Inbox"));
+    service.updateCollection(renamed);
+    QCOMPARE(service.unreadCount(1), 4ll);
+    QCOMPARE(service.collection(1).name(), QStringLiteral("Inbox"));
+}
+
+void UnreadCountServiceTest::shouldReturnPath()
+{
+    KMail::UnreadCountService service(nullptr);
+    service.updateCollection(createCollection(1, -1, QStringLiteral("Local Folders"), 0));
+    service.updateCollection(createCollection(2, 1, QStringLiteral("inbox"), 0));
+    service.updateCollection(createCollection(3, 2, QStringLiteral("lists"), 2));
+    QCOMPARE(service.path(3), QStringList() << QStringLiteral("Local Folders") << QStringLiteral("inbox") << QStringLiteral("lists"));
+    QCOMPARE(service.path(1), QStringList() << QStringLiteral("Local Folders"));
+}
+
+void UnreadCountServiceTest::shouldRemoveCollection()
+{
+    KMail::UnreadCountService service(nullptr);
+    service.updateCollection(createCollection(1, -1, QStringLiteral("inbox"), 2));
+    service.removeCollection(1);
+    QVERIFY(service.unreadCollections().isEmpty());
+    QVERIFY(!service.collection(1).isValid());
+    QCOMPARE(service.unreadCount(1), 0ll);
+}
+
+QTEST_MAIN(UnreadCountServiceTest)
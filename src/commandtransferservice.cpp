@@ -0,0 +1,92 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "commandtransferservice.h"
+#include "kmcommands.h"
+
+using namespace KMail;
+
+Q_GLOBAL_STATIC(CommandTransferService, s_commandTransferService)
+
+CommandTransferService::CommandTransferService(QObject *parent)
+    : QObject(parent)
+{
+}
+
+CommandTransferService::~CommandTransferService()
+{
+}
+
+CommandTransferService *CommandTransferService::self()
+{
+    return s_commandTransferService;
+}
+
+void CommandTransferService::enqueue(KMCommand *command)
+{
+    if (!mQueue.contains(command)) {
+        mQueue.append(command);
+    }
+    dispatch();
+}
+
+void CommandTransferService::remove(KMCommand *command)
+{
+    mQueue.removeAll(command);
+}
+
+void CommandTransferService::jobFinished()
+{
+    if (mRunningJobs > 0) {
+        --mRunningJobs;
+    }
+    dispatch();
+}
+
+void CommandTransferService::setMaximumRunningJobs(int max)
+{
+    mMaximumRunningJobs = qMax(1, max);
+    dispatch();
+}
+
+int CommandTransferService::maximumRunningJobs() const
+{
+    return mMaximumRunningJobs;
+}
+
+int CommandTransferService::runningJobs() const
+{
+    return mRunningJobs;
+}
+
+void CommandTransferService::dispatch()
+{
+    // startTransferJob() enqueues the command again while it has chunks left
+    if (mDispatching) {
+        return;
+    }
+    mDispatching = true;
+    while (mRunningJobs < mMaximumRunningJobs && !mQueue.isEmpty()) {
+        QPointer<KMCommand> command = mQueue.takeFirst();
+        if (command && command->startTransferJob()) {
+            ++mRunningJobs;
+        }
+    }
+    mDispatching = false;
+}
@@ -0,0 +1,78 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef COMMANDTRANSFERSERVICE_H
+#define COMMANDTRANSFERSERVICE_H
+
+#include <QObject>
+#include <QPointer>
+#include <QList>
+
+class KMCommand;
+
+namespace KMail {
+/**
+ * @short Schedules the message transfers of the running commands.
+ *
+ * Each KMCommand fetches its messages in chunks. The service limits the
+ * number of fetch jobs running at the same time and hands the free slots
+ * to the waiting commands in turn, so that a small transfer, e.g. for a
+ * reply, isn't held up by a large one.
+ */
+class CommandTransferService : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CommandTransferService(QObject *parent = nullptr);
+    ~CommandTransferService();
+
+    static CommandTransferService *self();
+
+    /**
+     * Queues @p command to start its next fetch job once a slot is free.
+     */
+    void enqueue(KMCommand *command);
+
+    /**
+     * Removes @p command from the queue, e.g. when its transfer was canceled.
+     */
+    void remove(KMCommand *command);
+
+    /**
+     * Releases the slot of a finished fetch job.
+     */
+    void jobFinished();
+
+    void setMaximumRunningJobs(int max);
+    int maximumRunningJobs() const;
+
+    int runningJobs() const;
+
+private:
+    Q_DISABLE_COPY(CommandTransferService)
+    void dispatch();
+
+    QList<QPointer<KMCommand> > mQueue;
+    int mRunningJobs = 0;
+    int mMaximumRunningJobs = 4;
+    bool mDispatching = false;
+};
+}
+
+#endif // COMMANDTRANSFERSERVICE_H
@@ -70,4 +70,32 @@ void FolderArchiveAccountInfoTest::shouldRestoreFromSettings()
     QCOMPARE(info, restoreInfo);
 }
 
+void FolderArchiveAccountInfoTest::shouldReturnArchiveFolderName_data()
+{
+    QTest::addColumn<int>("type");
+    QTest::addColumn<QDate>("date");
+    QTest::addColumn<QString>("folderName");
+    QTest::addColumn<QDate>("nextPeriodStart");
+    QTest::newRow("unique") << static_cast<int>(FolderArchiveAccountInfo::UniqueFolder) << QDate(2018, 3, 14) << QString() << QDate();
+    QTest::newRow("month") << static_cast<int>(FolderArchiveAccountInfo::FolderByMonths) << QDate(2018, 3, 14) << QStringLiteral("3-2018") << QDate(2018, 4, 1);
+    QTest::newRow("lastmonth") << static_cast<int>(FolderArchiveAccountInfo::FolderByMonths) << QDate(2018, 12, 31) << QStringLiteral("12-2018") << QDate(2019, 1, 1);
+    QTest::newRow("year") << static_cast<int>(FolderArchiveAccountInfo::FolderByYears) << QDate(2018, 3, 14) << QStringLiteral("2018") << QDate(2019, 1, 1);
+}
+
+void FolderArchiveAccountInfoTest::shouldReturnArchiveFolderName()
+{
+    QFETCH(int, type);
+    QFETCH(QDate, date);
+    QFETCH(QString, folderName);
+    QFETCH(QDate, nextPeriodStart);
+    FolderArchiveAccountInfo info;
+    info.setFolderArchiveType(static_cast<FolderArchiveAccountInfo::FolderArchiveType>(type));
+    QCOMPARE(info.archiveFolderName(date), folderName);
+    QCOMPARE(info.nextPeriodStart(date), nextPeriodStart);
+    // the folder of the next period differs from the current one
+    if (nextPeriodStart.isValid()) {
+        QVERIFY(info.archiveFolderName(nextPeriodStart) != folderName);
+    }
+}
+
 QTEST_MAIN(FolderArchiveAccountInfoTest)
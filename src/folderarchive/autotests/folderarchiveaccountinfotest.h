@@ -32,6 +32,8 @@ private Q_SLOTS:
     void shouldHaveDefaultValue();
     void shouldBeValid();
     void shouldRestoreFromSettings();
+    void shouldReturnArchiveFolderName_data();
+    void shouldReturnArchiveFolderName();
 };
 
 #endif // FOLDERARCHIVEACCOUNTINFOTEST_H
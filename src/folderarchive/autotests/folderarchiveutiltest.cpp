@@ -0,0 +1,112 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+#include "folderarchiveutiltest.h"
+#include "../folderarchiveutil.h"
+#include <qtest.h>
+
+using namespace FolderArchive;
+
+typedef QVector<int> Positions;
+
+namespace {
+Akonadi::Item createItem(Akonadi::Item::Id id, Akonadi::Collection::Id parent)
+{
+    Akonadi::Item item(id);
+    item.setParentCollection(Akonadi::Collection(parent));
+    return item;
+}
+}
+
+FolderArchiveUtilTest::FolderArchiveUtilTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+FolderArchiveUtilTest::~FolderArchiveUtilTest()
+{
+}
+
+void FolderArchiveUtilTest::shouldFallBackToParentCollection()
+{
+    // the storage collection is only known once the item was fetched
+    QCOMPARE(FolderArchiveUtil::storageCollectionId(createItem(1, 10)), Akonadi::Collection::Id(10));
+    QCOMPARE(FolderArchiveUtil::storageCollectionId(Akonadi::Item(1)), Akonadi::Collection::Id(-1));
+}
+
+void FolderArchiveUtilTest::shouldGroupItemsByResource()
+{
+    QHash<Akonadi::Collection::Id, QString> resources;
+    resources.insert(10, QStringLiteral("imap"));
+    resources.insert(11, QStringLiteral("imap"));
+    resources.insert(20, QStringLiteral("maildir"));
+
+    const Akonadi::Item::List items = { createItem(1, 10), createItem(2, 20), createItem(3, 11), createItem(4, 20) };
+    Akonadi::Item::List unresolvedItems;
+    const QHash<QString, Akonadi::Item::List> itemsByResource = FolderArchiveUtil::groupItemsByResource(items, resources, unresolvedItems);
+    QVERIFY(unresolvedItems.isEmpty());
+    QCOMPARE(itemsByResource.count(), 2);
+    QCOMPARE(itemsByResource.value(QStringLiteral("imap")), Akonadi::Item::List({ items.at(0), items.at(2) }));
+    QCOMPARE(itemsByResource.value(QStringLiteral("maildir")), Akonadi::Item::List({ items.at(1), items.at(3) }));
+}
+
+void FolderArchiveUtilTest::shouldReportUnresolvedItems()
+{
+    QHash<Akonadi::Collection::Id, QString> resources;
+    resources.insert(10, QStringLiteral("imap"));
+    // folder which couldn't be fetched
+    resources.insert(20, QString());
+
+    const Akonadi::Item::List items = { createItem(1, 10), createItem(2, 20), createItem(3, 30) };
+    Akonadi::Item::List unresolvedItems;
+    const QHash<QString, Akonadi::Item::List> itemsByResource = FolderArchiveUtil::groupItemsByResource(items, resources, unresolvedItems);
+    QCOMPARE(itemsByResource.count(), 1);
+    QCOMPARE(itemsByResource.value(QStringLiteral("imap")), Akonadi::Item::List({ items.at(0) }));
+    QCOMPARE(unresolvedItems, Akonadi::Item::List({ items.at(1), items.at(2) }));
+}
+
+void FolderArchiveUtilTest::shouldStartOneJobPerAccount_data()
+{
+    QTest::addColumn<QStringList>("queuedAccounts");
+    QTest::addColumn<QStringList>("runningAccounts");
+    QTest::addColumn<int>("maximumRunningJobs");
+    QTest::addColumn<Positions>("positions");
+
+    const QString a = QStringLiteral("a");
+    const QString b = QStringLiteral("b");
+    const QString c = QStringLiteral("c");
+    const QString d = QStringLiteral("d");
+    QTest::newRow("empty") << QStringList() << QStringList() << 4 << Positions();
+    QTest::newRow("all") << QStringList({ a, b, c }) << QStringList() << 4 << Positions({ 0, 1, 2 });
+    QTest::newRow("in order per account") << QStringList({ a, a, b, a, c }) << QStringList() << 4 << Positions({ 0, 2, 4 });
+    QTest::newRow("account running") << QStringList({ a, b, a }) << QStringList({ a }) << 4 << Positions({ 1 });
+    QTest::newRow("limit") << QStringList({ a, b, c }) << QStringList() << 2 << Positions({ 0, 1 });
+    QTest::newRow("limit with running") << QStringList({ a, b, c }) << QStringList({ c }) << 2 << Positions({ 0 });
+    QTest::newRow("limit reached") << QStringList({ a, b }) << QStringList({ c, d }) << 2 << Positions();
+}
+
+void FolderArchiveUtilTest::shouldStartOneJobPerAccount()
+{
+    QFETCH(QStringList, queuedAccounts);
+    QFETCH(QStringList, runningAccounts);
+    QFETCH(int, maximumRunningJobs);
+    QFETCH(Positions, positions);
+    QCOMPARE(FolderArchiveUtil::jobsToStart(queuedAccounts, runningAccounts, maximumRunningJobs), positions);
+}
+
+QTEST_MAIN(FolderArchiveUtilTest)
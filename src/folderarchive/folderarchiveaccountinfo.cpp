@@ -88,6 +88,33 @@ bool FolderArchiveAccountInfo::keepExistingStructure() const
     return mKeepExistingStructure;
 }
 
+QString FolderArchiveAccountInfo::archiveFolderName(const QDate &date) const
+{
+    switch (mArchiveType) {
+    case UniqueFolder:
+        break;
+    case FolderByMonths:
+        //TODO translate ?
+        return QStringLiteral("%1-%2").arg(date.month()).arg(date.year());
+    case FolderByYears:
+        return QStringLiteral("%1").arg(date.year());
+    }
+    return QString();
+}
+
+QDate FolderArchiveAccountInfo::nextPeriodStart(const QDate &date) const
+{
+    switch (mArchiveType) {
+    case UniqueFolder:
+        break;
+    case FolderByMonths:
+        return QDate(date.year(), date.month(), 1).addMonths(1);
+    case FolderByYears:
+        return QDate(date.year() + 1, 1, 1);
+    }
+    return QDate();
+}
+
 void FolderArchiveAccountInfo::readConfig(const KConfigGroup &config)
 {
     mInstanceName = config.readEntry(QStringLiteral("instanceName"));
@@ -21,6 +21,7 @@
 
 #include <KConfigGroup>
 #include <AkonadiCore/Collection>
+#include <QDate>
 
 class FolderArchiveAccountInfo
 {
@@ -52,6 +53,18 @@ public:
     void setKeepExistingStructure(bool b);
     bool keepExistingStructure() const;
 
+    /**
+     * Returns the name of the folder receiving the messages archived at
+     * @p date, or an empty string for UniqueFolder.
+     */
+    QString archiveFolderName(const QDate &date) const;
+
+    /**
+     * Returns the first day of the archive period following the one of
+     * @p date, or an invalid date for UniqueFolder.
+     */
+    QDate nextPeriodStart(const QDate &date) const;
+
     void writeConfig(KConfigGroup &config);
     void readConfig(const KConfigGroup &config);
 
@@ -29,7 +29,7 @@
 FolderArchiveAgentCheckCollection::FolderArchiveAgentCheckCollection(FolderArchiveAccountInfo *info, QObject *parent)
     : QObject(parent)
     , mCurrentDate(QDate::currentDate())
-    , mInfo(info)
+    , mInfo(*info)
 {
 }
 
@@ -37,9 +37,19 @@ FolderArchiveAgentCheckCollection::~FolderArchiveAgentCheckCollection()
 {
 }
 
+void FolderArchiveAgentCheckCollection::setDate(const QDate &date)
+{
+    mCurrentDate = date;
+}
+
+QDate FolderArchiveAgentCheckCollection::date() const
+{
+    return mCurrentDate;
+}
+
 void FolderArchiveAgentCheckCollection::start()
 {
-    Akonadi::Collection col(mInfo->archiveTopLevel());
+    Akonadi::Collection col(mInfo.archiveTopLevel());
     Akonadi::CollectionFetchJob *job = new Akonadi::CollectionFetchJob(col, Akonadi::CollectionFetchJob::FirstLevel);
     connect(job, &Akonadi::CollectionFetchJob::result, this, &FolderArchiveAgentCheckCollection::slotInitialCollectionFetchingFirstLevelDone);
 }
@@ -52,19 +62,7 @@ void FolderArchiveAgentCheckCollection::slotInitialCollectionFetchingFirstLevelD
         return;
     }
 
-    QString folderName;
-    switch (mInfo->folderArchiveType()) {
-    case FolderArchiveAccountInfo::UniqueFolder:
-        //Nothing
-        break;
-    case FolderArchiveAccountInfo::FolderByMonths:
-        //TODO translate ?
-        folderName = QStringLiteral("%1-%2").arg(mCurrentDate.month()).arg(mCurrentDate.year());
-        break;
-    case FolderArchiveAccountInfo::FolderByYears:
-        folderName = QStringLiteral("%1").arg(mCurrentDate.year());
-        break;
-    }
+    const QString folderName = mInfo.archiveFolderName(mCurrentDate);
 
     if (folderName.isEmpty()) {
         Q_EMIT checkFailed(i18n("Folder name not defined."));
@@ -85,7 +83,7 @@ void FolderArchiveAgentCheckCollection::slotInitialCollectionFetchingFirstLevelD
 
 void FolderArchiveAgentCheckCollection::createNewFolder(const QString &name)
 {
-    Akonadi::Collection parentCollection(mInfo->archiveTopLevel());
+    Akonadi::Collection parentCollection(mInfo.archiveTopLevel());
     Akonadi::Collection collection;
     collection.setParentCollection(parentCollection);
     collection.setName(name);
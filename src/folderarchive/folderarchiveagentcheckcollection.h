@@ -21,8 +21,8 @@
 #include <QObject>
 #include <AkonadiCore/Collection>
 #include <QDate>
+#include "folderarchiveaccountinfo.h"
 class KJob;
-class FolderArchiveAccountInfo;
 class FolderArchiveAgentCheckCollection : public QObject
 {
     Q_OBJECT
@@ -30,6 +30,13 @@ public:
     explicit FolderArchiveAgentCheckCollection(FolderArchiveAccountInfo *info, QObject *parent = nullptr);
     ~FolderArchiveAgentCheckCollection();
 
+    /**
+     * Looks up, or creates, the archive folder of the period of @p date
+     * instead of the current one.
+     */
+    void setDate(const QDate &date);
+    QDate date() const;
+
     void start();
 
 Q_SIGNALS:
@@ -42,7 +49,7 @@ private:
     void slotCreateNewFolder(KJob *);
     void createNewFolder(const QString &name);
     QDate mCurrentDate;
-    FolderArchiveAccountInfo *mInfo = nullptr;
+    FolderArchiveAccountInfo mInfo;
 };
 
 #endif // FOLDERARCHIVEAGENTCHECKCOLLECTION_H
@@ -33,7 +33,7 @@ FolderArchiveAgentJob::FolderArchiveAgentJob(FolderArchiveManager *manager, Fold
     : QObject(parent)
     , mListItem(lstItem)
     , mManager(manager)
-    , mInfo(info)
+    , mInfo(*info)
 {
 }
 
@@ -41,10 +41,25 @@ FolderArchiveAgentJob::~FolderArchiveAgentJob()
 {
 }
 
+QString FolderArchiveAgentJob::instanceName() const
+{
+    return mInfo.instanceName();
+}
+
+int FolderArchiveAgentJob::itemCount() const
+{
+    return mListItem.count();
+}
+
+void FolderArchiveAgentJob::setParentProgressItem(KPIM::ProgressItem *item)
+{
+    mParentProgressItem = item;
+}
+
 void FolderArchiveAgentJob::start()
 {
-    if (!mInfo->isValid()) {
-        sendError(i18n("Archive folder not defined. Please verify settings for account %1", mInfo->instanceName()));
+    if (!mInfo.isValid()) {
+        sendError(i18n("Archive folder not defined. Please verify settings for account %1", mInfo.instanceName()));
         return;
     }
     if (mListItem.isEmpty()) {
@@ -52,23 +67,31 @@ void FolderArchiveAgentJob::start()
         return;
     }
 
-    if (mInfo->folderArchiveType() == FolderArchiveAccountInfo::UniqueFolder) {
-        Akonadi::CollectionFetchJob *fetchCollection = new Akonadi::CollectionFetchJob(Akonadi::Collection(mInfo->archiveTopLevel()), Akonadi::CollectionFetchJob::Base);
+    if (mInfo.folderArchiveType() == FolderArchiveAccountInfo::UniqueFolder) {
+        Akonadi::CollectionFetchJob *fetchCollection = new Akonadi::CollectionFetchJob(Akonadi::Collection(mInfo.archiveTopLevel()), Akonadi::CollectionFetchJob::Base);
         connect(fetchCollection, &Akonadi::CollectionFetchJob::result, this, &FolderArchiveAgentJob::slotFetchCollection);
     } else {
-        Akonadi::Collection::Id id = mManager->folderArchiveCache()->collectionId(mInfo);
+        mDate = QDate::currentDate();
+        Akonadi::Collection::Id id = mManager->folderArchiveCache()->collectionId(&mInfo, mDate);
         if (id != -1) {
+            mCachedCollectionId = id;
             Akonadi::CollectionFetchJob *fetchCollection = new Akonadi::CollectionFetchJob(Akonadi::Collection(id), Akonadi::CollectionFetchJob::Base);
             connect(fetchCollection, &Akonadi::CollectionFetchJob::result, this, &FolderArchiveAgentJob::slotFetchCollection);
         } else {
-            FolderArchiveAgentCheckCollection *checkCol = new FolderArchiveAgentCheckCollection(mInfo, this);
-            connect(checkCol, &FolderArchiveAgentCheckCollection::collectionIdFound, this, &FolderArchiveAgentJob::slotCollectionIdFound);
-            connect(checkCol, &FolderArchiveAgentCheckCollection::checkFailed, this, &FolderArchiveAgentJob::slotCheckFailed);
-            checkCol->start();
+            checkCollection();
         }
     }
 }
 
+void FolderArchiveAgentJob::checkCollection()
+{
+    FolderArchiveAgentCheckCollection *checkCol = new FolderArchiveAgentCheckCollection(&mInfo, this);
+    checkCol->setDate(mDate);
+    connect(checkCol, &FolderArchiveAgentCheckCollection::collectionIdFound, this, &FolderArchiveAgentJob::slotCollectionIdFound);
+    connect(checkCol, &FolderArchiveAgentCheckCollection::checkFailed, this, &FolderArchiveAgentJob::slotCheckFailed);
+    checkCol->start();
+}
+
 void FolderArchiveAgentJob::slotCheckFailed(const QString &message)
 {
     sendError(i18n("Cannot fetch collection. %1", message));
@@ -76,6 +99,13 @@ void FolderArchiveAgentJob::slotCheckFailed(const QString &message)
 
 void FolderArchiveAgentJob::slotFetchCollection(KJob *job)
 {
+    if (job->error() && mCachedCollectionId != -1) {
+        // The cached folder was removed while we didn't watch, look it up again
+        mManager->folderArchiveCache()->clearCacheWithContainsCollection(mCachedCollectionId);
+        mCachedCollectionId = -1;
+        checkCollection();
+        return;
+    }
     if (job->error()) {
         sendError(i18n("Cannot fetch collection. %1", job->errorString()));
         return;
@@ -91,7 +121,7 @@ void FolderArchiveAgentJob::slotFetchCollection(KJob *job)
 
 void FolderArchiveAgentJob::slotCollectionIdFound(const Akonadi::Collection &col)
 {
-    mManager->folderArchiveCache()->addToCache(mInfo->instanceName(), col.id());
+    mManager->folderArchiveCache()->addToCache(&mInfo, mDate, col.id());
     sloMoveMailsToCollection(col);
 }
 
@@ -99,16 +129,17 @@ void FolderArchiveAgentJob::sloMoveMailsToCollection(const Akonadi::Collection &
 {
     if (Akonadi::Collection::CanCreateItem &col.rights()) {
         KMMoveCommand *command = new KMMoveCommand(col, mListItem, -1);
+        command->setParentProgressItem(mParentProgressItem);
         connect(command, &KMMoveCommand::moveDone, this, &FolderArchiveAgentJob::slotMoveMessages);
         command->start();
     } else {
-        sendError(i18n("This folder %1 is read only. Please verify the configuration of account %2", col.name(), mInfo->instanceName()));
+        sendError(i18n("This folder %1 is read only. Please verify the configuration of account %2", col.name(), mInfo.instanceName()));
     }
 }
 
 void FolderArchiveAgentJob::sendError(const QString &error)
 {
-    mManager->moveFailed(error);
+    mManager->moveFailed(this, error);
 }
 
 void FolderArchiveAgentJob::slotMoveMessages(KMMoveCommand *command)
@@ -116,6 +147,9 @@ void FolderArchiveAgentJob::slotMoveMessages(KMMoveCommand *command)
     if (command->result() == KMCommand::Failed) {
         sendError(i18n("Cannot move messages."));
         return;
+    } else if (command->result() == KMCommand::Canceled) {
+        sendError(i18n("Archiving messages canceled."));
+        return;
     }
-    mManager->moveDone();
+    mManager->moveDone(this);
 }
@@ -21,10 +21,13 @@
 
 #include <QObject>
 #include <AkonadiCore/Item>
+#include "folderarchiveaccountinfo.h"
 class KJob;
-class FolderArchiveAccountInfo;
 class FolderArchiveManager;
 class KMMoveCommand;
+namespace KPIM {
+class ProgressItem;
+}
 class FolderArchiveAgentJob : public QObject
 {
     Q_OBJECT
@@ -34,6 +37,11 @@ public:
 
     void start();
 
+    QString instanceName() const;
+    int itemCount() const;
+
+    void setParentProgressItem(KPIM::ProgressItem *item);
+
 private:
     Q_DISABLE_COPY(FolderArchiveAgentJob)
     void slotFetchCollection(KJob *job);
@@ -43,9 +51,15 @@ private:
     void slotMoveMessages(KMMoveCommand *);
 
     void sendError(const QString &error);
+    void checkCollection();
     Akonadi::Item::List mListItem;
     FolderArchiveManager *mManager = nullptr;
-    FolderArchiveAccountInfo *mInfo = nullptr;
+    KPIM::ProgressItem *mParentProgressItem = nullptr;
+    // archive period of the messages, fixed when the job starts
+    QDate mDate;
+    Akonadi::Collection::Id mCachedCollectionId = -1;
+    // A copy, the manager recreates its infos when the configuration changes
+    FolderArchiveAccountInfo mInfo;
 };
 
 #endif // FOLDERARCHIVEAGENTJOB_H
@@ -19,76 +19,210 @@
 #include "folderarchivecache.h"
 #include "kmail_debug.h"
 #include "folderarchiveaccountinfo.h"
+#include "folderarchiveagentcheckcollection.h"
+#include "folderarchiveutil.h"
+
+#include <KConfigGroup>
+
+#include <QRegularExpression>
+#include <QStandardPaths>
+
+namespace {
+// number of days before the start of a period to create its folder
+static const int PrepareNextPeriodDays = 7;
+
+QString cacheGroupName(const QString &instanceName)
+{
+    return QStringLiteral("FolderArchiveCache ") + instanceName;
+}
+}
 
 FolderArchiveCache::FolderArchiveCache(QObject *parent)
     : QObject(parent)
+    , mConfig(KSharedConfig::openConfig(FolderArchive::FolderArchiveUtil::cacheFileName(), KConfig::SimpleConfig, QStandardPaths::AppDataLocation))
 {
+    load();
 }
 
 FolderArchiveCache::~FolderArchiveCache()
 {
 }
 
+QString FolderArchiveCache::cacheKey(FolderArchiveAccountInfo *info, const QDate &date)
+{
+    const QString folderName = info->archiveFolderName(date);
+    return folderName.isEmpty() ? QStringLiteral("UniqueFolder") : folderName;
+}
+
+void FolderArchiveCache::load()
+{
+    mCache.clear();
+    const QStringList groups = mConfig->groupList().filter(QRegularExpression(QStringLiteral("^FolderArchiveCache ")));
+    for (const QString &groupName : groups) {
+        const KConfigGroup group = mConfig->group(groupName);
+        const QString instanceName = groupName.mid(cacheGroupName(QString()).length());
+        QHash<QString, ArchiveCache> &entries = mCache[instanceName];
+        const QStringList keys = group.groupList();
+        for (const QString &key : keys) {
+            const KConfigGroup entryGroup = group.group(key);
+            ArchiveCache cache;
+            cache.topLevelId = entryGroup.readEntry("topLevelCollectionId", -1);
+            cache.colId = entryGroup.readEntry("collectionId", -1);
+            if (cache.colId > -1) {
+                entries.insert(key, cache);
+            }
+        }
+    }
+}
+
+void FolderArchiveCache::save(const QString &instanceName)
+{
+    KConfigGroup group = mConfig->group(cacheGroupName(instanceName));
+    group.deleteGroup();
+    const QHash<QString, ArchiveCache> entries = mCache.value(instanceName);
+    for (auto it = entries.constBegin(), end = entries.constEnd(); it != end; ++it) {
+        KConfigGroup entryGroup = group.group(it.key());
+        entryGroup.writeEntry("topLevelCollectionId", it.value().topLevelId);
+        entryGroup.writeEntry("collectionId", it.value().colId);
+    }
+    mConfig->sync();
+}
+
 void FolderArchiveCache::clearCache()
 {
+    const QStringList instances = mCache.keys();
     mCache.clear();
+    for (const QString &instanceName : instances) {
+        save(instanceName);
+    }
+}
+
+void FolderArchiveCache::clearCache(const QString &instanceName)
+{
+    if (mCache.remove(instanceName)) {
+        save(instanceName);
+    }
+}
+
+void FolderArchiveCache::removeEntries(const QString &instanceName, const QStringList &keys)
+{
+    QHash<QString, ArchiveCache> &entries = mCache[instanceName];
+    for (const QString &key : keys) {
+        entries.remove(key);
+    }
+    save(instanceName);
 }
 
 void FolderArchiveCache::clearCacheWithContainsCollection(Akonadi::Collection::Id id)
 {
-    QHash<QString, ArchiveCache>::iterator i = mCache.begin();
-    while (i != mCache.end()) {
-        if (i.value().colId == id) {
-            i = mCache.erase(i);
-        } else {
-            ++i;
+    QHash<QString, QStringList> outdated;
+    for (auto it = mCache.constBegin(), end = mCache.constEnd(); it != end; ++it) {
+        for (auto entry = it.value().constBegin(), entryEnd = it.value().constEnd(); entry != entryEnd; ++entry) {
+            if (entry.value().colId == id || entry.value().topLevelId == id) {
+                outdated[it.key()].append(entry.key());
+            }
         }
     }
+    for (auto it = outdated.constBegin(), end = outdated.constEnd(); it != end; ++it) {
+        removeEntries(it.key(), it.value());
+    }
 }
 
-Akonadi::Collection::Id FolderArchiveCache::collectionId(FolderArchiveAccountInfo *info)
+void FolderArchiveCache::collectionChanged(const Akonadi::Collection &collection)
 {
-    //qCDebug(KMAIL_LOG)<<" Look at Cache ";
-    if (mCache.contains(info->instanceName())) {
-        //qCDebug(KMAIL_LOG)<<"instance name : "<<info->instanceName();
-        switch (info->folderArchiveType()) {
-        case FolderArchiveAccountInfo::UniqueFolder:
-            qCDebug(KMAIL_LOG) << "FolderArchiveAccountInfo::UniqueFolder has cache " << mCache.value(info->instanceName()).colId;
-            return mCache.value(info->instanceName()).colId;
-        case FolderArchiveAccountInfo::FolderByMonths:
-            //qCDebug(KMAIL_LOG)<<"FolderArchiveAccountInfo::ByMonths has cache ?";
-            if (mCache.value(info->instanceName()).date.month() != QDate::currentDate().month()) {
-                //qCDebug(KMAIL_LOG)<<"need to remove current cache month is not good";
-                mCache.remove(info->instanceName());
-                return -1;
-            } else {
-                return mCache.value(info->instanceName()).colId;
+    QHash<QString, QStringList> outdated;
+    for (auto it = mCache.constBegin(), end = mCache.constEnd(); it != end; ++it) {
+        for (auto entry = it.value().constBegin(), entryEnd = it.value().constEnd(); entry != entryEnd; ++entry) {
+            if (entry.value().colId != collection.id()) {
+                continue;
             }
-        case FolderArchiveAccountInfo::FolderByYears:
-            //qCDebug(KMAIL_LOG)<<"FolderArchiveAccountInfo::ByYears has cache ?";
-            if (mCache.value(info->instanceName()).date.year() != QDate::currentDate().year()) {
-                //qCDebug(KMAIL_LOG)<<"need to remove current cache year is not good";
-                mCache.remove(info->instanceName());
-                return -1;
-            } else {
-                return mCache.value(info->instanceName()).colId;
+            // Moved out of the top level folder, or renamed
+            const bool moved = collection.parentCollection().isValid() && collection.parentCollection().id() != entry.value().topLevelId;
+            const bool renamed = !collection.name().isEmpty() && collection.name() != entry.key();
+            if (moved || renamed) {
+                outdated[it.key()].append(entry.key());
             }
         }
-        return mCache.value(info->instanceName()).colId;
     }
-    //qCDebug(KMAIL_LOG)<<" Don't have cache for this instancename "<<info->instanceName();
-    return -1;
+    for (auto it = outdated.constBegin(), end = outdated.constEnd(); it != end; ++it) {
+        removeEntries(it.key(), it.value());
+    }
+}
+
+Akonadi::Collection::Id FolderArchiveCache::collectionId(FolderArchiveAccountInfo *info, const QDate &date)
+{
+    const auto instanceIt = mCache.constFind(info->instanceName());
+    if (instanceIt == mCache.constEnd()) {
+        return -1;
+    }
+    const auto it = instanceIt.value().constFind(cacheKey(info, date));
+    if (it == instanceIt.value().constEnd()) {
+        return -1;
+    }
+    // The account was configured with another top level folder since then
+    if (it.value().topLevelId != info->archiveTopLevel()) {
+        qCDebug(KMAIL_LOG) << "Archive folder cache outdated for" << info->instanceName();
+        return -1;
+    }
+    return it.value().colId;
+}
+
+void FolderArchiveCache::addToCache(FolderArchiveAccountInfo *info, const QDate &date, Akonadi::Collection::Id id)
+{
+    const QString key = cacheKey(info, date);
+    QHash<QString, ArchiveCache> &entries = mCache[info->instanceName()];
+
+    // Only keep the folders of the current and the next period
+    const QDate today = QDate::currentDate();
+    const QString currentKey = cacheKey(info, today);
+    const QString nextKey = info->nextPeriodStart(today).isValid() ? cacheKey(info, info->nextPeriodStart(today)) : QString();
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it.key() != key && it.key() != currentKey && it.key() != nextKey) {
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    ArchiveCache cache;
+    cache.topLevelId = info->archiveTopLevel();
+    cache.colId = id;
+    entries.insert(key, cache);
+    save(info->instanceName());
 }
 
-void FolderArchiveCache::addToCache(const QString &resourceName, Akonadi::Collection::Id id)
+void FolderArchiveCache::prepareNextPeriod(FolderArchiveAccountInfo *info, const QDate &date)
 {
-    if (mCache.contains(resourceName)) {
-        ArchiveCache cache = mCache.value(resourceName);
-        cache.colId = id;
-        mCache.insert(resourceName, cache);
-    } else {
-        ArchiveCache cache;
-        cache.colId = id;
-        mCache.insert(resourceName, cache);
+    if (!info->isValid()) {
+        return;
+    }
+    const QDate nextPeriod = info->nextPeriodStart(date);
+    if (!nextPeriod.isValid() || date.daysTo(nextPeriod) > PrepareNextPeriodDays) {
+        return;
     }
+    if (collectionId(info, nextPeriod) != -1) {
+        return;
+    }
+    const QString pendingKey = info->instanceName() + QLatin1Char('/') + cacheKey(info, nextPeriod);
+    if (mPendingFolders.contains(pendingKey)) {
+        return;
+    }
+    mPendingFolders.insert(pendingKey);
+
+    qCDebug(KMAIL_LOG) << "Prepare archive folder" << info->archiveFolderName(nextPeriod) << "for" << info->instanceName();
+    FolderArchiveAgentCheckCollection *checkCol = new FolderArchiveAgentCheckCollection(info, this);
+    checkCol->setDate(nextPeriod);
+    const FolderArchiveAccountInfo infoCopy = *info;
+    connect(checkCol, &FolderArchiveAgentCheckCollection::collectionIdFound, this, [this, checkCol, infoCopy, nextPeriod, pendingKey](const Akonadi::Collection &col) {
+        FolderArchiveAccountInfo preparedInfo = infoCopy;
+        addToCache(&preparedInfo, nextPeriod, col.id());
+        mPendingFolders.remove(pendingKey);
+        checkCol->deleteLater();
+    });
+    connect(checkCol, &FolderArchiveAgentCheckCollection::checkFailed, this, [this, checkCol, pendingKey](const QString &message) {
+        qCDebug(KMAIL_LOG) << "Unable to prepare archive folder:" << message;
+        mPendingFolders.remove(pendingKey);
+        checkCol->deleteLater();
+    });
+    checkCol->start();
 }
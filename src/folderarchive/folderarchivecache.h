@@ -22,15 +22,25 @@
 #include <QObject>
 #include <QDateTime>
 #include <QHash>
+#include <QSet>
 #include <AkonadiCore/Collection>
+#include <KSharedConfig>
 
 class FolderArchiveAccountInfo;
 
 struct ArchiveCache {
-    QDate date = QDate::currentDate();
+    Akonadi::Collection::Id topLevelId = -1;
     Akonadi::Collection::Id colId = -1;
 };
 
+/**
+ * @short Remembers the archive folder of every account and archive period.
+ *
+ * The cache is kept on disk, so the archive folders don't have to be looked
+ * up again after a restart. Entries are dropped one by one when their folder
+ * is removed, moved or renamed, and are ignored when the account is
+ * configured with another top level folder.
+ */
 class FolderArchiveCache : public QObject
 {
     Q_OBJECT
@@ -38,17 +48,39 @@ public:
     explicit FolderArchiveCache(QObject *parent = nullptr);
     ~FolderArchiveCache();
 
-    void addToCache(const QString &resourceName, Akonadi::Collection::Id id);
+    void addToCache(FolderArchiveAccountInfo *info, const QDate &date, Akonadi::Collection::Id id);
 
-    Akonadi::Collection::Id collectionId(FolderArchiveAccountInfo *info);
+    Akonadi::Collection::Id collectionId(FolderArchiveAccountInfo *info, const QDate &date = QDate::currentDate());
 
     void clearCacheWithContainsCollection(Akonadi::Collection::Id id);
 
+    /**
+     * Drops the cached folder if @p collection is no longer the archive
+     * folder it was cached for.
+     */
+    void collectionChanged(const Akonadi::Collection &collection);
+
+    void clearCache(const QString &instanceName);
     void clearCache();
 
+    /**
+     * Creates the archive folder of the next period of @p info in the
+     * background when that period starts within a few days, so that the
+     * first archiving of the new period finds it in the cache.
+     */
+    void prepareNextPeriod(FolderArchiveAccountInfo *info, const QDate &date = QDate::currentDate());
+
 private:
     Q_DISABLE_COPY(FolderArchiveCache)
-    QHash<QString, ArchiveCache> mCache;
+    static QString cacheKey(FolderArchiveAccountInfo *info, const QDate &date);
+    void load();
+    void save(const QString &instanceName);
+    void removeEntries(const QString &instanceName, const QStringList &keys);
+
+    // instance name -> archive folder name -> cache
+    QHash<QString, QHash<QString, ArchiveCache> > mCache;
+    QSet<QString> mPendingFolders;
+    KSharedConfig::Ptr mConfig;
 };
 
 #endif // FOLDERARCHIVECACHE_H
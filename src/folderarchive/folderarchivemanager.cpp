@@ -20,14 +20,14 @@
 #include "folderarchiveagentjob.h"
 #include "folderarchiveaccountinfo.h"
 #include "folderarchivecache.h"
+#include "folderarchiveresolveitemsjob.h"
 #include "folderarchiveutil.h"
 
 #include "util.h"
 
 #include <AkonadiCore/AgentManager>
-#include <AkonadiCore/ItemFetchJob>
-#include <AkonadiCore/ItemFetchScope>
-#include <AkonadiCore/CollectionFetchJob>
+
+#include <Libkdepim/ProgressManager>
 
 #include <KSharedConfig>
 #include <KNotification>
@@ -37,12 +37,24 @@
 #include "kmail_debug.h"
 
 #include <QRegularExpression>
+#include <QTimer>
+
+namespace {
+static const int PrepareFoldersInterval = 60 * 60 * 1000;
+}
 
 FolderArchiveManager::FolderArchiveManager(QObject *parent)
     : QObject(parent)
 {
     mFolderArchiveCache = new FolderArchiveCache(this);
     load();
+
+    // Check from time to time whether the folders of the next period can be created
+    mPrepareFoldersTimer = new QTimer(this);
+    mPrepareFoldersTimer->setInterval(PrepareFoldersInterval);
+    connect(mPrepareFoldersTimer, &QTimer::timeout, this, &FolderArchiveManager::prepareArchiveFolders);
+    mPrepareFoldersTimer->start();
+    QTimer::singleShot(0, this, &FolderArchiveManager::prepareArchiveFolders);
 }
 
 FolderArchiveManager::~FolderArchiveManager()
@@ -50,21 +62,46 @@ FolderArchiveManager::~FolderArchiveManager()
     qDeleteAll(mListAccountInfo);
     mListAccountInfo.clear();
     qDeleteAll(mJobQueue);
-    delete mCurrentJob;
+    qDeleteAll(mRunningJobs);
 }
 
 void FolderArchiveManager::slotCollectionRemoved(const Akonadi::Collection &collection)
 {
-    KConfig config(FolderArchive::FolderArchiveUtil::configFileName());
     mFolderArchiveCache->clearCacheWithContainsCollection(collection.id());
+    bool changed = false;
+    KConfig config(FolderArchive::FolderArchiveUtil::configFileName());
     for (FolderArchiveAccountInfo *info : qAsConst(mListAccountInfo)) {
         if (info->archiveTopLevel() == collection.id()) {
             info->setArchiveTopLevel(-1);
             KConfigGroup group = config.group(FolderArchive::FolderArchiveUtil::groupConfigPattern() + info->instanceName());
             info->writeConfig(group);
+            changed = true;
         }
     }
-    load();
+    if (changed) {
+        config.sync();
+        load();
+    }
+}
+
+void FolderArchiveManager::slotCollectionChanged(const Akonadi::Collection &collection)
+{
+    mFolderArchiveCache->collectionChanged(collection);
+}
+
+void FolderArchiveManager::slotCollectionMoved(const Akonadi::Collection &collection, const Akonadi::Collection &source, const Akonadi::Collection &destination)
+{
+    Q_UNUSED(source);
+    Akonadi::Collection movedCollection(collection);
+    movedCollection.setParentCollection(destination);
+    mFolderArchiveCache->collectionChanged(movedCollection);
+}
+
+void FolderArchiveManager::prepareArchiveFolders()
+{
+    for (FolderArchiveAccountInfo *info : qAsConst(mListAccountInfo)) {
+        mFolderArchiveCache->prepareNextPeriod(info);
+    }
 }
 
 FolderArchiveAccountInfo *FolderArchiveManager::infoFromInstanceName(const QString &instanceName) const
@@ -79,61 +116,173 @@ FolderArchiveAccountInfo *FolderArchiveManager::infoFromInstanceName(const QStri
 
 void FolderArchiveManager::setArchiveItem(qlonglong itemId)
 {
-    Akonadi::ItemFetchJob *job = new Akonadi::ItemFetchJob(Akonadi::Item(itemId), this);
-    job->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
-    job->fetchScope().setFetchRemoteIdentification(true);
-    connect(job, &Akonadi::ItemFetchJob::result, this, &FolderArchiveManager::slotFetchParentCollection);
+    setArchiveItems(Akonadi::Item::List() << Akonadi::Item(itemId));
 }
 
-void FolderArchiveManager::slotFetchParentCollection(KJob *job)
+void FolderArchiveManager::setArchiveItems(const Akonadi::Item::List &items, const QString &instanceName)
 {
-    if (job->error()) {
-        moveFailed(i18n("Unable to fetch folder. Error reported: %1", job->errorString()));
-        qCDebug(KMAIL_LOG) << "Unable to fetch folder:" << job->errorString();
+    if (items.isEmpty()) {
         return;
     }
-    const Akonadi::ItemFetchJob *fetchJob = qobject_cast<Akonadi::ItemFetchJob *>(job);
-    const Akonadi::Item::List items = fetchJob->items();
-    if (items.isEmpty()) {
-        moveFailed(i18n("No folder returned."));
-        qCDebug(KMAIL_LOG) << "Fetch list is empty";
+    FolderArchiveAccountInfo *info = infoFromInstanceName(instanceName);
+    if (info) {
+        enqueue(info, items);
+        dispatch();
     } else {
-        Akonadi::CollectionFetchJob *jobCol = new Akonadi::CollectionFetchJob(Akonadi::Collection(items.first().parentCollection().id()), Akonadi::CollectionFetchJob::Base, this);
-        jobCol->setProperty("itemId", items.first().id());
-        connect(jobCol, &Akonadi::CollectionFetchJob::result, this, &FolderArchiveManager::slotFetchCollection);
+        resolveItems(items);
     }
 }
 
-void FolderArchiveManager::slotFetchCollection(KJob *job)
+void FolderArchiveManager::setArchiveItems(const Akonadi::Item::List &items)
 {
-    if (job->error()) {
-        moveFailed(i18n("Unable to fetch parent folder. Error reported: %1", job->errorString()));
-        qCDebug(KMAIL_LOG) << "cannot fetch collection " << job->errorString();
-        return;
-    }
-    Akonadi::CollectionFetchJob *jobCol = qobject_cast<Akonadi::CollectionFetchJob *>(job);
-    if (jobCol->collections().isEmpty()) {
-        moveFailed(i18n("Unable to return list of folders."));
-        qCDebug(KMAIL_LOG) << "List of folder is empty";
+    if (items.isEmpty()) {
         return;
     }
+    resolveItems(items);
+}
 
-    const Akonadi::Item::List itemIds = {Akonadi::Item(jobCol->property("itemId").toLongLong())};
-    setArchiveItems(itemIds, jobCol->collections().constFirst().resource());
+void FolderArchiveManager::resolveItems(const Akonadi::Item::List &items)
+{
+    ++mPendingResolves;
+    FolderArchiveResolveItemsJob *job = new FolderArchiveResolveItemsJob(items, this);
+    connect(job, &FolderArchiveResolveItemsJob::itemsResolved, this, &FolderArchiveManager::slotItemsResolved);
+    connect(job, &FolderArchiveResolveItemsJob::resolveFailed, this, &FolderArchiveManager::slotResolveFailed);
+    job->start();
 }
 
-void FolderArchiveManager::setArchiveItems(const Akonadi::Item::List &items, const QString &instanceName)
+void FolderArchiveManager::slotItemsResolved(const QHash<QString, Akonadi::Item::List> &itemsByResource, int unresolvedCount)
 {
-    FolderArchiveAccountInfo *info = infoFromInstanceName(instanceName);
-    if (info) {
-        FolderArchiveAgentJob *job = new FolderArchiveAgentJob(this, info, items);
-        if (mCurrentJob) {
-            mJobQueue.enqueue(job);
+    --mPendingResolves;
+    if (unresolvedCount > 0) {
+        mTotalItems += unresolvedCount;
+        addFailure(unresolvedCount, i18np("The folder of 1 message was not found.", "The folder of %1 messages was not found.", unresolvedCount));
+    }
+    for (auto it = itemsByResource.constBegin(), end = itemsByResource.constEnd(); it != end; ++it) {
+        FolderArchiveAccountInfo *info = infoFromInstanceName(it.key());
+        if (info) {
+            enqueue(info, it.value());
         } else {
-            mCurrentJob = job;
-            job->start();
+            mTotalItems += it.value().count();
+            addFailure(it.value().count(), i18n("Archiving is not enabled for account %1", it.key()));
         }
     }
+    dispatch();
+}
+
+void FolderArchiveManager::slotResolveFailed(const QString &msg, int itemCount)
+{
+    --mPendingResolves;
+    mTotalItems += itemCount;
+    addFailure(itemCount, msg);
+    dispatch();
+}
+
+void FolderArchiveManager::enqueue(FolderArchiveAccountInfo *info, const Akonadi::Item::List &items)
+{
+    FolderArchiveAgentJob *job = new FolderArchiveAgentJob(this, info, items);
+    mTotalItems += items.count();
+    mJobQueue.enqueue(job);
+}
+
+void FolderArchiveManager::addFailure(int count, const QString &msg)
+{
+    mFailedItems += count;
+    if (!mErrors.contains(msg)) {
+        mErrors.append(msg);
+    }
+}
+
+void FolderArchiveManager::dispatch()
+{
+    if (!mJobQueue.isEmpty() && !mProgressItem) {
+        mProgressItem = KPIM::ProgressManager::createProgressItem(QLatin1String("folderarchive") + KPIM::ProgressManager::getUniqueID(),
+                                                                 i18n("Archiving messages"), QString(), true, KPIM::ProgressItem::Unknown);
+        connect(mProgressItem.data(), &KPIM::ProgressItem::progressItemCanceled, this, &FolderArchiveManager::slotProgressCanceled);
+    }
+    // Start the oldest job of every idle account, keeping the order per account
+    QStringList queuedAccounts;
+    queuedAccounts.reserve(mJobQueue.count());
+    for (FolderArchiveAgentJob *job : qAsConst(mJobQueue)) {
+        queuedAccounts.append(job->instanceName());
+    }
+    const QVector<int> positions = FolderArchive::FolderArchiveUtil::jobsToStart(queuedAccounts, mRunningJobs.keys(), mMaximumRunningJobs);
+    QVector<FolderArchiveAgentJob *> jobs(positions.count());
+    // take the jobs from the back so that the positions stay valid
+    for (int i = positions.count() - 1; i >= 0; --i) {
+        jobs[i] = mJobQueue.takeAt(positions.at(i));
+    }
+    for (FolderArchiveAgentJob *job : qAsConst(jobs)) {
+        mRunningJobs.insert(job->instanceName(), job);
+        job->setParentProgressItem(mProgressItem);
+        job->start();
+    }
+    updateProgress();
+    if (mPendingResolves == 0 && mJobQueue.isEmpty() && mRunningJobs.isEmpty()) {
+        batchFinished();
+    }
+}
+
+void FolderArchiveManager::jobFinished(FolderArchiveAgentJob *job)
+{
+    mRunningJobs.remove(job->instanceName());
+    job->deleteLater();
+    // the job may report from start(), let dispatch() finish its loop first
+    QTimer::singleShot(0, this, &FolderArchiveManager::dispatch);
+}
+
+void FolderArchiveManager::updateProgress()
+{
+    if (!mProgressItem || mTotalItems == 0) {
+        return;
+    }
+    const int processed = mArchivedItems + mFailedItems;
+    mProgressItem->setProgress(processed * 100 / mTotalItems);
+    mProgressItem->setStatus(i18n("%1 of %2 messages", processed, mTotalItems));
+}
+
+void FolderArchiveManager::slotProgressCanceled()
+{
+    mCanceled = true;
+    // the running jobs are canceled through their child progress items
+    for (FolderArchiveAgentJob *job : qAsConst(mJobQueue)) {
+        mFailedItems += job->itemCount();
+    }
+    qDeleteAll(mJobQueue);
+    mJobQueue.clear();
+    updateProgress();
+}
+
+void FolderArchiveManager::batchFinished()
+{
+    if (mTotalItems == 0 && mErrors.isEmpty()) {
+        return;
+    }
+    if (mProgressItem) {
+        mProgressItem->setComplete();
+        mProgressItem = nullptr;
+    }
+
+    const QPixmap pixmap = QIcon::fromTheme(QStringLiteral("kmail")).pixmap(KIconLoader::SizeSmall, KIconLoader::SizeSmall);
+    if (mErrors.isEmpty() || mCanceled) {
+        KNotification::event(QStringLiteral("folderarchivedone"),
+                             i18np("1 message archived", "%1 messages archived", mArchivedItems),
+                             pixmap,
+                             nullptr,
+                             KNotification::CloseOnTimeout,
+                             QStringLiteral("kmail2"));
+    } else {
+        KNotification::event(QStringLiteral("folderarchiveerror"),
+                             mErrors.join(QLatin1Char('\n')),
+                             pixmap,
+                             nullptr,
+                             KNotification::CloseOnTimeout,
+                             QStringLiteral("kmail2"));
+    }
+    mErrors.clear();
+    mTotalItems = 0;
+    mArchivedItems = 0;
+    mFailedItems = 0;
+    mCanceled = false;
 }
 
 void FolderArchiveManager::slotInstanceRemoved(const Akonadi::AgentInstance &instance)
@@ -142,6 +291,8 @@ void FolderArchiveManager::slotInstanceRemoved(const Akonadi::AgentInstance &ins
     for (FolderArchiveAccountInfo *info : qAsConst(mListAccountInfo)) {
         if (info->instanceName() == instanceName) {
             mListAccountInfo.removeAll(info);
+            delete info;
+            mFolderArchiveCache->clearCache(instanceName);
             removeInfo(instanceName);
             break;
         }
@@ -160,8 +311,6 @@ void FolderArchiveManager::load()
 {
     qDeleteAll(mListAccountInfo);
     mListAccountInfo.clear();
-    //Be sure to clear cache.
-    mFolderArchiveCache->clearCache();
 
     KConfig config(FolderArchive::FolderArchiveUtil::configFileName());
     const QStringList accountList = config.groupList().filter(QRegularExpression(FolderArchive::FolderArchiveUtil::groupConfigPattern()));
@@ -176,41 +325,32 @@ void FolderArchiveManager::load()
     }
 }
 
-void FolderArchiveManager::moveDone()
+void FolderArchiveManager::moveDone(FolderArchiveAgentJob *job)
 {
-    const QPixmap pixmap = QIcon::fromTheme(QStringLiteral("kmail")).pixmap(KIconLoader::SizeSmall, KIconLoader::SizeSmall);
-
-    KNotification::event(QStringLiteral("folderarchivedone"),
-                         i18n("Messages archived"),
-                         pixmap,
-                         nullptr,
-                         KNotification::CloseOnTimeout,
-                         QStringLiteral("kmail2"));
-    nextJob();
+    mArchivedItems += job->itemCount();
+    jobFinished(job);
 }
 
-void FolderArchiveManager::moveFailed(const QString &msg)
+void FolderArchiveManager::moveFailed(FolderArchiveAgentJob *job, const QString &msg)
 {
-    const QPixmap pixmap = QIcon::fromTheme(QStringLiteral("kmail")).pixmap(KIconLoader::SizeSmall, KIconLoader::SizeSmall);
+    qCDebug(KMAIL_LOG) << "Archiving failed for account" << job->instanceName() << msg;
+    if (mCanceled) {
+        mFailedItems += job->itemCount();
+    } else {
+        addFailure(job->itemCount(), msg);
+    }
+    jobFinished(job);
+}
 
-    KNotification::event(QStringLiteral("folderarchiveerror"),
-                         msg,
-                         pixmap,
-                         nullptr,
-                         KNotification::CloseOnTimeout,
-                         QStringLiteral("kmail2"));
-    nextJob();
+void FolderArchiveManager::setMaximumRunningJobs(int max)
+{
+    mMaximumRunningJobs = qMax(1, max);
+    dispatch();
 }
 
-void FolderArchiveManager::nextJob()
+int FolderArchiveManager::maximumRunningJobs() const
 {
-    mCurrentJob->deleteLater();
-    if (mJobQueue.isEmpty()) {
-        mCurrentJob = nullptr;
-    } else {
-        mCurrentJob = mJobQueue.dequeue();
-        mCurrentJob->start();
-    }
+    return mMaximumRunningJobs;
 }
 
 FolderArchiveCache *FolderArchiveManager::folderArchiveCache() const
@@ -221,4 +361,5 @@ FolderArchiveCache *FolderArchiveManager::folderArchiveCache() const
 void FolderArchiveManager::reloadConfig()
 {
     load();
+    prepareArchiveFolders();
 }
@@ -21,16 +21,22 @@
 
 #include <QObject>
 #include <QQueue>
+#include <QHash>
+#include <QPointer>
+#include <QStringList>
 #include <AkonadiCore/Item>
 namespace Akonadi {
 class AgentInstance;
 class Collection;
 }
+namespace KPIM {
+class ProgressItem;
+}
 
 class FolderArchiveAccountInfo;
 class FolderArchiveAgentJob;
 class FolderArchiveCache;
-class KJob;
+class QTimer;
 class FolderArchiveManager : public QObject
 {
     Q_OBJECT
@@ -39,11 +45,27 @@ public:
     ~FolderArchiveManager();
 
     void load();
+    /**
+     * Archives @p items, which all belong to the account @p instanceName.
+     * If the account isn't configured for archiving (e.g. the messages are
+     * listed in a search folder), the account of every message is looked up.
+     */
     void setArchiveItems(const Akonadi::Item::List &items, const QString &instanceName);
+    /**
+     * Archives @p items, which may belong to different accounts.
+     */
+    void setArchiveItems(const Akonadi::Item::List &items);
     void setArchiveItem(qlonglong itemId);
 
-    void moveFailed(const QString &msg);
-    void moveDone();
+    void moveFailed(FolderArchiveAgentJob *job, const QString &msg);
+    void moveDone(FolderArchiveAgentJob *job);
+
+    /**
+     * Sets the number of accounts archived at the same time. Messages of the
+     * same account are always moved one job after the other.
+     */
+    void setMaximumRunningJobs(int max);
+    int maximumRunningJobs() const;
 
     void collectionRemoved(const Akonadi::Collection &collection);
 
@@ -53,19 +75,40 @@ public:
 public Q_SLOTS:
     void slotCollectionRemoved(const Akonadi::Collection &collection);
     void slotInstanceRemoved(const Akonadi::AgentInstance &instance);
+    void slotCollectionChanged(const Akonadi::Collection &collection);
+    void slotCollectionMoved(const Akonadi::Collection &collection, const Akonadi::Collection &source, const Akonadi::Collection &destination);
 
 private:
     Q_DISABLE_COPY(FolderArchiveManager)
-    void slotFetchParentCollection(KJob *job);
-    void slotFetchCollection(KJob *job);
+    void slotItemsResolved(const QHash<QString, Akonadi::Item::List> &itemsByResource, int unresolvedCount);
+    void slotResolveFailed(const QString &msg, int itemCount);
+    void slotProgressCanceled();
 
     FolderArchiveAccountInfo *infoFromInstanceName(const QString &instanceName) const;
-    void nextJob();
+    void resolveItems(const Akonadi::Item::List &items);
+    void enqueue(FolderArchiveAccountInfo *info, const Akonadi::Item::List &items);
+    void addFailure(int count, const QString &msg);
+    void dispatch();
+    void jobFinished(FolderArchiveAgentJob *job);
+    void updateProgress();
+    void batchFinished();
     void removeInfo(const QString &instanceName);
+    void prepareArchiveFolders();
+
     QQueue<FolderArchiveAgentJob *> mJobQueue;
-    FolderArchiveAgentJob *mCurrentJob = nullptr;
+    // running job per account
+    QHash<QString, FolderArchiveAgentJob *> mRunningJobs;
     QList<FolderArchiveAccountInfo *> mListAccountInfo;
+    QStringList mErrors;
+    QPointer<KPIM::ProgressItem> mProgressItem;
     FolderArchiveCache *mFolderArchiveCache = nullptr;
+    QTimer *mPrepareFoldersTimer = nullptr;
+    int mMaximumRunningJobs = 4;
+    int mPendingResolves = 0;
+    int mTotalItems = 0;
+    int mArchivedItems = 0;
+    int mFailedItems = 0;
+    bool mCanceled = false;
 };
 
 #endif // FOLDERARCHIVEMANAGER_H
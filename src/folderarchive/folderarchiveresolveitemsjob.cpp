@@ -0,0 +1,143 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "folderarchiveresolveitemsjob.h"
+#include "folderarchiveutil.h"
+#include "kmail_debug.h"
+
+#include <MailCommon/MailKernel>
+
+#include <AkonadiCore/CollectionFetchJob>
+#include <AkonadiCore/ItemFetchJob>
+#include <AkonadiCore/ItemFetchScope>
+
+#include <KLocalizedString>
+
+FolderArchiveResolveItemsJob::FolderArchiveResolveItemsJob(const Akonadi::Item::List &items, QObject *parent)
+    : QObject(parent)
+    , mItems(items)
+    , mItemCount(items.count())
+{
+}
+
+FolderArchiveResolveItemsJob::~FolderArchiveResolveItemsJob()
+{
+}
+
+void FolderArchiveResolveItemsJob::start()
+{
+    Akonadi::Item::List unknownItems;
+    for (const Akonadi::Item &item : qAsConst(mItems)) {
+        if (FolderArchive::FolderArchiveUtil::storageCollectionId(item) <= 0) {
+            unknownItems.append(Akonadi::Item(item.id()));
+        }
+    }
+    if (unknownItems.isEmpty()) {
+        resolveCollections();
+        return;
+    }
+    Akonadi::ItemFetchJob *job = new Akonadi::ItemFetchJob(unknownItems, this);
+    job->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
+    job->fetchScope().setFetchRemoteIdentification(false);
+    job->fetchScope().setFetchModificationTime(false);
+    connect(job, &Akonadi::ItemFetchJob::result, this, &FolderArchiveResolveItemsJob::slotItemFetchDone);
+}
+
+void FolderArchiveResolveItemsJob::slotItemFetchDone(KJob *job)
+{
+    if (job->error()) {
+        qCDebug(KMAIL_LOG) << "Unable to fetch folder:" << job->errorString();
+        Q_EMIT resolveFailed(i18n("Unable to fetch folder. Error reported: %1", job->errorString()), mItemCount);
+        deleteLater();
+        return;
+    }
+    QHash<Akonadi::Item::Id, Akonadi::Item> fetchedItems;
+    const Akonadi::Item::List items = static_cast<Akonadi::ItemFetchJob *>(job)->items();
+    fetchedItems.reserve(items.count());
+    for (const Akonadi::Item &item : items) {
+        fetchedItems.insert(item.id(), item);
+    }
+
+    Akonadi::Item::List resolvedItems;
+    resolvedItems.reserve(mItems.count());
+    for (const Akonadi::Item &item : qAsConst(mItems)) {
+        if (FolderArchive::FolderArchiveUtil::storageCollectionId(item) > 0) {
+            resolvedItems.append(item);
+        } else if (fetchedItems.contains(item.id())) {
+            resolvedItems.append(fetchedItems.value(item.id()));
+        } else {
+            qCDebug(KMAIL_LOG) << "Message" << item.id() << "not found, not archived";
+            ++mNotFoundCount;
+        }
+    }
+    mItems = resolvedItems;
+    resolveCollections();
+}
+
+void FolderArchiveResolveItemsJob::resolveCollections()
+{
+    Akonadi::Collection::List unknownCollections;
+    for (const Akonadi::Item &item : qAsConst(mItems)) {
+        const Akonadi::Collection::Id id = FolderArchive::FolderArchiveUtil::storageCollectionId(item);
+        if (mResources.contains(id)) {
+            continue;
+        }
+        const Akonadi::Collection col = CommonKernel->collectionFromId(id);
+        if (col.isValid() && !col.resource().isEmpty()) {
+            mResources.insert(id, col.resource());
+        } else {
+            // Known as unresolved until the fetch below is done
+            mResources.insert(id, QString());
+            unknownCollections.append(Akonadi::Collection(id));
+        }
+    }
+    if (unknownCollections.isEmpty()) {
+        finish();
+        return;
+    }
+    Akonadi::CollectionFetchJob *job = new Akonadi::CollectionFetchJob(unknownCollections, Akonadi::CollectionFetchJob::Base, this);
+    connect(job, &Akonadi::CollectionFetchJob::result, this, &FolderArchiveResolveItemsJob::slotCollectionFetchDone);
+}
+
+void FolderArchiveResolveItemsJob::slotCollectionFetchDone(KJob *job)
+{
+    if (job->error()) {
+        qCDebug(KMAIL_LOG) << "cannot fetch collection " << job->errorString();
+        Q_EMIT resolveFailed(i18n("Unable to fetch parent folder. Error reported: %1", job->errorString()), mItemCount);
+        deleteLater();
+        return;
+    }
+    const Akonadi::Collection::List collections = static_cast<Akonadi::CollectionFetchJob *>(job)->collections();
+    for (const Akonadi::Collection &col : collections) {
+        mResources.insert(col.id(), col.resource());
+    }
+    finish();
+}
+
+void FolderArchiveResolveItemsJob::finish()
+{
+    Akonadi::Item::List unresolvedItems;
+    const QHash<QString, Akonadi::Item::List> itemsByResource = FolderArchive::FolderArchiveUtil::groupItemsByResource(mItems, mResources, unresolvedItems);
+    if (itemsByResource.isEmpty()) {
+        Q_EMIT resolveFailed(i18n("No folder returned."), mItemCount);
+    } else {
+        Q_EMIT itemsResolved(itemsByResource, mNotFoundCount + unresolvedItems.count());
+    }
+    deleteLater();
+}
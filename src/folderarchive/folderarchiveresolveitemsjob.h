@@ -0,0 +1,65 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef FOLDERARCHIVERESOLVEITEMSJOB_H
+#define FOLDERARCHIVERESOLVEITEMSJOB_H
+
+#include <QObject>
+#include <QHash>
+#include <AkonadiCore/Item>
+#include <AkonadiCore/Collection>
+
+class KJob;
+
+/**
+ * @short Finds the account of a batch of messages.
+ *
+ * The messages are grouped by the resource of the folder they are stored
+ * in. Messages whose folder is unknown are fetched with one item fetch job,
+ * and the folders missing from the collection model with one collection
+ * fetch job, whatever the number of messages. Messages which are not
+ * found, or whose account can't be found, are reported as unresolved.
+ */
+class FolderArchiveResolveItemsJob : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FolderArchiveResolveItemsJob(const Akonadi::Item::List &items, QObject *parent = nullptr);
+    ~FolderArchiveResolveItemsJob();
+
+    void start();
+
+Q_SIGNALS:
+    void itemsResolved(const QHash<QString, Akonadi::Item::List> &itemsByResource, int unresolvedCount);
+    void resolveFailed(const QString &message, int itemCount);
+
+private:
+    Q_DISABLE_COPY(FolderArchiveResolveItemsJob)
+    void slotItemFetchDone(KJob *job);
+    void slotCollectionFetchDone(KJob *job);
+    void resolveCollections();
+    void finish();
+
+    Akonadi::Item::List mItems;
+    QHash<Akonadi::Collection::Id, QString> mResources;
+    int mItemCount = 0;
+    int mNotFoundCount = 0;
+};
+
+#endif // FOLDERARCHIVERESOLVEITEMSJOB_H
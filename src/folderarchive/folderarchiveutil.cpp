@@ -33,6 +33,11 @@ QString FolderArchiveUtil::configFileName()
     return QStringLiteral("foldermailarchiverc");
 }
 
+QString FolderArchiveUtil::cacheFileName()
+{
+    return QStringLiteral("foldermailarchivecache");
+}
+
 bool FolderArchiveUtil::resourceSupportArchiving(const QString &resource)
 {
     KConfig config(FolderArchiveUtil::configFileName());
@@ -44,3 +49,40 @@ bool FolderArchiveUtil::resourceSupportArchiving(const QString &resource)
     }
     return false;
 }
+
+Akonadi::Collection::Id FolderArchiveUtil::storageCollectionId(const Akonadi::Item &item)
+{
+    if (item.storageCollectionId() > 0) {
+        return item.storageCollectionId();
+    }
+    return item.parentCollection().id();
+}
+
+QHash<QString, Akonadi::Item::List> FolderArchiveUtil::groupItemsByResource(const Akonadi::Item::List &items, const QHash<Akonadi::Collection::Id, QString> &resources, Akonadi::Item::List &unresolvedItems)
+{
+    QHash<QString, Akonadi::Item::List> itemsByResource;
+    for (const Akonadi::Item &item : items) {
+        const QString resource = resources.value(storageCollectionId(item));
+        if (resource.isEmpty()) {
+            unresolvedItems.append(item);
+        } else {
+            itemsByResource[resource].append(item);
+        }
+    }
+    return itemsByResource;
+}
+
+QVector<int> FolderArchiveUtil::jobsToStart(const QStringList &queuedAccounts, const QStringList &runningAccounts, int maximumRunningJobs)
+{
+    QVector<int> positions;
+    QStringList busyAccounts = runningAccounts;
+    for (int i = 0, total = queuedAccounts.count(); i < total && busyAccounts.count() < maximumRunningJobs; ++i) {
+        const QString &account = queuedAccounts.at(i);
+        if (busyAccounts.contains(account)) {
+            continue;
+        }
+        busyAccounts.append(account);
+        positions.append(i);
+    }
+    return positions;
+}
@@ -20,11 +20,37 @@
 #define FOLDERARCHIVEUTIL_H
 
 #include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+#include <AkonadiCore/Item>
+#include <AkonadiCore/Collection>
 namespace FolderArchive {
 namespace FolderArchiveUtil {
 QString groupConfigPattern();
 bool resourceSupportArchiving(const QString &resource);
 QString configFileName();
+QString cacheFileName();
+
+/**
+ * Returns the folder @p item is stored in, which differs from its parent
+ * collection when the message is listed in a search folder.
+ */
+Akonadi::Collection::Id storageCollectionId(const Akonadi::Item &item);
+
+/**
+ * Groups @p items by the resource of their storage folder, looked up in
+ * @p resources. Items whose resource is unknown are appended to
+ * @p unresolvedItems.
+ */
+QHash<QString, Akonadi::Item::List> groupItemsByResource(const Akonadi::Item::List &items, const QHash<Akonadi::Collection::Id, QString> &resources, Akonadi::Item::List &unresolvedItems);
+
+/**
+ * Returns the positions in @p queuedAccounts of the jobs to start, in queue
+ * order: the oldest job of every account not listed in @p runningAccounts,
+ * as long as fewer than @p maximumRunningJobs jobs run.
+ */
+QVector<int> jobsToStart(const QStringList &queuedAccounts, const QStringList &runningAccounts, int maximumRunningJobs);
 }
 }
 
@@ -56,6 +56,7 @@
 #include "editor/composer.h"
 #include "kmmainwidget.h"
 #include "undostack.h"
+#include "commandtransferservice.h"
 
 #include <KIdentityManagement/IdentityManager>
 
@@ -116,6 +117,7 @@
 #include <KBookmarkManager>
 
 #include <KEmailAddress>
+#include <KFormat>
 #include <KFileWidget>
 #include <KJobWidgets>
 #include <KLocalizedString>
@@ -132,10 +134,13 @@
 #include <QFileDialog>
 #include <QFontDatabase>
 #include <QList>
-#include <QProgressDialog>
 #include <QStandardPaths>
+#include <QTimer>
+
+#include <algorithm>
 
 using KMail::SecondaryWindow;
+using KMail::CommandTransferService;
 using MailTransport::TransportManager;
 using MessageComposer::MessageFactoryNG;
 
@@ -159,6 +164,20 @@ static void showJobError(KJob *job)
     }
 }
 
+/// Records @p changes of @p items for undo once @p job applied them
+static void journalChanges(KJob *job, const QString &description, const Akonadi::Item::List &items, const QVector<KMail::UndoChange> &changes)
+{
+    QObject::connect(job, &KJob::result, [description, items, changes](KJob *job) {
+        if (job->error()) {
+            return;
+        }
+        const int undoId = kmkernel->undoStack()->newChangeAction(description);
+        for (int i = 0, total = items.count(); i < total; ++i) {
+            kmkernel->undoStack()->addChangeToAction(undoId, items.at(i), changes.at(i));
+        }
+    });
+}
+
 KMCommand::KMCommand(QWidget *parent)
     : mCountMsgs(0)
     , mResult(Undefined)
@@ -192,6 +211,18 @@ KMCommand::KMCommand(QWidget *parent, const Akonadi::Item::List &msgList)
 
 KMCommand::~KMCommand()
 {
+    if (mTransferring) {
+        CommandTransferService::self()->remove(this);
+        // the fetch jobs are deleted with us without emitting their result
+        for (const QPointer<Akonadi::ItemFetchJob> &job : qAsConst(mTransferJobs)) {
+            if (job) {
+                CommandTransferService::self()->jobFinished();
+            }
+        }
+        if (mTransferProgress) {
+            mTransferProgress->setComplete();
+        }
+    }
 }
 
 KMCommand::Result KMCommand::result() const
@@ -245,7 +276,20 @@ void KMCommand::setResult(KMCommand::Result result)
     mResult = result;
 }
 
-int KMCommand::mCountJobs = 0;
+bool KMCommand::processesIncrementally() const
+{
+    return mProcessesIncrementally;
+}
+
+void KMCommand::setProcessesIncrementally(bool processesIncrementally)
+{
+    mProcessesIncrementally = processesIncrementally;
+}
+
+void KMCommand::processTransferredMsgs(const Akonadi::Item::List &msgs)
+{
+    Q_UNUSED(msgs);
+}
 
 void KMCommand::start()
 {
@@ -298,109 +342,176 @@ Akonadi::ItemFetchJob *KMCommand::createFetchJob(const Akonadi::Item::List &item
     return new Akonadi::ItemFetchJob(items, this);
 }
 
+// Large selections are fetched in chunks of at most this many messages or bytes
+static const int s_transferChunkMessages = 25;
+static const qint64 s_transferChunkSize = 4 * 1024 * 1024;
+// Fetch jobs of one command running at the same time
+static const int s_maximumTransferJobs = 2;
+
 void KMCommand::transferSelectedMsgs()
 {
-    // make sure no other transfer is active
-    if (KMCommand::mCountJobs > 0) {
-        Q_EMIT messagesTransfered(Failed);
+    mCountMsgs = mMsgList.count();
+    mRetrievedMsgs.clear();
+    mTransferredMsgs = 0;
+    mTransferredSize = 0;
+    mTransferSize = 0;
+
+    // TODO once the message list is based on ETM and we get the more advanced caching we need to make that check a bit more clever
+    if (mFetchScope.isEmpty()) {
+        // no need to fetch anything
+        mRetrievedMsgs = mMsgList;
+        Q_EMIT messagesTransfered(OK);
         return;
     }
 
-    bool complete = true;
-    KMCommand::mCountJobs = 0;
-    mCountMsgs = 0;
-    mRetrievedMsgs.clear();
-    mCountMsgs = mMsgList.count();
-    uint totalSize = 0;
-    // the QProgressDialog for the user-feedback. Only enable it if it's needed.
-    // For some commands like KMSetStatusCommand it's not needed. Note, that
-    // for some reason the QProgressDialog eats the MouseReleaseEvent (if a
-    // command is executed after the MousePressEvent), cf. bug #71761.
-    if (mCountMsgs > 0) {
-        mProgressDialog = new QProgressDialog(mParent);
-        mProgressDialog.data()->setWindowTitle(i18n("Please wait"));
+    mFetchScope.fetchAttribute< MailCommon::MDNStateAttribute >();
+    mPendingMsgs = mMsgList;
+    for (const Akonadi::Item &item : qAsConst(mMsgList)) {
+        mTransferSize += item.size();
+    }
+    mTransferring = true;
+
+    mTransferProgress = ProgressManager::createProgressItem(nullptr, QLatin1String("transfer") + ProgressManager::getUniqueID(),
+                                                            i18np("Transferring message", "Transferring %1 messages", mCountMsgs),
+                                                            QString(), true, KPIM::ProgressItem::Unknown);
+    mTransferProgress->setTotalItems(mCountMsgs);
+    connect(mTransferProgress.data(), &KPIM::ProgressItem::progressItemCanceled,
+            this, &KMCommand::slotTransferCancelled);
+
+    CommandTransferService::self()->enqueue(this);
+}
 
-        mProgressDialog.data()->setLabelText(i18np("Please wait while the message is transferred", "Please wait while the %1 messages are transferred", mMsgList.count()));
-        mProgressDialog.data()->setModal(true);
-        mProgressDialog.data()->setMinimumDuration(1000);
+bool KMCommand::startTransferJob()
+{
+    if (!mTransferring || mPendingMsgs.isEmpty()) {
+        return false;
     }
 
-    // TODO once the message list is based on ETM and we get the more advanced caching we need to make that check a bit more clever
-    if (!mFetchScope.isEmpty()) {
-        complete = false;
-        ++KMCommand::mCountJobs;
-        Akonadi::ItemFetchJob *fetch = createFetchJob(mMsgList);
-        mFetchScope.fetchAttribute< MailCommon::MDNStateAttribute >();
-        fetch->setFetchScope(mFetchScope);
-        connect(fetch, &Akonadi::ItemFetchJob::itemsReceived, this, &KMCommand::slotMsgTransfered);
-        connect(fetch, &Akonadi::ItemFetchJob::result, this, &KMCommand::slotJobFinished);
-    } else {
-        // no need to fetch anything
-        if (!mMsgList.isEmpty()) {
-            mRetrievedMsgs = mMsgList;
-        }
+    Akonadi::Item::List chunk;
+    qint64 chunkSize = 0;
+    while (!mPendingMsgs.isEmpty() && chunk.count() < s_transferChunkMessages
+           && (chunk.isEmpty() || chunkSize + mPendingMsgs.first().size() <= s_transferChunkSize)) {
+        const Akonadi::Item item = mPendingMsgs.takeFirst();
+        chunkSize += item.size();
+        chunk.append(item);
     }
 
-    if (complete) {
-        delete mProgressDialog.data();
-        mProgressDialog.clear();
-        Q_EMIT messagesTransfered(OK);
-    } else {
-        // wait for the transfer and tell the progressBar the necessary steps
-        if (mProgressDialog.data()) {
-            connect(mProgressDialog.data(), &QProgressDialog::canceled,
-                    this, &KMCommand::slotTransferCancelled);
-            mProgressDialog.data()->setMaximum(totalSize);
-        }
+    Akonadi::ItemFetchJob *fetch = createFetchJob(chunk);
+    fetch->setFetchScope(mFetchScope);
+    connect(fetch, &Akonadi::ItemFetchJob::itemsReceived, this, &KMCommand::slotMsgTransfered);
+    connect(fetch, &Akonadi::ItemFetchJob::result, this, &KMCommand::slotJobFinished);
+    mTransferJobs.append(fetch);
+
+    if (!mPendingMsgs.isEmpty() && mTransferJobs.count() < s_maximumTransferJobs) {
+        CommandTransferService::self()->enqueue(this);
     }
+    return true;
 }
 
 void KMCommand::slotMsgTransfered(const Akonadi::Item::List &msgs)
 {
-    if (mProgressDialog.data() && mProgressDialog.data()->wasCanceled()) {
-        Q_EMIT messagesTransfered(Canceled);
+    if (!mTransferring) {
+        return;
+    }
+    mTransferredMsgs += msgs.count();
+    for (const Akonadi::Item &item : msgs) {
+        mTransferredSize += item.size();
+    }
+    updateTransferProgress();
+
+    if (mProcessesIncrementally) {
+        processTransferredMsgs(msgs);
+    } else {
+        // save the complete messages
+        mRetrievedMsgs.append(msgs);
+    }
+}
+
+void KMCommand::updateTransferProgress()
+{
+    if (!mTransferProgress) {
         return;
     }
-    // save the complete messages
-    mRetrievedMsgs.append(msgs);
+    mTransferProgress->setCompletedItems(mTransferredMsgs);
+    if (mTransferSize > 0) {
+        mTransferProgress->setProgress(static_cast<unsigned int>(qMin<qint64>(100, mTransferredSize * 100 / mTransferSize)));
+        mTransferProgress->setStatus(i18nc("transferred size of total size", "%1 of %2",
+                                           KFormat().formatByteSize(mTransferredSize),
+                                           KFormat().formatByteSize(mTransferSize)));
+    } else {
+        mTransferProgress->updateProgress();
+    }
 }
 
-void KMCommand::slotJobFinished()
+void KMCommand::slotJobFinished(KJob *job)
 {
     // the job is finished (with / without error)
-    KMCommand::mCountJobs--;
+    mTransferJobs.removeAll(static_cast<Akonadi::ItemFetchJob *>(job));
+    CommandTransferService::self()->jobFinished();
 
-    if (mProgressDialog.data() && mProgressDialog.data()->wasCanceled()) {
+    if (!mTransferring) {
         return;
     }
-
-    if (mCountMsgs > mRetrievedMsgs.count()) {
-        // the message wasn't retrieved before => error
-        if (mProgressDialog.data()) {
-            mProgressDialog.data()->hide();
-        }
+    if (job->error()) {
+        // the messages weren't retrieved => error
+        qCDebug(KMAIL_LOG) << "Unable to transfer messages:" << job->errorString();
         slotTransferCancelled();
         return;
     }
-    // update the progressbar
-    if (mProgressDialog.data()) {
-        mProgressDialog.data()->setLabelText(i18np("Please wait while the message is transferred",
-                                                   "Please wait while the %1 messages are transferred", KMCommand::mCountJobs));
-    }
-    if (KMCommand::mCountJobs == 0) {
+
+    if (mTransferJobs.isEmpty() && mPendingMsgs.isEmpty()) {
         // all done
-        delete mProgressDialog.data();
-        mProgressDialog.clear();
-        Q_EMIT messagesTransfered(OK);
+        if (mCountMsgs > mTransferredMsgs) {
+            // some messages weren't retrieved => error
+            slotTransferCancelled();
+            return;
+        }
+        if (!mProcessesIncrementally) {
+            // chunks may complete in any order, keep the one of the selection
+            QHash<Akonadi::Item::Id, int> position;
+            position.reserve(mMsgList.count());
+            for (int i = 0, total = mMsgList.count(); i < total; ++i) {
+                position.insert(mMsgList.at(i).id(), i);
+            }
+            std::stable_sort(mRetrievedMsgs.begin(), mRetrievedMsgs.end(),
+                             [&position](const Akonadi::Item &left, const Akonadi::Item &right) {
+                return position.value(left.id()) < position.value(right.id());
+            });
+        }
+        finishTransfer(OK);
+    } else if (!mPendingMsgs.isEmpty()) {
+        CommandTransferService::self()->enqueue(this);
     }
 }
 
 void KMCommand::slotTransferCancelled()
 {
-    KMCommand::mCountJobs = 0;
+    if (!mTransferring) {
+        return;
+    }
     mCountMsgs = 0;
     mRetrievedMsgs.clear();
-    Q_EMIT messagesTransfered(Canceled);
+    finishTransfer(Canceled);
+}
+
+void KMCommand::finishTransfer(KMCommand::Result result)
+{
+    mTransferring = false;
+    mPendingMsgs.clear();
+    CommandTransferService::self()->remove(this);
+    const QList<QPointer<Akonadi::ItemFetchJob> > jobs = mTransferJobs;
+    for (const QPointer<Akonadi::ItemFetchJob> &job : jobs) {
+        // emits result(), which releases the slot
+        if (job) {
+            job->kill(KJob::EmitResult);
+        }
+    }
+    mTransferJobs.clear();
+    if (mTransferProgress) {
+        mTransferProgress->setComplete();
+        mTransferProgress.clear();
+    }
+    Q_EMIT messagesTransfered(result);
 }
 
 KMMailtoComposeCommand::KMMailtoComposeCommand(const QUrl &url, const Akonadi::Item &msg)
@@ -1198,9 +1309,24 @@ KMCommand::Result KMSetStatusCommand::execute()
     if (itemsToModify.isEmpty()) {
         slotModifyItemDone(nullptr);   // pretend we did something
     } else {
+        const Akonadi::Item::Flag flag = *(mStatus.statusFlags().begin());
+        QVector<KMail::UndoChange> changes;
+        changes.reserve(itemsToModify.count());
+        for (const Akonadi::Item &item : qAsConst(itemsToModify)) {
+            KMail::UndoChange change;
+            if (item.hasFlag(flag)) {
+                change.addedFlags.insert(flag);
+            } else {
+                change.removedFlags.insert(flag);
+            }
+            changes.append(change);
+        }
+
         Akonadi::ItemModifyJob *modifyJob = new Akonadi::ItemModifyJob(itemsToModify, this);
         modifyJob->disableRevisionCheck();
         modifyJob->setIgnorePayload(true);
+        journalChanges(modifyJob, i18np("Change Message Status", "Change Status of %1 Messages", itemsToModify.count()),
+                       itemsToModify, changes);
         connect(modifyJob, &Akonadi::ItemModifyJob::result, this, &KMSetStatusCommand::slotModifyItemDone);
     }
     return OK;
@@ -1272,9 +1398,39 @@ void KMSetTagCommand::setTags()
         }
         itemsToModify << item;
     }
+
+    QVector<KMail::UndoChange> changes;
+    changes.reserve(itemsToModify.count());
+    int changedItems = 0;
+    for (int i = 0, total = itemsToModify.count(); i < total; ++i) {
+        QSet<Akonadi::Tag::Id> before;
+        const Akonadi::Tag::List oldTags = mItem.at(i).tags();
+        for (const Akonadi::Tag &tag : oldTags) {
+            before.insert(tag.id());
+        }
+        QSet<Akonadi::Tag::Id> after;
+        const Akonadi::Tag::List newTags = itemsToModify.at(i).tags();
+        for (const Akonadi::Tag &tag : newTags) {
+            after.insert(tag.id());
+        }
+        KMail::UndoChange change;
+        change.addedTags = QSet<Akonadi::Tag::Id>(after).subtract(before).toList().toVector();
+        change.removedTags = before.subtract(after).toList().toVector();
+        std::sort(change.addedTags.begin(), change.addedTags.end());
+        std::sort(change.removedTags.begin(), change.removedTags.end());
+        if (!change.isEmpty()) {
+            ++changedItems;
+        }
+        changes.append(change);
+    }
+
     Akonadi::ItemModifyJob *modifyJob = new Akonadi::ItemModifyJob(itemsToModify, this);
     modifyJob->disableRevisionCheck();
     modifyJob->setIgnorePayload(true);
+    if (changedItems > 0) {
+        journalChanges(modifyJob, i18np("Change Message Tags", "Change Tags of %1 Messages", changedItems),
+                       itemsToModify, changes);
+    }
     connect(modifyJob, &Akonadi::ItemModifyJob::result, this, &KMSetTagCommand::slotModifyItemDone);
 
     if (!mCreatedTags.isEmpty()) {
@@ -1419,6 +1575,13 @@ KMCopyDecryptedCommand::KMCopyDecryptedCommand(const Akonadi::Collection &destFo
 {
     fetchScope().fetchAllAttributes();
     fetchScope().fetchFullPayload();
+    // decrypt and copy each chunk as soon as it arrives
+    setProcessesIncrementally(true);
+    // the copies of the chunks already transferred may still be created
+    // once the transfer is done, whatever its result
+    setDeletesItself(true);
+    setEmitsCompletedItself(true);
+    connect(this, &KMCommand::messagesTransfered, this, &KMCopyDecryptedCommand::slotTransferFinished);
 }
 
 KMCopyDecryptedCommand::KMCopyDecryptedCommand(const Akonadi::Collection &destFolder, const Akonadi::Item &msg)
@@ -1426,12 +1589,9 @@ KMCopyDecryptedCommand::KMCopyDecryptedCommand(const Akonadi::Collection &destFo
 {
 }
 
-KMCommand::Result KMCopyDecryptedCommand::execute()
+void KMCopyDecryptedCommand::processTransferredMsgs(const Akonadi::Item::List &msgs)
 {
-    setDeletesItself(true);
-
-    const auto items = retrievedMsgs();
-    for (const auto &item : items) {
+    for (const auto &item : msgs) {
         // Decrypt
         if (!item.hasPayload<KMime::Message::Ptr>()) {
             continue;
@@ -1451,22 +1611,59 @@ KMCommand::Result KMCopyDecryptedCommand::execute()
         connect(job, &Akonadi::Job::result, this, &KMCopyDecryptedCommand::slotAppendResult);
         mPendingJobs << job;
     }
+}
 
-    if (mPendingJobs.isEmpty()) {
-        Q_EMIT completed(this);
-        deleteLater();
+KMCommand::Result KMCopyDecryptedCommand::execute()
+{
+    // standalone messages are handed over without a transfer
+    const auto items = retrievedMsgs();
+    if (!items.isEmpty()) {
+        processTransferredMsgs(items);
     }
 
+    mTransferFinished = true;
+    QTimer::singleShot(0, this, &KMCopyDecryptedCommand::finishWhenDone);
     return KMCommand::OK;
 }
 
+void KMCopyDecryptedCommand::slotTransferFinished(KMCommand::Result result)
+{
+    if (result == OK) {
+        // execute() creates the remaining copies
+        return;
+    }
+    setResult(result);
+    mCanceled = (result == Canceled);
+    mTransferFinished = true;
+    // the result is set by KMCommand once this slot returns
+    QTimer::singleShot(0, this, &KMCopyDecryptedCommand::finishWhenDone);
+}
+
 void KMCopyDecryptedCommand::slotAppendResult(KJob *job)
 {
     mPendingJobs.removeOne(job);
-    if (mPendingJobs.isEmpty()) {
-        Q_EMIT completed(this);
-        deleteLater();
+    if (job->error()) {
+        showJobError(job);
+        setResult(Failed);
+    } else {
+        ++mCopiedCount;
+    }
+    finishWhenDone();
+}
+
+void KMCopyDecryptedCommand::finishWhenDone()
+{
+    if (!mTransferFinished || !mPendingJobs.isEmpty()) {
+        return;
     }
+    mTransferFinished = false;
+    if (mCanceled && mCopiedCount > 0) {
+        // the messages copied before the cancellation are kept
+        KPIM::BroadcastStatus::instance()->setStatusMsg(i18np("Copy canceled, 1 message was already copied.",
+                                                              "Copy canceled, %1 messages were already copied.", mCopiedCount));
+    }
+    Q_EMIT completed(this);
+    deleteLater();
 }
 
 KMMoveCommand::KMMoveCommand(const Akonadi::Collection &destFolder, const Akonadi::Item::List &msgList, MessageList::Core::MessageItemSetReference ref)
@@ -1539,7 +1736,7 @@ KMCommand::Result KMMoveCommand::execute()
     // TODO set SSL state according to source and destfolder connection?
     Q_ASSERT(!mProgressItem);
     mProgressItem
-        = ProgressManager::createProgressItem(QLatin1String("move") + ProgressManager::getUniqueID(),
+        = ProgressManager::createProgressItem(mParentProgressItem, QLatin1String("move") + ProgressManager::getUniqueID(),
                                               mDestFolder.isValid() ? i18n("Moving messages") : i18n("Deleting messages"), QString(), true, KPIM::ProgressItem::Unknown);
     mProgressItem->setUsesBusyIndicator(true);
     connect(mProgressItem, &ProgressItem::progressItemCanceled,
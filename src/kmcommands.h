@@ -27,7 +27,6 @@ class ProgressItem;
 
 using Akonadi::MessageStatus;
 
-class QProgressDialog;
 class KMMainWidget;
 class KMReaderMainWin;
 
@@ -43,6 +42,7 @@ class Job;
 }
 namespace KMail {
 class Composer;
+class CommandTransferService;
 }
 typedef QMap<KMime::Content *, Akonadi::Item> PartNodeMessageMap;
 /// Small helper structure which encapsulates the KMMessage created when creating a reply, and
@@ -119,21 +119,41 @@ protected:
     */
     void setResult(Result result);
 
+    bool processesIncrementally() const;
+    /** Specify whether the subclass processes the messages chunk by chunk
+      while they are transferred, see processTransferredMsgs(). The messages
+      are not kept for retrievedMsgs() then.
+      @param processesIncrementally true if processTransferredMsgs() handles
+                                    the messages
+    */
+    void setProcessesIncrementally(bool processesIncrementally);
+
+    /** Called with each chunk of transferred messages when the command
+      processes them incrementally. execute() is called once all messages
+      have been transferred.
+    */
+    virtual void processTransferredMsgs(const Akonadi::Item::List &msgs);
+
 private:
     Q_DISABLE_COPY(KMCommand)
+    friend class KMail::CommandTransferService;
     // execute should be implemented by derived classes
     virtual Result execute() = 0;
 
     /** transfers the list of (imap)-messages
     *  this is a necessary preparation for e.g. forwarding */
     void transferSelectedMsgs();
+    /** starts the fetch job of the next chunk, called by CommandTransferService */
+    bool startTransferJob();
+    void finishTransfer(KMCommand::Result result);
+    void updateTransferProgress();
 
 private Q_SLOTS:
     void slotPostTransfer(KMCommand::Result result);
     /** the msg has been transferred */
     void slotMsgTransfered(const Akonadi::Item::List &msgs);
-    /** the KMImapJob is finished */
-    void slotJobFinished();
+    /** the fetch job of a chunk is finished */
+    void slotJobFinished(KJob *job);
     /** the transfer was canceled */
     void slotTransferCancelled();
 
@@ -141,10 +161,16 @@ protected:
     Akonadi::Item::List mRetrievedMsgs;
 
 private:
-    // ProgressDialog for transferring messages
-    QPointer<QProgressDialog> mProgressDialog;
-    //Currently only one async command allowed at a time
-    static int mCountJobs;
+    // Progress of the transfer in the status bar
+    QPointer<KPIM::ProgressItem> mTransferProgress;
+    // Messages not yet requested and running fetch jobs
+    Akonadi::Item::List mPendingMsgs;
+    QList<QPointer<Akonadi::ItemFetchJob> > mTransferJobs;
+    qint64 mTransferSize = 0;
+    qint64 mTransferredSize = 0;
+    int mTransferredMsgs = 0;
+    bool mTransferring = false;
+    bool mProcessesIncrementally = false;
     int mCountMsgs;
     Result mResult;
     bool mDeletesItself : 1;
@@ -516,9 +542,16 @@ protected Q_SLOTS:
 
 private:
     Result execute() override;
+    void processTransferredMsgs(const Akonadi::Item::List &msgs) override;
+    void slotTransferFinished(KMCommand::Result result);
+    void finishWhenDone();
 
     Akonadi::Collection mDestFolder;
+    // the copies being created, children of the command
     QList<KJob *> mPendingJobs;
+    int mCopiedCount = 0;
+    bool mTransferFinished = false;
+    bool mCanceled = false;
 };
 
 class KMMoveCommand : public KMCommand
@@ -538,6 +571,15 @@ public:
         return mRef;
     }
 
+    /**
+     * Shows the progress of the move below @p parent instead of as a
+     * top level item.
+     */
+    void setParentProgressItem(KPIM::ProgressItem *parent)
+    {
+        mParentProgressItem = parent;
+    }
+
 public Q_SLOTS:
     void slotMoveCanceled();
     void slotMoveResult(KJob *job);
@@ -556,6 +598,7 @@ private:
 
     Akonadi::Collection mDestFolder;
     KPIM::ProgressItem *mProgressItem = nullptr;
+    KPIM::ProgressItem *mParentProgressItem = nullptr;
     MessageList::Core::MessageItemSetReference mRef;
 };
 
@@ -24,6 +24,7 @@ using KPIM::RecentAddresses;
 #include "configuredialog/configuredialog.h"
 #include "kmcommands.h"
 #include "unityservicemanager.h"
+#include "unreadcountservice.h"
 #include <MessageCore/StringUtil>
 #include "mailcommon/mailutil.h"
 #include "pop3settings.h"
@@ -192,9 +193,6 @@ KMKernel::KMKernel(QObject *parent)
     mCollectionModel->setDynamicSortFilter(true);
     mCollectionModel->setSortCaseSensitivity(Qt::CaseInsensitive);
 
-    connect(folderCollectionMonitor(), QOverload<const Akonadi::Collection &, const QSet<QByteArray> &>::of(&Akonadi::ChangeRecorder::collectionChanged), this,
-            &KMKernel::slotCollectionChanged);
-
     connect(MailTransport::TransportManager::self(), &MailTransport::TransportManager::transportRemoved, this, &KMKernel::transportRemoved);
     connect(MailTransport::TransportManager::self(), &MailTransport::TransportManager::transportRenamed, this, &KMKernel::transportRenamed);
 
@@ -220,8 +218,15 @@ KMKernel::KMKernel(QObject *parent)
     CommonKernel->registerSettingsIf(this);
     CommonKernel->registerFilterIf(this);
     mFolderArchiveManager = new FolderArchiveManager(this);
+    connect(mFolderCollectionMonitor->monitor(), &Akonadi::Monitor::collectionRemoved, mFolderArchiveManager, &FolderArchiveManager::slotCollectionRemoved);
+    connect(mFolderCollectionMonitor->monitor(), &Akonadi::Monitor::collectionMoved, mFolderArchiveManager, &FolderArchiveManager::slotCollectionMoved);
+    connect(folderCollectionMonitor(), QOverload<const Akonadi::Collection &>::of(&Akonadi::ChangeRecorder::collectionChanged), mFolderArchiveManager,
+            &FolderArchiveManager::slotCollectionChanged);
     mIndexedItems = new Akonadi::Search::PIM::IndexedItems(this);
     mCheckIndexingManager = new CheckIndexingManager(mIndexedItems, this);
+    connect(mFolderCollectionMonitor->monitor(), &Akonadi::Monitor::collectionStatisticsChanged, mCheckIndexingManager, &CheckIndexingManager::slotCollectionStatisticsChanged);
+    connect(mFolderCollectionMonitor->monitor(), &Akonadi::Monitor::collectionRemoved, mCheckIndexingManager, &CheckIndexingManager::slotCollectionRemoved);
+    mUnreadCountService = new KMail::UnreadCountService(folderCollectionMonitor(), this);
     mUnityServiceManager = new KMail::UnityServiceManager(this);
 }
 
@@ -1235,9 +1240,19 @@ void KMKernel::slotShowConfigurationDialog()
 void KMKernel::slotConfigChanged()
 {
     CodecManager::self()->updatePreferredCharsets();
+    updateIndexingCheck();
     Q_EMIT configChanged();
 }
 
+void KMKernel::updateIndexingCheck()
+{
+    if (KMailSettings::self()->checkCollectionsIndexing()) {
+        mCheckIndexingManager->start(entityTreeModel());
+    } else {
+        mCheckIndexingManager->stop();
+    }
+}
+
 //-------------------------------------------------------------------------------
 
 bool KMKernel::haveSystemTrayApplet() const
@@ -1253,7 +1268,7 @@ QTextCodec *KMKernel::networkCodec() const
 void KMKernel::updateSystemTray()
 {
     if (!the_shuttingDown) {
-        mUnityServiceManager->initListOfCollection();
+        mUnityServiceManager->updateSystemTray();
     }
 }
 
@@ -1384,9 +1399,7 @@ void KMKernel::slotRunBackgroundTasks() // called regularly by timer
     if (KMailSettings::self()->autoExpiring()) {
         mFolderCollectionMonitor->expireAllFolders(false /*scheduled, not immediate*/, entityTreeModel());
     }
-    if (KMailSettings::self()->checkCollectionsIndexing()) {
-        mCheckIndexingManager->start(entityTreeModel());
-    }
+    updateIndexingCheck();
 #ifdef DEBUG_SCHEDULER // for debugging, see jobscheduler.h
     mBackgroundTasksTimer->start(60 * 1000);   // check again in 1 minute
 #else
@@ -1472,6 +1485,11 @@ Akonadi::Search::PIM::IndexedItems *KMKernel::indexedItems() const
     return mIndexedItems;
 }
 
+KMail::UnreadCountService *KMKernel::unreadCountService() const
+{
+    return mUnreadCountService;
+}
+
 // can't be inline, since KMSender isn't known to implement
 // KMail::MessageSender outside this .cpp file
 MessageComposer::MessageSender *KMKernel::msgSender()
@@ -1677,6 +1695,9 @@ void KMKernel::slotCollectionRemoved(const Akonadi::Collection &col)
     const QString colStr = QString::number(col.id());
     TemplateParser::Util::deleteTemplate(colStr);
     MessageList::Util::deleteConfig(colStr);
+    if (the_undoStack) {
+        the_undoStack->folderDestroyed(col);
+    }
 }
 
 void KMKernel::slotDeleteIdentity(uint identity)
@@ -1882,13 +1903,6 @@ void KMKernel::reloadFolderArchiveConfig()
     mFolderArchiveManager->reloadConfig();
 }
 
-void KMKernel::slotCollectionChanged(const Akonadi::Collection &, const QSet<QByteArray> &set)
-{
-    if (set.contains("newmailnotifierattribute")) {
-        mUnityServiceManager->initListOfCollection();
-    }
-}
-
 FolderArchiveManager *KMKernel::folderArchiveManager() const
 {
     return mFolderArchiveManager;
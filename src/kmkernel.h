@@ -56,6 +56,7 @@ namespace KMail {
 class MailServiceImpl;
 class UndoStack;
 class UnityServiceManager;
+class UnreadCountService;
 }
 namespace MessageComposer {
 class AkonadiSender;
@@ -410,6 +411,12 @@ public:
 
     Akonadi::Search::PIM::IndexedItems *indexedItems() const;
 
+    /**
+     * Returns the unread counts of the folders, shared by the tray icon
+     * and the Unity launcher.
+     */
+    KMail::UnreadCountService *unreadCountService() const;
+
     void cleanupTemporaryFiles();
     MailCommon::MailCommonSettings *mailCommonSettings() const;
 
@@ -468,7 +475,6 @@ private Q_SLOTS:
     void slotDeleteIdentity(uint identity);
     void slotInstanceRemoved(const Akonadi::AgentInstance &);
     void slotSystemNetworkStatusChanged(bool isOnline);
-    void slotCollectionChanged(const Akonadi::Collection &, const QSet<QByteArray> &set);
 
     void slotCheckAccount(Akonadi::ServerManager::State state);
 private:
@@ -488,6 +494,7 @@ private:
     void openReader(bool onlyCheck);
     QSharedPointer<MailCommon::FolderSettings> currentFolderCollection();
     void saveConfig();
+    void updateIndexingCheck();
 
     KMail::UndoStack *the_undoStack = nullptr;
     MessageComposer::AkonadiSender *the_msgSender = nullptr;
@@ -510,6 +517,7 @@ private:
     bool mSystemNetworkStatus = true;
 
     KMail::UnityServiceManager *mUnityServiceManager = nullptr;
+    KMail::UnreadCountService *mUnreadCountService = nullptr;
     QHash<QString, KPIM::ProgressItem::CryptoStatus> mResourceCryptoSettingCache;
     MailCommon::FolderCollectionMonitor *mFolderCollectionMonitor = nullptr;
     Akonadi::EntityTreeModel *mEntityTreeModel = nullptr;
@@ -42,6 +42,8 @@
 #include "MailCommon/FolderTreeView"
 #include "tag/tagactionmanager.h"
 #include "foldershortcutactionmanager.h"
+#include "messagefetchbroker.h"
+#include "messageprefetcher.h"
 #include "widgets/collectionpane.h"
 #include "manageshowcollectionproperties.h"
 #include "widgets/kactionmenutransport.h"
@@ -1034,11 +1036,19 @@ void KMMainWidget::createWidgets()
     connect(mMessagePane, &MessageList::Pane::forceLostFocus,
             this, &KMMainWidget::slotSetFocusToViewer);
 
+    if (!mMessagePrefetcher) {
+        mMessagePrefetcher = new KMail::MessagePrefetcher(this);
+        mMessagePrefetcher->setMonitor(kmkernel->folderCollectionMonitor());
+    }
+    mMessagePrefetcher->clear();
+    mMessagePrefetcher->setViewer(nullptr);
+
     //
     // Create the reader window
     //
     if (mReaderWindowActive) {
         mMsgView = new KMReaderWin(this, this, actionCollection());
+        mMessagePrefetcher->setViewer(mMsgView->viewer());
         if (mMsgActions) {
             mMsgActions->setMessageView(mMsgView);
         }
@@ -4443,6 +4453,9 @@ void KMMainWidget::slotMessageSelected(const Akonadi::Item &item)
         // selected message from the preview pane
         if (!item.isValid()) {
             mMsgView->clear();
+        } else if (mCurrentCollection.isValid() && mMessagePrefetcher->cachedItem(item.id()).isValid()) {
+            // Prefetched while displaying a neighbour
+            itemsReceived(Akonadi::Item::List() << mMessagePrefetcher->cachedItem(item.id()));
         } else {
             mShowBusySplashTimer = new QTimer(this);
             mShowBusySplashTimer->setSingleShot(true);
@@ -4450,6 +4463,7 @@ void KMMainWidget::slotMessageSelected(const Akonadi::Item &item)
             mShowBusySplashTimer->start(1000);
 
             Akonadi::ItemFetchJob *itemFetchJob = mMsgView->viewer()->createFetchJob(item);
+            MessageFetchBroker::self()->addFetchJob(itemFetchJob, Akonadi::Item::List() << item);
             if (mCurrentCollection.isValid()) {
                 const QString resource = mCurrentCollection.resource();
                 itemFetchJob->setProperty("_resource", QVariant::fromValue(resource));
@@ -4501,6 +4515,17 @@ void KMMainWidget::itemsReceived(const Akonadi::Item::List &list)
     mMsgView->setHtmlLoadExtDefault(mFolderHtmlLoadExtPreference);
     mMsgView->setDecryptMessageOverwrite(false);
     mMsgActions->setCurrentMessage(copyItem);
+
+    // Read ahead the messages around this one, in the order of the list
+    QModelIndex currentIndex;
+    QItemSelectionModel *selectionModel = mMessagePane ? mMessagePane->currentItemSelectionModel() : nullptr;
+    if (selectionModel) {
+        currentIndex = selectionModel->currentIndex();
+        if (currentIndex.data(Akonadi::EntityTreeModel::ItemRole).value<Akonadi::Item>().id() != item.id()) {
+            currentIndex = QModelIndex();
+        }
+    }
+    mMessagePrefetcher->setCurrent(item, currentIndex);
 }
 
 void KMMainWidget::itemsFetchDone(KJob *job)
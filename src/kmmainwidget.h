@@ -76,6 +76,7 @@ class SearchWindow;
 class VacationScriptIndicatorWidget;
 class TagActionManager;
 class FolderShortcutActionManager;
+class MessagePrefetcher;
 }
 
 namespace KSieveUi {
@@ -590,6 +591,7 @@ private:
 
     QTimer *menutimer = nullptr;
     QTimer *mShowBusySplashTimer = nullptr;
+    KMail::MessagePrefetcher *mMessagePrefetcher = nullptr;
 
     KSieveUi::VacationManager *mVacationManager = nullptr;
     KActionCollection *mActionCollection = nullptr;
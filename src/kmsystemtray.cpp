@@ -21,6 +21,7 @@
 #include "kmsystemtray.h"
 #include "kmmainwidget.h"
 #include "unityservicemanager.h"
+#include "unreadcountservice.h"
 #include "settings/kmailsettings.h"
 #include "mailcommon/mailutil.h"
 #include "MailCommon/MailKernel"
@@ -33,6 +34,9 @@
 #include <QMenu>
 #include <KLocalizedString>
 #include <QAction>
+#include <QCollator>
+
+#include <algorithm>
 
 #include "widgets/kactionmenutransport.h"
 
@@ -202,7 +206,7 @@ void KMSystemTray::slotContextMenuAboutToShow()
     }
     mHasUnreadMessage = false;
     mNewMessagesPopup = new QMenu();
-    fillFoldersMenu(mNewMessagesPopup, kmkernel->treeviewModelSelection());
+    fillFoldersMenu(mNewMessagesPopup);
 
     connect(mNewMessagesPopup, &QMenu::triggered, this, &KMSystemTray::slotSelectCollection);
 
@@ -212,35 +216,31 @@ void KMSystemTray::slotContextMenuAboutToShow()
     }
 }
 
-void KMSystemTray::fillFoldersMenu(QMenu *menu, const QAbstractItemModel *model, const QString &parentName, const QModelIndex &parentIndex)
+void KMSystemTray::fillFoldersMenu(QMenu *menu)
 {
-    const int rowCount = model->rowCount(parentIndex);
-    for (int row = 0; row < rowCount; ++row) {
-        const QModelIndex index = model->index(row, 0, parentIndex);
-        const Akonadi::Collection collection = model->data(index, Akonadi::EntityTreeModel::CollectionRole).value<Akonadi::Collection>();
-        qint64 count = 0;
-        if (!mUnityServiceManager->excludeFolder(collection)) {
-            Akonadi::CollectionStatistics statistics = collection.statistics();
-            count = qMax(0LL, statistics.unreadCount());
-            if (count > 0) {
-                if (mUnityServiceManager->ignoreNewMailInFolder(collection)) {
-                    count = 0;
-                } else {
-                    mHasUnreadMessage = true;
-                }
-            }
+    const UnreadCountService *service = kmkernel->unreadCountService();
+    const Akonadi::Collection::List collections = service->unreadCollections();
+    QVector<QPair<QString, Akonadi::Collection::Id> > entries;
+    entries.reserve(collections.count());
+    for (const Akonadi::Collection &collection : collections) {
+        if (mUnityServiceManager->excludeFolder(collection) || mUnityServiceManager->ignoreNewMailInFolder(collection)) {
+            continue;
         }
-        QString label = parentName.isEmpty() ? QString() : QString(parentName + QLatin1String("->"));
-        label += model->data(index).toString();
+        QString label = service->path(collection.id()).join(QLatin1String("->"));
         label.replace(QLatin1Char('&'), QStringLiteral("&&"));
-        if (count > 0) {
-            // insert an item
-            QAction *action = menu->addAction(label);
-            action->setData(collection.id());
-        }
-        if (model->rowCount(index) > 0) {
-            fillFoldersMenu(menu, model, label, index);
-        }
+        entries.append(qMakePair(label, collection.id()));
+    }
+    mHasUnreadMessage = !entries.isEmpty();
+
+    // Sorted by path, so parents come before their children
+    QCollator collator;
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    std::sort(entries.begin(), entries.end(), [&collator](const QPair<QString, Akonadi::Collection::Id> &left, const QPair<QString, Akonadi::Collection::Id> &right) {
+        return collator.compare(left.first, right.first) < 0;
+    });
+    for (const auto &entry : qAsConst(entries)) {
+        QAction *action = menu->addAction(entry.first);
+        action->setData(entry.second);
     }
 }
 
@@ -22,7 +22,6 @@
 #include <kstatusnotifieritem.h>
 
 #include <QAction>
-#include <QAbstractItemModel>
 
 class QDBusServiceWatcher;
 class QMenu;
@@ -56,7 +55,7 @@ private:
 
     bool mainWindowIsOnCurrentDesktop();
     bool buildPopupMenu();
-    void fillFoldersMenu(QMenu *menu, const QAbstractItemModel *model, const QString &parentName = QString(), const QModelIndex &parentIndex = QModelIndex());
+    void fillFoldersMenu(QMenu *menu);
     int mDesktopOfMainWin = 0;
 
     bool mHasUnreadMessage = false;
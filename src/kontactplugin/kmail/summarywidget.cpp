@@ -26,30 +26,29 @@
 
 #include "summarywidget.h"
 #include "kmailinterface.h"
+#include "unreadcountservice.h"
 
 #include <KontactInterface/Core>
 #include <KontactInterface/Plugin>
 
-#include <AkonadiCore/ChangeRecorder>
+#include <AkonadiCore/Monitor>
 #include <AkonadiCore/CollectionFetchScope>
 #include <AkonadiCore/collectionstatistics.h>
-#include <AkonadiCore/EntityTreeModel>
-#include <AkonadiWidgets/ETMViewStateSaver>
+#include <AkonadiCore/EntityDisplayAttribute>
 
 #include <KMime/KMimeMessage>
 
-#include <KCheckableProxyModel>
 #include <KConfigGroup>
 #include "kmailplugin_debug.h"
 #include <KLocalizedString>
 #include <KUrlLabel>
-#include <KSharedConfig>
 
 #include <QEvent>
 #include <QIcon>
 #include <QGridLayout>
 #include <QVBoxLayout>
-#include <QItemSelectionModel>
+
+#include <algorithm>
 
 #include <ctime>
 
@@ -69,31 +68,16 @@ SummaryWidget::SummaryWidget(KontactInterface::Plugin *plugin, QWidget *parent)
     mLayout->setSpacing(3);
     mLayout->setRowStretch(6, 1);
 
-    // Create a new change recorder.
-    mChangeRecorder = new Akonadi::ChangeRecorder(this);
-    mChangeRecorder->setMimeTypeMonitored(KMime::Message::mimeType());
-    mChangeRecorder->fetchCollectionStatistics(true);
-    mChangeRecorder->setAllMonitored(true);
-    mChangeRecorder->collectionFetchScope().setIncludeStatistics(true);
-
-    mModel = new Akonadi::EntityTreeModel(mChangeRecorder, this);
-    mModel->setItemPopulationStrategy(Akonadi::EntityTreeModel::NoItemPopulation);
-
-    mSelectionModel = new QItemSelectionModel(mModel);
-    mModelProxy = new KCheckableProxyModel(this);
-    mModelProxy->setSelectionModel(mSelectionModel);
-    mModelProxy->setSourceModel(mModel);
-
-    KSharedConfigPtr _config = KSharedConfig::openConfig(QStringLiteral("kcmkmailsummaryrc"));
+    // Create a new monitor.
+    mMonitor = new Akonadi::Monitor(this);
+    mMonitor->setMimeTypeMonitored(KMime::Message::mimeType());
+    mMonitor->fetchCollectionStatistics(true);
+    mMonitor->setAllMonitored(true);
+    mMonitor->collectionFetchScope().setIncludeStatistics(true);
 
-    mModelState
-        = new KViewStateMaintainer<Akonadi::ETMViewStateSaver>(_config->group("CheckState"), this);
-    mModelState->setSelectionModel(mSelectionModel);
-
-    connect(mChangeRecorder, QOverload<const Akonadi::Collection &>::of(&Akonadi::ChangeRecorder::collectionChanged), this, &SummaryWidget::slotCollectionChanged);
-    connect(mChangeRecorder, &Akonadi::ChangeRecorder::collectionRemoved, this, &SummaryWidget::slotCollectionChanged);
-    connect(mChangeRecorder, &Akonadi::ChangeRecorder::collectionStatisticsChanged, this, &SummaryWidget::slotCollectionChanged);
-    QTimer::singleShot(0, this, &SummaryWidget::slotUpdateFolderList);
+    // Lists the folders once and follows the statistics notifications
+    mUnreadCountService = new KMail::UnreadCountService(mMonitor, this);
+    connect(mUnreadCountService, &KMail::UnreadCountService::unreadCountsChanged, this, &SummaryWidget::slotUpdateFolderList);
 }
 
 int SummaryWidget::summaryHeight() const
@@ -101,11 +85,6 @@ int SummaryWidget::summaryHeight() const
     return 1;
 }
 
-void SummaryWidget::slotCollectionChanged()
-{
-    QTimer::singleShot(0, this, &SummaryWidget::slotUpdateFolderList);
-}
-
 void SummaryWidget::updateSummary(bool force)
 {
     Q_UNUSED(force);
@@ -124,88 +103,94 @@ void SummaryWidget::selectFolder(const QString &folder)
     kmail.selectFolder(folder);
 }
 
-void SummaryWidget::displayModel(const QModelIndex &parent, int &counter, const bool showFolderPaths, QStringList parentTreeNames)
-{
-    const int nbCol = mModelProxy->rowCount(parent);
-    for (int i = 0; i < nbCol; ++i) {
-        const QModelIndex child = mModelProxy->index(i, 0, parent);
-        const Akonadi::Collection col
-            = mModelProxy->data(child,
-                                Akonadi::EntityTreeModel::CollectionRole).value<Akonadi::Collection>();
-        const int showCollection
-            = mModelProxy->data(child, Qt::CheckStateRole).toInt();
-
-        if (col.isValid()) {
-            const Akonadi::CollectionStatistics stats = col.statistics();
-            if (((stats.unreadCount()) != Q_INT64_C(0)) && showCollection) {
-                // Collection Name.
-                KUrlLabel *urlLabel = nullptr;
-
-                if (showFolderPaths) {
-                    // Construct the full path string.
-                    parentTreeNames.insert(parentTreeNames.size(), col.name());
-                    urlLabel = new KUrlLabel(QString::number(col.id()),
-                                             parentTreeNames.join(QLatin1Char('/')), this);
-                    parentTreeNames.removeLast();
-                } else {
-                    urlLabel = new KUrlLabel(QString::number(col.id()), col.name(), this);
-                }
-
-                urlLabel->installEventFilter(this);
-                urlLabel->setAlignment(Qt::AlignLeft);
-                urlLabel->setWordWrap(true);
-                mLayout->addWidget(urlLabel, counter, 1);
-                mLabels.append(urlLabel);
-
-                // tooltip
-                urlLabel->setToolTip(i18n("<qt><b>%1</b>"
-                                          "<br/>Total: %2<br/>"
-                                          "Unread: %3</qt>",
-                                          col.name(),
-                                          stats.count(),
-                                          stats.unreadCount()));
-
-                connect(urlLabel, QOverload<const QString &>::of(&KUrlLabel::leftClickedUrl), this, &SummaryWidget::selectFolder);
-
-                // Read and unread count.
-                QLabel *label = new QLabel(i18nc("%1: number of unread messages "
-                                                 "%2: total number of messages",
-                                                 "%1 / %2", stats.unreadCount(), stats.count()), this);
-
-                label->setAlignment(Qt::AlignLeft);
-                mLayout->addWidget(label, counter, 2);
-                mLabels.append(label);
-
-                // Folder icon.
-                QIcon icon = mModelProxy->data(child, Qt::DecorationRole).value<QIcon>();
-                label = new QLabel(this);
-                label->setPixmap(icon.pixmap(label->height() / 1.5));
-                label->setMaximumWidth(label->minimumSizeHint().width());
-                label->setAlignment(Qt::AlignVCenter);
-                mLayout->addWidget(label, counter, 0);
-                mLabels.append(label);
-
-                ++counter;
-            }
-            parentTreeNames.insert(parentTreeNames.size(), col.name());
-            displayModel(child, counter, showFolderPaths, parentTreeNames);
-            // Remove the last parent collection name for the next iteration.
-            parentTreeNames.removeLast();
-        }
-    }
-}
-
 void SummaryWidget::slotUpdateFolderList()
 {
     qDeleteAll(mLabels);
     mLabels.clear();
-    mModelState->restoreState();
-    int counter = 0;
-    qCDebug(KMAILPLUGIN_LOG) << QStringLiteral("Iterating over") << mModel->rowCount() << QStringLiteral("collections.");
+    if (!mUnreadCountService->isLoaded()) {
+        return;
+    }
+
     KConfig _config(QStringLiteral("kcmkmailsummaryrc"));
     KConfigGroup config(&_config, "General");
     const bool showFolderPaths = config.readEntry("showFolderPaths", false);
-    displayModel(QModelIndex(), counter, showFolderPaths, QStringList());
+
+    // The folders checked in the configuration module, as saved by its ETMViewStateSaver
+    QSet<Akonadi::Collection::Id> checkedCollections;
+    const QStringList selection = KConfigGroup(&_config, "CheckState").readEntry("Selection", QStringList());
+    for (const QString &key : selection) {
+        if (key.startsWith(QLatin1Char('c'))) {
+            checkedCollections.insert(key.midRef(1).toLongLong());
+        }
+    }
+
+    struct Entry {
+        Akonadi::Collection collection;
+        QString label;
+    };
+    QVector<Entry> entries;
+    const Akonadi::Collection::List collections = mUnreadCountService->unreadCollections();
+    for (const Akonadi::Collection &col : collections) {
+        if (!checkedCollections.contains(col.id())) {
+            continue;
+        }
+        const QStringList path = mUnreadCountService->path(col.id());
+        entries.append({col, path.join(QLatin1Char('/'))});
+    }
+    qCDebug(KMAILPLUGIN_LOG) << entries.count() << "monitored folders with unread messages";
+    std::sort(entries.begin(), entries.end(), [](const Entry &left, const Entry &right) {
+        return QString::localeAwareCompare(left.label, right.label) < 0;
+    });
+
+    int counter = 0;
+    for (const Entry &entry : qAsConst(entries)) {
+        const Akonadi::Collection &col = entry.collection;
+        const Akonadi::CollectionStatistics stats = col.statistics();
+
+        // Collection Name.
+        KUrlLabel *urlLabel = new KUrlLabel(QString::number(col.id()),
+                                            showFolderPaths ? entry.label : col.displayName(), this);
+
+        urlLabel->installEventFilter(this);
+        urlLabel->setAlignment(Qt::AlignLeft);
+        urlLabel->setWordWrap(true);
+        mLayout->addWidget(urlLabel, counter, 1);
+        mLabels.append(urlLabel);
+
+        // tooltip
+        urlLabel->setToolTip(i18n("<qt><b>%1</b>"
+                                  "<br/>Total: %2<br/>"
+                                  "Unread: %3</qt>",
+                                  col.name(),
+                                  stats.count(),
+                                  stats.unreadCount()));
+
+        connect(urlLabel, QOverload<const QString &>::of(&KUrlLabel::leftClickedUrl), this, &SummaryWidget::selectFolder);
+
+        // Read and unread count.
+        QLabel *label = new QLabel(i18nc("%1: number of unread messages "
+                                         "%2: total number of messages",
+                                         "%1 / %2", stats.unreadCount(), stats.count()), this);
+
+        label->setAlignment(Qt::AlignLeft);
+        mLayout->addWidget(label, counter, 2);
+        mLabels.append(label);
+
+        // Folder icon.
+        QString iconName = QStringLiteral("folder");
+        if (col.hasAttribute<Akonadi::EntityDisplayAttribute>()
+            && !col.attribute<Akonadi::EntityDisplayAttribute>()->iconName().isEmpty()) {
+            iconName = col.attribute<Akonadi::EntityDisplayAttribute>()->iconName();
+        }
+        label = new QLabel(this);
+        label->setPixmap(QIcon::fromTheme(iconName).pixmap(label->height() / 1.5));
+        label->setMaximumWidth(label->minimumSizeHint().width());
+        label->setAlignment(Qt::AlignVCenter);
+        mLayout->addWidget(label, counter, 0);
+        mLabels.append(label);
+
+        ++counter;
+    }
 
     if (counter == 0) {
         QLabel *label = new QLabel(i18n("No unread messages in your monitored folders"), this);
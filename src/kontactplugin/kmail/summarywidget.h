@@ -28,25 +28,20 @@
 
 #include <KontactInterface/Summary>
 
-#include <KViewStateMaintainer>
-
 namespace Akonadi {
-class ChangeRecorder;
-class Collection;
-class EntityTreeModel;
-class ETMViewStateSaver;
+class Monitor;
 }
 
 namespace KontactInterface {
 class Plugin;
 }
 
-class KCheckableProxyModel;
+namespace KMail {
+class UnreadCountService;
+}
 
 class QGridLayout;
-class QItemSelectionModel;
 class QLabel;
-class QModelIndex;
 
 class SummaryWidget : public KontactInterface::Summary
 {
@@ -67,18 +62,13 @@ public Q_SLOTS:
 
 private:
     void selectFolder(const QString &);
-    void slotCollectionChanged();
     void slotUpdateFolderList();
-    void displayModel(const QModelIndex &, int &, const bool, QStringList);
 
     QList<QLabel *> mLabels;
     QGridLayout *mLayout = nullptr;
     KontactInterface::Plugin *mPlugin = nullptr;
-    Akonadi::ChangeRecorder *mChangeRecorder = nullptr;
-    Akonadi::EntityTreeModel *mModel = nullptr;
-    KViewStateMaintainer<Akonadi::ETMViewStateSaver> *mModelState = nullptr;
-    KCheckableProxyModel *mModelProxy = nullptr;
-    QItemSelectionModel *mSelectionModel = nullptr;
+    Akonadi::Monitor *mMonitor = nullptr;
+    KMail::UnreadCountService *mUnreadCountService = nullptr;
 };
 
 #endif
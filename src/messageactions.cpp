@@ -25,6 +25,7 @@
 #include "kmmainwidget.h"
 #include "util.h"
 #include "kmcommands.h"
+#include "messagefetchbroker.h"
 #include <TemplateParser/CustomTemplatesMenu>
 
 #include <PimCommonAkonadi/AnnotationDialog>
@@ -167,6 +168,7 @@ MessageActions::MessageActions(KActionCollection *ac, QWidget *parent)
 
     connect(kmkernel->folderCollectionMonitor(), &Akonadi::Monitor::itemChanged, this, &MessageActions::slotItemModified);
     connect(kmkernel->folderCollectionMonitor(), &Akonadi::Monitor::itemRemoved, this, &MessageActions::slotItemRemoved);
+    connect(MessageFetchBroker::self(), &MessageFetchBroker::itemFetched, this, &MessageActions::slotItemFetched);
 
     mCustomTemplatesMenu = new TemplateParser::CustomTemplatesMenu(parent, ac);
 
@@ -362,34 +364,34 @@ void MessageActions::updateActions()
     mPrintPreviewAction->setEnabled(mMessageView != nullptr);
 
     if (mCurrentItem.hasPayload<KMime::Message::Ptr>()) {
-        if (mCurrentItem.loadedPayloadParts().contains("RFC822")) {
+        const QSet<QByteArray> loadedParts = mCurrentItem.loadedPayloadParts();
+        if (loadedParts.contains(Akonadi::MessagePart::Header) || loadedParts.contains("RFC822")) {
+            if (mMailingListItemId != -1) {
+                MessageFetchBroker::self()->cancelRequest(mMailingListItemId);
+                mMailingListItemId = -1;
+            }
             updateMailingListActions(mCurrentItem);
-        } else {
-            Akonadi::ItemFetchJob *job = new Akonadi::ItemFetchJob(mCurrentItem);
-            job->fetchScope().fetchAllAttributes();
-            job->fetchScope().fetchFullPayload(true);
-            job->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Header);
-            job->fetchScope().fetchAttribute<Akonadi::EntityAnnotationsAttribute>();
-            connect(job, &Akonadi::ItemFetchJob::result, this, &MessageActions::slotUpdateActionsFetchDone);
+        } else if (mMailingListItemId != mCurrentItem.id()) {
+            // Shares the fetch of the reader if there is one
+            mMailingListItemId = mCurrentItem.id();
+            MessageFetchBroker::self()->requestHeaders(mCurrentItem);
         }
     }
 }
 
-void MessageActions::slotUpdateActionsFetchDone(KJob *job)
+void MessageActions::slotItemFetched(const Akonadi::Item &item)
 {
-    if (job->error()) {
+    if (item.id() != mCurrentItem.id() || item.id() != mMailingListItemId) {
         return;
     }
-
-    Akonadi::ItemFetchJob *fetchJob = static_cast<Akonadi::ItemFetchJob *>(job);
-    if (fetchJob->items().isEmpty()) {
-        return;
+    mMailingListItemId = -1;
+    if (item.loadedPayloadParts().contains("RFC822")) {
+        mCurrentItem = item;
     }
-    const Akonadi::Item messageItem = fetchJob->items().constFirst();
-    if (messageItem == mCurrentItem) {
-        mCurrentItem = messageItem;
-        updateMailingListActions(messageItem);
+    if (item.hasAttribute<Akonadi::EntityAnnotationsAttribute>()) {
+        mAnnotateAction->setText(i18n("Edit Note..."));
     }
+    updateMailingListActions(item);
 }
 
 void MessageActions::clearMailingListActions()
@@ -131,7 +131,7 @@ private Q_SLOTS:
     void slotPrintMessage();
     void slotPrintPreviewMsg();
 
-    void slotUpdateActionsFetchDone(KJob *job);
+    void slotItemFetched(const Akonadi::Item &item);
     void slotMailingListFilter();
     void slotDebugAkonadiSearch();
 
@@ -143,6 +143,8 @@ private:
     QList<QAction *> mMailListActionList;
     Akonadi::Item mCurrentItem;
     Akonadi::Item::List mVisibleItems;
+    // message whose headers were requested for the mailing list actions
+    Akonadi::Item::Id mMailingListItemId = -1;
     QWidget *mParent = nullptr;
     KMReaderWin *mMessageView = nullptr;
 
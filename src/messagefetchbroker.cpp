@@ -0,0 +1,149 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "messagefetchbroker.h"
+#include "kmail_debug.h"
+
+#include <Akonadi/KMime/MessageParts>
+#include <AkonadiCore/ItemFetchJob>
+#include <AkonadiCore/ItemFetchScope>
+#include <AkonadiCore/entityannotationsattribute.h>
+
+#include <QTimer>
+
+using namespace KMail;
+
+Q_GLOBAL_STATIC(MessageFetchBroker, s_messageFetchBroker)
+
+MessageFetchBroker::MessageFetchBroker(QObject *parent)
+    : QObject(parent)
+{
+}
+
+MessageFetchBroker::~MessageFetchBroker()
+{
+}
+
+MessageFetchBroker *MessageFetchBroker::self()
+{
+    return s_messageFetchBroker;
+}
+
+void MessageFetchBroker::addFetchJob(Akonadi::ItemFetchJob *job, const Akonadi::Item::List &items)
+{
+    QList<Akonadi::Item::Id> ids;
+    ids.reserve(items.count());
+    for (const Akonadi::Item &item : items) {
+        ids.append(item.id());
+        ++mRunningFetches[item.id()];
+    }
+    mJobItems.insert(job, ids);
+    connect(job, &Akonadi::ItemFetchJob::itemsReceived, this, &MessageFetchBroker::slotItemsReceived);
+    connect(job, &Akonadi::ItemFetchJob::result, this, &MessageFetchBroker::slotFetchDone);
+}
+
+bool MessageFetchBroker::isFetching(Akonadi::Item::Id id) const
+{
+    return mRunningFetches.contains(id) || mHeaderFetches.contains(id);
+}
+
+void MessageFetchBroker::requestHeaders(const Akonadi::Item &item)
+{
+    if (!item.isValid()) {
+        return;
+    }
+    // The reader usually starts its fetch right after the selection changed,
+    // so give it a chance before fetching the headers separately.
+    mWaitingItems.insert(item.id());
+    if (!mHeaderFetchScheduled) {
+        mHeaderFetchScheduled = true;
+        QTimer::singleShot(0, this, &MessageFetchBroker::slotStartHeaderFetches);
+    }
+}
+
+void MessageFetchBroker::cancelRequest(Akonadi::Item::Id id)
+{
+    mWaitingItems.remove(id);
+}
+
+void MessageFetchBroker::slotStartHeaderFetches()
+{
+    mHeaderFetchScheduled = false;
+    const QList<Akonadi::Item::Id> waitingItems = mWaitingItems.values();
+    for (Akonadi::Item::Id id : waitingItems) {
+        if (!mRunningFetches.contains(id)) {
+            mWaitingItems.remove(id);
+            if (!mHeaderFetches.contains(id)) {
+                fetchHeaders(id);
+            }
+        }
+    }
+}
+
+void MessageFetchBroker::fetchHeaders(Akonadi::Item::Id id)
+{
+    mHeaderFetches.insert(id);
+    Akonadi::ItemFetchJob *job = new Akonadi::ItemFetchJob(Akonadi::Item(id), this);
+    job->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Header);
+    job->fetchScope().fetchAttribute<Akonadi::EntityAnnotationsAttribute>();
+    job->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
+    job->setProperty("_itemId", id);
+    connect(job, &Akonadi::ItemFetchJob::result, this, &MessageFetchBroker::slotHeaderFetchDone);
+}
+
+void MessageFetchBroker::slotItemsReceived(const Akonadi::Item::List &items)
+{
+    for (const Akonadi::Item &item : items) {
+        if (mWaitingItems.remove(item.id())) {
+            Q_EMIT itemFetched(item);
+        }
+    }
+}
+
+void MessageFetchBroker::slotFetchDone(KJob *job)
+{
+    const QList<Akonadi::Item::Id> ids = mJobItems.take(job);
+    for (Akonadi::Item::Id id : ids) {
+        auto it = mRunningFetches.find(id);
+        if (it == mRunningFetches.end()) {
+            continue;
+        }
+        if (--it.value() > 0) {
+            continue;
+        }
+        mRunningFetches.erase(it);
+        // The message wasn't delivered, e.g. the resource is offline
+        if (mWaitingItems.remove(id) && !mHeaderFetches.contains(id)) {
+            fetchHeaders(id);
+        }
+    }
+}
+
+void MessageFetchBroker::slotHeaderFetchDone(KJob *job)
+{
+    mHeaderFetches.remove(job->property("_itemId").toLongLong());
+    if (job->error()) {
+        qCDebug(KMAIL_LOG) << "Unable to fetch message headers:" << job->errorString();
+        return;
+    }
+    const Akonadi::Item::List items = static_cast<Akonadi::ItemFetchJob *>(job)->items();
+    for (const Akonadi::Item &item : items) {
+        Q_EMIT itemFetched(item);
+    }
+}
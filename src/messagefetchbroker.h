@@ -0,0 +1,95 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef MESSAGEFETCHBROKER_H
+#define MESSAGEFETCHBROKER_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <AkonadiCore/Item>
+
+class KJob;
+namespace Akonadi {
+class ItemFetchJob;
+}
+
+namespace KMail {
+/**
+ * @short Shares the message fetches between the parts of the main window.
+ *
+ * The reader and the prefetcher announce their fetches of complete messages.
+ * Components which only need the headers of a message, like the mailing
+ * list actions, wait for such a fetch when one is running instead of
+ * fetching the message again, and otherwise fetch the headers only.
+ */
+class MessageFetchBroker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MessageFetchBroker(QObject *parent = nullptr);
+    ~MessageFetchBroker();
+
+    static MessageFetchBroker *self();
+
+    /**
+     * Announces @p job, fetching the complete messages @p items.
+     */
+    void addFetchJob(Akonadi::ItemFetchJob *job, const Akonadi::Item::List &items);
+
+    /**
+     * Asks for the headers of @p item, delivered through itemFetched().
+     */
+    void requestHeaders(const Akonadi::Item &item);
+
+    /**
+     * Withdraws a requestHeaders() for @p id, e.g. when the complete
+     * message turned up elsewhere.
+     */
+    void cancelRequest(Akonadi::Item::Id id);
+
+    /**
+     * Returns whether a fetch of @p id is running.
+     */
+    bool isFetching(Akonadi::Item::Id id) const;
+
+Q_SIGNALS:
+    /**
+     * Emitted with a requested message, which carries at least its headers.
+     */
+    void itemFetched(const Akonadi::Item &item);
+
+private:
+    Q_DISABLE_COPY(MessageFetchBroker)
+    void slotItemsReceived(const Akonadi::Item::List &items);
+    void slotFetchDone(KJob *job);
+    void slotHeaderFetchDone(KJob *job);
+    void slotStartHeaderFetches();
+    void fetchHeaders(Akonadi::Item::Id id);
+
+    // message -> number of running fetches of the complete message
+    QHash<Akonadi::Item::Id, int> mRunningFetches;
+    QHash<KJob *, QList<Akonadi::Item::Id> > mJobItems;
+    QSet<Akonadi::Item::Id> mWaitingItems;
+    QSet<Akonadi::Item::Id> mHeaderFetches;
+    bool mHeaderFetchScheduled = false;
+};
+}
+
+#endif // MESSAGEFETCHBROKER_H
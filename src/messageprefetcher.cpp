@@ -0,0 +1,272 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "messageprefetcher.h"
+#include "messagefetchbroker.h"
+#include "kmail_debug.h"
+
+#include <MessageViewer/Viewer>
+
+#include <AkonadiCore/EntityTreeModel>
+#include <AkonadiCore/ItemFetchJob>
+#include <AkonadiCore/Monitor>
+
+#include <KMime/Message>
+
+#include <QModelIndex>
+
+using namespace KMail;
+
+namespace {
+// Cost of a message whose size is unknown
+static const qint64 DefaultItemCost = 64 * 1024;
+// Rows visited at most for each wanted message, e.g. to skip group headers
+static const int MaximumStepsPerMessage = 10;
+
+QModelIndex nextIndex(const QModelIndex &index)
+{
+    const QAbstractItemModel *model = index.model();
+    if (model->rowCount(index) > 0) {
+        return model->index(0, 0, index);
+    }
+    QModelIndex current = index;
+    while (current.isValid()) {
+        const QModelIndex sibling = current.sibling(current.row() + 1, 0);
+        if (sibling.isValid()) {
+            return sibling;
+        }
+        current = current.parent();
+    }
+    return QModelIndex();
+}
+
+QModelIndex previousIndex(const QModelIndex &index)
+{
+    if (index.row() == 0) {
+        return index.parent();
+    }
+    const QAbstractItemModel *model = index.model();
+    QModelIndex current = index.sibling(index.row() - 1, 0);
+    while (model->rowCount(current) > 0) {
+        current = model->index(model->rowCount(current) - 1, 0, current);
+    }
+    return current;
+}
+
+Akonadi::Item::List collect(const QModelIndex &start, int count, QModelIndex (*step)(const QModelIndex &))
+{
+    Akonadi::Item::List items;
+    int steps = count * MaximumStepsPerMessage;
+    QModelIndex index = step(start);
+    while (index.isValid() && items.count() < count && steps-- > 0) {
+        const Akonadi::Item item = index.data(Akonadi::EntityTreeModel::ItemRole).value<Akonadi::Item>();
+        if (item.isValid()) {
+            items.append(item);
+        }
+        index = step(index);
+    }
+    return items;
+}
+}
+
+MessagePrefetcher::MessagePrefetcher(QObject *parent)
+    : QObject(parent)
+{
+}
+
+MessagePrefetcher::~MessagePrefetcher()
+{
+}
+
+void MessagePrefetcher::setViewer(MessageViewer::Viewer *viewer)
+{
+    mViewer = viewer;
+}
+
+void MessagePrefetcher::setMonitor(Akonadi::Monitor *monitor)
+{
+    connect(monitor, &Akonadi::Monitor::itemChanged, this, &MessagePrefetcher::slotItemChanged);
+    connect(monitor, &Akonadi::Monitor::itemRemoved, this, &MessagePrefetcher::slotItemChanged);
+    connect(monitor, &Akonadi::Monitor::itemMoved, this, &MessagePrefetcher::slotItemChanged);
+    connect(monitor, &Akonadi::Monitor::itemsFlagsChanged, this,
+            [this](const Akonadi::Item::List &items, const QSet<QByteArray> &addedFlags, const QSet<QByteArray> &removedFlags) {
+        // Keep the payload, only the flags changed
+        for (const Akonadi::Item &item : items) {
+            const auto it = mCache.find(item.id());
+            if (it != mCache.end()) {
+                for (const QByteArray &flag : addedFlags) {
+                    it->setFlag(flag);
+                }
+                for (const QByteArray &flag : removedFlags) {
+                    it->clearFlag(flag);
+                }
+            }
+        }
+    });
+}
+
+void MessagePrefetcher::setWindow(int before, int after)
+{
+    mBefore = qMax(0, before);
+    mAfter = qMax(0, after);
+}
+
+void MessagePrefetcher::setMemoryBudget(qint64 bytes)
+{
+    mMemoryBudget = bytes;
+    trim();
+}
+
+qint64 MessagePrefetcher::memoryBudget() const
+{
+    return mMemoryBudget;
+}
+
+Akonadi::Item MessagePrefetcher::cachedItem(Akonadi::Item::Id id) const
+{
+    return mCache.value(id);
+}
+
+Akonadi::Item::List MessagePrefetcher::neighbours(const QModelIndex &current, int before, int after)
+{
+    if (!current.isValid()) {
+        return Akonadi::Item::List();
+    }
+    const QModelIndex index = current.sibling(current.row(), 0);
+    const Akonadi::Item::List next = collect(index, after, nextIndex);
+    const Akonadi::Item::List previous = collect(index, before, previousIndex);
+
+    // The closest first, preferring the reading direction
+    Akonadi::Item::List items;
+    items.reserve(next.count() + previous.count());
+    for (int i = 0, total = qMax(next.count(), previous.count()); i < total; ++i) {
+        if (i < next.count()) {
+            items.append(next.at(i));
+        }
+        if (i < previous.count()) {
+            items.append(previous.at(i));
+        }
+    }
+    return items;
+}
+
+void MessagePrefetcher::setCurrent(const Akonadi::Item &item, const QModelIndex &current)
+{
+    mWindow.clear();
+    mWindow.append(item);
+    mWindow += neighbours(current, mBefore, mAfter);
+
+    QSet<Akonadi::Item::Id> wanted;
+    for (const Akonadi::Item &windowItem : qAsConst(mWindow)) {
+        wanted.insert(windowItem.id());
+    }
+    const QList<Akonadi::Item::Id> cachedIds = mCache.keys();
+    for (Akonadi::Item::Id id : cachedIds) {
+        if (!wanted.contains(id)) {
+            remove(id);
+        }
+    }
+
+    if (item.hasPayload<KMime::Message::Ptr>()) {
+        insert(item);
+    }
+    if (!mViewer) {
+        return;
+    }
+    for (const Akonadi::Item &windowItem : qAsConst(mWindow)) {
+        const Akonadi::Item::Id id = windowItem.id();
+        if (mCache.contains(id) || mPendingFetches.contains(id) || id == item.id()) {
+            continue;
+        }
+        mPendingFetches.insert(id);
+        Akonadi::ItemFetchJob *job = mViewer->createFetchJob(windowItem);
+        MessageFetchBroker::self()->addFetchJob(job, Akonadi::Item::List() << windowItem);
+        job->setProperty("_itemId", id);
+        connect(job, &Akonadi::ItemFetchJob::itemsReceived, this, &MessagePrefetcher::slotItemReceived);
+        connect(job, &Akonadi::ItemFetchJob::result, this, &MessagePrefetcher::slotFetchDone);
+    }
+}
+
+void MessagePrefetcher::slotItemReceived(const Akonadi::Item::List &items)
+{
+    for (const Akonadi::Item &item : items) {
+        // The user may have moved on in the meantime
+        for (const Akonadi::Item &windowItem : qAsConst(mWindow)) {
+            if (windowItem.id() == item.id()) {
+                insert(item);
+                break;
+            }
+        }
+    }
+}
+
+void MessagePrefetcher::slotFetchDone(KJob *job)
+{
+    if (job->error()) {
+        qCDebug(KMAIL_LOG) << "Unable to prefetch message:" << job->errorString();
+    }
+    mPendingFetches.remove(job->property("_itemId").toLongLong());
+}
+
+void MessagePrefetcher::slotItemChanged(const Akonadi::Item &item)
+{
+    remove(item.id());
+}
+
+qint64 MessagePrefetcher::itemCost(const Akonadi::Item &item)
+{
+    return item.size() > 0 ? item.size() : DefaultItemCost;
+}
+
+void MessagePrefetcher::insert(const Akonadi::Item &item)
+{
+    if (!item.hasPayload<KMime::Message::Ptr>()) {
+        return;
+    }
+    remove(item.id());
+    mCache.insert(item.id(), item);
+    mCacheSize += itemCost(item);
+    trim();
+}
+
+void MessagePrefetcher::remove(Akonadi::Item::Id id)
+{
+    const auto it = mCache.find(id);
+    if (it != mCache.end()) {
+        mCacheSize -= itemCost(it.value());
+        mCache.erase(it);
+    }
+}
+
+void MessagePrefetcher::trim()
+{
+    // Evict the messages the furthest from the current one first
+    for (int i = mWindow.count() - 1; i >= 0 && mCacheSize > mMemoryBudget; --i) {
+        remove(mWindow.at(i).id());
+    }
+    if (mCacheSize > mMemoryBudget) {
+        clear();
+    }
+}
+
+void MessagePrefetcher::clear()
+{
+    mCache.clear();
+    mCacheSize = 0;
+}
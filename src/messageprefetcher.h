@@ -0,0 +1,122 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef MESSAGEPREFETCHER_H
+#define MESSAGEPREFETCHER_H
+
+#include <QObject>
+#include <QHash>
+#include <QPointer>
+#include <QSet>
+#include <AkonadiCore/Item>
+
+class KJob;
+class QModelIndex;
+namespace Akonadi {
+class Monitor;
+}
+namespace MessageViewer {
+class Viewer;
+}
+
+namespace KMail {
+/**
+ * @short Keeps the messages around the current one fetched and parsed.
+ *
+ * The main widget asks for the messages before and after the selected one
+ * in the order of the message list. They are fetched in the background with
+ * the fetch scope of the viewer and kept within a memory budget, so stepping
+ * to a neighbouring message doesn't wait for Akonadi.
+ *
+ * Messages changed, moved or removed are dropped from the cache.
+ */
+class MessagePrefetcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MessagePrefetcher(QObject *parent = nullptr);
+    ~MessagePrefetcher();
+
+    /**
+     * Sets the viewer whose fetch scope is used for the prefetched messages.
+     */
+    void setViewer(MessageViewer::Viewer *viewer);
+
+    /**
+     * Sets the monitor reporting changes of the cached messages.
+     */
+    void setMonitor(Akonadi::Monitor *monitor);
+
+    /**
+     * Sets the number of messages kept before and after the current one.
+     */
+    void setWindow(int before, int after);
+
+    /**
+     * Sets the total size in bytes of the cached messages.
+     */
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const;
+
+    /**
+     * Returns the cached message @p id, or an invalid item.
+     */
+    Akonadi::Item cachedItem(Akonadi::Item::Id id) const;
+
+    /**
+     * Makes @p current the current message and prefetches its neighbours in
+     * the model of @p current, walking it in display order. @p item is
+     * cached when it carries its payload.
+     */
+    void setCurrent(const Akonadi::Item &item, const QModelIndex &current);
+
+    /**
+     * Drops all cached messages.
+     */
+    void clear();
+
+    /**
+     * Returns up to @p before messages displayed before @p current and
+     * @p after messages displayed after it, the closest first.
+     */
+    static Akonadi::Item::List neighbours(const QModelIndex &current, int before, int after);
+
+private:
+    Q_DISABLE_COPY(MessagePrefetcher)
+    void slotItemReceived(const Akonadi::Item::List &items);
+    void slotFetchDone(KJob *job);
+    void slotItemChanged(const Akonadi::Item &item);
+    void insert(const Akonadi::Item &item);
+    void remove(Akonadi::Item::Id id);
+    void trim();
+    static qint64 itemCost(const Akonadi::Item &item);
+
+    QHash<Akonadi::Item::Id, Akonadi::Item> mCache;
+    // messages wanted in the cache, the closest to the current one first
+    Akonadi::Item::List mWindow;
+    QSet<Akonadi::Item::Id> mPendingFetches;
+    QPointer<MessageViewer::Viewer> mViewer;
+    qint64 mMemoryBudget = 32 * 1024 * 1024;
+    qint64 mCacheSize = 0;
+    int mBefore = 1;
+    int mAfter = 2;
+};
+}
+
+#endif // MESSAGEPREFETCHER_H
@@ -21,11 +21,8 @@
 #include "kmail_debug.h"
 #include <AkonadiSearch/PIM/indexeditems.h>
 
-#include <AkonadiCore/CollectionFetchJob>
-#include <AkonadiCore/CollectionFetchScope>
-#include <AkonadiCore/CollectionStatistics>
-
-#include <PimCommon/PimUtil>
+#include <AkonadiCore/ItemFetchJob>
+#include <AkonadiCore/ItemFetchScope>
 
 CheckIndexingJob::CheckIndexingJob(Akonadi::Search::PIM::IndexedItems *indexedItems, QObject *parent)
     : QObject(parent)
@@ -48,36 +45,59 @@ void CheckIndexingJob::setCollection(const Akonadi::Collection &col)
     mCollection = col;
 }
 
+int CheckIndexingJob::itemCount() const
+{
+    return mItemIds.count();
+}
+
 void CheckIndexingJob::start()
 {
     if (mCollection.isValid()) {
-        Akonadi::CollectionFetchJob *fetch = new Akonadi::CollectionFetchJob(mCollection,
-                                                                             Akonadi::CollectionFetchJob::Base);
-        fetch->fetchScope().setIncludeStatistics(true);
-        connect(fetch, &KJob::result, this, &CheckIndexingJob::slotCollectionPropertiesFinished);
+        // Only the identifiers are needed, don't ask the resource for anything
+        Akonadi::ItemFetchJob *fetch = new Akonadi::ItemFetchJob(mCollection, this);
+        fetch->fetchScope().fetchFullPayload(false);
+        fetch->fetchScope().fetchAllAttributes(false);
+        fetch->fetchScope().setCacheOnly(true);
+        fetch->fetchScope().setFetchModificationTime(false);
+        fetch->fetchScope().setFetchRemoteIdentification(false);
+        fetch->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::None);
+        fetch->setDeliveryOption(Akonadi::ItemFetchJob::EmitItemsInBatches);
+        connect(fetch, &Akonadi::ItemFetchJob::itemsReceived, this, &CheckIndexingJob::slotItemsReceived);
+        connect(fetch, &KJob::result, this, &CheckIndexingJob::slotItemFetchFinished);
     } else {
         qCWarning(KMAIL_LOG) << "Collection was not valid";
         askForNextCheck(-1);
     }
 }
 
-void CheckIndexingJob::slotCollectionPropertiesFinished(KJob *job)
+void CheckIndexingJob::slotItemsReceived(const Akonadi::Item::List &items)
 {
-    Akonadi::CollectionFetchJob *fetch = qobject_cast<Akonadi::CollectionFetchJob *>(job);
-    Q_ASSERT(fetch);
-    if (fetch->collections().isEmpty()) {
-        qCWarning(KMAIL_LOG) << "No collection fetched";
+    mItemIds.reserve(mItemIds.count() + items.count());
+    for (const Akonadi::Item &item : items) {
+        mItemIds.insert(item.id());
+    }
+}
+
+void CheckIndexingJob::slotItemFetchFinished(KJob *job)
+{
+    if (job->error()) {
+        qCWarning(KMAIL_LOG) << "Unable to fetch the messages of" << mCollection.id() << job->errorString();
         askForNextCheck(-1);
         return;
     }
 
-    mCollection = fetch->collections().constFirst();
-    const qlonglong result = mIndexedItems->indexedItems(mCollection.id());
-    bool needToReindex = false;
-    qCDebug(KMAIL_LOG) << "name :" << mCollection.name() << " mCollection.statistics().count() " << mCollection.statistics().count() << "stats.value(mCollection.id())" << result;
-    if (mCollection.statistics().count() != result) {
-        needToReindex = true;
-        qCDebug(KMAIL_LOG) << "Reindex collection :" << "name :" << mCollection.name();
+    QSet<Akonadi::Item::Id> indexed;
+    mIndexedItems->findIndexed(indexed, mCollection.id());
+
+    int missing = 0;
+    for (Akonadi::Item::Id id : qAsConst(mItemIds)) {
+        if (!indexed.contains(id)) {
+            ++missing;
+        }
     }
+    // indexed messages which are not in the folder anymore
+    const int stale = indexed.count() - (mItemIds.count() - missing);
+    const bool needToReindex = (missing > 0 || stale > 0);
+    qCDebug(KMAIL_LOG) << "collection :" << mCollection.id() << "messages :" << mItemIds.count() << "not indexed :" << missing << "stale :" << stale;
     askForNextCheck(mCollection.id(), needToReindex);
 }
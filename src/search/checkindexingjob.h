@@ -21,7 +21,9 @@
 #define CHECKINDEXINGJOB_H
 
 #include <QObject>
+#include <QSet>
 #include <AkonadiCore/Collection>
+#include <AkonadiCore/Item>
 namespace Akonadi {
 namespace Search {
 namespace PIM {
@@ -30,6 +32,14 @@ class IndexedItems;
 }
 }
 class KJob;
+/**
+ * @short Compares the messages of a folder with the indexed ones.
+ *
+ * The identifiers of the messages stored in the folder are compared with
+ * the identifiers known to the search index, so a folder where as many
+ * messages were removed from the index as were missing from it is still
+ * reported.
+ */
 class CheckIndexingJob : public QObject
 {
     Q_OBJECT
@@ -41,14 +51,21 @@ public:
 
     void start();
 
+    /**
+     * Returns the number of messages of the folder, valid once finished.
+     */
+    int itemCount() const;
+
 Q_SIGNALS:
     void finished(Akonadi::Collection::Id id, bool needToReindex);
 
 private:
     Q_DISABLE_COPY(CheckIndexingJob)
-    void slotCollectionPropertiesFinished(KJob *job);
+    void slotItemsReceived(const Akonadi::Item::List &items);
+    void slotItemFetchFinished(KJob *job);
     void askForNextCheck(quint64 id, bool needToReindex = false);
     Akonadi::Collection mCollection;
+    QSet<Akonadi::Item::Id> mItemIds;
     Akonadi::Search::PIM::IndexedItems *mIndexedItems = nullptr;
 };
 
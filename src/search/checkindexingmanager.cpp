@@ -25,6 +25,7 @@
 #include <KSharedConfig>
 #include <KConfigGroup>
 #include <AkonadiCore/ServerManager>
+#include <MailCommon/MailKernel>
 #include <MailCommon/MailUtil>
 #include <PimCommon/PimUtil>
 #include <PimCommonAkonadi/MailUtil>
@@ -34,61 +35,163 @@
 #include <QDBusPendingCall>
 #include <AkonadiCore/entityhiddenattribute.h>
 
+namespace {
+// Leave the indexer some time to catch up with the changes of a folder
+static const int SettleDelay = 5 * 60;
+// Delay before a folder found inconsistent is checked again
+static const int RecheckDelay = 10 * 60;
+}
+
 CheckIndexingManager::CheckIndexingManager(Akonadi::Search::PIM::IndexedItems *indexer, QObject *parent)
     : QObject(parent)
     , mIndexedItems(indexer)
 {
     mTimer = new QTimer(this);
     mTimer->setSingleShot(true);
-    mTimer->setInterval(5 * 1000); //5 secondes
     connect(mTimer, &QTimer::timeout, this, &CheckIndexingManager::checkNextCollection);
 }
 
 CheckIndexingManager::~CheckIndexingManager()
 {
     callToReindexCollection();
+    if (mStarted) {
+        saveState();
+    }
+}
+
+void CheckIndexingManager::start(QAbstractItemModel *collectionModel)
+{
+    // Once started, changes are followed through the change notifications
+    if (mStarted || !collectionModel) {
+        return;
+    }
+    mStarted = true;
+
     const KSharedConfig::Ptr cfg = KSharedConfig::openConfig(QStringLiteral("kmailsearchindexingrc"));
     KConfigGroup grp = cfg->group(QStringLiteral("General"));
-    grp.writeEntry(QStringLiteral("collectionsIndexed"), mCollectionsIndexed);
+    // Settings of the former weekly check
+    grp.deleteEntry(QStringLiteral("lastCheck"));
+    grp.deleteEntry(QStringLiteral("collectionsIndexed"));
+
+    const KConfigGroup verifiedGroup = cfg->group(QStringLiteral("VerifiedCollections"));
+    const QMap<QString, QString> entries = verifiedGroup.entryMap();
+    for (auto it = entries.constBegin(), end = entries.constEnd(); it != end; ++it) {
+        mVerifiedCollections.insert(it.key().toLongLong(), it.value().toLongLong());
+    }
+
+    initializeCollectionList(collectionModel);
+    qCDebug(KMAIL_LOG) << "Number of collection to check " << mPendingCollections.count();
+    scheduleTimer();
 }
 
-void CheckIndexingManager::start(QAbstractItemModel *collectionModel)
+void CheckIndexingManager::stop()
 {
-    if (mIsReady) {
-        const KSharedConfig::Ptr cfg = KSharedConfig::openConfig(QStringLiteral("kmailsearchindexingrc"));
-        KConfigGroup grp = cfg->group(QStringLiteral("General"));
-        const QDateTime lastDateTime = grp.readEntry(QStringLiteral("lastCheck"), QDateTime());
-        //Check each 7 days
-        QDateTime today = QDateTime::currentDateTime();
-        if (!lastDateTime.isValid() || today > lastDateTime.addDays(7)) {
-            mIndex = 0;
-            mListCollection.clear();
-            mCollectionsIndexed = grp.readEntry(QStringLiteral("collectionsIndexed"), QList<qint64>());
-            if (collectionModel) {
-                initializeCollectionList(collectionModel);
-                if (!mListCollection.isEmpty()) {
-                    qCDebug(KMAIL_LOG) << "Number of collection to check " << mListCollection.count();
-                    mIsReady = false;
-                    mTimer->start();
-                }
-            }
-        }
+    if (!mStarted) {
+        return;
     }
+    mStarted = false;
+    mTimer->stop();
+    callToReindexCollection();
+    mCollectionsNeedToBeReIndexed.clear();
+    saveState();
+    // found again by start() from the verified counts
+    mPendingCollections.clear();
+    mKnownCounts.clear();
+    mSuspectCollections.clear();
+    mVerifiedCollections.clear();
 }
 
-void CheckIndexingManager::createJob()
+bool CheckIndexingManager::canCheckCollection(const Akonadi::Collection &collection)
 {
-    CheckIndexingJob *job = new CheckIndexingJob(mIndexedItems, this);
-    job->setCollection(mListCollection.at(mIndex));
-    connect(job, &CheckIndexingJob::finished, this, &CheckIndexingManager::indexingFinished);
-    job->start();
+    if (!collection.isValid() || MailCommon::Util::isVirtualCollection(collection)) {
+        return false;
+    }
+    if (collection.hasAttribute<Akonadi::EntityHiddenAttribute>()) {
+        return false;
+    }
+    if (PimCommon::Util::isImapResource(collection.resource()) && !collection.cachePolicy().localParts().contains(QLatin1String("RFC822"))) {
+        return false;
+    }
+    return true;
+}
+
+void CheckIndexingManager::slotCollectionStatisticsChanged(Akonadi::Collection::Id id, const Akonadi::CollectionStatistics &statistics)
+{
+    if (!mStarted) {
+        return;
+    }
+    // Flag changes don't change what is indexed
+    const auto it = mKnownCounts.constFind(id);
+    if (it != mKnownCounts.constEnd() && it.value() == statistics.count()) {
+        return;
+    }
+    mKnownCounts.insert(id, statistics.count());
+    if (!canCheckCollection(CommonKernel->collectionFromId(id))) {
+        return;
+    }
+    schedule(id, SettleDelay);
+}
+
+void CheckIndexingManager::slotCollectionRemoved(const Akonadi::Collection &collection)
+{
+    const Akonadi::Collection::Id id = collection.id();
+    mPendingCollections.remove(id);
+    mVerifiedCollections.remove(id);
+    mKnownCounts.remove(id);
+    mSuspectCollections.remove(id);
+    mCollectionsNeedToBeReIndexed.removeAll(id);
+}
+
+void CheckIndexingManager::schedule(Akonadi::Collection::Id id, int delay)
+{
+    // Postponed again by every new change
+    mPendingCollections.insert(id, QDateTime::currentDateTime().addSecs(delay));
+    scheduleTimer();
+}
+
+void CheckIndexingManager::scheduleTimer()
+{
+    if (mCurrentCollection != -1) {
+        // rescheduled when the running check is done
+        return;
+    }
+    if (mPendingCollections.isEmpty()) {
+        mTimer->stop();
+        return;
+    }
+    QDateTime next;
+    for (auto it = mPendingCollections.constBegin(), end = mPendingCollections.constEnd(); it != end; ++it) {
+        if (!next.isValid() || it.value() < next) {
+            next = it.value();
+        }
+    }
+    mTimer->start(qMax<qint64>(0, QDateTime::currentDateTime().msecsTo(next)));
 }
 
 void CheckIndexingManager::checkNextCollection()
 {
-    if (mIndex < mListCollection.count()) {
-        createJob();
+    const QDateTime now = QDateTime::currentDateTime();
+    Akonadi::Collection::Id id = -1;
+    QDateTime due;
+    for (auto it = mPendingCollections.constBegin(), end = mPendingCollections.constEnd(); it != end; ++it) {
+        if (it.value() <= now && (!due.isValid() || it.value() < due)) {
+            id = it.key();
+            due = it.value();
+        }
+    }
+    if (id == -1) {
+        scheduleTimer();
+        return;
     }
+    mPendingCollections.remove(id);
+    mCurrentCollection = id;
+
+    CheckIndexingJob *job = new CheckIndexingJob(mIndexedItems, this);
+    job->setCollection(Akonadi::Collection(id));
+    connect(job, &CheckIndexingJob::finished, this, [this, job](Akonadi::Collection::Id index, bool reindexCollection) {
+        indexingFinished(index, reindexCollection, job->itemCount());
+    });
+    job->start();
 }
 
 void CheckIndexingManager::callToReindexCollection()
@@ -97,44 +200,74 @@ void CheckIndexingManager::callToReindexCollection()
         QDBusInterface interfaceAkonadiIndexer(PimCommon::MailUtil::indexerServiceName(), QStringLiteral("/"),
                                                QStringLiteral("org.freedesktop.Akonadi.Indexer"));
         if (interfaceAkonadiIndexer.isValid()) {
-            qCDebug(KMAIL_LOG) << "Reindex collections :" << mCollectionsIndexed;
+            qCDebug(KMAIL_LOG) << "Reindex collections :" << mCollectionsNeedToBeReIndexed;
             interfaceAkonadiIndexer.asyncCall(QStringLiteral("reindexCollections"), QVariant::fromValue(mCollectionsNeedToBeReIndexed));
         }
     }
 }
 
-void CheckIndexingManager::indexingFinished(qint64 index, bool reindexCollection)
+void CheckIndexingManager::indexingFinished(qint64 index, bool reindexCollection, int itemCount)
 {
-    if (index != -1) {
-        if (!mCollectionsIndexed.contains(index)) {
-            mCollectionsIndexed.append(index);
-        }
+    const Akonadi::Collection::Id checkedCollection = mCurrentCollection;
+    mCurrentCollection = -1;
+    if (!mStarted) {
+        // stopped while checking
+        return;
     }
-    if (reindexCollection) {
-        if (!mCollectionsNeedToBeReIndexed.contains(index)) {
-            mCollectionsNeedToBeReIndexed.append(index);
+    if (index == -1) {
+        // The check itself failed, try again later
+        if (checkedCollection != -1 && CommonKernel->collectionFromId(checkedCollection).isValid()
+            && !mPendingCollections.contains(checkedCollection)) {
+            schedule(checkedCollection, RecheckDelay);
+        }
+    } else if (CommonKernel->collectionFromId(index).isValid()) {
+        // The collection may have been removed in the meantime
+        if (!reindexCollection) {
+            mSuspectCollections.remove(index);
+            mVerifiedCollections.insert(index, itemCount);
+        } else if (mSuspectCollections.contains(index)) {
+            // Still different after the indexer had time to catch up
+            qCDebug(KMAIL_LOG) << "Reindex collection :" << index;
+            mSuspectCollections.remove(index);
+            mVerifiedCollections.remove(index);
+            if (!mCollectionsNeedToBeReIndexed.contains(index)) {
+                mCollectionsNeedToBeReIndexed.append(index);
+            }
+        } else {
+            mSuspectCollections.insert(index);
+            if (!mPendingCollections.contains(index)) {
+                schedule(index, RecheckDelay);
+            }
         }
-        if (mCollectionsNeedToBeReIndexed.count() > 30) {
-            callToReindexCollection();
-            mCollectionsNeedToBeReIndexed.clear();
+    }
+
+    bool busy = false;
+    const QDateTime now = QDateTime::currentDateTime();
+    for (const QDateTime &due : qAsConst(mPendingCollections)) {
+        if (due <= now) {
+            busy = true;
+            break;
         }
     }
-    mIndex++;
-    if (mIndex < mListCollection.count()) {
-        mTimer->start();
-    } else {
-        mIsReady = true;
-        mIndex = 0;
+    if (mCollectionsNeedToBeReIndexed.count() > 30 || !busy) {
         callToReindexCollection();
-        mListCollection.clear();
         mCollectionsNeedToBeReIndexed.clear();
+    }
+    if (!busy) {
+        saveState();
+    }
+    scheduleTimer();
+}
 
-        const KSharedConfig::Ptr cfg = KSharedConfig::openConfig(QStringLiteral("kmailsearchindexingrc"));
-        KConfigGroup grp = cfg->group(QStringLiteral("General"));
-        grp.writeEntry(QStringLiteral("lastCheck"), QDateTime::currentDateTime());
-        grp.deleteEntry(QStringLiteral("collectionsIndexed"));
-        grp.sync();
+void CheckIndexingManager::saveState()
+{
+    const KSharedConfig::Ptr cfg = KSharedConfig::openConfig(QStringLiteral("kmailsearchindexingrc"));
+    KConfigGroup grp = cfg->group(QStringLiteral("VerifiedCollections"));
+    grp.deleteGroup();
+    for (auto it = mVerifiedCollections.constBegin(), end = mVerifiedCollections.constEnd(); it != end; ++it) {
+        grp.writeEntry(QString::number(it.key()), it.value());
     }
+    grp.sync();
 }
 
 void CheckIndexingManager::initializeCollectionList(QAbstractItemModel *model, const QModelIndex &parentIndex)
@@ -146,17 +279,15 @@ void CheckIndexingManager::initializeCollectionList(QAbstractItemModel *model, c
             = model->data(
             index, Akonadi::EntityTreeModel::CollectionRole).value<Akonadi::Collection>();
 
-        if (!collection.isValid() || MailCommon::Util::isVirtualCollection(collection)) {
-            continue;
-        }
-        if (collection.hasAttribute<Akonadi::EntityHiddenAttribute>()) {
-            continue;
-        }
-        if (PimCommon::Util::isImapResource(collection.resource()) && !collection.cachePolicy().localParts().contains(QLatin1String("RFC822"))) {
+        if (!canCheckCollection(collection)) {
             continue;
         }
-        if (!mCollectionsIndexed.contains(collection.id())) {
-            mListCollection.append(collection);
+        const qint64 count = collection.statistics().count();
+        mKnownCounts.insert(collection.id(), count);
+        // Only check what changed since the last verification
+        const auto it = mVerifiedCollections.constFind(collection.id());
+        if (count < 0 || it == mVerifiedCollections.constEnd() || it.value() != count) {
+            mPendingCollections.insert(collection.id(), QDateTime::currentDateTime());
         }
         if (model->rowCount(index) > 0) {
             initializeCollectionList(model, index);
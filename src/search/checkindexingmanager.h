@@ -21,7 +21,11 @@
 #define CHECKINDEXINGMANAGER_H
 
 #include <QObject>
+#include <QHash>
+#include <QDateTime>
+#include <QSet>
 #include <AkonadiCore/Collection>
+#include <AkonadiCore/CollectionStatistics>
 #include <QAbstractItemModel>
 namespace Akonadi {
 namespace Search {
@@ -31,6 +35,15 @@ class IndexedItems;
 }
 }
 class QTimer;
+/**
+ * @short Keeps the search index consistent with the mail folders.
+ *
+ * Once started, all folders whose number of messages changed since they
+ * were last verified are checked. Afterwards the folders are checked again
+ * when their statistics change, once the changes settled down so the
+ * indexer could catch up. A folder whose messages differ from the indexed
+ * ones on two checks in a row is reindexed.
+ */
 class CheckIndexingManager : public QObject
 {
     Q_OBJECT
@@ -39,24 +52,41 @@ public:
     ~CheckIndexingManager();
 
     void start(QAbstractItemModel *collectionModel);
+    /**
+     * Stops checking, start() checks the changed folders again.
+     */
+    void stop();
+
+    static bool canCheckCollection(const Akonadi::Collection &collection);
+
+public Q_SLOTS:
+    void slotCollectionStatisticsChanged(Akonadi::Collection::Id id, const Akonadi::CollectionStatistics &statistics);
+    void slotCollectionRemoved(const Akonadi::Collection &collection);
 
 private:
     Q_DISABLE_COPY(CheckIndexingManager)
     void checkNextCollection();
 
-    void indexingFinished(qint64 index, bool reindexCollection);
+    void indexingFinished(qint64 index, bool reindexCollection, int itemCount);
 
     void initializeCollectionList(QAbstractItemModel *model, const QModelIndex &parentIndex = QModelIndex());
-    void createJob();
+    void schedule(Akonadi::Collection::Id id, int delay);
+    void scheduleTimer();
     void callToReindexCollection();
+    void saveState();
 
     Akonadi::Search::PIM::IndexedItems *mIndexedItems = nullptr;
-    Akonadi::Collection::List mListCollection;
     QTimer *mTimer = nullptr;
-    QList<qint64> mCollectionsIndexed;
+    // collection -> time from which it can be checked
+    QHash<Akonadi::Collection::Id, QDateTime> mPendingCollections;
+    // collection -> number of messages when it was last found consistent
+    QHash<Akonadi::Collection::Id, qint64> mVerifiedCollections;
+    // collection -> number of messages last reported by a change notification
+    QHash<Akonadi::Collection::Id, qint64> mKnownCounts;
+    QSet<Akonadi::Collection::Id> mSuspectCollections;
     QList<qint64> mCollectionsNeedToBeReIndexed;
-    int mIndex = 0;
-    bool mIsReady = true;
+    Akonadi::Collection::Id mCurrentCollection = -1;
+    bool mStarted = false;
 };
 
 #endif // CHECKINDEXINGMANAGER_H
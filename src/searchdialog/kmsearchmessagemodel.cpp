@@ -31,6 +31,7 @@
 
 #include <MessageCore/StringUtil>
 
+#include <AkonadiCore/itemfetchjob.h>
 #include <AkonadiCore/itemfetchscope.h>
 #include <AkonadiCore/monitor.h>
 #include <AkonadiCore/session.h>
@@ -41,25 +42,181 @@
 #include <QColor>
 #include <QApplication>
 #include <QPalette>
+#include <QTimer>
 #include "kmail_debug.h"
 #include <KLocalizedString>
 #include <KFormat>
 
+// Rows whose envelopes are fetched together
+static const int s_envelopePageSize = 100;
+// Tooltips with preview kept around
+static const int s_toolTipCacheSize = 50;
+// Delay in ms before asking again for an envelope the server didn't deliver
+static const qint64 s_retryInterval = 60 * 1000;
+
 KMSearchMessageModel::KMSearchMessageModel(QObject *parent)
     : Akonadi::MessageModel(parent)
+    , mFetchTimer(new QTimer(this))
 {
-    fetchScope().fetchFullPayload();
+    // The envelopes are fetched on demand, see envelope()
+    fetchScope().fetchFullPayload(false);
     fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::All);
+
+    mEnvelopes.setMaxCost(16 * 1024 * 1024);
+    mToolTips.setMaxCost(s_toolTipCacheSize);
+    mFetchTimer->setSingleShot(true);
+    mFetchTimer->setInterval(0);
+    connect(mFetchTimer, &QTimer::timeout, this, &KMSearchMessageModel::fetchRequestedEnvelopes);
+    connect(this, &KMSearchMessageModel::dataChanged, this, &KMSearchMessageModel::slotDataChanged);
+    mClock.start();
 }
 
 KMSearchMessageModel::~KMSearchMessageModel()
 {
 }
 
-static QString toolTip(const Akonadi::Item &item)
+void KMSearchMessageModel::setMemoryBudget(int bytes)
+{
+    mEnvelopes.setMaxCost(bytes);
+}
+
+int KMSearchMessageModel::memoryBudget() const
 {
-    KMime::Message::Ptr msg = item.payload<KMime::Message::Ptr>();
+    return mEnvelopes.maxCost();
+}
+
+const KMSearchMessageModel::Envelope *KMSearchMessageModel::envelope(const QModelIndex &index, const Akonadi::Item &item) const
+{
+    const Envelope *result = mEnvelopes.object(item.id());
+    if (result || mFetchingEnvelopes.contains(item.id())) {
+        return result;
+    }
+    const auto it = mUnavailable.constFind(item.id());
+    if (it != mUnavailable.constEnd()) {
+        if (mClock.elapsed() - it.value() < s_retryInterval) {
+            return nullptr;
+        }
+        mUnavailable.erase(it);
+    }
+    mRequestedRows.insert(index.row());
+    mFetchTimer->start();
+    return nullptr;
+}
+
+void KMSearchMessageModel::slotDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    if (mEmittingRowChange) {
+        return;
+    }
+    // The item changed on the server, forget what was fetched for it
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        const Akonadi::Item::Id id = itemForIndex(index(row, 0)).id();
+        mEnvelopes.remove(id);
+        mToolTips.remove(id);
+        mUnavailable.remove(id);
+    }
+}
 
+void KMSearchMessageModel::fetchRequestedEnvelopes()
+{
+    // Fetch the pages around the requested rows, which are usually the
+    // visible ones, so scrolling doesn't fetch row by row.
+    QSet<int> pages;
+    for (int row : qAsConst(mRequestedRows)) {
+        pages.insert(row / s_envelopePageSize);
+    }
+    mRequestedRows.clear();
+
+    const int rows = rowCount();
+    for (int page : qAsConst(pages)) {
+        Akonadi::Item::List items;
+        for (int row = page * s_envelopePageSize, end = qMin(rows, row + s_envelopePageSize); row < end; ++row) {
+            const Akonadi::Item item = itemForIndex(index(row, 0));
+            if (item.isValid() && !mEnvelopes.contains(item.id())
+                && !mFetchingEnvelopes.contains(item.id()) && !mUnavailable.contains(item.id())) {
+                mFetchingEnvelopes.insert(item.id());
+                items.append(item);
+            }
+        }
+        if (items.isEmpty()) {
+            continue;
+        }
+        Akonadi::ItemFetchJob *job = new Akonadi::ItemFetchJob(items, this);
+        job->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Envelope);
+        job->fetchScope().setIgnoreRetrievalErrors(true);
+        connect(job, &Akonadi::ItemFetchJob::result, this, &KMSearchMessageModel::slotEnvelopesFetched);
+        job->setProperty("_items", QVariant::fromValue(items));
+    }
+}
+
+void KMSearchMessageModel::slotEnvelopesFetched(KJob *job)
+{
+    Akonadi::ItemFetchJob *fetchJob = static_cast<Akonadi::ItemFetchJob *>(job);
+    if (job->error()) {
+        qCDebug(KMAIL_LOG) << "Unable to fetch the envelopes:" << job->errorString();
+    }
+    const Akonadi::Item::List items = fetchJob->items();
+    for (const Akonadi::Item &item : items) {
+        mFetchingEnvelopes.remove(item.id());
+        if (!item.hasPayload<KMime::Message::Ptr>()) {
+            mUnavailable.insert(item.id(), mClock.elapsed());
+            continue;
+        }
+        const KMime::Message::Ptr msg = item.payload<KMime::Message::Ptr>();
+        Envelope *envelope = new Envelope;
+        envelope->subject = msg->subject()->asUnicodeString();
+        envelope->from = msg->from()->asUnicodeString();
+        envelope->to = msg->to()->asUnicodeString();
+        envelope->date = msg->date()->dateTime();
+        const int cost = static_cast<int>(sizeof(Envelope))
+                         + 2 * (envelope->subject.size() + envelope->from.size() + envelope->to.size());
+        mEnvelopes.insert(item.id(), envelope, cost);
+        emitRowChanged(item);
+    }
+    // Don't ask again right away for messages the server didn't deliver
+    const Akonadi::Item::List requested = job->property("_items").value<Akonadi::Item::List>();
+    for (const Akonadi::Item &item : requested) {
+        if (mFetchingEnvelopes.remove(item.id())) {
+            mUnavailable.insert(item.id(), mClock.elapsed());
+        }
+    }
+}
+
+void KMSearchMessageModel::slotMessageFetched(KJob *job)
+{
+    const Akonadi::Item::Id id = job->property("_itemId").toLongLong();
+    mFetchingMessages.remove(id);
+    if (job->error()) {
+        qCDebug(KMAIL_LOG) << "Unable to fetch the message:" << job->errorString();
+        return;
+    }
+    const Akonadi::Item::List items = static_cast<Akonadi::ItemFetchJob *>(job)->items();
+    if (items.isEmpty() || !items.constFirst().hasPayload<KMime::Message::Ptr>()) {
+        return;
+    }
+    const Akonadi::Item item = items.constFirst();
+    const KMime::Message::Ptr msg = item.payload<KMime::Message::Ptr>();
+    Envelope envelope;
+    envelope.subject = msg->subject()->asUnicodeString();
+    envelope.from = msg->from()->displayString();
+    envelope.to = msg->to()->displayString();
+    envelope.date = msg->date()->dateTime();
+    mToolTips.insert(id, new QString(toolTip(item, envelope)));
+    emitRowChanged(item);
+}
+
+void KMSearchMessageModel::emitRowChanged(const Akonadi::Item &item)
+{
+    const QModelIndex first = indexForItem(item, Collection);
+    if (first.isValid()) {
+        mEmittingRowChange = true;
+        Q_EMIT dataChanged(first, index(first.row(), Size));
+        mEmittingRowChange = false;
+    }
+}
+
+QString KMSearchMessageModel::toolTip(const Akonadi::Item &item, const Envelope &envelope) const
+{
     QColor bckColor = QApplication::palette().color(QPalette::ToolTipBase);
     QColor txtColor = QApplication::palette().color(QPalette::ToolTipText);
 
@@ -79,7 +236,7 @@ static QString toolTip(const Akonadi::Item &item)
         "</div>"                                                       \
         "</td>"                                                        \
         "</tr>"
-        ).arg(txtColorName).arg(bckColorName).arg(msg->subject()->asUnicodeString().toHtmlEscaped()).arg(textDirection);
+        ).arg(txtColorName).arg(bckColorName).arg(envelope.subject.toHtmlEscaped()).arg(textDirection);
 
     tip += QStringLiteral(
         "<tr>"                                                              \
@@ -99,19 +256,23 @@ static QString toolTip(const Akonadi::Item &item)
         "</td>"                                                      \
         "</tr>");
 
-    QString content = MessageList::Util::contentSummary(item);
+    // Only available once the complete message was fetched
+    QString content;
+    if (item.hasPayload<KMime::Message::Ptr>()) {
+        content = MessageList::Util::contentSummary(item);
+    }
 
     if (textIsLeftToRight) {
-        tip += htmlCodeForStandardRow.arg(i18n("From"), msg->from()->displayString());
-        tip += htmlCodeForStandardRow.arg(i18nc("Receiver of the email", "To"), msg->to()->displayString());
-        tip += htmlCodeForStandardRow.arg(i18n("Date"), QLocale().toString(msg->date()->dateTime()));
+        tip += htmlCodeForStandardRow.arg(i18n("From"), envelope.from);
+        tip += htmlCodeForStandardRow.arg(i18nc("Receiver of the email", "To"), envelope.to);
+        tip += htmlCodeForStandardRow.arg(i18n("Date"), QLocale().toString(envelope.date));
         if (!content.isEmpty()) {
             tip += htmlCodeForStandardRow.arg(i18n("Preview")).arg(content.replace(QLatin1Char('\n'), QStringLiteral("<br>")));
         }
     } else {
-        tip += htmlCodeForStandardRow.arg(msg->from()->displayString()).arg(i18n("From"));
-        tip += htmlCodeForStandardRow.arg(msg->to()->displayString()).arg(i18nc("Receiver of the email", "To"));
-        tip += htmlCodeForStandardRow.arg(QLocale().toString(msg->date()->dateTime())).arg(i18n("Date"));
+        tip += htmlCodeForStandardRow.arg(envelope.from).arg(i18n("From"));
+        tip += htmlCodeForStandardRow.arg(envelope.to).arg(i18nc("Receiver of the email", "To"));
+        tip += htmlCodeForStandardRow.arg(QLocale().toString(envelope.date)).arg(i18n("Date"));
         if (!content.isEmpty()) {
             tip += htmlCodeForStandardRow.arg(content.replace(QLatin1Char('\n'), QStringLiteral("<br>"))).arg(i18n("Preview"));
         }
@@ -149,6 +310,30 @@ QString KMSearchMessageModel::fullCollectionPath(Akonadi::Collection::Id id) con
     return path;
 }
 
+QVariant KMSearchMessageModel::sortData(const QModelIndex &index, const Akonadi::Item &item) const
+{
+    // Sorting asks for all rows, so this must not fetch anything
+    const Envelope *env = mEnvelopes.object(item.id());
+    switch (index.column()) {
+    case Collection:
+        return fullCollectionPath(item.storageCollectionId() >= 0 ? item.storageCollectionId() : item.parentCollection().id());
+    case Subject:
+        return env ? env->subject : QString();
+    case Sender:
+        return env ? env->from : QString();
+    case Receiver:
+        return env ? env->to : QString();
+    case Date:
+        // the time the message was stored, until its envelope was seen
+        return env ? env->date : item.modificationTime();
+    case Size:
+        return item.size();
+    default:
+        break;
+    }
+    return QVariant();
+}
+
 QVariant KMSearchMessageModel::data(const QModelIndex &index, int role) const
 {
     if (!index.isValid()) {
@@ -169,6 +354,10 @@ QVariant KMSearchMessageModel::data(const QModelIndex &index, int role) const
 
     Akonadi::Item item = itemForIndex(index);
 
+    if (role == SortRole) {
+        return sortData(index, item);
+    }
+
     // Handle the most common case first, before calling payload().
     if ((role == Qt::DisplayRole || role == Qt::EditRole) && index.column() == Collection) {
         if (item.storageCollectionId() >= 0) {
@@ -177,48 +366,68 @@ QVariant KMSearchMessageModel::data(const QModelIndex &index, int role) const
         return fullCollectionPath(item.parentCollection().id());
     }
 
-    if (!item.hasPayload<KMime::Message::Ptr>()) {
+    if (role != Qt::DisplayRole && role != Qt::EditRole && role != Qt::ToolTipRole) {
+        return ItemModel::data(index, role);
+    }
+
+    if (role == Qt::ToolTipRole) {
+        if (const QString *tip = mToolTips.object(item.id())) {
+            return *tip;
+        }
+        // Fetch the complete message for the preview
+        if (!mFetchingMessages.contains(item.id())) {
+            mFetchingMessages.insert(item.id());
+            Akonadi::ItemFetchJob *job = new Akonadi::ItemFetchJob(item, const_cast<KMSearchMessageModel *>(this));
+            job->fetchScope().fetchFullPayload();
+            job->setProperty("_itemId", item.id());
+            connect(job, &Akonadi::ItemFetchJob::result, this, &KMSearchMessageModel::slotMessageFetched);
+        }
+    }
+
+    if ((role == Qt::DisplayRole || role == Qt::EditRole) && index.column() == Size) {
+        if (role == Qt::EditRole) {
+            return item.size();
+        }
+        if (item.size() == 0) {
+            return i18nc("@label No size available", "-");
+        } else {
+            return KFormat().formatByteSize(item.size());
+        }
+    }
+
+    const Envelope *env = envelope(index, item);
+    if (!env) {
         return QVariant();
     }
-    KMime::Message::Ptr msg = item.payload<KMime::Message::Ptr>();
     if (role == Qt::DisplayRole) {
         switch (index.column()) {
         case Subject:
-            return msg->subject()->asUnicodeString();
+            return env->subject;
         case Sender:
-            return msg->from()->asUnicodeString();
+            return env->from;
         case Receiver:
-            return msg->to()->asUnicodeString();
+            return env->to;
         case Date:
-            return QLocale().toString(msg->date()->dateTime());
-        case Size:
-            if (item.size() == 0) {
-                return i18nc("@label No size available", "-");
-            } else {
-                return KFormat().formatByteSize(item.size());
-            }
+            return QLocale().toString(env->date);
         default:
             return QVariant();
         }
     } else if (role == Qt::EditRole) { // used for sorting
         switch (index.column()) {
         case Subject:
-            return msg->subject()->asUnicodeString();
+            return env->subject;
         case Sender:
-            return msg->from()->asUnicodeString();
+            return env->from;
         case Receiver:
-            return msg->to()->asUnicodeString();
+            return env->to;
         case Date:
-            return msg->date()->dateTime();
-        case Size:
-            return item.size();
+            return env->date;
         default:
             return QVariant();
         }
-    } else if (role == Qt::ToolTipRole) {
-        return toolTip(item);
     }
-    return ItemModel::data(index, role);
+    // The preview is added once the complete message arrived
+    return toolTip(item, *env);
 }
 
 QVariant KMSearchMessageModel::headerData(int section, Qt::Orientation orientation, int role) const
@@ -29,8 +29,23 @@
 #define KMSEARCHMESSAGEMODEL_H
 
 #include <Akonadi/KMime/MessageModel>
+#include <QCache>
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <QHash>
+#include <QSet>
 
+class KJob;
+class QTimer;
+
+/**
+ * The results of a search.
+ *
+ * The items are listed without payload. The envelopes of the rows are
+ * fetched in pages as the view asks for them, and kept within a memory
+ * budget. The complete message is only fetched for the preview of the
+ * tooltip.
+ */
 class KMSearchMessageModel : public Akonadi::MessageModel
 {
     Q_OBJECT
@@ -44,6 +59,13 @@ public:
         Date,
         Size
     };
+    enum Roles {
+        /**
+         * Sort key which never starts a fetch: the envelope values only when
+         * cached, the size and folder from the item.
+         */
+        SortRole = Qt::UserRole + 100
+    };
     explicit KMSearchMessageModel(QObject *parent = nullptr);
     ~KMSearchMessageModel() override;
 
@@ -52,10 +74,42 @@ public:
 
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
 
+    /**
+     * Sets the memory in bytes used for the envelopes of the rows.
+     */
+    void setMemoryBudget(int bytes);
+    int memoryBudget() const;
+
 private:
+    struct Envelope {
+        QString subject;
+        QString from;
+        QString to;
+        QDateTime date;
+    };
+
     QString fullCollectionPath(Akonadi::Collection::Id id) const;
+    const Envelope *envelope(const QModelIndex &index, const Akonadi::Item &item) const;
+    QString toolTip(const Akonadi::Item &item, const Envelope &envelope) const;
+    void fetchRequestedEnvelopes();
+    void slotEnvelopesFetched(KJob *job);
+    void slotMessageFetched(KJob *job);
+    void slotDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    QVariant sortData(const QModelIndex &index, const Akonadi::Item &item) const;
+    void emitRowChanged(const Akonadi::Item &item);
 
     mutable QHash<Akonadi::Collection::Id, QString> m_collectionFullPathCache;
+    mutable QCache<Akonadi::Item::Id, Envelope> mEnvelopes;
+    mutable QCache<Akonadi::Item::Id, QString> mToolTips;
+    // rows the view asked for, fetched with their page on the next event loop run
+    mutable QSet<int> mRequestedRows;
+    mutable QSet<Akonadi::Item::Id> mFetchingEnvelopes;
+    mutable QSet<Akonadi::Item::Id> mFetchingMessages;
+    // messages the server didn't deliver, with the time of the attempt
+    mutable QHash<Akonadi::Item::Id, qint64> mUnavailable;
+    QElapsedTimer mClock;
+    QTimer *mFetchTimer = nullptr;
+    bool mEmittingRowChange = false;
 };
 
 #endif
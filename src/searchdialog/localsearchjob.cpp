@@ -0,0 +1,254 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "localsearchjob.h"
+#include "kmail_debug.h"
+
+#include <Akonadi/KMime/MessageParts>
+#include <AkonadiCore/ItemFetchJob>
+#include <AkonadiCore/ItemFetchScope>
+
+#include <QRunnable>
+#include <QThread>
+
+using namespace KMail;
+using namespace MailCommon;
+
+// Messages matched by one thread at a time
+static const int s_matchChunkSize = 50;
+// Messages fetched with their payload at a time
+static const int s_fetchBatchSize = 200;
+
+namespace {
+class SearchMatchRunnable : public QRunnable
+{
+public:
+    SearchMatchRunnable(QObject *receiver, const SearchPattern &pattern, const Akonadi::Item::List &items, const QAtomicInt &canceled)
+        : mReceiver(receiver)
+        , mPattern(pattern)
+        , mItems(items)
+        , mCanceled(canceled)
+    {
+    }
+
+    void run() override
+    {
+        Akonadi::Item::List hits;
+        for (const Akonadi::Item &item : qAsConst(mItems)) {
+            if (mCanceled.load()) {
+                break;
+            }
+            if (mPattern.matches(item)) {
+                hits.append(item);
+            }
+        }
+        // Queued, the receiver waits for all runnables before it's deleted
+        QMetaObject::invokeMethod(mReceiver, "slotMatched", Qt::QueuedConnection, Q_ARG(Akonadi::Item::List, hits));
+    }
+
+private:
+    QObject *mReceiver = nullptr;
+    const SearchPattern &mPattern;
+    const Akonadi::Item::List mItems;
+    const QAtomicInt &mCanceled;
+};
+}
+
+LocalSearchJob::LocalSearchJob(const SearchPattern &pattern, QObject *parent)
+    : KJob(parent)
+    , mPattern(pattern)
+{
+    qRegisterMetaType<Akonadi::Item::List>("Akonadi::Item::List");
+    mThreadSafe = isThreadSafe(mPattern);
+    mThreadPool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+LocalSearchJob::~LocalSearchJob()
+{
+    mCanceled.store(1);
+    mThreadPool.waitForDone();
+}
+
+void LocalSearchJob::setCollections(const QVector<qint64> &collections)
+{
+    mCollections = collections;
+}
+
+void LocalSearchJob::setWorkerCount(int count)
+{
+    mThreadPool.setMaxThreadCount(qMax(1, count));
+}
+
+int LocalSearchJob::workerCount() const
+{
+    return mThreadPool.maxThreadCount();
+}
+
+bool LocalSearchJob::isThreadSafe(const SearchPattern &pattern)
+{
+    static const QList<QByteArray> safeFields = {
+        QByteArrayLiteral("<message>"), QByteArrayLiteral("<body>"), QByteArrayLiteral("<any header>"),
+        QByteArrayLiteral("<recipients>"), QByteArrayLiteral("<status>"), QByteArrayLiteral("<size>"),
+        QByteArrayLiteral("<age in days>"), QByteArrayLiteral("<date>")
+    };
+    for (const SearchRule::Ptr &rule : pattern) {
+        switch (rule->function()) {
+        case SearchRule::FuncIsInAddressbook:
+        case SearchRule::FuncIsNotInAddressbook:
+        case SearchRule::FuncIsInCategory:
+        case SearchRule::FuncIsNotInCategory:
+            // these run Akonadi searches
+            return false;
+        default:
+            break;
+        }
+        const QByteArray field = rule->field();
+        if (field.startsWith('<') && !safeFields.contains(field)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LocalSearchJob::start()
+{
+    fetchNextCollection();
+}
+
+void LocalSearchJob::fetchNextCollection()
+{
+    if (mCanceled.load() || mCollections.isEmpty()) {
+        checkFinished();
+        return;
+    }
+    const qint64 id = mCollections.takeFirst();
+    qCDebug(KMAIL_LOG) << "Searching unindexed folder" << id;
+    // Only list the messages, their parts are fetched as the matching keeps up
+    mFetchJob = new Akonadi::ItemFetchJob(Akonadi::Collection(id), this);
+    mFetchJob->fetchScope().fetchFullPayload(false);
+    mFetchJob->fetchScope().setFetchModificationTime(false);
+    mFetchJob->fetchScope().setFetchRemoteIdentification(false);
+    mFetchJob->setDeliveryOption(Akonadi::ItemFetchJob::EmitItemsInBatches);
+    connect(mFetchJob.data(), &Akonadi::ItemFetchJob::itemsReceived, this, [this](const Akonadi::Item::List &items) {
+        mPendingItems += items;
+    });
+    connect(mFetchJob.data(), &KJob::result, this, &LocalSearchJob::slotListingDone);
+}
+
+void LocalSearchJob::slotListingDone(KJob *job)
+{
+    if (job->error()) {
+        qCDebug(KMAIL_LOG) << "Cannot list folder:" << job->errorString();
+    }
+    mFetchJob = nullptr;
+    fetchNextBatch();
+}
+
+void LocalSearchJob::fetchNextBatch()
+{
+    if (mFetchJob) {
+        return;
+    }
+    if (mCanceled.load()) {
+        mPendingItems.clear();
+        checkFinished();
+        return;
+    }
+    if (mPendingItems.isEmpty()) {
+        fetchNextCollection();
+        return;
+    }
+    // Don't queue more work than the threads can take, slotMatched() resumes
+    if (mPendingBatches >= mThreadPool.maxThreadCount()) {
+        return;
+    }
+    const int count = qMin(s_fetchBatchSize, mPendingItems.count());
+    mFetchJob = new Akonadi::ItemFetchJob(mPendingItems.mid(0, count), this);
+    mPendingItems.remove(0, count);
+    const SearchRule::RequiredPart requiredPart = mPattern.requiredPart();
+    if (requiredPart == SearchRule::CompleteMessage) {
+        mFetchJob->fetchScope().fetchFullPayload();
+    } else if (requiredPart == SearchRule::Header) {
+        mFetchJob->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Header);
+    } else {
+        mFetchJob->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Envelope);
+    }
+    mFetchJob->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
+    mFetchJob->fetchScope().setIgnoreRetrievalErrors(true);
+    mFetchJob->setDeliveryOption(Akonadi::ItemFetchJob::EmitItemsInBatches);
+    connect(mFetchJob.data(), &Akonadi::ItemFetchJob::itemsReceived, this, &LocalSearchJob::slotItemsReceived);
+    connect(mFetchJob.data(), &KJob::result, this, &LocalSearchJob::slotFetchDone);
+}
+
+void LocalSearchJob::slotItemsReceived(const Akonadi::Item::List &items)
+{
+    if (mCanceled.load()) {
+        return;
+    }
+    if (!mThreadSafe || mThreadPool.maxThreadCount() <= 1) {
+        Akonadi::Item::List hits;
+        for (const Akonadi::Item &item : items) {
+            if (mPattern.matches(item)) {
+                hits.append(item);
+            }
+        }
+        if (!hits.isEmpty()) {
+            Q_EMIT itemsFound(hits);
+        }
+        return;
+    }
+    for (int begin = 0, total = items.count(); begin < total; begin += s_matchChunkSize) {
+        ++mPendingBatches;
+        mThreadPool.start(new SearchMatchRunnable(this, mPattern, items.mid(begin, s_matchChunkSize), mCanceled));
+    }
+}
+
+void LocalSearchJob::slotMatched(const Akonadi::Item::List &items)
+{
+    --mPendingBatches;
+    if (!items.isEmpty() && !mCanceled.load()) {
+        Q_EMIT itemsFound(items);
+    }
+    fetchNextBatch();
+}
+
+void LocalSearchJob::slotFetchDone(KJob *job)
+{
+    if (job->error()) {
+        qCDebug(KMAIL_LOG) << "Cannot search folder:" << job->errorString();
+    }
+    mFetchJob = nullptr;
+    fetchNextBatch();
+}
+
+void LocalSearchJob::checkFinished()
+{
+    if (!mFetchJob && mPendingBatches == 0 && mPendingItems.isEmpty() && (mCollections.isEmpty() || mCanceled.load())) {
+        emitResult();
+    }
+}
+
+bool LocalSearchJob::doKill()
+{
+    mCanceled.store(1);
+    if (mFetchJob) {
+        mFetchJob->kill(KJob::Quietly);
+    }
+    return true;
+}
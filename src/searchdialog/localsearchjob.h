@@ -0,0 +1,98 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef LOCALSEARCHJOB_H
+#define LOCALSEARCHJOB_H
+
+#include <KJob>
+#include <QAtomicInt>
+#include <QPointer>
+#include <QThreadPool>
+#include <QVector>
+#include <AkonadiCore/item.h>
+#include <MailCommon/SearchPattern>
+
+namespace Akonadi {
+class ItemFetchJob;
+}
+
+namespace KMail {
+/**
+ * @short Searches folders without the search index.
+ *
+ * The messages of each folder are fetched in batches with only the parts
+ * the pattern needs, and matched against the pattern on several threads.
+ * The next batch is only fetched once the threads caught up, so a big
+ * folder is never held in memory at once.
+ * Used for the folders the indexer hasn't caught up with, so that a search
+ * doesn't miss their messages.
+ */
+class LocalSearchJob : public KJob
+{
+    Q_OBJECT
+public:
+    explicit LocalSearchJob(const MailCommon::SearchPattern &pattern, QObject *parent = nullptr);
+    ~LocalSearchJob() override;
+
+    void setCollections(const QVector<qint64> &collections);
+
+    /**
+     * Sets the number of threads matching the messages.
+     */
+    void setWorkerCount(int count);
+    int workerCount() const;
+
+    void start() override;
+
+    /**
+     * Returns whether @p pattern can be matched outside of the main thread.
+     */
+    static bool isThreadSafe(const MailCommon::SearchPattern &pattern);
+
+Q_SIGNALS:
+    /**
+     * Emitted with the messages matching the pattern.
+     */
+    void itemsFound(const Akonadi::Item::List &items);
+
+protected:
+    bool doKill() override;
+
+private:
+    Q_INVOKABLE void slotMatched(const Akonadi::Item::List &items);
+    void fetchNextCollection();
+    void slotListingDone(KJob *job);
+    void fetchNextBatch();
+    void slotItemsReceived(const Akonadi::Item::List &items);
+    void slotFetchDone(KJob *job);
+    void checkFinished();
+
+    MailCommon::SearchPattern mPattern;
+    QVector<qint64> mCollections;
+    // messages of the current folder not fetched yet
+    Akonadi::Item::List mPendingItems;
+    QPointer<Akonadi::ItemFetchJob> mFetchJob;
+    QThreadPool mThreadPool;
+    QAtomicInt mCanceled;
+    int mPendingBatches = 0;
+    bool mThreadSafe = true;
+};
+}
+
+#endif // LOCALSEARCHJOB_H
@@ -0,0 +1,251 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "progressivesearchjob.h"
+#include "localsearchjob.h"
+#include "kmail_debug.h"
+
+#include <Akonadi/KMime/MessageParts>
+#include <AkonadiCore/ItemFetchScope>
+#include <AkonadiCore/ItemSearchJob>
+#include <AkonadiCore/SearchQuery>
+#include <KLocalizedString>
+#include <KMime/Message>
+
+using namespace KMail;
+using namespace MailCommon;
+
+ProgressiveSearchJob::ProgressiveSearchJob(const SearchPattern &pattern, QObject *parent)
+    : KJob(parent)
+    , mPattern(pattern)
+{
+    // Split off the rules which the index answers from the headers alone
+    if (mPattern.op() == SearchPattern::OpAnd) {
+        bool hasExpensiveRule = false;
+        mHeaderPattern.setOp(SearchPattern::OpAnd);
+        for (const SearchRule::Ptr &rule : qAsConst(mPattern)) {
+            if (isExpensiveRule(rule)) {
+                hasExpensiveRule = true;
+            } else {
+                mHeaderPattern.append(rule);
+            }
+        }
+        if (!hasExpensiveRule) {
+            mHeaderPattern.clear();
+        }
+    }
+}
+
+ProgressiveSearchJob::~ProgressiveSearchJob()
+{
+}
+
+void ProgressiveSearchJob::setSearchCollections(const QVector<Akonadi::Collection> &collections)
+{
+    mCollections = collections;
+}
+
+void ProgressiveSearchJob::setRecursive(bool recursive)
+{
+    mRecursive = recursive;
+}
+
+void ProgressiveSearchJob::setUnindexedCollections(const QVector<qint64> &collections)
+{
+    mUnindexedCollections = collections;
+}
+
+Akonadi::Item::List ProgressiveSearchJob::localHits() const
+{
+    return mLocalHits;
+}
+
+int ProgressiveSearchJob::hitCount() const
+{
+    return mHits.count();
+}
+
+bool ProgressiveSearchJob::isExpensiveRule(const SearchRule::Ptr &rule)
+{
+    const QByteArray field = rule->field();
+    return field == "<body>" || field == "<message>";
+}
+
+void ProgressiveSearchJob::start()
+{
+    mHits.clear();
+    mLocalHits.clear();
+    if (!mUnindexedCollections.isEmpty()) {
+        // The index misses messages of these folders, search them directly
+        mLocalJob = new LocalSearchJob(mPattern, this);
+        mLocalJob->setCollections(mUnindexedCollections);
+        connect(mLocalJob.data(), &LocalSearchJob::itemsFound, this, &ProgressiveSearchJob::slotLocalItemsFound);
+        connect(mLocalJob.data(), &KJob::result, this, &ProgressiveSearchJob::slotLocalSearchDone);
+        mLocalJob->start();
+    }
+    if (!mHeaderPattern.isEmpty()) {
+        Akonadi::SearchQuery query;
+        if (mHeaderPattern.asAkonadiQuery(query) == SearchPattern::NoError) {
+            mJob = new Akonadi::ItemSearchJob(query, this);
+            mJob->setSearchCollections(mCollections);
+            mJob->setRecursive(mRecursive);
+            mJob->setMimeTypes(QStringList() << KMime::Message::mimeType());
+            mJob->setRemoteSearchEnabled(false);
+            mJob->fetchScope().fetchFullPayload(false);
+            mJob->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
+            connect(mJob.data(), &Akonadi::ItemSearchJob::itemsReceived, this, &ProgressiveSearchJob::slotCandidatesReceived);
+            connect(mJob.data(), &KJob::result, this, &ProgressiveSearchJob::slotCandidatesDone);
+            return;
+        }
+    }
+    if (!startSearch(mPattern, mCollections, mRecursive)) {
+        setError(UserDefinedError);
+        setErrorText(i18n("The search pattern can't be used with the search index."));
+        indexedSearchDone();
+    }
+}
+
+bool ProgressiveSearchJob::startSearch(const SearchPattern &pattern, const QVector<Akonadi::Collection> &collections, bool recursive)
+{
+    Akonadi::SearchQuery query;
+    if (pattern.asAkonadiQuery(query) != SearchPattern::NoError) {
+        return false;
+    }
+    mJob = new Akonadi::ItemSearchJob(query, this);
+    mJob->setSearchCollections(collections);
+    mJob->setRecursive(recursive);
+    mJob->setMimeTypes(QStringList() << KMime::Message::mimeType());
+    mJob->setRemoteSearchEnabled(false);
+    mJob->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Envelope);
+    mJob->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
+    connect(mJob.data(), &Akonadi::ItemSearchJob::itemsReceived, this, &ProgressiveSearchJob::slotItemsReceived);
+    connect(mJob.data(), &KJob::result, this, &ProgressiveSearchJob::slotSearchDone);
+    return true;
+}
+
+void ProgressiveSearchJob::slotCandidatesReceived(const Akonadi::Item::List &items)
+{
+    for (const Akonadi::Item &item : items) {
+        mCandidateCollections.insert(item.parentCollection().id());
+    }
+}
+
+void ProgressiveSearchJob::slotCandidatesDone(KJob *job)
+{
+    if (job->error()) {
+        // Search the whole pattern as usual
+        qCDebug(KMAIL_LOG) << "Header search failed:" << job->errorString();
+        mCandidateCollections.clear();
+        if (!startSearch(mPattern, mCollections, mRecursive)) {
+            setError(job->error());
+            setErrorText(job->errorString());
+            indexedSearchDone();
+        }
+        return;
+    }
+    if (mCandidateCollections.isEmpty()) {
+        // nothing matches the header rules
+        indexedSearchDone();
+        return;
+    }
+    QVector<Akonadi::Collection> collections;
+    collections.reserve(mCandidateCollections.count());
+    for (Akonadi::Collection::Id id : qAsConst(mCandidateCollections)) {
+        collections.append(Akonadi::Collection(id));
+    }
+    qCDebug(KMAIL_LOG) << "Applying the body rules to" << collections.count() << "folders";
+    if (!startSearch(mPattern, collections, false)) {
+        indexedSearchDone();
+    }
+}
+
+void ProgressiveSearchJob::slotItemsReceived(const Akonadi::Item::List &items)
+{
+    Akonadi::Item::List hits;
+    hits.reserve(items.count());
+    for (const Akonadi::Item &item : items) {
+        if (!mHits.contains(item.id())) {
+            mHits.insert(item.id());
+            hits.append(item);
+        }
+    }
+    if (!hits.isEmpty()) {
+        Q_EMIT itemsFound(hits);
+    }
+}
+
+void ProgressiveSearchJob::slotLocalItemsFound(const Akonadi::Item::List &items)
+{
+    Akonadi::Item::List hits;
+    hits.reserve(items.count());
+    for (const Akonadi::Item &item : items) {
+        if (!mHits.contains(item.id())) {
+            mHits.insert(item.id());
+            hits.append(item);
+            mLocalHits.append(Akonadi::Item(item.id()));
+        }
+    }
+    if (!hits.isEmpty()) {
+        Q_EMIT itemsFound(hits);
+    }
+}
+
+void ProgressiveSearchJob::slotLocalSearchDone(KJob *job)
+{
+    if (job->error()) {
+        qCDebug(KMAIL_LOG) << "Local search failed:" << job->errorString();
+    }
+    mLocalJob = nullptr;
+    checkFinished();
+}
+
+void ProgressiveSearchJob::indexedSearchDone()
+{
+    mJob = nullptr;
+    mIndexedSearchDone = true;
+    checkFinished();
+}
+
+void ProgressiveSearchJob::checkFinished()
+{
+    if (mIndexedSearchDone && !mLocalJob) {
+        qCDebug(KMAIL_LOG) << "Search found" << hitCount() << "messages," << mLocalHits.count() << "of them without the index";
+        emitResult();
+    }
+}
+
+void ProgressiveSearchJob::slotSearchDone(KJob *job)
+{
+    if (job->error()) {
+        setError(job->error());
+        setErrorText(job->errorString());
+    }
+    indexedSearchDone();
+}
+
+bool ProgressiveSearchJob::doKill()
+{
+    if (mJob) {
+        mJob->kill(KJob::Quietly);
+    }
+    if (mLocalJob) {
+        mLocalJob->kill(KJob::Quietly);
+    }
+    return true;
+}
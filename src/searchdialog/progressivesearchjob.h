@@ -0,0 +1,115 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef PROGRESSIVESEARCHJOB_H
+#define PROGRESSIVESEARCHJOB_H
+
+#include <KJob>
+#include <QPointer>
+#include <QSet>
+#include <AkonadiCore/collection.h>
+#include <AkonadiCore/item.h>
+#include <MailCommon/SearchPattern>
+
+namespace Akonadi {
+class ItemSearchJob;
+class SearchQuery;
+}
+
+namespace KMail {
+class LocalSearchJob;
+/**
+ * @short Runs a search pattern and reports the hits while they are found.
+ *
+ * When all rules of a pattern must match and the pattern mixes header rules
+ * with rules on the body or the complete message, the header rules are run
+ * first. The expensive rules are then only applied to the folders holding
+ * candidates, and not at all when there are none.
+ */
+class ProgressiveSearchJob : public KJob
+{
+    Q_OBJECT
+public:
+    explicit ProgressiveSearchJob(const MailCommon::SearchPattern &pattern, QObject *parent = nullptr);
+    ~ProgressiveSearchJob() override;
+
+    /**
+     * Restricts the search to @p collections, all folders are searched otherwise.
+     */
+    void setSearchCollections(const QVector<Akonadi::Collection> &collections);
+    void setRecursive(bool recursive);
+
+    /**
+     * Sets the folders whose messages aren't all indexed. They are searched
+     * without the index in addition, see LocalSearchJob.
+     */
+    void setUnindexedCollections(const QVector<qint64> &collections);
+
+    void start() override;
+
+    /**
+     * Returns the number of hits reported so far.
+     */
+    int hitCount() const;
+
+    /**
+     * Returns the hits which were only found without the index.
+     */
+    Akonadi::Item::List localHits() const;
+
+    /**
+     * Returns whether @p rule needs the body or the complete message.
+     */
+    static bool isExpensiveRule(const MailCommon::SearchRule::Ptr &rule);
+
+Q_SIGNALS:
+    /**
+     * Emitted with the new hits, which carry their envelope and parent folder.
+     */
+    void itemsFound(const Akonadi::Item::List &items);
+
+protected:
+    bool doKill() override;
+
+private:
+    bool startSearch(const MailCommon::SearchPattern &pattern, const QVector<Akonadi::Collection> &collections, bool recursive);
+    void slotCandidatesReceived(const Akonadi::Item::List &items);
+    void slotCandidatesDone(KJob *job);
+    void slotItemsReceived(const Akonadi::Item::List &items);
+    void slotSearchDone(KJob *job);
+    void slotLocalItemsFound(const Akonadi::Item::List &items);
+    void slotLocalSearchDone(KJob *job);
+    void indexedSearchDone();
+    void checkFinished();
+
+    MailCommon::SearchPattern mPattern;
+    MailCommon::SearchPattern mHeaderPattern;
+    QVector<Akonadi::Collection> mCollections;
+    QSet<Akonadi::Collection::Id> mCandidateCollections;
+    QSet<Akonadi::Item::Id> mHits;
+    QVector<qint64> mUnindexedCollections;
+    Akonadi::Item::List mLocalHits;
+    QPointer<Akonadi::ItemSearchJob> mJob;
+    QPointer<LocalSearchJob> mLocalJob;
+    bool mRecursive = false;
+    bool mIndexedSearchDone = false;
+};
+}
+
+#endif // PROGRESSIVESEARCHJOB_H
@@ -0,0 +1,184 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "searchresultstreammodel.h"
+#include "kmsearchmessagemodel.h"
+
+#include <MailCommon/MailUtil>
+
+#include <AkonadiCore/EntityTreeModel>
+#include <AkonadiCore/ItemModel>
+#include <KMime/Message>
+#include <KLocalizedString>
+#include <KFormat>
+#include <QLocale>
+
+using namespace KMail;
+
+SearchResultStreamModel::SearchResultStreamModel(QObject *parent)
+    : QAbstractTableModel(parent)
+{
+}
+
+SearchResultStreamModel::~SearchResultStreamModel()
+{
+}
+
+int SearchResultStreamModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : mRows.count();
+}
+
+int SearchResultStreamModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : KMSearchMessageModel::Size + 1;
+}
+
+void SearchResultStreamModel::addItems(const Akonadi::Item::List &items)
+{
+    QVector<Row> rows;
+    rows.reserve(items.count());
+    for (const Akonadi::Item &item : items) {
+        if (mRowIndex.contains(item.id())) {
+            continue;
+        }
+        mRowIndex.insert(item.id(), mRows.count() + rows.count());
+        Row row;
+        // Keep only what the view and the actions need, not the payload
+        row.item = Akonadi::Item(item.id());
+        row.item.setParentCollection(item.parentCollection());
+        row.item.setMimeType(item.mimeType());
+        row.item.setSize(item.size());
+        row.item.setFlags(item.flags());
+        if (item.hasPayload<KMime::Message::Ptr>()) {
+            const KMime::Message::Ptr msg = item.payload<KMime::Message::Ptr>();
+            row.subject = msg->subject()->asUnicodeString();
+            row.from = msg->from()->displayString();
+            row.to = msg->to()->displayString();
+            row.date = msg->date()->dateTime();
+        }
+        rows.append(row);
+    }
+    if (rows.isEmpty()) {
+        return;
+    }
+    beginInsertRows(QModelIndex(), mRows.count(), mRows.count() + rows.count() - 1);
+    mRows += rows;
+    endInsertRows();
+}
+
+void SearchResultStreamModel::clear()
+{
+    beginResetModel();
+    mRows.clear();
+    mRowIndex.clear();
+    endResetModel();
+}
+
+Akonadi::Item SearchResultStreamModel::item(int row) const
+{
+    if (row < 0 || row >= mRows.count()) {
+        return Akonadi::Item();
+    }
+    return mRows.at(row).item;
+}
+
+QString SearchResultStreamModel::collectionPath(Akonadi::Collection::Id id) const
+{
+    auto it = mCollectionPaths.constFind(id);
+    if (it != mCollectionPaths.constEnd()) {
+        return it.value();
+    }
+    const QString path = MailCommon::Util::fullCollectionPath(Akonadi::Collection(id));
+    mCollectionPaths.insert(id, path);
+    return path;
+}
+
+QVariant SearchResultStreamModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= mRows.count()) {
+        return QVariant();
+    }
+    const Row &row = mRows.at(index.row());
+
+    // The item roles of both Akonadi models, so that the view can be used as usual
+    if (role == Akonadi::ItemModel::ItemRole || role == Akonadi::EntityTreeModel::ItemRole) {
+        return QVariant::fromValue(row.item);
+    }
+    if (role == Akonadi::ItemModel::IdRole || role == Akonadi::EntityTreeModel::ItemIdRole) {
+        return row.item.id();
+    }
+    if (role == Akonadi::EntityTreeModel::MimeTypeRole) {
+        return row.item.mimeType();
+    }
+    if (role != Qt::DisplayRole && role != Qt::EditRole) {
+        return QVariant();
+    }
+
+    switch (index.column()) {
+    case KMSearchMessageModel::Collection:
+        return collectionPath(row.item.parentCollection().id());
+    case KMSearchMessageModel::Subject:
+        return row.subject;
+    case KMSearchMessageModel::Sender:
+        return row.from;
+    case KMSearchMessageModel::Receiver:
+        return row.to;
+    case KMSearchMessageModel::Date:
+        if (role == Qt::EditRole) { // used for sorting
+            return row.date;
+        }
+        return QLocale().toString(row.date);
+    case KMSearchMessageModel::Size:
+        if (role == Qt::EditRole) {
+            return row.item.size();
+        }
+        if (row.item.size() == 0) {
+            return i18nc("@label No size available", "-");
+        }
+        return KFormat().formatByteSize(row.item.size());
+    default:
+        break;
+    }
+    return QVariant();
+}
+
+QVariant SearchResultStreamModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+    switch (section) {
+    case KMSearchMessageModel::Collection:
+        return i18nc("@title:column, folder (e.g. email)", "Folder");
+    case KMSearchMessageModel::Subject:
+        return i18nc("@title:column, message (e.g. email) subject", "Subject");
+    case KMSearchMessageModel::Sender:
+        return i18nc("@title:column, sender of message (e.g. email)", "Sender");
+    case KMSearchMessageModel::Receiver:
+        return i18nc("@title:column, receiver of message (e.g. email)", "Receiver");
+    case KMSearchMessageModel::Date:
+        return i18nc("@title:column, message (e.g. email) timestamp", "Date");
+    case KMSearchMessageModel::Size:
+        return i18nc("@title:column, message (e.g. email) size", "Size");
+    default:
+        break;
+    }
+    return QVariant();
+}
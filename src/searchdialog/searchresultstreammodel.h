@@ -0,0 +1,75 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef SEARCHRESULTSTREAMMODEL_H
+#define SEARCHRESULTSTREAMMODEL_H
+
+#include <QAbstractTableModel>
+#include <QDateTime>
+#include <QHash>
+#include <QVector>
+#include <AkonadiCore/item.h>
+
+namespace KMail {
+/**
+ * @short Holds the hits of a running search.
+ *
+ * Rows are appended as the search reports them, see ProgressiveSearchJob.
+ * Only the envelope of each hit is kept, and the columns are the same as
+ * the ones of KMSearchMessageModel, which replaces this model once the
+ * search folder exists.
+ */
+class SearchResultStreamModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    explicit SearchResultStreamModel(QObject *parent = nullptr);
+    ~SearchResultStreamModel() override;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    /**
+     * Appends the messages of @p items not listed yet.
+     */
+    void addItems(const Akonadi::Item::List &items);
+    void clear();
+
+    Akonadi::Item item(int row) const;
+
+private:
+    struct Row {
+        Akonadi::Item item;
+        QString subject;
+        QString from;
+        QString to;
+        QDateTime date;
+    };
+
+    QString collectionPath(Akonadi::Collection::Id id) const;
+
+    QVector<Row> mRows;
+    QHash<Akonadi::Item::Id, int> mRowIndex;
+    mutable QHash<Akonadi::Collection::Id, QString> mCollectionPaths;
+};
+}
+
+#endif // SEARCHRESULTSTREAMMODEL_H
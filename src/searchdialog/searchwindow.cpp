@@ -32,6 +32,8 @@
 #include "searchdescriptionattribute.h"
 #include "MailCommon/FolderTreeView"
 #include "kmsearchmessagemodel.h"
+#include "progressivesearchjob.h"
+#include "searchresultstreammodel.h"
 #include "searchpatternwarning.h"
 #include "PimCommonAkonadi/SelectMultiCollectionDialog"
 #include <PimCommon/PimUtil>
@@ -41,6 +43,7 @@
 #include <AkonadiWidgets/EntityTreeView>
 #include <AkonadiCore/persistentsearchattribute.h>
 #include <AkonadiCore/SearchCreateJob>
+#include <AkonadiCore/LinkJob>
 #include <AkonadiCore/ChangeRecorder>
 #include <AkonadiWidgets/standardactionmanager.h>
 #include <AkonadiCore/EntityMimeTypeFilterModel>
@@ -55,6 +58,7 @@
 #include <KStandardAction>
 #include <KStandardGuiItem>
 #include <KWindowSystem>
+#include <KFormat>
 #include <KMessageBox>
 #include <AkonadiSearch/PIM/indexeditems.h>
 
@@ -143,6 +147,8 @@ SearchWindow::SearchWindow(KMMainWidget *widget, const Akonadi::Collection &coll
 
     connect(mUi.mSearchFolderEdt, &KLineEdit::textChanged, this, &SearchWindow::scheduleRename);
     connect(&mRenameTimer, &QTimer::timeout, this, &SearchWindow::renameSearchFolder);
+    mSearchStatusTimer.setInterval(1000);
+    connect(&mSearchStatusTimer, &QTimer::timeout, this, &SearchWindow::updateSearchStatus);
     connect(mUi.mSearchFolderOpenBtn, &QPushButton::clicked, this, &SearchWindow::openSearchFolder);
 
     connect(mUi.mSearchResultOpenBtn, &QPushButton::clicked, this, &SearchWindow::slotViewSelectedMsg);
@@ -231,7 +237,7 @@ SearchWindow::SearchWindow(KMMainWidget *widget, const Akonadi::Collection &coll
 
 SearchWindow::~SearchWindow()
 {
-    if (mResultModel) {
+    if (mResultModel || mStreamModel) {
         if (mUi.mLbxMatches->columnWidth(0) > 0) {
             KMailSettings::self()->setCollectionWidth(mUi.mLbxMatches->columnWidth(0));
         }
@@ -253,7 +259,9 @@ SearchWindow::~SearchWindow()
         KMailSettings::self()->setSearchWidgetWidth(width());
         KMailSettings::self()->setSearchWidgetHeight(height());
         KMailSettings::self()->requestSync();
-        mResultModel->deleteLater();
+        if (mResultModel) {
+            mResultModel->deleteLater();
+        }
     }
 }
 
@@ -265,8 +273,9 @@ void SearchWindow::createSearchModel()
     mResultModel = new KMSearchMessageModel(this);
     mResultModel->setCollection(mFolder);
     QSortFilterProxyModel *sortproxy = new QSortFilterProxyModel(mResultModel);
-    sortproxy->setDynamicSortFilter(true);
-    sortproxy->setSortRole(Qt::EditRole);
+    // Envelopes arriving must not re-sort, nor sorting fetch all of them
+    sortproxy->setDynamicSortFilter(false);
+    sortproxy->setSortRole(KMSearchMessageModel::SortRole);
     sortproxy->setFilterCaseSensitivity(Qt::CaseInsensitive);
     sortproxy->setSourceModel(mResultModel);
     mUi.mLbxMatches->setModel(sortproxy);
@@ -310,7 +319,7 @@ void SearchWindow::updateCollectionStatistic(Akonadi::Collection::Id id, const A
 
 void SearchWindow::keyPressEvent(QKeyEvent *event)
 {
-    if (event->key() == Qt::Key_Escape && mSearchJob) {
+    if (event->key() == Qt::Key_Escape && (mSearchJob || mCollectionJob)) {
         slotStop();
         return;
     }
@@ -418,21 +427,18 @@ void SearchWindow::doSearch()
         mUi.mSearchFolderEdt->setText(i18n("Last Search"));
     }
 
-    if (mResultModel) {
+    if (mResultModel || mStreamModel) {
         mHeaderState = mUi.mLbxMatches->header()->saveState();
     }
 
     mUi.mLbxMatches->setModel(nullptr);
+    mSearchStatusTimer.stop();
 
     mSortColumn = mUi.mLbxMatches->header()->sortIndicatorSection();
     mSortOrder = mUi.mLbxMatches->header()->sortIndicatorOrder();
     mUi.mLbxMatches->setSortingEnabled(false);
 
-    if (mSearchJob) {
-        mSearchJob->kill(KJob::Quietly);
-        mSearchJob->deleteLater();
-        mSearchJob = nullptr;
-    }
+    killSearchJobs();
 
     mUi.mSearchFolderEdt->setEnabled(false);
 
@@ -496,50 +502,146 @@ void SearchWindow::doSearch()
     qCDebug(KMAIL_LOG) << mQuery.toJSON();
     mUi.mSearchFolderOpenBtn->setEnabled(true);
 
-    const QVector<qint64> unindexedCollections = checkIncompleteIndex(searchCollections, recursive);
-    if (!unindexedCollections.isEmpty()) {
-        QScopedPointer<IncompleteIndexDialog> dlg(new IncompleteIndexDialog(unindexedCollections));
-        dlg->exec();
+    QVector<qint64> unindexedCollections;
+    if (searchCollections.isEmpty()) {
+        // Searching all folders doesn't ask about the index, the folders
+        // the indexer didn't reach yet are still searched locally
+        unindexedCollections = checkIncompleteIndex(Akonadi::Collection::List() << Akonadi::Collection::root(), true);
+    } else {
+        unindexedCollections = checkIncompleteIndex(searchCollections, recursive);
+        if (!unindexedCollections.isEmpty()) {
+            QScopedPointer<IncompleteIndexDialog> dlg(new IncompleteIndexDialog(unindexedCollections));
+            dlg->exec();
+        }
     }
 
+    mSearchCollections = searchCollections;
+    mSearchRecursive = recursive;
+
+    // Show the hits while they are found, the server fills the search folder
+    // at the same time
+    createStreamModel();
+    ProgressiveSearchJob *searchJob = new ProgressiveSearchJob(searchPattern, this);
+    searchJob->setSearchCollections(searchCollections);
+    searchJob->setRecursive(recursive);
+    searchJob->setUnindexedCollections(unindexedCollections);
+    connect(searchJob, &ProgressiveSearchJob::itemsFound, this, &SearchWindow::slotItemsFound);
+    connect(searchJob, &KJob::result, this, &SearchWindow::slotProgressiveSearchDone);
+    mSearchJob = searchJob;
+    searchJob->start();
+    createSearchCollection();
+
+    mSearchTime.start();
+    mSearchStatusTimer.start();
+    mUi.mProgressIndicator->start();
+    enableGUI();
+    mUi.mStatusLbl->setText(i18n("Searching..."));
+}
+
+void SearchWindow::createStreamModel()
+{
+    if (mResultModel) {
+        mResultModel->deleteLater();
+        mResultModel = nullptr;
+    }
+    if (mStreamModel) {
+        mStreamModel->deleteLater();
+    }
+    mStreamModel = new SearchResultStreamModel(this);
+    QSortFilterProxyModel *sortproxy = new QSortFilterProxyModel(mStreamModel);
+    sortproxy->setDynamicSortFilter(true);
+    sortproxy->setSortRole(Qt::EditRole);
+    sortproxy->setSourceModel(mStreamModel);
+    mUi.mLbxMatches->setModel(sortproxy);
+    mUi.mLbxMatches->header()->setStretchLastSection(false);
+    mUi.mLbxMatches->header()->restoreState(mHeaderState);
+    mUi.mLbxMatches->setSortingEnabled(true);
+    mUi.mLbxMatches->header()->setSortIndicator(mSortColumn, mSortOrder);
+    if (mAkonadiStandardAction) {
+        mAkonadiStandardAction->setItemSelectionModel(mUi.mLbxMatches->selectionModel());
+    }
+}
+
+void SearchWindow::slotItemsFound(const Akonadi::Item::List &items)
+{
+    if (mStreamModel) {
+        mStreamModel->addItems(items);
+        updateSearchStatus();
+    }
+}
+
+void SearchWindow::updateSearchStatus()
+{
+    const int count = mStreamModel ? mStreamModel->rowCount() : 0;
+    mUi.mStatusLbl->setText(i18np("Searching... %1 message found (%2)", "Searching... %1 messages found (%2)",
+                                  count, KFormat().formatDuration(mSearchTime.elapsed())));
+}
+
+void SearchWindow::slotProgressiveSearchDone(KJob *job)
+{
+    Q_ASSERT(job == mSearchJob);
+    mSearchJob = nullptr;
+    mSearchStatusTimer.stop();
+    mLocalHits = static_cast<ProgressiveSearchJob *>(job)->localHits();
+    if (job->error()) {
+        // The search folder is still created, Akonadi reports the error if there is one
+        qCDebug(KMAIL_LOG) << "Progressive search failed:" << job->errorString();
+    }
+    qCDebug(KMAIL_LOG) << "Search took" << mSearchTime.elapsed() << "ms";
+    if (!mCollectionJob) {
+        showSearchResult();
+    } else {
+        updateSearchStatus();
+    }
+}
+
+void SearchWindow::createSearchCollection()
+{
     if (!mFolder.isValid()) {
         qCDebug(KMAIL_LOG) << " create new folder " << mUi.mSearchFolderEdt->text();
         Akonadi::SearchCreateJob *searchJob = new Akonadi::SearchCreateJob(mUi.mSearchFolderEdt->text(), mQuery, this);
         searchJob->setSearchMimeTypes(QStringList() << QStringLiteral("message/rfc822"));
-        searchJob->setSearchCollections(searchCollections);
-        searchJob->setRecursive(recursive);
+        searchJob->setSearchCollections(mSearchCollections);
+        searchJob->setRecursive(mSearchRecursive);
         searchJob->setRemoteSearchEnabled(false);
-        mSearchJob = searchJob;
+        mCollectionJob = searchJob;
     } else {
         qCDebug(KMAIL_LOG) << " use existing folder " << mFolder.id();
         Akonadi::PersistentSearchAttribute *attribute = new Akonadi::PersistentSearchAttribute();
         mFolder.setContentMimeTypes(QStringList() << QStringLiteral("message/rfc822"));
         attribute->setQueryString(QString::fromLatin1(mQuery.toJSON()));
-        attribute->setQueryCollections(searchCollections);
-        attribute->setRecursive(recursive);
+        attribute->setQueryCollections(mSearchCollections);
+        attribute->setRecursive(mSearchRecursive);
         attribute->setRemoteSearchEnabled(false);
         mFolder.addAttribute(attribute);
-        mSearchJob = new Akonadi::CollectionModifyJob(mFolder, this);
+        mCollectionJob = new Akonadi::CollectionModifyJob(mFolder, this);
     }
 
-    connect(mSearchJob, &Akonadi::CollectionModifyJob::result, this, &SearchWindow::searchDone);
-    mUi.mProgressIndicator->start();
-    enableGUI();
-    mUi.mStatusLbl->setText(i18n("Searching..."));
+    connect(mCollectionJob, &KJob::result, this, &SearchWindow::searchDone);
 }
 
-void SearchWindow::searchDone(KJob *job)
+void SearchWindow::killSearchJobs()
 {
-    Q_ASSERT(job == mSearchJob);
-    mSearchJob = nullptr;
-#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
-    QMetaObject::invokeMethod(this, &SearchWindow::enableGUI, Qt::QueuedConnection);
-#else
-    QMetaObject::invokeMethod(this, "enableGUI", Qt::QueuedConnection);
-#endif
+    if (mSearchJob) {
+        mSearchJob->kill(KJob::Quietly);
+        mSearchJob->deleteLater();
+        mSearchJob = nullptr;
+    }
+    if (mCollectionJob) {
+        mCollectionJob->kill(KJob::Quietly);
+        mCollectionJob->deleteLater();
+        mCollectionJob = nullptr;
+    }
+}
 
-    mUi.mProgressIndicator->stop();
+void SearchWindow::searchDone(KJob *job)
+{
+    Q_ASSERT(job == mCollectionJob);
+    mCollectionJob = nullptr;
     if (job->error()) {
+        killSearchJobs();
+        mSearchStatusTimer.stop();
+        mUi.mProgressIndicator->stop();
         qCDebug(KMAIL_LOG) << job->errorString();
         KMessageBox::sorry(this, i18n("Cannot get search result. %1", job->errorString()));
         enableGUI();
@@ -581,22 +683,50 @@ void SearchWindow::searchDone(KJob *job)
         }
         searchDescription->setRecursive(mUi.mChkSubFolders->isChecked());
         new Akonadi::CollectionModifyJob(mFolder, this);
-        Akonadi::CollectionFetchJob *fetch = new Akonadi::CollectionFetchJob(mFolder, Akonadi::CollectionFetchJob::Base, this);
-        fetch->fetchScope().setIncludeStatistics(true);
-        connect(fetch, &KJob::result, this, &SearchWindow::slotCollectionStatisticsRetrieved);
 
-        mUi.mStatusLbl->setText(i18n("Search complete."));
-        createSearchModel();
-
-        if (mCloseRequested) {
-            close();
+        // The hits keep streaming in until the search is done too
+        if (!mSearchJob) {
+            showSearchResult();
         }
+    }
+}
 
-        mUi.mLbxMatches->setSortingEnabled(true);
-        mUi.mLbxMatches->header()->setSortIndicator(mSortColumn, mSortOrder);
+void SearchWindow::showSearchResult()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    QMetaObject::invokeMethod(this, &SearchWindow::enableGUI, Qt::QueuedConnection);
+#else
+    QMetaObject::invokeMethod(this, "enableGUI", Qt::QueuedConnection);
+#endif
+    mUi.mProgressIndicator->stop();
 
-        mUi.mSearchFolderEdt->setEnabled(true);
+    if (!mLocalHits.isEmpty()) {
+        // The index doesn't know these yet, add them to the search folder
+        new Akonadi::LinkJob(mFolder, mLocalHits, this);
+        mLocalHits.clear();
     }
+    Akonadi::CollectionFetchJob *fetch = new Akonadi::CollectionFetchJob(mFolder, Akonadi::CollectionFetchJob::Base, this);
+    fetch->fetchScope().setIncludeStatistics(true);
+    connect(fetch, &KJob::result, this, &SearchWindow::slotCollectionStatisticsRetrieved);
+
+    mUi.mStatusLbl->setText(i18n("Search complete."));
+    if (mStreamModel) {
+        mHeaderState = mUi.mLbxMatches->header()->saveState();
+    }
+    createSearchModel();
+    if (mStreamModel) {
+        mStreamModel->deleteLater();
+        mStreamModel = nullptr;
+    }
+
+    if (mCloseRequested) {
+        close();
+    }
+
+    mUi.mLbxMatches->setSortingEnabled(true);
+    mUi.mLbxMatches->header()->setSortIndicator(mSortColumn, mSortOrder);
+
+    mUi.mSearchFolderEdt->setEnabled(true);
 }
 
 void SearchWindow::slotCollectionStatisticsRetrieved(KJob *job)
@@ -619,11 +749,17 @@ void SearchWindow::slotCollectionStatisticsRetrieved(KJob *job)
 void SearchWindow::slotStop()
 {
     mUi.mProgressIndicator->stop();
-    if (mSearchJob) {
-        mSearchJob->kill(KJob::Quietly);
-        mSearchJob->deleteLater();
-        mSearchJob = nullptr;
-        mUi.mStatusLbl->setText(i18n("Search stopped."));
+    mSearchStatusTimer.stop();
+    if (mSearchJob || mCollectionJob) {
+        killSearchJobs();
+        // the hits found so far stay in the list
+        if (mStreamModel) {
+            mUi.mStatusLbl->setText(i18np("Search stopped, %1 message found.", "Search stopped, %1 messages found.",
+                                          mStreamModel->rowCount()));
+        } else {
+            mUi.mStatusLbl->setText(i18n("Search stopped."));
+        }
+        mUi.mSearchFolderEdt->setEnabled(true);
     }
 
     enableGUI();
@@ -636,12 +772,10 @@ void SearchWindow::slotClose()
 
 void SearchWindow::closeEvent(QCloseEvent *event)
 {
-    if (mSearchJob) {
+    if (mSearchJob || mCollectionJob) {
         mCloseRequested = true;
         //Cancel search in progress
-        mSearchJob->kill(KJob::Quietly);
-        mSearchJob->deleteLater();
-        mSearchJob = nullptr;
+        killSearchJobs();
         QTimer::singleShot(0, this, &SearchWindow::slotClose);
     } else {
         QDialog::closeEvent(event);
@@ -716,7 +850,7 @@ void SearchWindow::slotCurrentChanged(const Akonadi::Item &item)
 
 void SearchWindow::enableGUI()
 {
-    const bool searching = (mSearchJob != nullptr);
+    const bool searching = (mSearchJob != nullptr || mCollectionJob != nullptr);
 
     KGuiItem::assign(mSearchButton, searching ? mStopSearchGuiItem : mStartSearchGuiItem);
     if (searching) {
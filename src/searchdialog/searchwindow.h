@@ -30,6 +30,7 @@
 #include <QDialog>
 #include <kxmlguiclient.h>
 #include <KGuiItem>
+#include <QElapsedTimer>
 #include <QTimer>
 
 class QCloseEvent;
@@ -59,6 +60,7 @@ namespace KMail {
    * or moving on them.
    */
 class SearchPatternWarning;
+class SearchResultStreamModel;
 class SearchWindow : public QDialog, public KXMLGUIClient
 {
     Q_OBJECT
@@ -140,6 +142,9 @@ private:
     /** GUI cleanup after search */
     void slotCollectionStatisticsRetrieved(KJob *job);
     void searchDone(KJob *);
+    void slotItemsFound(const Akonadi::Item::List &items);
+    void slotProgressiveSearchDone(KJob *job);
+    void updateSearchStatus();
     void enableGUI();
 
     void setEnabledSearchButton(bool);
@@ -154,6 +159,10 @@ private:
 
 private:
     void doSearch();
+    void createSearchCollection();
+    void createStreamModel();
+    void showSearchResult();
+    void killSearchJobs();
     QVector<qint64> checkIncompleteIndex(const Akonadi::Collection::List &searchCols, bool recursive);
     Akonadi::Collection::List searchCollectionsRecursive(const Akonadi::Collection::List &cols) const;
     QPointer<PimCommon::SelectMultiCollectionDialog> mSelectMultiCollectionDialog;
@@ -171,7 +180,17 @@ private:
     int mSortColumn = 0;
 
     KJob *mSearchJob = nullptr;
+    // creates or updates the search folder while mSearchJob streams the hits
+    KJob *mCollectionJob = nullptr;
     KMSearchMessageModel *mResultModel = nullptr;
+    // shows the hits while searching, until the search folder exists
+    SearchResultStreamModel *mStreamModel = nullptr;
+    QVector<Akonadi::Collection> mSearchCollections;
+    bool mSearchRecursive = false;
+    // hits of folders which aren't fully indexed, see LocalSearchJob
+    Akonadi::Item::List mLocalHits;
+    QElapsedTimer mSearchTime;
+    QTimer mSearchStatusTimer;
     QPushButton *mSearchButton = nullptr;
 
     QAction *mReplyAction = nullptr;
@@ -25,30 +25,329 @@
 #include "kmkernel.h"
 #include <KJob>
 #include <AkonadiCore/itemmovejob.h>
+#include <AkonadiCore/itemmodifyjob.h>
 
 #include <kmessagebox.h>
 #include <KLocalizedString>
 #include "kmail_debug.h"
 
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
 #include <QList>
+#include <QStandardPaths>
+#include <QTimer>
+
+#include <algorithm>
 
 using namespace KMail;
 
-UndoStack::UndoStack(int size)
+namespace KMail {
+QDataStream &operator<<(QDataStream &stream, const UndoChange &change)
+{
+    stream << change.addedFlags << change.removedFlags << change.addedTags << change.removedTags;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, UndoChange &change)
+{
+    stream >> change.addedFlags >> change.removedFlags >> change.addedTags >> change.removedTags;
+    return stream;
+}
+}
+
+namespace {
+static const quint32 s_journalMagic = 0x4b4d554a; // "KMUJ"
+static const qint32 s_journalVersion = 1;
+// messages per job when undoing
+static const int s_undoBatchSize = 500;
+
+enum JournalRecord {
+    ChangeRecord = 1,
+    ItemRecord = 2
+};
+
+// size of an ItemRecord: the record type and the item id
+static const qint64 s_itemRecordSize = 1 + 8;
+
+bool readHeader(QDataStream &stream, UndoInfo &info)
+{
+    quint32 magic = 0;
+    qint32 version = 0;
+    stream >> magic >> version;
+    if (magic != s_journalMagic || version != s_journalVersion) {
+        return false;
+    }
+    qint32 id = -1;
+    qint32 type = 0;
+    qint64 srcFolder = -1;
+    qint64 destFolder = -1;
+    stream >> id >> type >> info.description >> srcFolder >> destFolder >> info.moveToTrash;
+    if (stream.status() != QDataStream::Ok || id <= 0 || (type != UndoInfo::Move && type != UndoInfo::Change)) {
+        return false;
+    }
+    info.id = id;
+    info.type = static_cast<UndoInfo::Type>(type);
+    info.srcFolder = Akonadi::Collection(srcFolder);
+    info.destFolder = Akonadi::Collection(destFolder);
+    return true;
+}
+
+// Counts the messages of a journal, the stream is after the header
+int countItems(QDataStream &stream)
+{
+    int count = 0;
+    while (!stream.atEnd()) {
+        quint8 record = 0;
+        stream >> record;
+        if (record == ItemRecord) {
+            qint64 id = -1;
+            stream >> id;
+        } else if (record == ChangeRecord) {
+            UndoChange change;
+            stream >> change;
+        } else {
+            break;
+        }
+        if (stream.status() != QDataStream::Ok) {
+            // truncated by a crash, the complete records are still replayed
+            break;
+        }
+        if (record == ItemRecord) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+/**
+ * Replays the journal of an undone action in batches, one job at a time,
+ * and removes the journal afterwards.
+ */
+class UndoReplay : public QObject
+{
+public:
+    UndoReplay(const UndoInfo &info, const QString &fileName, QObject *parent)
+        : QObject(parent)
+        , mInfo(info)
+        , mFile(fileName)
+    {
+    }
+
+    ~UndoReplay()
+    {
+        mFile.remove();
+    }
+
+    void start()
+    {
+        UndoInfo header;
+        if (!mFile.open(QIODevice::ReadOnly)) {
+            finish(i18n("Cannot read the undo information."));
+            return;
+        }
+        mStream.setDevice(&mFile);
+        mStream.setVersion(QDataStream::Qt_5_9);
+        if (!readHeader(mStream, header)) {
+            finish(i18n("Cannot read the undo information."));
+            return;
+        }
+        next();
+    }
+
+private:
+    void next()
+    {
+        Akonadi::Item::List items;
+        UndoChange change = mChange;
+        while (items.count() < s_undoBatchSize && !mStream.atEnd()) {
+            quint8 record = 0;
+            mStream >> record;
+            if (record == ChangeRecord) {
+                mStream >> change;
+                if (!items.isEmpty()) {
+                    // the new change goes into the next batch
+                    mPendingChange = change;
+                    mHasPendingChange = true;
+                    break;
+                }
+                mChange = change;
+            } else if (record == ItemRecord) {
+                qint64 id = -1;
+                mStream >> id;
+                items.append(Akonadi::Item(id));
+            } else {
+                break;
+            }
+            if (mStream.status() != QDataStream::Ok) {
+                break;
+            }
+        }
+
+        if (items.isEmpty()) {
+            finish(QString());
+            return;
+        }
+
+        KJob *job = nullptr;
+        if (mInfo.type == UndoInfo::Move) {
+            job = new Akonadi::ItemMoveJob(items, mInfo.srcFolder, this);
+        } else {
+            for (Akonadi::Item &item : items) {
+                for (const QByteArray &flag : qAsConst(mChange.addedFlags)) {
+                    item.clearFlag(flag);
+                }
+                for (const QByteArray &flag : qAsConst(mChange.removedFlags)) {
+                    item.setFlag(flag);
+                }
+                for (Akonadi::Tag::Id tag : qAsConst(mChange.addedTags)) {
+                    item.clearTag(Akonadi::Tag(tag));
+                }
+                for (Akonadi::Tag::Id tag : qAsConst(mChange.removedTags)) {
+                    item.setTag(Akonadi::Tag(tag));
+                }
+            }
+            Akonadi::ItemModifyJob *modifyJob = new Akonadi::ItemModifyJob(items, this);
+            modifyJob->disableRevisionCheck();
+            modifyJob->setIgnorePayload(true);
+            job = modifyJob;
+        }
+        connect(job, &KJob::result, this, [this](KJob *job) {
+            if (job->error()) {
+                qCWarning(KMAIL_LOG) << "Undo failed:" << job->errorString();
+                if (mError.isEmpty()) {
+                    mError = job->errorString();
+                }
+            }
+            if (mHasPendingChange) {
+                mChange = mPendingChange;
+                mHasPendingChange = false;
+            }
+            next();
+        });
+    }
+
+    void finish(const QString &error)
+    {
+        const QString message = error.isEmpty() ? mError : error;
+        if (!message.isEmpty()) {
+            if (mInfo.type == UndoInfo::Move) {
+                KMessageBox::sorry(kmkernel->mainWin(), i18n("Cannot move message. %1", message));
+            } else {
+                KMessageBox::sorry(kmkernel->mainWin(), i18n("Cannot undo the change. %1", message));
+            }
+        }
+        deleteLater();
+    }
+
+    UndoInfo mInfo;
+    QFile mFile;
+    QDataStream mStream;
+    UndoChange mChange;
+    UndoChange mPendingChange;
+    bool mHasPendingChange = false;
+    QString mError;
+};
+}
+
+bool UndoChange::isEmpty() const
+{
+    return addedFlags.isEmpty() && removedFlags.isEmpty() && addedTags.isEmpty() && removedTags.isEmpty();
+}
+
+bool UndoChange::operator==(const UndoChange &other) const
+{
+    return addedFlags == other.addedFlags && removedFlags == other.removedFlags
+           && addedTags == other.addedTags && removedTags == other.removedTags;
+}
+
+UndoStack::UndoStack(int size, const QString &journalPath)
     : QObject(nullptr)
+    , mJournalPath(journalPath)
     , mSize(size)
 {
+    if (mJournalPath.isEmpty()) {
+        mJournalPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + QStringLiteral("/undo");
+    }
+    QDir().mkpath(mJournalPath);
+    loadJournal();
 }
 
 UndoStack::~UndoStack()
 {
-    clear();
+    // the journal is kept for the next session
+    closeJournal();
+    qDeleteAll(mStack);
+}
+
+QString UndoStack::journalPath() const
+{
+    return mJournalPath;
+}
+
+QString UndoStack::journalFileName(int id) const
+{
+    return mJournalPath + QStringLiteral("/%1.undo").arg(id);
+}
+
+void UndoStack::loadJournal()
+{
+    QDir dir(mJournalPath);
+    const QStringList files = dir.entryList(QStringList() << QStringLiteral("*.undo"), QDir::Files);
+    QList<UndoInfo *> infos;
+    for (const QString &fileName : files) {
+        QFile file(dir.filePath(fileName));
+        UndoInfo *info = new UndoInfo;
+        bool valid = false;
+        if (file.open(QIODevice::ReadOnly)) {
+            QDataStream stream(&file);
+            stream.setVersion(QDataStream::Qt_5_9);
+            valid = readHeader(stream, *info) && fileName == QStringLiteral("%1.undo").arg(info->id);
+            if (valid) {
+                // a move journal only holds item records
+                info->itemCount = info->type == UndoInfo::Move
+                                  ? static_cast<int>((file.size() - file.pos()) / s_itemRecordSize)
+                                  : countItems(stream);
+            }
+        }
+        if (!valid || info->itemCount == 0) {
+            qCDebug(KMAIL_LOG) << "Removing invalid undo journal" << fileName;
+            delete info;
+            file.remove();
+            continue;
+        }
+        infos.append(info);
+    }
+    // newest first
+    std::sort(infos.begin(), infos.end(), [](const UndoInfo *left, const UndoInfo *right) {
+        return left->id > right->id;
+    });
+    for (UndoInfo *info : qAsConst(infos)) {
+        mLastId = qMax(mLastId, info->id);
+        if (mStack.count() >= mSize) {
+            QFile::remove(journalFileName(info->id));
+            delete info;
+            continue;
+        }
+        mStack.append(info);
+        mInfos.insert(info->id, info);
+        if (info->type == UndoInfo::Move) {
+            mFolderIndex.insert(info->srcFolder.id(), info->id);
+            mFolderIndex.insert(info->destFolder.id(), info->id);
+        }
+    }
 }
 
 void UndoStack::clear()
 {
+    closeJournal();
+    for (UndoInfo *info : qAsConst(mStack)) {
+        QFile::remove(journalFileName(info->id));
+    }
     qDeleteAll(mStack);
     mStack.clear();
+    mInfos.clear();
+    mFolderIndex.clear();
 }
 
 int UndoStack::size() const
@@ -60,43 +359,146 @@ QString UndoStack::undoInfo() const
 {
     if (!mStack.isEmpty()) {
         UndoInfo *info = mStack.first();
-        return info->moveToTrash ? i18n("Move To Trash") : i18np("Move Message", "Move Messages", info->items.count());
+        if (info->type == UndoInfo::Change) {
+            return info->description;
+        }
+        return info->moveToTrash ? i18n("Move To Trash") : i18np("Move Message", "Move Messages", info->itemCount);
     } else {
         return QString();
     }
 }
 
-int UndoStack::newUndoAction(const Akonadi::Collection &srcFolder, const Akonadi::Collection &destFolder)
+UndoInfo *UndoStack::createInfo(UndoInfo::Type type)
 {
+    closeJournal();
     UndoInfo *info = new UndoInfo;
     info->id = ++mLastId;
+    info->type = type;
+    if (mStack.count() >= mSize && !mStack.isEmpty()) {
+        removeInfo(mStack.last());
+    }
+    mStack.prepend(info);
+    mInfos.insert(info->id, info);
+    return info;
+}
+
+void UndoStack::removeInfo(UndoInfo *info)
+{
+    if (info == mCachedInfo) {
+        closeJournal();
+    }
+    mStack.removeOne(info);
+    mInfos.remove(info->id);
+    if (info->type == UndoInfo::Move) {
+        mFolderIndex.remove(info->srcFolder.id(), info->id);
+        mFolderIndex.remove(info->destFolder.id(), info->id);
+    }
+    QFile::remove(journalFileName(info->id));
+    delete info;
+}
+
+int UndoStack::newUndoAction(const Akonadi::Collection &srcFolder, const Akonadi::Collection &destFolder)
+{
+    UndoInfo *info = createInfo(UndoInfo::Move);
     info->srcFolder = srcFolder;
     info->destFolder = destFolder;
     info->moveToTrash = (destFolder == CommonKernel->trashCollectionFolder());
-    if (static_cast<int>(mStack.count()) == mSize) {
-        delete mStack.last();
-        mStack.removeLast();
-    }
-    mStack.prepend(info);
+    mFolderIndex.insert(srcFolder.id(), info->id);
+    mFolderIndex.insert(destFolder.id(), info->id);
+    openJournal(info);
+    Q_EMIT undoStackChanged();
+    return info->id;
+}
+
+int UndoStack::newChangeAction(const QString &description)
+{
+    UndoInfo *info = createInfo(UndoInfo::Change);
+    info->description = description;
+    openJournal(info);
     Q_EMIT undoStackChanged();
     return info->id;
 }
 
+bool UndoStack::openJournal(UndoInfo *info)
+{
+    if (mCachedInfo == info && mJournalStream) {
+        return true;
+    }
+    closeJournal();
+    mJournalFile = new QFile(journalFileName(info->id));
+    if (!mJournalFile->open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qCWarning(KMAIL_LOG) << "Unable to write the undo journal" << mJournalFile->fileName();
+        delete mJournalFile;
+        mJournalFile = nullptr;
+        return false;
+    }
+    mJournalStream = new QDataStream(mJournalFile);
+    mJournalStream->setVersion(QDataStream::Qt_5_9);
+    if (mJournalFile->size() == 0) {
+        *mJournalStream << s_journalMagic << s_journalVersion << qint32(info->id) << qint32(info->type)
+                        << info->description << qint64(info->srcFolder.id()) << qint64(info->destFolder.id())
+                        << info->moveToTrash;
+    }
+    mCachedInfo = info;
+    mHasLastChange = false;
+    return true;
+}
+
+void UndoStack::scheduleFlush()
+{
+    // once the command added all its messages
+    if (!mFlushScheduled) {
+        mFlushScheduled = true;
+        QTimer::singleShot(0, this, &UndoStack::flushJournal);
+    }
+}
+
+void UndoStack::flushJournal()
+{
+    mFlushScheduled = false;
+    if (mJournalFile) {
+        mJournalFile->flush();
+    }
+}
+
+void UndoStack::closeJournal()
+{
+    delete mJournalStream;
+    mJournalStream = nullptr;
+    delete mJournalFile;
+    mJournalFile = nullptr;
+    mCachedInfo = nullptr;
+    mHasLastChange = false;
+}
+
 void UndoStack::addMsgToAction(int undoId, const Akonadi::Item &item)
 {
-    if (!mCachedInfo || mCachedInfo->id != undoId) {
-        QList<UndoInfo *>::const_iterator itr = mStack.constBegin();
-        while (itr != mStack.constEnd()) {
-            if ((*itr)->id == undoId) {
-                mCachedInfo = (*itr);
-                break;
-            }
-            ++itr;
-        }
+    UndoInfo *info = mInfos.value(undoId);
+    Q_ASSERT(info);
+    if (!info || !openJournal(info)) {
+        return;
     }
+    *mJournalStream << quint8(ItemRecord) << qint64(item.id());
+    ++info->itemCount;
+    scheduleFlush();
+}
 
-    Q_ASSERT(mCachedInfo);
-    mCachedInfo->items.append(item);
+void UndoStack::addChangeToAction(int undoId, const Akonadi::Item &item, const UndoChange &change)
+{
+    UndoInfo *info = mInfos.value(undoId);
+    Q_ASSERT(info);
+    if (!info || change.isEmpty() || !openJournal(info)) {
+        return;
+    }
+    // consecutive messages with the same change share the change record
+    if (!mHasLastChange || mLastChange != change) {
+        *mJournalStream << quint8(ChangeRecord) << change;
+        mLastChange = change;
+        mHasLastChange = true;
+    }
+    *mJournalStream << quint8(ItemRecord) << qint64(item.id());
+    ++info->itemCount;
+    scheduleFlush();
 }
 
 bool UndoStack::isEmpty() const
@@ -107,24 +509,26 @@ bool UndoStack::isEmpty() const
 void UndoStack::undo()
 {
     if (!mStack.isEmpty()) {
-        UndoInfo *info = mStack.takeFirst();
+        UndoInfo *info = mStack.first();
+        if (info == mCachedInfo) {
+            closeJournal();
+        }
+        mStack.removeFirst();
+        mInfos.remove(info->id);
+        if (info->type == UndoInfo::Move) {
+            mFolderIndex.remove(info->srcFolder.id(), info->id);
+            mFolderIndex.remove(info->destFolder.id(), info->id);
+        }
         Q_EMIT undoStackChanged();
-        Akonadi::ItemMoveJob *job = new Akonadi::ItemMoveJob(info->items, info->srcFolder, this);
-        connect(job, &Akonadi::ItemMoveJob::result, this, &UndoStack::slotMoveResult);
+        UndoReplay *replay = new UndoReplay(*info, journalFileName(info->id), this);
         delete info;
+        replay->start();
     } else {
         // Sorry.. stack is empty..
         KMessageBox::sorry(kmkernel->mainWin(), i18n("There is nothing to undo."));
     }
 }
 
-void UndoStack::slotMoveResult(KJob *job)
-{
-    if (job->error()) {
-        KMessageBox::sorry(kmkernel->mainWin(), i18n("Cannot move message. %1", job->errorString()));
-    }
-}
-
 void UndoStack::pushSingleAction(const Akonadi::Item &item, const Akonadi::Collection &folder, const Akonadi::Collection &destFolder)
 {
     const int id = newUndoAction(folder, destFolder);
@@ -133,16 +537,13 @@ void UndoStack::pushSingleAction(const Akonadi::Item &item, const Akonadi::Colle
 
 void UndoStack::folderDestroyed(const Akonadi::Collection &folder)
 {
-    QList<UndoInfo *>::iterator it = mStack.begin();
-    while (it != mStack.end()) {
-        UndoInfo *info = *it;
-        if (info
-            && ((info->srcFolder == folder)
-                || (info->destFolder == folder))) {
-            delete info;
-            it = mStack.erase(it);
-        } else {
-            ++it;
+    const QList<int> ids = mFolderIndex.values(folder.id());
+    if (ids.isEmpty()) {
+        return;
+    }
+    for (int id : ids) {
+        if (UndoInfo *info = mInfos.value(id)) {
+            removeInfo(info);
         }
     }
     Q_EMIT undoStackChanged();
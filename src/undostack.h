@@ -23,39 +23,88 @@
 #define UNDOSTACK_H
 
 #include <QList>
+#include <QHash>
 #include <QObject>
+#include <QSet>
+#include <QVector>
 #include <AkonadiCore/collection.h>
 #include <AkonadiCore/item.h>
+#include <AkonadiCore/tag.h>
 class KJob;
+class QFile;
+class QDataStream;
 
 namespace KMail {
-/** A class for storing Undo information. */
+/** The change of the flags and tags of a message, recorded for undo. */
+class UndoChange
+{
+public:
+    bool isEmpty() const;
+    bool operator==(const UndoChange &other) const;
+    bool operator!=(const UndoChange &other) const
+    {
+        return !(*this == other);
+    }
+
+    QSet<QByteArray> addedFlags;
+    QSet<QByteArray> removedFlags;
+    QVector<Akonadi::Tag::Id> addedTags;
+    QVector<Akonadi::Tag::Id> removedTags;
+};
+
+/** A class for storing Undo information.
+    The messages of an action are only kept in its journal file. */
 class UndoInfo
 {
 public:
+    enum Type {
+        Move = 0,
+        Change
+    };
+
     UndoInfo()
     {
     }
 
     int id = -1;
-    Akonadi::Item::List items;
+    Type type = Move;
+    QString description;
+    int itemCount = 0;
     Akonadi::Collection srcFolder;
     Akonadi::Collection destFolder;
     bool moveToTrash = false;
 };
 
+/**
+ * The undo history of moves, status and tag changes.
+ *
+ * Every action is journaled to a file below the application data
+ * directory as its messages are added, so the history survives a restart
+ * and the memory used doesn't depend on the number of messages. Undoing
+ * replays the journal in batches of ItemMoveJob or ItemModifyJob.
+ */
 class UndoStack : public QObject
 {
     Q_OBJECT
 
 public:
-    explicit UndoStack(int size);
+    explicit UndoStack(int size, const QString &journalPath = QString());
     ~UndoStack();
 
     void clear();
     int  size() const;
     int  newUndoAction(const Akonadi::Collection &srcFolder, const Akonadi::Collection &destFolder);
     void addMsgToAction(int undoId, const Akonadi::Item &item);
+
+    /**
+     * Starts an action undoing flag or tag changes, described by @p description.
+     */
+    int  newChangeAction(const QString &description);
+    /**
+     * Records that @p change was applied to @p item.
+     */
+    void addChangeToAction(int undoId, const Akonadi::Item &item, const UndoChange &change);
+
     bool isEmpty() const;
     void undo();
 
@@ -64,16 +113,36 @@ public:
 
     QString undoInfo() const;
 
+    QString journalPath() const;
+
 Q_SIGNALS:
     void undoStackChanged();
 
 private:
     Q_DISABLE_COPY(UndoStack)
-    void slotMoveResult(KJob *);
+    UndoInfo *createInfo(UndoInfo::Type type);
+    void removeInfo(UndoInfo *info);
+    QString journalFileName(int id) const;
+    bool openJournal(UndoInfo *info);
+    void scheduleFlush();
+    void flushJournal();
+    void closeJournal();
+    void loadJournal();
+
     QList<UndoInfo *> mStack;
+    QHash<int, UndoInfo *> mInfos;
+    // folder -> moves from or to it
+    QMultiHash<Akonadi::Collection::Id, int> mFolderIndex;
+    QString mJournalPath;
     int mSize = 0;
     int mLastId = 0;
+    // journal of the action messages are currently added to
     UndoInfo *mCachedInfo = nullptr;
+    QFile *mJournalFile = nullptr;
+    QDataStream *mJournalStream = nullptr;
+    UndoChange mLastChange;
+    bool mHasLastChange = false;
+    bool mFlushScheduled = false;
 };
 }
 
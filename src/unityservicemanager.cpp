@@ -20,6 +20,7 @@
 #include "unityservicemanager.h"
 #include "kmkernel.h"
 #include "kmsystemtray.h"
+#include "unreadcountservice.h"
 #include "settings/kmailsettings.h"
 #include "kmail_debug.h"
 #include <MailCommon/MailKernel>
@@ -32,11 +33,7 @@
 #include <QDBusPendingReply>
 #include <QDBusConnectionInterface>
 #include <QApplication>
-#include <QTimer>
 
-#include <AkonadiCore/ChangeRecorder>
-#include <AkonadiCore/EntityTreeModel>
-#include <AkonadiCore/EntityMimeTypeFilterModel>
 #include <AkonadiCore/CollectionStatistics>
 #include <AkonadiCore/NewMailNotifierAttribute>
 
@@ -46,13 +43,9 @@ UnityServiceManager::UnityServiceManager(QObject *parent)
     : QObject(parent)
     , mUnityServiceWatcher(new QDBusServiceWatcher(this))
 {
-    connect(kmkernel->folderCollectionMonitor(), &Akonadi::Monitor::collectionStatisticsChanged, this, &UnityServiceManager::slotCollectionStatisticsChanged);
-
-    connect(kmkernel->folderCollectionMonitor(), &Akonadi::Monitor::collectionAdded, this, &UnityServiceManager::initListOfCollection);
-    connect(kmkernel->folderCollectionMonitor(), &Akonadi::Monitor::collectionRemoved, this, &UnityServiceManager::initListOfCollection);
-    connect(kmkernel->folderCollectionMonitor(), &Akonadi::Monitor::collectionSubscribed, this, &UnityServiceManager::initListOfCollection);
-    connect(kmkernel->folderCollectionMonitor(), &Akonadi::Monitor::collectionUnsubscribed, this, &UnityServiceManager::initListOfCollection);
-    initListOfCollection();
+    // The service coalesces bursts of changes, e.g. while a folder is synchronized
+    connect(kmkernel->unreadCountService(), &UnreadCountService::unreadCountsChanged, this, &UnityServiceManager::updateUnreadCount);
+    updateUnreadCount();
     initUnity();
 }
 
@@ -80,67 +73,43 @@ bool UnityServiceManager::excludeFolder(const Akonadi::Collection &collection) c
     return false;
 }
 
-void UnityServiceManager::unreadMail(const QAbstractItemModel *model, const QModelIndex &parentIndex)
+bool UnityServiceManager::countCollection(const Akonadi::Collection &collection)
 {
-    const int rowCount = model->rowCount(parentIndex);
-    for (int row = 0; row < rowCount; ++row) {
-        const QModelIndex index = model->index(row, 0, parentIndex);
-        const Akonadi::Collection collection = model->data(index, Akonadi::EntityTreeModel::CollectionRole).value<Akonadi::Collection>();
-
-        if (!excludeFolder(collection)) {
-            const Akonadi::CollectionStatistics statistics = collection.statistics();
-            const qint64 count = qMax(0LL, statistics.unreadCount());
-
-            if (count > 0) {
-                if (!ignoreNewMailInFolder(collection)) {
-                    mCount += count;
-                }
-            }
-        }
-        if (model->rowCount(index) > 0) {
-            unreadMail(model, index);
-        }
-    }
-    if (mSystemTray) {
-        // Update tooltip to reflect count of unread messages
-        mSystemTray->updateToolTip(mCount);
-    }
+    return !excludeFolder(collection) && !ignoreNewMailInFolder(collection);
 }
 
 void UnityServiceManager::updateSystemTray()
 {
-    initListOfCollection();
+    mPublishedCount = -1;
+    updateUnreadCount();
 }
 
-void UnityServiceManager::initListOfCollection()
+void UnityServiceManager::updateUnreadCount()
 {
-    mCount = 0;
-    const QAbstractItemModel *model = kmkernel->collectionModel();
-    if (model->rowCount() == 0) {
-        QTimer::singleShot(1000, this, &UnityServiceManager::initListOfCollection);
-        return;
-    }
-    unreadMail(model);
-    if (mSystemTray) {
-        mSystemTray->updateStatus(mCount);
+    // Only the folders with unread messages need to be looked at
+    qint64 count = 0;
+    const Akonadi::Collection::List collections = kmkernel->unreadCountService()->unreadCollections();
+    for (const Akonadi::Collection &collection : collections) {
+        if (countCollection(collection)) {
+            count += collection.statistics().unreadCount();
+        }
     }
-
-    //qCDebug(KMAIL_LOG)<<" mCount :"<<mCount;
-    updateCount();
+    mCount = count;
+    publishCount();
 }
 
-void UnityServiceManager::slotCollectionStatisticsChanged(Akonadi::Collection::Id id, const Akonadi::CollectionStatistics &)
+void UnityServiceManager::publishCount()
 {
-    //Exclude sent mail folder
-
-    if (CommonKernel->outboxCollectionFolder().id() == id
-        || CommonKernel->sentCollectionFolder().id() == id
-        || CommonKernel->templatesCollectionFolder().id() == id
-        || CommonKernel->trashCollectionFolder().id() == id
-        || CommonKernel->draftsCollectionFolder().id() == id) {
+    if (mCount == mPublishedCount) {
         return;
     }
-    initListOfCollection();
+    mPublishedCount = mCount;
+    if (mSystemTray) {
+        // Update tooltip to reflect count of unread messages
+        mSystemTray->updateToolTip(mCount);
+        mSystemTray->updateStatus(mCount);
+    }
+    updateCount();
 }
 
 void UnityServiceManager::updateCount()
@@ -20,11 +20,9 @@
 #ifndef UNITYSERVICEMANAGER_H
 #define UNITYSERVICEMANAGER_H
 
-#include <QModelIndex>
 #include <QObject>
 #include <AkonadiCore/Collection>
 class QDBusServiceWatcher;
-class QAbstractItemModel;
 namespace KMail {
 class KMSystemTray;
 class UnityServiceManager : public QObject
@@ -45,19 +43,23 @@ public:
 
     bool canQueryClose();
     void toggleSystemTray(QWidget *parent);
-    void initListOfCollection();
+    /**
+     * Recomputes the unread count from the UnreadCountService of the kernel.
+     */
+    void updateUnreadCount();
     bool excludeFolder(const Akonadi::Collection &collection) const;
     bool ignoreNewMailInFolder(const Akonadi::Collection &collection);
 private:
     Q_DISABLE_COPY(UnityServiceManager)
-    void unreadMail(const QAbstractItemModel *model, const QModelIndex &parentIndex = {});
-    void slotCollectionStatisticsChanged(Akonadi::Collection::Id id, const Akonadi::CollectionStatistics &);
+    void publishCount();
+    bool countCollection(const Akonadi::Collection &collection);
     void updateCount();
     void initUnity();
     bool hasUnreadMail() const;
     QDBusServiceWatcher *mUnityServiceWatcher = nullptr;
     KMail::KMSystemTray *mSystemTray = nullptr;
     int mCount = 0;
+    int mPublishedCount = -1;
     bool mUnityServiceAvailable = false;
 };
 }
@@ -0,0 +1,235 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "unreadcountservice.h"
+#include "kmailunreadcount_debug.h"
+
+#include <AkonadiCore/CollectionFetchJob>
+#include <AkonadiCore/CollectionFetchScope>
+#include <AkonadiCore/CollectionStatistics>
+#include <AkonadiCore/Monitor>
+#include <KMime/Message>
+
+#include <QTimer>
+
+using namespace KMail;
+
+namespace {
+// Minimal delay between two notifications of the consumers
+static const int UpdateInterval = 500;
+}
+
+UnreadCountService::UnreadCountService(Akonadi::Monitor *monitor, QObject *parent)
+    : QObject(parent)
+    , mUpdateTimer(new QTimer(this))
+{
+    mUpdateTimer->setSingleShot(true);
+    mUpdateTimer->setInterval(UpdateInterval);
+    connect(mUpdateTimer, &QTimer::timeout, this, &UnreadCountService::unreadCountsChanged);
+
+    if (!monitor) {
+        mLoaded = true;
+        return;
+    }
+    connect(monitor, &Akonadi::Monitor::collectionStatisticsChanged, this, &UnreadCountService::updateStatistics);
+    connect(monitor, &Akonadi::Monitor::collectionAdded, this, &UnreadCountService::slotCollectionChanged);
+    connect(monitor, QOverload<const Akonadi::Collection &>::of(&Akonadi::Monitor::collectionChanged), this, &UnreadCountService::slotCollectionChanged);
+    connect(monitor, &Akonadi::Monitor::collectionMoved, this, &UnreadCountService::slotCollectionChanged);
+    connect(monitor, &Akonadi::Monitor::collectionSubscribed, this, &UnreadCountService::slotCollectionChanged);
+    connect(monitor, &Akonadi::Monitor::collectionRemoved, this, &UnreadCountService::slotCollectionRemoved);
+    connect(monitor, &Akonadi::Monitor::collectionUnsubscribed, this, &UnreadCountService::slotCollectionRemoved);
+
+    Akonadi::CollectionFetchJob *job = new Akonadi::CollectionFetchJob(Akonadi::Collection::root(), Akonadi::CollectionFetchJob::Recursive, this);
+    job->fetchScope().setContentMimeTypes(QStringList() << KMime::Message::mimeType());
+    job->fetchScope().setIncludeStatistics(true);
+    connect(job, &Akonadi::CollectionFetchJob::collectionsReceived, this, &UnreadCountService::slotCollectionsReceived);
+    connect(job, &KJob::result, this, &UnreadCountService::slotListingDone);
+}
+
+UnreadCountService::~UnreadCountService()
+{
+}
+
+Akonadi::Collection UnreadCountService::collection(Akonadi::Collection::Id id) const
+{
+    return mCollections.value(id);
+}
+
+qint64 UnreadCountService::unreadCount(Akonadi::Collection::Id id) const
+{
+    if (!mUnreadCollections.contains(id)) {
+        return 0;
+    }
+    return mCollections.value(id).statistics().unreadCount();
+}
+
+Akonadi::Collection::List UnreadCountService::unreadCollections() const
+{
+    Akonadi::Collection::List collections;
+    collections.reserve(mUnreadCollections.count());
+    for (Akonadi::Collection::Id id : qAsConst(mUnreadCollections)) {
+        collections.append(mCollections.value(id));
+    }
+    return collections;
+}
+
+QStringList UnreadCountService::path(Akonadi::Collection::Id id) const
+{
+    QStringList names;
+    auto it = mCollections.constFind(id);
+    while (it != mCollections.constEnd()) {
+        names.prepend(it.value().displayName());
+        const Akonadi::Collection::Id parentId = it.value().parentCollection().id();
+        if (parentId == id) {
+            break;
+        }
+        id = parentId;
+        it = mCollections.constFind(id);
+    }
+    return names;
+}
+
+bool UnreadCountService::isLoaded() const
+{
+    return mLoaded;
+}
+
+void UnreadCountService::setUpdateInterval(int msec)
+{
+    mUpdateTimer->setInterval(msec);
+}
+
+int UnreadCountService::updateInterval() const
+{
+    return mUpdateTimer->interval();
+}
+
+void UnreadCountService::updateCollection(const Akonadi::Collection &collection)
+{
+    if (!collection.isValid()) {
+        return;
+    }
+    const qint64 oldCount = unreadCount(collection.id());
+    Akonadi::Collection col = collection;
+    auto it = mCollections.find(col.id());
+    if (it != mCollections.end()) {
+        if (col.statistics().count() < 0) {
+            // change notifications come without statistics
+            col.setStatistics(it.value().statistics());
+        }
+        it.value() = col;
+        if (oldCount > 0) {
+            // the consumers show the name and check the attributes
+            scheduleUpdate();
+        }
+    } else {
+        mCollections.insert(col.id(), col);
+    }
+    setUnread(col.id(), oldCount, col.statistics().unreadCount());
+}
+
+void UnreadCountService::updateStatistics(Akonadi::Collection::Id id, const Akonadi::CollectionStatistics &statistics)
+{
+    auto it = mCollections.find(id);
+    if (it == mCollections.end()) {
+        fetchCollection(id);
+        return;
+    }
+    const qint64 oldCount = unreadCount(id);
+    it.value().setStatistics(statistics);
+    setUnread(id, oldCount, statistics.unreadCount());
+}
+
+void UnreadCountService::removeCollection(Akonadi::Collection::Id id)
+{
+    mCollections.remove(id);
+    mFetchingCollections.remove(id);
+    if (mUnreadCollections.remove(id)) {
+        scheduleUpdate();
+    }
+}
+
+void UnreadCountService::setUnread(Akonadi::Collection::Id id, qint64 oldCount, qint64 count)
+{
+    if (count > 0) {
+        mUnreadCollections.insert(id);
+    } else {
+        mUnreadCollections.remove(id);
+    }
+    if (qMax(0LL, count) != oldCount) {
+        scheduleUpdate();
+    }
+}
+
+void UnreadCountService::scheduleUpdate()
+{
+    if (!mLoaded) {
+        // reported once the listing is done
+        return;
+    }
+    if (!mUpdateTimer->isActive()) {
+        mUpdateTimer->start();
+    }
+}
+
+void UnreadCountService::fetchCollection(Akonadi::Collection::Id id)
+{
+    if (mFetchingCollections.contains(id)) {
+        return;
+    }
+    mFetchingCollections.insert(id);
+    Akonadi::CollectionFetchJob *job = new Akonadi::CollectionFetchJob(Akonadi::Collection(id), Akonadi::CollectionFetchJob::Base, this);
+    job->fetchScope().setIncludeStatistics(true);
+    connect(job, &Akonadi::CollectionFetchJob::collectionsReceived, this, &UnreadCountService::slotCollectionsReceived);
+    connect(job, &KJob::result, this, [this, id](KJob *job) {
+        // Also when the folder is gone, the next change fetches it again
+        mFetchingCollections.remove(id);
+        if (job->error()) {
+            qCDebug(KMAILUNREADCOUNT_LOG) << "Cannot fetch folder" << id << job->errorString();
+        }
+    });
+}
+
+void UnreadCountService::slotCollectionsReceived(const Akonadi::Collection::List &collections)
+{
+    for (const Akonadi::Collection &collection : collections) {
+        updateCollection(collection);
+    }
+}
+
+void UnreadCountService::slotListingDone(KJob *job)
+{
+    if (job->error()) {
+        qCWarning(KMAILUNREADCOUNT_LOG) << "Cannot list the folders:" << job->errorString();
+    }
+    qCDebug(KMAILUNREADCOUNT_LOG) << "Unread counts of" << mCollections.count() << "folders loaded";
+    mLoaded = true;
+    mUpdateTimer->stop();
+    Q_EMIT unreadCountsChanged();
+}
+
+void UnreadCountService::slotCollectionChanged(const Akonadi::Collection &collection)
+{
+    updateCollection(collection);
+}
+
+void UnreadCountService::slotCollectionRemoved(const Akonadi::Collection &collection)
+{
+    removeCollection(collection.id());
+}
@@ -0,0 +1,122 @@
+/*
+   Copyright (C) 2018 KDE PIM developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef UNREADCOUNTSERVICE_H
+#define UNREADCOUNTSERVICE_H
+
+#include "kmailunreadcount_export.h"
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <AkonadiCore/Collection>
+
+class KJob;
+class QTimer;
+
+namespace Akonadi {
+class CollectionStatistics;
+class Monitor;
+}
+
+namespace KMail {
+/**
+ * @short Keeps the unread message counts of all mail folders.
+ *
+ * The folders are listed once, and then kept up to date from the
+ * notifications of a monitor, which must fetch the collection statistics.
+ * The tray icon, the Unity launcher and the Kontact summary read the counts
+ * from here instead of walking a collection model.
+ *
+ * Bursts of changes, e.g. while a folder is synchronized, are reported by a
+ * single unreadCountsChanged() signal.
+ */
+class KMAILUNREADCOUNT_EXPORT UnreadCountService : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * Creates a service following @p monitor. Without a monitor the folders
+     * have to be fed through updateCollection() and friends.
+     */
+    explicit UnreadCountService(Akonadi::Monitor *monitor, QObject *parent = nullptr);
+    ~UnreadCountService() override;
+
+    /**
+     * Returns the folder with @p id, with its statistics, or an invalid one.
+     */
+    Akonadi::Collection collection(Akonadi::Collection::Id id) const;
+
+    /**
+     * Returns the number of unread messages in the folder with @p id.
+     */
+    qint64 unreadCount(Akonadi::Collection::Id id) const;
+
+    /**
+     * Returns the folders with unread messages.
+     */
+    Akonadi::Collection::List unreadCollections() const;
+
+    /**
+     * Returns the names of the folder with @p id and of its parents,
+     * starting with the top-level folder.
+     */
+    QStringList path(Akonadi::Collection::Id id) const;
+
+    /**
+     * Returns whether the initial listing of the folders finished.
+     */
+    bool isLoaded() const;
+
+    /**
+     * Sets the minimal delay in milliseconds between two unreadCountsChanged().
+     */
+    void setUpdateInterval(int msec);
+    int updateInterval() const;
+
+    void updateCollection(const Akonadi::Collection &collection);
+    void updateStatistics(Akonadi::Collection::Id id, const Akonadi::CollectionStatistics &statistics);
+    void removeCollection(Akonadi::Collection::Id id);
+
+Q_SIGNALS:
+    /**
+     * Emitted when unread counts or folders with unread messages changed.
+     */
+    void unreadCountsChanged();
+
+private:
+    void slotCollectionsReceived(const Akonadi::Collection::List &collections);
+    void slotListingDone(KJob *job);
+    void slotCollectionChanged(const Akonadi::Collection &collection);
+    void slotCollectionRemoved(const Akonadi::Collection &collection);
+    void fetchCollection(Akonadi::Collection::Id id);
+    void setUnread(Akonadi::Collection::Id id, qint64 oldCount, qint64 count);
+    void scheduleUpdate();
+
+    QHash<Akonadi::Collection::Id, Akonadi::Collection> mCollections;
+    QSet<Akonadi::Collection::Id> mUnreadCollections;
+    // folders reported by statistics notifications before they were known
+    QSet<Akonadi::Collection::Id> mFetchingCollections;
+    QTimer *mUpdateTimer = nullptr;
+    bool mLoaded = false;
+};
+}
+
+#endif // UNREADCOUNTSERVICE_H